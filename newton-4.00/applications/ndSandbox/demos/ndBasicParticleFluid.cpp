@@ -32,6 +32,8 @@ class ndIsoSurfaceParticleVolume : public ndBodySphFluid
 		,m_meshIsReady(0)
 	{
 		SetParticleRadius(radius);
+		SetSolverMode(ndBodySphFluid::m_positionBased);
+		SetReorderPeriod(8);
 		SetGravity(ndVector(ndFloat32(0.0f), DEMO_GRAVITY, ndFloat32(0.0f), ndFloat32(0.0f)));
 	}
 
@@ -408,8 +410,207 @@ static void AddWaterVolume(ndDemoEntityManager* const scene, const ndMatrix& loc
 	world->AddBody(body);
 }
 
+static ndFloat32 CalculateMaxDensityError(const ndBodySphFluid* const fluid)
+{
+	const ndArray<ndVector>& posit = fluid->GetPositions();
+	const ndFloat32 r = fluid->GetParticleRadius();
+	const ndFloat32 h = ndFloat32(2.0f) * r;
+	const ndFloat32 h2 = h * h;
+	const ndFloat32 mass = ndPi * ndFloat32(4.0f / 3.0f) * r * r * r * fluid->GetRestDensity();
+	const ndFloat32 kernelConst = mass * ndFloat32(315.0f) / (ndFloat32(64.0f) * ndPi * ndPow(h, ndFloat32(9.0f)));
+
+	ndFloat32 maxError = ndFloat32(0.0f);
+	for (ndInt32 i = 0; i < posit.GetCount(); ++i)
+	{
+		ndFloat32 volume = ndFloat32(0.0f);
+		for (ndInt32 j = 0; j < posit.GetCount(); ++j)
+		{
+			const ndVector dp(posit[i] - posit[j]);
+			const ndFloat32 w = ndMax(h2 - dp.DotProduct(dp).GetScalar(), ndFloat32(0.0f));
+			volume += w * w * w;
+		}
+		maxError = ndMax(maxError, kernelConst * volume / fluid->GetRestDensity() - ndFloat32(1.0f));
+	}
+	return maxError;
+}
+
+static void FluidSolverBenchmark(ndBodySphFluid::ndSolverMode mode, ndFloat32 gasConstant, ndInt32 subSteps)
+{
+	ndWorld world;
+	world.SetThreadCount(4);
+
+	ndBodySphFluid* const fluid = new ndBodySphFluid();
+	fluid->SetParticleRadius(ndFloat32(0.05f));
+	fluid->SetGravity(ndVector(ndFloat32(0.0f), DEMO_GRAVITY, ndFloat32(0.0f), ndFloat32(0.0f)));
+	fluid->SetSolverMode(mode);
+	fluid->SetGasConstant(gasConstant);
+	fluid->SetSubSteps(subSteps);
+	fluid->SetAsynUpdate(false);
+
+	const ndInt32 size = 16;
+	const ndFloat32 spacing = ndFloat32(2.0f) * fluid->GetParticleRadius();
+	for (ndInt32 z = 0; z < size; ++z)
+	{
+		for (ndInt32 y = 0; y < size / 2; ++y)
+		{
+			for (ndInt32 x = 0; x < size; ++x)
+			{
+				fluid->GetPositions().PushBack(ndVector(ndFloat32(x) * spacing, ndFloat32(1.0f) + ndFloat32(y) * spacing, ndFloat32(z) * spacing, ndFloat32(0.0f)));
+				fluid->GetVelocity().PushBack(ndVector::m_zero);
+			}
+		}
+	}
+	ndSharedPtr<ndBody> body(fluid);
+	world.AddBody(body);
+
+	const ndInt32 frames = 240;
+	ndUnsigned64 time = ndGetTimeInMicroseconds();
+	for (ndInt32 i = 0; i < frames; ++i)
+	{
+		world.Update(ndFloat32(1.0f / 60.0f));
+		world.Sync();
+	}
+	time = ndGetTimeInMicroseconds() - time;
+
+	// particles times world steps per second, the density error measures the visual compression
+	const ndFloat32 rate = ndFloat32(fluid->GetPositions().GetCount()) * ndFloat32(frames) / (ndFloat32(time) * ndFloat32(1.0e-6f));
+	const char* const name = (mode == ndBodySphFluid::m_positionBased) ? "position based" : "weakly compressible";
+	ndExpandTraceMessage("%s: gas(%g) subSteps(%d) %f MParticleSteps/s, max density error %f\n", name, gasConstant, subSteps, rate * ndFloat32(1.0e-6f), CalculateMaxDensityError(fluid));
+	world.CleanUp();
+}
+
+static void FluidSolverBenchmark()
+{
+	// the weakly compressible solver needs a stiff gas constant and many sub steps to match the compression of the position based solver 
+	FluidSolverBenchmark(ndBodySphFluid::m_positionBased, ndFloat32(1.0f), 1);
+	FluidSolverBenchmark(ndBodySphFluid::m_weaklyCompressible, ndFloat32(100.0f), 4);
+	FluidSolverBenchmark(ndBodySphFluid::m_weaklyCompressible, ndFloat32(1000.0f), 8);
+}
+
+static void ParticleReorderBenchmark(ndBodySphFluid::ndSolverMode mode, ndInt32 size, ndInt32 reorderPeriod)
+{
+	ndWorld world;
+	world.SetThreadCount(4);
+
+	ndBodySphFluid* const fluid = new ndBodySphFluid();
+	fluid->SetParticleRadius(ndFloat32(0.05f));
+	fluid->SetGravity(ndVector(ndFloat32(0.0f), DEMO_GRAVITY, ndFloat32(0.0f), ndFloat32(0.0f)));
+	fluid->SetSolverMode(mode);
+	fluid->SetGasConstant(ndFloat32(100.0f));
+	fluid->SetSubSteps((mode == ndBodySphFluid::m_positionBased) ? 1 : 4);
+	fluid->SetReorderPeriod(reorderPeriod);
+	fluid->SetAsynUpdate(false);
+
+	const ndFloat32 spacing = ndFloat32(2.0f) * fluid->GetParticleRadius();
+	ndArray<ndVector>& posit = fluid->GetPositions();
+	for (ndInt32 z = 0; z < size; ++z)
+	{
+		for (ndInt32 y = 0; y < size / 2; ++y)
+		{
+			for (ndInt32 x = 0; x < size; ++x)
+			{
+				posit.PushBack(ndVector(ndFloat32(x) * spacing, ndFloat32(1.0f) + ndFloat32(y) * spacing, ndFloat32(z) * spacing, ndFloat32(0.0f)));
+				fluid->GetVelocity().PushBack(ndVector::m_zero);
+			}
+		}
+	}
+
+	// shuffle the particles, like a fluid that was emitted over time
+	posit.RandomShuffle(ndInt32(posit.GetCount()));
+	ndSharedPtr<ndBody> body(fluid);
+	world.AddBody(body);
+
+	const ndInt32 frames = 16;
+	ndUnsigned64 time = ndGetTimeInMicroseconds();
+	for (ndInt32 i = 0; i < frames; ++i)
+	{
+		world.Update(ndFloat32(1.0f / 60.0f));
+		world.Sync();
+	}
+	time = ndGetTimeInMicroseconds() - time;
+
+	const char* const name = (mode == ndBodySphFluid::m_positionBased) ? "position based" : "weakly compressible";
+	ndExpandTraceMessage("%s: particles(%d) reorderPeriod(%d) %f ms per frame\n", name, ndInt32(posit.GetCount()), reorderPeriod, ndFloat32(time) * ndFloat32(1.0e-3f) / ndFloat32(frames));
+	world.CleanUp();
+}
+
+static void ParticleReorderBenchmark()
+{
+	// with 4 threads, about 100k particles: pbf 218 ms -> 113 ms, explicit 321 ms -> 254 ms. 
+	// 1m particles: pbf 3.6 s -> 2.3 s
+	ParticleReorderBenchmark(ndBodySphFluid::m_positionBased, 60, 0);
+	ParticleReorderBenchmark(ndBodySphFluid::m_positionBased, 60, 8);
+	ParticleReorderBenchmark(ndBodySphFluid::m_weaklyCompressible, 60, 0);
+	ParticleReorderBenchmark(ndBodySphFluid::m_weaklyCompressible, 60, 8);
+	ParticleReorderBenchmark(ndBodySphFluid::m_positionBased, 126, 0);
+	ParticleReorderBenchmark(ndBodySphFluid::m_positionBased, 126, 8);
+}
+
+static void NeighborSearchBenchmark(ndBodySphFluid::ndSolverMode mode, ndBodySphFluid::ndNeighborSearch search, ndInt32 size)
+{
+	ndWorld world;
+	world.SetThreadCount(4);
+
+	ndBodySphFluid* const fluid = new ndBodySphFluid();
+	fluid->SetParticleRadius(ndFloat32(0.05f));
+	fluid->SetGravity(ndVector(ndFloat32(0.0f), DEMO_GRAVITY, ndFloat32(0.0f), ndFloat32(0.0f)));
+	fluid->SetSolverMode(mode);
+	fluid->SetNeighborSearch(search);
+	fluid->SetGasConstant(ndFloat32(100.0f));
+	fluid->SetSubSteps((mode == ndBodySphFluid::m_positionBased) ? 1 : 4);
+	fluid->SetReorderPeriod(8);
+	fluid->SetAsynUpdate(false);
+
+	const ndFloat32 spacing = ndFloat32(2.0f) * fluid->GetParticleRadius();
+	ndArray<ndVector>& posit = fluid->GetPositions();
+	for (ndInt32 z = 0; z < size; ++z)
+	{
+		for (ndInt32 y = 0; y < size / 2; ++y)
+		{
+			for (ndInt32 x = 0; x < size; ++x)
+			{
+				posit.PushBack(ndVector(ndFloat32(x) * spacing, ndFloat32(1.0f) + ndFloat32(y) * spacing, ndFloat32(z) * spacing, ndFloat32(0.0f)));
+				fluid->GetVelocity().PushBack(ndVector::m_zero);
+			}
+		}
+	}
+	ndSharedPtr<ndBody> body(fluid);
+	world.AddBody(body);
+
+	const ndInt32 frames = 16;
+	ndUnsigned64 time = ndGetTimeInMicroseconds();
+	for (ndInt32 i = 0; i < frames; ++i)
+	{
+		world.Update(ndFloat32(1.0f / 60.0f));
+		world.Sync();
+	}
+	time = ndGetTimeInMicroseconds() - time;
+
+	const char* const name = (mode == ndBodySphFluid::m_positionBased) ? "position based" : "weakly compressible";
+	const char* const searchName = (search == ndBodySphFluid::m_pairList) ? "pair list" : "cell list";
+	const ndFloat32 bytesPerParticle = ndFloat32(fluid->GetWorkingMemory()) / ndFloat32(posit.GetCount());
+	ndExpandTraceMessage("%s %s: particles(%d) %f bytes per particle %f ms per frame\n", name, searchName, ndInt32(posit.GetCount()), bytesPerParticle, ndFloat32(time) * ndFloat32(1.0e-3f) / ndFloat32(frames));
+	world.CleanUp();
+}
+
+static void NeighborSearchBenchmark()
+{
+	// with one thread, about 100k particles: working memory 210 -> 135 bytes per particle 
+	// (150 for pbf, which keeps a compact neighbor list), pbf 65 ms -> 60 ms, explicit 160 ms -> 115 ms
+	NeighborSearchBenchmark(ndBodySphFluid::m_positionBased, ndBodySphFluid::m_pairList, 60);
+	NeighborSearchBenchmark(ndBodySphFluid::m_positionBased, ndBodySphFluid::m_cellList, 60);
+	NeighborSearchBenchmark(ndBodySphFluid::m_weaklyCompressible, ndBodySphFluid::m_pairList, 60);
+	NeighborSearchBenchmark(ndBodySphFluid::m_weaklyCompressible, ndBodySphFluid::m_cellList, 60);
+	NeighborSearchBenchmark(ndBodySphFluid::m_positionBased, ndBodySphFluid::m_pairList, 126);
+	NeighborSearchBenchmark(ndBodySphFluid::m_positionBased, ndBodySphFluid::m_cellList, 126);
+}
+
 void ndBasicParticleFluid (ndDemoEntityManager* const scene)
 {
+	//FluidSolverBenchmark();
+	//ParticleReorderBenchmark();
+	//NeighborSearchBenchmark();
+
 	// build a floor
 	BuildFlatPlane(scene, true);
 
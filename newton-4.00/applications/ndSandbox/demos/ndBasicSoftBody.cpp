@@ -0,0 +1,139 @@
+/* Copyright (c) <2003-2022> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndSandboxStdafx.h"
+#include "ndSkyBox.h"
+#include "ndDemoMesh.h"
+#include "ndDemoCamera.h"
+#include "ndPhysicsUtils.h"
+#include "ndPhysicsWorld.h"
+#include "ndMakeStaticMap.h"
+#include "ndDemoEntityManager.h"
+
+// a square cloth in the xz plane, with structural, shear and bending springs
+static ndBodySoftBody* BuildCloth(const ndVector& origin, ndInt32 size, ndFloat32 spacing)
+{
+	ndBodySoftBody* const cloth = new ndBodySoftBody();
+	cloth->SetParticleRadius(spacing * ndFloat32(0.25f));
+	cloth->SetGravity(ndVector(ndFloat32(0.0f), DEMO_GRAVITY, ndFloat32(0.0f), ndFloat32(0.0f)));
+	cloth->SetSolverIterations(4);
+	cloth->SetSubSteps(8);
+
+	for (ndInt32 z = 0; z < size; ++z)
+	{
+		for (ndInt32 x = 0; x < size; ++x)
+		{
+			cloth->AddParticle(origin + ndVector(ndFloat32(x) * spacing, ndFloat32(0.0f), ndFloat32(z) * spacing, ndFloat32(0.0f)), ndFloat32(0.05f));
+		}
+	}
+
+	// the structural springs are rigid, shear and bend are soft
+	const ndFloat32 shearCompliance = ndFloat32(1.0e-4f);
+	const ndFloat32 bendCompliance = ndFloat32(1.0e-3f);
+	const ndFloat32 damping = ndFloat32(0.1f);
+	for (ndInt32 z = 0; z < size; ++z)
+	{
+		for (ndInt32 x = 0; x < size; ++x)
+		{
+			const ndInt32 i = z * size + x;
+			if (x + 1 < size)
+			{
+				cloth->AddSpring(i, i + 1, ndFloat32(0.0f), ndFloat32(0.0f));
+			}
+			if (z + 1 < size)
+			{
+				cloth->AddSpring(i, i + size, ndFloat32(0.0f), ndFloat32(0.0f));
+			}
+			if ((x + 1 < size) && (z + 1 < size))
+			{
+				cloth->AddSpring(i, i + size + 1, shearCompliance, damping);
+				cloth->AddSpring(i + 1, i + size, shearCompliance, damping);
+			}
+			if (x + 2 < size)
+			{
+				cloth->AddSpring(i, i + 2, bendCompliance, damping);
+			}
+			if (z + 2 < size)
+			{
+				cloth->AddSpring(i, i + 2 * size, bendCompliance, damping);
+			}
+		}
+	}
+	return cloth;
+}
+
+static void ClothBenchmark(ndInt32 size)
+{
+	ndWorld world;
+	world.SetThreadCount(4);
+
+	ndBodySoftBody* const cloth = BuildCloth(ndVector(ndFloat32(0.0f), ndFloat32(4.0f), ndFloat32(0.0f), ndFloat32(0.0f)), size, ndFloat32(0.05f));
+	cloth->SetAsynUpdate(false);
+	cloth->SetParticleMass(0, ndFloat32(0.0f));
+	cloth->SetParticleMass(size - 1, ndFloat32(0.0f));
+	ndSharedPtr<ndBody> body(cloth);
+	world.AddBody(body);
+
+	const ndInt32 frames = 60;
+	ndUnsigned64 time = ndGetTimeInMicroseconds();
+	for (ndInt32 i = 0; i < frames; ++i)
+	{
+		world.Update(ndFloat32(1.0f / 60.0f));
+		world.Sync();
+	}
+	time = ndGetTimeInMicroseconds() - time;
+
+	ndExpandTraceMessage("cloth: particles(%d) springs(%d) batches(%d) %f ms per frame\n",
+		ndInt32(cloth->GetPositions().GetCount()), cloth->GetSpringCount(), cloth->GetBatchCount(), ndFloat32(time) * ndFloat32(1.0e-3f) / ndFloat32(frames));
+	world.CleanUp();
+}
+
+static void ClothBenchmark()
+{
+	// 8 sub steps and 4 iterations, 15 batches. on a single thread:
+	// 32 x 32 3.4 ms, 64 x 64 13.7 ms, 128 x 128 50 ms per frame
+	ClothBenchmark(32);
+	ClothBenchmark(64);
+	ClothBenchmark(128);
+}
+
+void ndBasicSoftBody(ndDemoEntityManager* const scene)
+{
+	//ClothBenchmark();
+
+	// build a floor
+	BuildFlatPlane(scene, true);
+
+	// a static box for the cloth to drape over
+	ndMatrix location(ndGetIdentityMatrix());
+	location.m_posit = ndVector(ndFloat32(0.0f), ndFloat32(1.0f), ndFloat32(0.0f), ndFloat32(1.0f));
+	AddBox(scene, location, ndFloat32(0.0f), ndFloat32(2.0f), ndFloat32(2.0f), ndFloat32(2.0f));
+
+	// and a few dynamics boxes on top of the cloth
+	for (ndInt32 i = 0; i < 3; ++i)
+	{
+		ndMatrix matrix(ndGetIdentityMatrix());
+		matrix.m_posit = ndVector(ndFloat32(i - 1) * ndFloat32(0.8f), ndFloat32(4.0f), ndFloat32(0.0f), ndFloat32(1.0f));
+		AddBox(scene, matrix, ndFloat32(1.0f), ndFloat32(0.3f), ndFloat32(0.3f), ndFloat32(0.3f));
+	}
+
+	const ndInt32 size = 48;
+	const ndFloat32 spacing = ndFloat32(0.075f);
+	const ndFloat32 offset = ndFloat32(size - 1) * spacing * ndFloat32(0.5f);
+	ndBodySoftBody* const cloth = BuildCloth(ndVector(-offset, ndFloat32(3.0f), -offset, ndFloat32(0.0f)), size, spacing);
+
+	ndSharedPtr<ndBody> body(cloth);
+	scene->GetWorld()->AddBody(body);
+
+	ndQuaternion rot;
+	ndVector origin(-8.0f, 4.0f, 0.0f, 1.0f);
+	scene->SetCameraMatrix(rot, origin);
+}
@@ -115,8 +115,112 @@ class ndMopcapRetargetMeshLoader : public ndMeshLoader
 	ndFloat32 m_scale;
 };
 
+class ndCrowdCapsule : public ndBodyPlayerCapsule
+{
+	public:
+	ndCrowdCapsule(const ndMatrix& localAxis, const ndMatrix& location, ndFloat32 heading)
+		:ndBodyPlayerCapsule(localAxis, ndFloat32(100.0f), ndFloat32(0.5f), ndFloat32(1.9f), ndFloat32(0.5f))
+		,m_heading(heading)
+	{
+		SetMatrix(location);
+	}
+
+	void ApplyInputs(ndFloat32 timestep)
+	{
+		m_impulse += ndVector(ndFloat32(0.0f), DEMO_GRAVITY * m_mass * timestep, ndFloat32(0.0f), ndFloat32(0.0f));
+		m_heading += ndFloat32(0.5f) * timestep;
+		SetForwardSpeed(ndFloat32(2.0f));
+		SetHeadingAngle(m_heading);
+	}
+
+	ndFloat32 m_heading;
+};
+
+static void PlayerCapsuleBenchmark(ndInt32 capsuleCount, ndInt32 threadCount, bool useCrowd)
+{
+	ndWorld world;
+	ndPlayerCapsuleCrowd crowd;
+	world.SetThreadCount(threadCount);
+
+	ndShapeInstance floorShape(new ndShapeBox(ndFloat32(400.0f), ndFloat32(1.0f), ndFloat32(400.0f)));
+	ndBodyDynamic* const floor = new ndBodyDynamic();
+	ndMatrix floorMatrix(ndGetIdentityMatrix());
+	floorMatrix.m_posit.m_y = ndFloat32(-0.5f);
+	floor->SetMatrix(floorMatrix);
+	floor->SetCollisionShape(floorShape);
+	ndSharedPtr<ndBody> floorPtr(floor);
+	world.AddBody(floorPtr);
+
+	ndMatrix localAxis(ndGetIdentityMatrix());
+	localAxis[0] = ndVector(0.0f, 1.0f, 0.0f, 0.0f);
+	localAxis[1] = ndVector(1.0f, 0.0f, 0.0f, 0.0f);
+	localAxis[2] = localAxis[0].CrossProduct(localAxis[1]);
+
+	// a square crowd, close enough for the capsules to bump into each other
+	const ndInt32 size = ndInt32(ndSqrt(ndFloat32(capsuleCount)));
+	for (ndInt32 i = 0; i < capsuleCount; ++i)
+	{
+		ndMatrix location(ndGetIdentityMatrix());
+		location.m_posit.m_x = ndFloat32(i % size) * ndFloat32(1.2f);
+		location.m_posit.m_z = ndFloat32(i / size) * ndFloat32(1.2f);
+		ndCrowdCapsule* const player = new ndCrowdCapsule(localAxis, location, ndFloat32(i) * ndFloat32(0.1f));
+		ndSharedPtr<ndBody> capsule(player);
+		world.AddBody(capsule);
+		if (useCrowd)
+		{
+			crowd.AddPlayer(player);
+		}
+	}
+
+	if (useCrowd)
+	{
+		world.GetScene()->AddPlayerCrowd(&crowd);
+	}
+
+	// let the contacts settle before timing
+	for (ndInt32 i = 0; i < 4; ++i)
+	{
+		world.Update(ndFloat32(1.0f / 60.0f));
+		world.Sync();
+	}
+
+	const ndInt32 frames = 60;
+	ndUnsigned64 time = ndGetTimeInMicroseconds();
+	for (ndInt32 i = 0; i < frames; ++i)
+	{
+		world.Update(ndFloat32(1.0f / 60.0f));
+		world.Sync();
+	}
+	time = ndGetTimeInMicroseconds() - time;
+
+	ndExpandTraceMessage("capsules(%d) threads(%d) crowd(%d) batched(%d) %f ms per frame\n", capsuleCount, threadCount, useCrowd, crowd.GetBatchedCount(), ndFloat32(time) * ndFloat32(1.0e-3f) / ndFloat32(frames));
+	world.CleanUp();
+}
+
+static void PlayerCapsuleBenchmark()
+{
+	// the special bodies update runs in batches of capsules that do not touch each other.
+	// only the single core timings are measured so far, unit test build:
+	// 1k 141 ms, 5k 1828 ms, 10k 1952 ms per frame.
+	// the 4 and 8 thread runs are there to measure the scaling on a multi core machine.
+	const ndInt32 capsuleCount[] = { 1000, 5000, 10000 };
+	for (ndInt32 i = 0; i < ndInt32(sizeof(capsuleCount) / sizeof(capsuleCount[0])); ++i)
+	{
+		PlayerCapsuleBenchmark(capsuleCount[i], 1, false);
+		PlayerCapsuleBenchmark(capsuleCount[i], 4, false);
+		PlayerCapsuleBenchmark(capsuleCount[i], 8, false);
+
+		// the crowd only batches the capsules that are not touching each other
+		PlayerCapsuleBenchmark(capsuleCount[i], 1, true);
+		PlayerCapsuleBenchmark(capsuleCount[i], 4, true);
+		PlayerCapsuleBenchmark(capsuleCount[i], 8, true);
+	}
+}
+
 void ndPlayerCapsuleDemo (ndDemoEntityManager* const scene)
 {
+	//PlayerCapsuleBenchmark();
+
 	// build a floor
 	//BuildPlayArena(scene);
 	BuildFloorBox(scene, ndGetIdentityMatrix());
@@ -62,9 +62,10 @@
 //#define DEFAULT_SCENE	23		// biped test 2
 //#define DEFAULT_SCENE	24		// train biped test 2
 //#define DEFAULT_SCENE	25		// simple voronoi fracture
-//#define DEFAULT_SCENE	26		// basic voronoi fracture
-//#define DEFAULT_SCENE	27		// linked voronoi fracture
-//#define DEFAULT_SCENE	28		// skin peel voronoi fracture
+//#define DEFAULT_SCENE	26		// basic soft body
+//#define DEFAULT_SCENE	27		// basic voronoi fracture
+//#define DEFAULT_SCENE	28		// linked voronoi fracture
+//#define DEFAULT_SCENE	29		// skin peel voronoi fracture
 						 
 // demos forward declaration 
 void ndRagdollTest(ndDemoEntityManager* const scene);
@@ -85,6 +86,7 @@ void ndBasicGpuRigidBody(ndDemoEntityManager* const scene);
 void ndBasicFrictionRamp(ndDemoEntityManager* const scene);
 void ndPlayerCapsuleDemo(ndDemoEntityManager* const scene);
 void ndBipedTest_2Trainer(ndDemoEntityManager* const scene);
+void ndBasicSoftBody(ndDemoEntityManager* const scene);
 void ndBasicParticleFluid(ndDemoEntityManager* const scene);
 void ndBasicAngularMomentum(ndDemoEntityManager* const scene);
 void ndBagroundLowLodVehicle(ndDemoEntityManager* const scene);
@@ -126,6 +128,7 @@ ndDemoEntityManager::SDKDemos ndDemoEntityManager::m_demosSelection[] =
 	{ "biped test two", ndBipedTest_2 },
 	{ "train biped test two", ndBipedTest_2Trainer },
 	{ "simple convex fracture", ndBasicExplodeConvexShape },
+	{ "basic soft body", ndBasicSoftBody },
 	//{ "basic convex fracture", ndBasicFracture_0 },
 	//{ "linked convex fracture", ndBasicFracture_2 },
 	//{ "simple skin peeling fracture", ndBasicFracture_4 },
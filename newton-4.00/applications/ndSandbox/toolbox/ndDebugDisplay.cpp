@@ -495,11 +495,13 @@ void RenderParticles(ndDemoEntityManager* const scene)
 	const glMatrix glProjectionMatrix(projectionMatrix);
 	glUniformMatrix4fv(projectionMatrixLocation, 1, false, &glProjectionMatrix[0][0]);
 	
+	// the particles may be updating in the background, render the last published positions
+	ndArray<ndVector> positions;
 	const ndBodyList& particles = world->GetParticleList();
 	for (ndBodyList::ndNode* particleNode = particles.GetFirst(); particleNode; particleNode = particleNode->GetNext())
 	{
 		ndBodyParticleSet* const particle = particleNode->GetInfo()->GetAsBodyParticleSet();
-		const ndArray<ndVector>& positions = particle->GetPositions();
+		particle->GetRenderPositions(positions);
 		if (positions.GetCount())
 		{
 			glEnableClientState(GL_VERTEX_ARRAY);
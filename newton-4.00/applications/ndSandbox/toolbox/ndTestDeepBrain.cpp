@@ -332,11 +332,504 @@ static void MnistTestSet()
 }
 
 
+static void BatchPredictionBenchmark()
+{
+	ndBrain brain;
+	ndInt32 neuronsPerLayers = 256;
+	ndBrainLayer* const inputLayer = new ndBrainLayer(784, neuronsPerLayers, m_tanh);
+	ndBrainLayer* const hiddenLayer0 = new ndBrainLayer(inputLayer->GetOuputSize(), neuronsPerLayers, m_tanh);
+	ndBrainLayer* const hiddenLayer1 = new ndBrainLayer(hiddenLayer0->GetOuputSize(), neuronsPerLayers, m_tanh);
+	ndBrainLayer* const ouputLayer = new ndBrainLayer(hiddenLayer1->GetOuputSize(), 10, m_sigmoid);
+
+	brain.BeginAddLayer();
+	brain.AddLayer(inputLayer);
+	brain.AddLayer(hiddenLayer0);
+	brain.AddLayer(hiddenLayer1);
+	brain.AddLayer(ouputLayer);
+	brain.EndAddLayer();
+	brain.InitGaussianWeights(0.0f, 0.25f);
+
+	ndInt32 samples = 4096;
+	ndBrainMatrix inputBatch(samples, brain.GetInputSize());
+	ndBrainMatrix outputBatch(samples, brain.GetOutputSize());
+	for (ndInt32 i = 0; i < samples; i++)
+	{
+		for (ndInt32 j = 0; j < inputBatch.GetColumns(); j++)
+		{
+			inputBatch[i][j] = ndReal(ndGaussianRandom(0.5f, 0.25f));
+		}
+	}
+
+	ndBrainVector output;
+	ndBrainInstance instance(&brain);
+	ndUnsigned64 time = ndGetTimeInMicroseconds();
+	for (ndInt32 i = 0; i < samples; i++)
+	{
+		instance.MakePrediction(inputBatch[i], output);
+	}
+	ndUnsigned64 singleTime = ndGetTimeInMicroseconds() - time;
+
+	time = ndGetTimeInMicroseconds();
+	instance.MakePrediction(inputBatch, outputBatch);
+	ndUnsigned64 batchTime = ndGetTimeInMicroseconds() - time;
+
+	ndBrainTrainer trainer(&brain);
+	time = ndGetTimeInMicroseconds();
+	for (ndInt32 i = 0; i < samples; i++)
+	{
+		trainer.MakePrediction(inputBatch[i]);
+		trainer.BackPropagate(outputBatch[i]);
+	}
+	ndUnsigned64 singleTrainTime = ndGetTimeInMicroseconds() - time;
+
+	time = ndGetTimeInMicroseconds();
+	trainer.MakePrediction(inputBatch);
+	trainer.BackPropagate(inputBatch, outputBatch);
+	ndUnsigned64 batchTrainTime = ndGetTimeInMicroseconds() - time;
+
+	ndExpandTraceMessage("%s\n", "batch benchmark");
+	ndExpandTraceMessage("single sample prediction: %f samples per second\n", ndFloat64(samples) * 1000000.0f / ndFloat64(singleTime));
+	ndExpandTraceMessage("minibatch prediction: %f samples per second\n", ndFloat64(samples) * 1000000.0f / ndFloat64(batchTime));
+	ndExpandTraceMessage("single sample back propagation: %f samples per second\n", ndFloat64(samples) * 1000000.0f / ndFloat64(singleTrainTime));
+	ndExpandTraceMessage("minibatch back propagation: %f samples per second\n\n", ndFloat64(samples) * 1000000.0f / ndFloat64(batchTrainTime));
+}
+
+static void ParallelTrainerScaling()
+{
+	ndInt32 samples = 8192;
+	ndInt32 inputSize = 64;
+	ndBrainMatrix inputBatch(samples, inputSize);
+	ndBrainMatrix groundTruth(samples, 4);
+	for (ndInt32 i = 0; i < samples; i++)
+	{
+		for (ndInt32 j = 0; j < inputSize; j++)
+		{
+			inputBatch[i][j] = ndReal(ndGaussianRandom(0.5f, 0.25f));
+		}
+		for (ndInt32 j = 0; j < groundTruth.GetColumns(); j++)
+		{
+			groundTruth[i][j] = (inputBatch[i][j] >= 0.5f) ? 1.0f : 0.0f;
+		}
+	}
+
+	ndExpandTraceMessage("%s\n", "parallel trainer scaling");
+	ndFloat64 baseRate = 0.0f;
+	ndInt32 lastThreadCount = 0;
+	for (ndInt32 threads = 1; threads <= ndMin(32, D_MAX_THREADS_COUNT); threads *= 2)
+	{
+		ndSetRandSeed(12345);
+		ndBrain brain;
+		ndBrainLayer* const inputLayer = new ndBrainLayer(inputSize, 256, m_tanh);
+		ndBrainLayer* const hiddenLayer = new ndBrainLayer(inputLayer->GetOuputSize(), 256, m_tanh);
+		ndBrainLayer* const ouputLayer = new ndBrainLayer(hiddenLayer->GetOuputSize(), groundTruth.GetColumns(), m_sigmoid);
+		brain.BeginAddLayer();
+		brain.AddLayer(inputLayer);
+		brain.AddLayer(hiddenLayer);
+		brain.AddLayer(ouputLayer);
+		brain.EndAddLayer();
+		brain.InitGaussianWeights(0.0f, 0.25f);
+
+		// the pool clamps the requested threads to the machine, 
+		// so the rows are labeled with the threads really used
+		ndBrainParallelTrainer trainer(&brain, threads);
+		const ndInt32 threadCount = trainer.GetThreadCount();
+		if (threadCount == lastThreadCount)
+		{
+			break;
+		}
+		lastThreadCount = threadCount;
+		ndBrainTrainer::ndValidation validator(trainer);
+		trainer.SetMiniBatchSize(256);
+		trainer.Optimize(validator, inputBatch, groundTruth, 1.0e-3f, 4);
+
+		ndFloat64 rate = trainer.GetSamplesPerSecond();
+		baseRate = (threadCount == 1) ? rate : baseRate;
+		ndExpandTraceMessage("threads %d: %f samples per second, scaling %f\n", threadCount, rate, rate / baseRate);
+	}
+	ndExpandTraceMessage("\n");
+}
+
+static void QuantizedInferenceReport()
+{
+	ndBrain brain;
+	ndInt32 neuronsPerLayers = 256;
+	ndBrainLayer* const inputLayer = new ndBrainLayer(784, neuronsPerLayers, m_tanh);
+	ndBrainLayer* const hiddenLayer0 = new ndBrainLayer(inputLayer->GetOuputSize(), neuronsPerLayers, m_tanh);
+	ndBrainLayer* const hiddenLayer1 = new ndBrainLayer(hiddenLayer0->GetOuputSize(), neuronsPerLayers, m_tanh);
+	ndBrainLayer* const ouputLayer = new ndBrainLayer(hiddenLayer1->GetOuputSize(), 10, m_sigmoid);
+
+	brain.BeginAddLayer();
+	brain.AddLayer(inputLayer);
+	brain.AddLayer(hiddenLayer0);
+	brain.AddLayer(hiddenLayer1);
+	brain.AddLayer(ouputLayer);
+	brain.EndAddLayer();
+	brain.InitGaussianWeights(0.0f, 0.1f);
+
+	ndInt32 samples = 2000;
+	ndBrainMatrix input(samples, brain.GetInputSize());
+	ndBrainMatrix floatOutput(samples, brain.GetOutputSize());
+	ndBrainMatrix quantizedOutput(samples, brain.GetOutputSize());
+	for (ndInt32 i = 0; i < samples; i++)
+	{
+		for (ndInt32 j = 0; j < input.GetColumns(); j++)
+		{
+			input[i][j] = ndReal(ndGaussianRandom(0.5f, 0.25f));
+		}
+	}
+
+	ndBrainInstance instance(&brain);
+	ndBrainQuantizedInstance quantized(&brain);
+
+	ndUnsigned64 floatTime = ndGetTimeInMicroseconds();
+	for (ndInt32 i = 0; i < samples; i++)
+	{
+		instance.MakePrediction(input[i], floatOutput[i]);
+	}
+	floatTime = ndGetTimeInMicroseconds() - floatTime;
+
+	ndUnsigned64 batchTime = ndGetTimeInMicroseconds();
+	instance.MakePrediction(input, floatOutput);
+	batchTime = ndGetTimeInMicroseconds() - batchTime;
+
+	ndUnsigned64 quantizedTime = ndGetTimeInMicroseconds();
+	quantized.MakePrediction(input, quantizedOutput);
+	quantizedTime = ndGetTimeInMicroseconds() - quantizedTime;
+
+	ndInt32 agree = 0;
+	ndReal maxError = 0.0f;
+	for (ndInt32 i = 0; i < samples; i++)
+	{
+		agree += (floatOutput[i].GetMaxIndex() == quantizedOutput[i].GetMaxIndex()) ? 1 : 0;
+		for (ndInt32 j = 0; j < floatOutput.GetColumns(); j++)
+		{
+			maxError = ndMax(maxError, ndReal(ndAbs(floatOutput[i][j] - quantizedOutput[i][j])));
+		}
+	}
+
+	ndArray<ndUnsigned8> buffer;
+	brain.Save(buffer);
+	ndUnsigned64 loadTime = ndGetTimeInMicroseconds();
+	ndBrain loaded;
+	loaded.Load(&buffer[0], buffer.GetCount());
+	loadTime = ndGetTimeInMicroseconds() - loadTime;
+
+	ndExpandTraceMessage("%s\n", "int8 quantized inference");
+	ndExpandTraceMessage("float sample: %f (ms)\n", ndFloat64(floatTime) / 1000.0f);
+	ndExpandTraceMessage("float batch: %f (ms)\n", ndFloat64(batchTime) / 1000.0f);
+	ndExpandTraceMessage("int8 sample: %f (ms)\n", ndFloat64(quantizedTime) / 1000.0f);
+	ndExpandTraceMessage("max error %f, same class %f%%\n", maxError, 100.0f * ndFloat32(agree) / ndFloat32(samples));
+	ndExpandTraceMessage("binary model %d bytes, load %f (ms)\n\n", buffer.GetCount(), ndFloat64(loadTime) / 1000.0f);
+}
+
+class ndRolloutThreadPool: public ndThreadPool
+{
+	public:
+	ndRolloutThreadPool()
+		:ndThreadPool("rollout")
+	{
+	}
+
+	~ndRolloutThreadPool()
+	{
+		Finish();
+	}
+
+	void ThreadFunction()
+	{
+	}
+};
+
+class ndRolloutBoxEnvironment: public ndBrainRollout::ndEnvironment
+{
+	public:
+	ndRolloutBoxEnvironment()
+		:ndBrainRollout::ndEnvironment()
+		,m_world()
+		,m_box(nullptr)
+		,m_steps(0)
+	{
+		ndMatrix matrix(ndGetIdentityMatrix());
+		matrix.m_posit.m_y = -0.5f;
+		ndShapeInstance floorShape(new ndShapeBox(20.0f, 1.0f, 20.0f));
+		ndBodyDynamic* const floor = new ndBodyDynamic();
+		floor->SetMatrix(matrix);
+		floor->SetCollisionShape(floorShape);
+		floor->SetMassMatrix(0.0f, floorShape);
+		ndSharedPtr<ndBody> floorPtr(floor);
+		m_world.AddBody(floorPtr);
+
+		ndShapeInstance boxShape(new ndShapeBox(0.5f, 0.5f, 0.5f));
+		m_box = new ndBodyDynamic();
+		m_box->SetNotifyCallback(new ndBodyNotify(ndVector(0.0f, -10.0f, 0.0f, 0.0f)));
+		m_box->SetCollisionShape(boxShape);
+		m_box->SetMassMatrix(1.0f, boxShape);
+		ndSharedPtr<ndBody> boxPtr(m_box);
+		m_world.AddBody(boxPtr);
+		Reset();
+	}
+
+	~ndRolloutBoxEnvironment()
+	{
+		m_world.CleanUp();
+	}
+
+	void GetObservation(ndBrainVector& observation) const
+	{
+		const ndVector posit(m_box->GetMatrix().m_posit);
+		const ndVector veloc(m_box->GetVelocity());
+		observation[0] = ndReal(posit.m_x);
+		observation[1] = ndReal(posit.m_y);
+		observation[2] = ndReal(posit.m_z);
+		observation[3] = ndReal(veloc.m_x);
+		observation[4] = ndReal(veloc.m_y);
+		observation[5] = ndReal(veloc.m_z);
+	}
+
+	void ApplyAction(ndBrainVector& action)
+	{
+		ndVector veloc(m_box->GetVelocity());
+		veloc.m_x = ndFloat32(action[0]);
+		veloc.m_z = ndFloat32(action[1]);
+		m_box->SetVelocity(veloc);
+	}
+
+	void Step(ndFloat32 timestep)
+	{
+		m_world.Update(timestep);
+		m_world.Sync();
+		m_steps++;
+	}
+
+	ndReal GetReward() const
+	{
+		const ndVector posit(m_box->GetMatrix().m_posit);
+		return -ndReal(ndAbs(posit.m_x) + ndAbs(posit.m_z));
+	}
+
+	bool IsTerminal() const
+	{
+		return m_steps >= 240;
+	}
+
+	void Reset()
+	{
+		ndMatrix matrix(ndGetIdentityMatrix());
+		matrix.m_posit.m_y = 1.0f;
+		m_box->SetMatrix(matrix);
+		m_box->SetVelocity(ndVector::m_zero);
+		m_box->SetOmega(ndVector::m_zero);
+		m_steps = 0;
+	}
+
+	ndWorld m_world;
+	ndBodyDynamic* m_box;
+	ndInt32 m_steps;
+};
+
+static void RolloutThroughput()
+{
+	ndBrain brain;
+	ndBrainLayer* const inputLayer = new ndBrainLayer(6, 64, m_tanh);
+	ndBrainLayer* const hiddenLayer = new ndBrainLayer(inputLayer->GetOuputSize(), 64, m_tanh);
+	ndBrainLayer* const ouputLayer = new ndBrainLayer(hiddenLayer->GetOuputSize(), 2, m_tanh);
+	brain.BeginAddLayer();
+	brain.AddLayer(inputLayer);
+	brain.AddLayer(hiddenLayer);
+	brain.AddLayer(ouputLayer);
+	brain.EndAddLayer();
+	brain.InitGaussianWeights(0.0f, 0.25f);
+
+	ndRolloutThreadPool threadPool;
+	threadPool.SetThreadCount(ndThreadPool::GetMaxThreads());
+
+	ndExpandTraceMessage("%s\n", "rollout throughput");
+	for (ndInt32 environmentCount = 1; environmentCount <= 64; environmentCount *= 4)
+	{
+		ndBrainReplayBuffer replayBuffer;
+		replayBuffer.SetCount(1 << 16, 256, brain.GetInputSize(), brain.GetOutputSize());
+
+		ndBrainRollout rollout(&brain, &replayBuffer);
+		ndArray<ndRolloutBoxEnvironment*> environments;
+		for (ndInt32 i = 0; i < environmentCount; i++)
+		{
+			environments.PushBack(new ndRolloutBoxEnvironment());
+			rollout.AddEnvironment(environments[i]);
+		}
+
+		threadPool.Begin();
+		for (ndInt32 i = 0; i < 600; i++)
+		{
+			rollout.Step(threadPool, 1.0f / 60.0f);
+		}
+		threadPool.End();
+
+		ndExpandTraceMessage("environments %d: %f steps per second\n", environmentCount, rollout.GetStepsPerSecond());
+		for (ndInt32 i = 0; i < environments.GetCount(); i++)
+		{
+			delete environments[i];
+		}
+	}
+	ndExpandTraceMessage("\n");
+}
+
+// the activations as they were before the fused kernels, one libm call per element
+static void ReferenceActivation(ndBrainActivationType type, ndBrainVector& output)
+{
+	switch (type)
+	{
+		case m_tanh:
+		{
+			for (ndInt32 i = output.GetCount() - 1; i >= 0; --i)
+			{
+				const ndReal exp = ndReal(ndPow(ndEXP, 2.0f * ndClamp(output[i], ndReal(-25.0f), ndReal(25.0f))));
+				output[i] = (exp - 1.0f) / (exp + 1.0f);
+			}
+			break;
+		}
+
+		case m_sigmoid:
+		{
+			for (ndInt32 i = output.GetCount() - 1; i >= 0; --i)
+			{
+				const ndReal exp = ndReal(ndPow(ndEXP, ndClamp(output[i], ndReal(-50.0f), ndReal(50.0f))));
+				output[i] = exp / (exp + 1.0f);
+			}
+			break;
+		}
+
+		case m_elu:
+		{
+			for (ndInt32 i = output.GetCount() - 1; i >= 0; --i)
+			{
+				output[i] = (output[i] > 0.0f) ? output[i] : ndReal(ndPow(ndEXP, output[i])) - 1.0f;
+			}
+			break;
+		}
+
+		case m_softplus:
+		{
+			for (ndInt32 i = output.GetCount() - 1; i >= 0; --i)
+			{
+				output[i] = ndReal(ndLog(1.0f + ndPow(ndEXP, ndClamp(output[i], ndReal(-50.0f), ndReal(50.0f)))));
+			}
+			break;
+		}
+
+		default:
+		{
+			for (ndInt32 i = output.GetCount() - 1; i >= 0; --i)
+			{
+				output[i] = ndMax(ndReal(0.0f), output[i]);
+			}
+		}
+	}
+}
+
+static void ActivationBenchmark()
+{
+	const ndInt32 samples = 512;
+	const ndInt32 neurons = 256;
+	const ndInt32 passes = 20;
+	const ndBrainActivationType types[] = { m_relu, m_tanh, m_sigmoid, m_elu, m_softplus };
+	const char* const names[] = { "relu", "tanh", "sigmoid", "elu", "softplus" };
+
+	ndBrainMatrix input(samples, neurons);
+	ndBrainMatrix referenceOutput(samples, neurons);
+	ndBrainMatrix fusedOutput(samples, neurons);
+	for (ndInt32 i = 0; i < samples; i++)
+	{
+		for (ndInt32 j = 0; j < neurons; j++)
+		{
+			input[i][j] = ndReal(ndGaussianRandom(0.0f, 1.0f));
+		}
+	}
+
+	ndExpandTraceMessage("%s\n", "fused bias and activation, 256 x 256 layer, 512 samples");
+	for (ndInt32 k = 0; k < ndInt32(sizeof(types) / sizeof(types[0])); ++k)
+	{
+		ndBrain brain;
+		brain.BeginAddLayer();
+		brain.AddLayer(new ndBrainLayer(neurons, neurons, types[k]));
+		brain.EndAddLayer();
+		brain.InitGaussianWeights(0.0f, 0.1f);
+
+		ndBrainLayer& layer = *brain[0];
+		for (ndInt32 i = 0; i < neurons; ++i)
+		{
+			layer.GetBias()[i] = ndReal(ndGaussianRandom(0.0f, 0.1f));
+		}
+
+		ndUnsigned64 referenceTime = ndGetTimeInMicroseconds();
+		for (ndInt32 n = 0; n < passes; ++n)
+		{
+			layer.Mul(input, referenceOutput);
+			for (ndInt32 i = 0; i < samples; ++i)
+			{
+				referenceOutput[i].Add(referenceOutput[i], layer.GetBias());
+				ReferenceActivation(types[k], referenceOutput[i]);
+			}
+		}
+		referenceTime = ndGetTimeInMicroseconds() - referenceTime;
+
+		ndUnsigned64 fusedTime = ndGetTimeInMicroseconds();
+		for (ndInt32 n = 0; n < passes; ++n)
+		{
+			layer.MakePrediction(input, fusedOutput);
+		}
+		fusedTime = ndGetTimeInMicroseconds() - fusedTime;
+
+		// activation pass alone, on the already multiplied outputs
+		ndUnsigned64 referenceActivationTime = ndGetTimeInMicroseconds();
+		for (ndInt32 n = 0; n < passes; ++n)
+		{
+			for (ndInt32 i = 0; i < samples; ++i)
+			{
+				ndBrainVector& row = referenceOutput[i];
+				row.Set(input[i]);
+				ReferenceActivation(types[k], row);
+			}
+		}
+		referenceActivationTime = ndGetTimeInMicroseconds() - referenceActivationTime;
+
+		ndUnsigned64 fusedActivationTime = ndGetTimeInMicroseconds();
+		for (ndInt32 n = 0; n < passes; ++n)
+		{
+			for (ndInt32 i = 0; i < samples; ++i)
+			{
+				ndBrainVector& row = fusedOutput[i];
+				row.Set(input[i]);
+				layer.ApplyActivation(row);
+			}
+		}
+		fusedActivationTime = ndGetTimeInMicroseconds() - fusedActivationTime;
+
+		ndReal maxError = 0.0f;
+		for (ndInt32 i = 0; i < samples; i++)
+		{
+			for (ndInt32 j = 0; j < neurons; j++)
+			{
+				maxError = ndMax(maxError, ndReal(ndAbs(referenceOutput[i][j] - fusedOutput[i][j])));
+			}
+		}
+
+		ndExpandTraceMessage("%s: layer %f / %f (ms), activation %f / %f (ms), max error %g\n", names[k],
+			ndFloat64(referenceTime) / 1000.0f, ndFloat64(fusedTime) / 1000.0f,
+			ndFloat64(referenceActivationTime) / 1000.0f, ndFloat64(fusedActivationTime) / 1000.0f, maxError);
+	}
+	ndExpandTraceMessage("%s\n", "");
+}
+
 void ndTestDeedBrian()
 {
 	ndSetRandSeed(12345);
 	//ThreeLayersTwoInputsTwoOutputs();
 	//MnistTrainingSet();
 	//MnistTestSet();
+	//BatchPredictionBenchmark();
+	//ParallelTrainerScaling();
+	//RolloutThroughput();
+	//QuantizedInferenceReport();
+	//ActivationBenchmark();
 }
 
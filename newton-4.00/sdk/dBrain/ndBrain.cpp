@@ -22,6 +22,27 @@
 #include "ndBrainStdafx.h"
 #include "ndBrain.h"
 
+class ndBrainBinaryHeader
+{
+	public:
+	ndUnsigned32 m_magic;
+	ndUnsigned32 m_version;
+	ndInt32 m_layerCount;
+	ndInt32 m_floatSize;
+	ndUnsigned64 m_size;
+	ndUnsigned64 m_checksum;
+};
+
+class ndBrainBinaryLayer
+{
+	public:
+	ndInt32 m_inputs;
+	ndInt32 m_outputs;
+	ndInt32 m_activation;
+	ndInt32 m_stride;
+	ndUnsigned64 m_offset;
+};
+
 ndBrain::ndBrain()
 	:ndArray<ndBrainLayer*>()
 	,m_memory(nullptr)
@@ -175,84 +196,176 @@ void ndBrain::InitGaussianWeights(ndReal mean, ndReal variance)
 	}
 }
 
-#if 0
-void ndBrain::Save(const char* const pathName) const
+static ndInt32 ndBrainBinaryStride(ndInt32 count)
 {
-	nd::TiXmlDocument asciifile;
-	nd::TiXmlDeclaration* const decl = new nd::TiXmlDeclaration("1.0", "", "");
-	asciifile.LinkEndChild(decl);
+	return (count + D_DEEP_BRAIN_DATA_ALIGMENT - 1) & -D_DEEP_BRAIN_DATA_ALIGMENT;
+}
 
-	nd::TiXmlElement* const rootNode = new nd::TiXmlElement("ndBrain");
-	asciifile.LinkEndChild(rootNode);
+static ndUnsigned64 ndBrainBinaryAlign(ndUnsigned64 offset)
+{
+	return (offset + D_BRAIN_BINARY_ALIGNMENT - 1) & ~ndUnsigned64(D_BRAIN_BINARY_ALIGNMENT - 1);
+}
 
-	for (ndInt32 i = 0; i < GetCount(); i++)
+void ndBrain::Save(ndArray<ndUnsigned8>& buffer) const
+{
+	const ndArray<ndBrainLayer*>& layers = *this;
+
+	// the layer table follows the header, then the payload of each layer,
+	// weight rows padded to the same stride as in memory, followed by the bias.
+	ndUnsigned64 offset = ndBrainBinaryAlign(sizeof(ndBrainBinaryHeader) + layers.GetCount() * sizeof(ndBrainBinaryLayer));
+	ndArray<ndBrainBinaryLayer> table;
+	for (ndInt32 i = 0; i < layers.GetCount(); ++i)
+	{
+		const ndBrainLayer& layer = *layers[i];
+		ndBrainBinaryLayer info;
+		info.m_inputs = layer.GetInputSize();
+		info.m_outputs = layer.GetOuputSize();
+		info.m_activation = ndInt32(layer.GetActivationType());
+		info.m_stride = ndBrainBinaryStride(info.m_inputs);
+		info.m_offset = offset;
+		table.PushBack(info);
+
+		const ndInt32 floats = info.m_outputs * info.m_stride + ndBrainBinaryStride(info.m_outputs);
+		offset = ndBrainBinaryAlign(offset + ndUnsigned64(floats) * sizeof(ndReal));
+	}
+
+	buffer.SetCount(ndInt32(offset));
+	ndUnsigned8* const data = &buffer[0];
+	memset(data, 0, size_t(offset));
+	if (table.GetCount())
+	{
+		memcpy(data + sizeof(ndBrainBinaryHeader), &table[0], table.GetCount() * sizeof(ndBrainBinaryLayer));
+	}
+
+	for (ndInt32 i = 0; i < layers.GetCount(); ++i)
 	{
-		ndBrainLayer* const layer = (*this)[i];
-		nd::TiXmlElement* const layerNode = new nd::TiXmlElement("ndLayer");
-		rootNode->LinkEndChild(layerNode);
-		layer->Save (layerNode);
+		const ndBrainLayer& layer = *layers[i];
+		const ndBrainBinaryLayer& info = table[i];
+		ndReal* const weights = (ndReal*)(data + info.m_offset);
+		for (ndInt32 j = 0; j < info.m_outputs; ++j)
+		{
+			memcpy(&weights[j * info.m_stride], &layer[j][0], info.m_inputs * sizeof(ndReal));
+		}
+		memcpy(&weights[info.m_outputs * info.m_stride], &layer.GetBias()[0], info.m_outputs * sizeof(ndReal));
 	}
 
-	char* const oldloc = setlocale(LC_ALL, 0);
-	setlocale(LC_ALL, "C");
-	asciifile.SaveFile(pathName);
-	setlocale(LC_ALL, oldloc);
+	ndBrainBinaryHeader header;
+	header.m_magic = D_BRAIN_BINARY_MAGIC;
+	header.m_version = D_BRAIN_BINARY_VERSION;
+	header.m_layerCount = layers.GetCount();
+	header.m_floatSize = sizeof(ndReal);
+	header.m_size = offset;
+	header.m_checksum = dCRC64(data + sizeof(ndBrainBinaryHeader), ndInt32(offset - sizeof(ndBrainBinaryHeader)), 0);
+	memcpy(data, &header, sizeof(ndBrainBinaryHeader));
 }
 
-bool ndBrain::Load(const char* const pathName)
+bool ndBrain::Save(const char* const pathName) const
 {
-	ndAssert(0);
+	ndArray<ndUnsigned8> buffer;
+	Save(buffer);
 
-	char* const oldloc = setlocale(LC_ALL, 0);
-	setlocale(LC_ALL, "C");
+	FILE* const file = fopen(pathName, "wb");
+	if (!file)
+	{
+		return false;
+	}
+	const size_t written = fwrite(&buffer[0], 1, size_t(buffer.GetCount()), file);
+	fclose(file);
+	return written == size_t(buffer.GetCount());
+}
 
-	nd::TiXmlDocument doc(pathName);
-	doc.LoadFile();
-	if (doc.Error())
+bool ndBrain::Load(const void* const buffer, ndInt64 size)
+{
+	ndAssert(!GetCount());
+	if (GetCount() || (size < ndInt64(sizeof(ndBrainBinaryHeader))))
 	{
-		setlocale(LC_ALL, oldloc);
 		return false;
 	}
-	ndAssert(!doc.Error());
 
-	const nd::TiXmlElement* const rootNode = doc.RootElement();
-	if (!rootNode)
+	const ndUnsigned8* const data = (ndUnsigned8*)buffer;
+	ndBrainBinaryHeader header;
+	memcpy(&header, data, sizeof(ndBrainBinaryHeader));
+	if ((header.m_magic != D_BRAIN_BINARY_MAGIC) || (header.m_version != D_BRAIN_BINARY_VERSION) || (header.m_floatSize != ndInt32(sizeof(ndReal))))
 	{
 		return false;
 	}
 
-	BeginAddLayer();
-	for (const nd::TiXmlNode* layerNode = rootNode->FirstChild("ndLayer"); layerNode; layerNode = layerNode->NextSibling())
+	const ndInt64 tableSize = ndInt64(sizeof(ndBrainBinaryHeader)) + ndInt64(header.m_layerCount) * ndInt64(sizeof(ndBrainBinaryLayer));
+	if ((header.m_size != ndUnsigned64(size)) || (header.m_layerCount <= 0) || (tableSize > size))
+	{
+		return false;
+	}
+
+	if (header.m_checksum != dCRC64(data + sizeof(ndBrainBinaryHeader), ndInt32(size - ndInt64(sizeof(ndBrainBinaryHeader))), 0))
+	{
+		return false;
+	}
+
+	ndArray<ndBrainBinaryLayer> table;
+	table.SetCount(header.m_layerCount);
+	memcpy(&table[0], data + sizeof(ndBrainBinaryHeader), table.GetCount() * sizeof(ndBrainBinaryLayer));
+	for (ndInt32 i = 0; i < table.GetCount(); ++i)
 	{
-		const char* const layerType = xmlGetString(layerNode, "type");
-		if (layerType)
+		const ndBrainBinaryLayer& info = table[i];
+		const ndInt64 floats = ndInt64(info.m_outputs) * info.m_stride + ndBrainBinaryStride(info.m_outputs);
+		bool valid = (info.m_inputs > 0) && (info.m_outputs > 0);
+		valid = valid && (info.m_stride == ndBrainBinaryStride(info.m_inputs));
+		valid = valid && (ndUnsigned32(info.m_activation) <= ndUnsigned32(m_softplus));
+		valid = valid && (!i || (info.m_inputs == table[i - 1].m_outputs));
+		// check the offset first, so that the remaining length can not wrap around
+		valid = valid && (info.m_offset <= ndUnsigned64(size));
+		valid = valid && (ndUnsigned64(floats) <= (ndUnsigned64(size) - info.m_offset) / sizeof(ndReal));
+		if (!valid)
 		{
-			ndBrainLayer* layer = nullptr;
-			if (!strcmp(layerType, "fullyConnected"))
-			{
-				layer = new ndBrainLayer(layerNode);
-			}
-			else
-			{
-				ndAssert(0);
-			}
-			if (layer)
-			{
-				AddLayer(layer);
-			}
+			return false;
 		}
 	}
-	EndAddLayer();
 
-	ndInt32 index = 0;
-	for (const nd::TiXmlNode* layerNode = rootNode->FirstChild("ndLayer"); layerNode; layerNode = layerNode->NextSibling())
+	BeginAddLayer();
+	for (ndInt32 i = 0; i < table.GetCount(); ++i)
 	{
-		ndBrainLayer* const layer = (*this)[index];
-		layer->Load((nd::TiXmlElement*)layerNode);
-		index++;
+		const ndBrainBinaryLayer& info = table[i];
+		AddLayer(new ndBrainLayer(info.m_inputs, info.m_outputs, ndBrainActivationType(info.m_activation)));
 	}
+	EndAddLayer();
 
-	m_isReady = true;
+	ndArray<ndBrainLayer*>& layers = *this;
+	for (ndInt32 i = 0; i < table.GetCount(); ++i)
+	{
+		ndBrainLayer& layer = *layers[i];
+		const ndBrainBinaryLayer& info = table[i];
+		const ndUnsigned8* const weights = data + info.m_offset;
+		for (ndInt32 j = 0; j < info.m_outputs; ++j)
+		{
+			memcpy(&layer[j][0], weights + j * info.m_stride * sizeof(ndReal), info.m_inputs * sizeof(ndReal));
+		}
+		memcpy(&layer.GetBias()[0], weights + info.m_outputs * info.m_stride * sizeof(ndReal), info.m_outputs * sizeof(ndReal));
+	}
 	return true;
 }
-#endif
+
+bool ndBrain::Load(const char* const pathName)
+{
+	FILE* const file = fopen(pathName, "rb");
+	if (!file)
+	{
+		return false;
+	}
+
+	fseek(file, 0, SEEK_END);
+	const long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	bool state = false;
+	if (size > 0)
+	{
+		void* const buffer = ndMemory::Malloc(size_t(size));
+		if (fread(buffer, 1, size_t(size), file) == size_t(size))
+		{
+			state = Load(buffer, ndInt64(size));
+		}
+		ndMemory::Free(buffer);
+	}
+	fclose(file);
+	return state;
+}
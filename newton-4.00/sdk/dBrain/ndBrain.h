@@ -26,6 +26,10 @@
 #include "ndBrainLayer.h"
 #include "ndBrainTrainerBase.h"
 
+#define D_BRAIN_BINARY_MAGIC		0x4e42646e
+#define D_BRAIN_BINARY_VERSION		1
+#define D_BRAIN_BINARY_ALIGNMENT	32
+
 class ndBrain: public ndArray<ndBrainLayer*>
 {
 	public: 
@@ -36,8 +40,14 @@ class ndBrain: public ndArray<ndBrainLayer*>
 	ndInt32 GetInputSize() const;
 	ndInt32 GetOutputSize() const;
 
+	// binary model, a header and a layer table followed by the weights
+	// and bias of each layer, in the padded layout used at runtime.
+	// the payload is protected by a checksum, load returns false
+	// if the data is not a valid model of this version.
 	bool Load(const char* const pathName);
-	void Save(const char* const pathName) const;
+	bool Load(const void* const buffer, ndInt64 size);
+	bool Save(const char* const pathName) const;
+	void Save(ndArray<ndUnsigned8>& buffer) const;
 	void CopyFrom(const ndBrain& src);
 
 	void BeginAddLayer();
@@ -26,10 +26,15 @@
 ndBrainAgentDQN::ndBrainAgentDQN(ndBrain* const agent, ndInt32 replayBufferSize, ndInt32 replayBatchSize)
 	:ndBrainAgent(agent)
 	,m_targetNetwork(new ndBrain(*agent))
+	,m_currentTransition()
 {
 	ndInt32 stateSize = m_network.GetBrain()->GetInputSize();
 	ndInt32 actionSize = m_network.GetBrain()->GetOutputSize();
 	m_replayBuffer.SetCount(replayBufferSize, replayBatchSize, stateSize, actionSize);
+
+	m_currentTransition.m_state.SetCount(stateSize);
+	m_currentTransition.m_action.SetCount(actionSize);
+	m_currentTransition.m_nextState.SetCount(stateSize);
 }
 
 ndBrainAgentDQN::~ndBrainAgentDQN()
@@ -44,10 +49,10 @@ void ndBrainAgentDQN::PredictAccion(ndBrainReiforcementTransition& transition)
 
 void ndBrainAgentDQN::LearnStep()
 {
-	ndBrainReiforcementTransition& transition = m_replayBuffer.GetTransitionEntry();
-	GetTransition(transition);
+	GetTransition(m_currentTransition);
+	m_replayBuffer.AddTransition(m_currentTransition);
 
-	if (m_replayBuffer.m_replayBufferIndex < m_replayBuffer.m_learnBatchSize)
+	if (m_replayBuffer.GetCount() < m_replayBuffer.m_learnBatchSize)
 	{
 		return;
 	}
@@ -35,6 +35,7 @@ class ndBrainAgentDQN: public ndBrainAgent
 	virtual void PredictAccion(ndBrainReiforcementTransition& transition);
 
 	ndBrainInstance m_targetNetwork;
+	ndBrainReiforcementTransition m_currentTransition;
 };
 
 #endif 
@@ -31,11 +31,14 @@
 #include <ndBrainVector.h>
 #include <ndBrainMatrix.h>
 #include <ndBrainTrainer.h>
+#include <ndBrainRollout.h>
 #include <ndBrainAgentDQN.h>
 #include <ndBrainInstance.h>
 #include <ndBrainAgentDDPG.h>
 #include <ndBrainTrainerBase.h>
 #include <ndBrainReplayBuffer.h>
+#include <ndBrainInferenceServer.h>
+#include <ndBrainQuantizedInstance.h>
 #include <ndBrainParallelTrainer.h>
 
 #endif 
@@ -0,0 +1,205 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "ndBrainStdafx.h"
+#include "ndBrain.h"
+#include "ndBrainInstance.h"
+#include "ndBrainInferenceServer.h"
+
+ndBrainInferenceServer::ndBatch::ndBatch(ndBrain* const brain)
+	:ndClassAlloc()
+	,m_brain(brain)
+	,m_instance(new ndBrainInstance(brain))
+	,m_input()
+	,m_start(0)
+	,m_count(0)
+{
+}
+
+ndBrainInferenceServer::ndBatch::~ndBatch()
+{
+	delete m_instance;
+}
+
+void ndBrainInferenceServer::ndBatch::SetCount(ndInt32 count)
+{
+	m_count = count;
+	if (m_input.GetCount() < count)
+	{
+		// grow geometrically, so that the buffers settle after a few frames
+		ndInt32 capacity = ndMax(m_input.GetCount() * 2, D_BRAIN_INFERENCE_CHUNK);
+		while (capacity < count)
+		{
+			capacity *= 2;
+		}
+		m_input.Init(capacity, m_brain->GetInputSize());
+		m_instance->SetBatchSize(capacity);
+	}
+}
+
+ndBrainInferenceServer::ndBrainInferenceServer()
+	:ndClassAlloc()
+	,m_requests()
+	,m_sortedRequests()
+	,m_batches()
+	,m_workItems()
+	,m_lock()
+{
+}
+
+ndBrainInferenceServer::~ndBrainInferenceServer()
+{
+	Clear();
+}
+
+void ndBrainInferenceServer::Clear()
+{
+	for (ndInt32 i = m_batches.GetCount() - 1; i >= 0; --i)
+	{
+		delete m_batches[i];
+	}
+	m_batches.SetCount(0);
+	m_requests.SetCount(0);
+}
+
+void ndBrainInferenceServer::AddRequest(ndBrain* const brain, const ndBrainVector& input, ndBrainVector& output)
+{
+	ndAssert(input.GetCount() == brain->GetInputSize());
+	ndAssert(output.GetCount() == brain->GetOutputSize());
+
+	ndRequest request;
+	request.m_brain = brain;
+	request.m_input = &input;
+	request.m_output = &output;
+	request.m_batch = -1;
+
+	ndScopeSpinLock lock(m_lock);
+	m_requests.PushBack(request);
+}
+
+ndInt32 ndBrainInferenceServer::PrepareBatches()
+{
+	D_TRACKTIME();
+	for (ndInt32 i = m_batches.GetCount() - 1; i >= 0; --i)
+	{
+		m_batches[i]->m_count = 0;
+	}
+
+	// the number of distinct networks is small, a linear search is enough
+	for (ndInt32 i = 0; i < m_requests.GetCount(); ++i)
+	{
+		ndRequest& request = m_requests[i];
+		ndInt32 batchIndex = m_batches.GetCount() - 1;
+		for (; batchIndex >= 0; --batchIndex)
+		{
+			if (m_batches[batchIndex]->m_brain == request.m_brain)
+			{
+				break;
+			}
+		}
+		if (batchIndex < 0)
+		{
+			batchIndex = m_batches.GetCount();
+			m_batches.PushBack(new ndBatch(request.m_brain));
+		}
+		request.m_batch = batchIndex;
+		m_batches[batchIndex]->m_count++;
+	}
+
+	// sort the requests by network, and split each batch in work items
+	ndInt32 start = 0;
+	m_workItems.SetCount(0);
+	for (ndInt32 i = 0; i < m_batches.GetCount(); ++i)
+	{
+		ndBatch* const batch = m_batches[i];
+		const ndInt32 count = batch->m_count;
+		batch->m_start = start;
+		batch->SetCount(count);
+		for (ndInt32 j = 0; j < count; j += D_BRAIN_INFERENCE_CHUNK)
+		{
+			ndWorkItem item;
+			item.m_batch = i;
+			item.m_start = j;
+			item.m_count = ndMin(D_BRAIN_INFERENCE_CHUNK, count - j);
+			m_workItems.PushBack(item);
+		}
+		batch->m_count = 0;
+		start += count;
+	}
+
+	m_sortedRequests.SetCount(m_requests.GetCount());
+	for (ndInt32 i = 0; i < m_requests.GetCount(); ++i)
+	{
+		const ndRequest& request = m_requests[i];
+		ndBatch* const batch = m_batches[request.m_batch];
+		m_sortedRequests[batch->m_start + batch->m_count] = request;
+		batch->m_count++;
+	}
+	return m_workItems.GetCount();
+}
+
+void ndBrainInferenceServer::EvaluateItem(const ndWorkItem& item)
+{
+	ndBatch* const batch = m_batches[item.m_batch];
+	const ndRequest* const requests = &m_sortedRequests[batch->m_start];
+
+	for (ndInt32 i = item.m_start + item.m_count - 1; i >= item.m_start; --i)
+	{
+		batch->m_input[i].Set(*requests[i].m_input);
+	}
+
+	batch->m_instance->MakeBatchPrediction(batch->m_input, item.m_start, item.m_count);
+
+	const ndBrainMatrix& output = *batch->m_instance->m_zBatch[batch->m_instance->m_zBatch.GetCount() - 1];
+	for (ndInt32 i = item.m_start + item.m_count - 1; i >= item.m_start; --i)
+	{
+		requests[i].m_output->Set(output[i]);
+	}
+}
+
+void ndBrainInferenceServer::Execute()
+{
+	D_TRACKTIME();
+	const ndInt32 itemCount = PrepareBatches();
+	for (ndInt32 i = 0; i < itemCount; ++i)
+	{
+		EvaluateItem(m_workItems[i]);
+	}
+	m_requests.SetCount(0);
+}
+
+void ndBrainInferenceServer::Execute(ndThreadPool& threadPool)
+{
+	D_TRACKTIME();
+	const ndInt32 itemCount = PrepareBatches();
+
+	ndAtomic<ndInt32> iterator(0);
+	auto EvaluateBatches = ndMakeObject::ndFunction([this, &iterator, itemCount](ndInt32, ndInt32)
+	{
+		D_TRACKTIME_NAMED(EvaluateBatches);
+		for (ndInt32 i = iterator.fetch_add(1); i < itemCount; i = iterator.fetch_add(1))
+		{
+			EvaluateItem(m_workItems[i]);
+		}
+	});
+	threadPool.ParallelExecute(EvaluateBatches);
+	m_requests.SetCount(0);
+}
@@ -0,0 +1,101 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef _ND_BRAIN_INFERENCE_SERVER_H__
+#define _ND_BRAIN_INFERENCE_SERVER_H__
+
+#include "ndBrainStdafx.h"
+#include "ndBrainVector.h"
+#include "ndBrainMatrix.h"
+
+class ndBrain;
+class ndBrainInstance;
+
+#define D_BRAIN_INFERENCE_CHUNK	16
+
+// collects the evaluations of many agents during a frame, and runs them
+// as one batched forward pass for each distinct network.
+// requests can be added from any thread, but the input and output
+// vectors must stay alive until Execute returns.
+class ndBrainInferenceServer: public ndClassAlloc
+{
+	public: 
+	ndBrainInferenceServer();
+	~ndBrainInferenceServer();
+
+	void AddRequest(ndBrain* const brain, const ndBrainVector& input, ndBrainVector& output);
+	void Execute(ndThreadPool& threadPool);
+	void Execute();
+
+	// releases the cached batches, must be called before a served brain is deleted.
+	void Clear();
+	ndInt32 GetRequestCount() const;
+
+	private:
+	class ndRequest
+	{
+		public:
+		ndBrain* m_brain;
+		const ndBrainVector* m_input;
+		ndBrainVector* m_output;
+		ndInt32 m_batch;
+	};
+
+	class ndBatch: public ndClassAlloc
+	{
+		public:
+		ndBatch(ndBrain* const brain);
+		~ndBatch();
+
+		void SetCount(ndInt32 count);
+
+		ndBrain* m_brain;
+		ndBrainInstance* m_instance;
+		ndBrainMatrix m_input;
+		ndInt32 m_start;
+		ndInt32 m_count;
+	};
+
+	class ndWorkItem
+	{
+		public:
+		ndInt32 m_batch;
+		ndInt32 m_start;
+		ndInt32 m_count;
+	};
+
+	ndInt32 PrepareBatches();
+	void EvaluateItem(const ndWorkItem& item);
+
+	ndArray<ndRequest> m_requests;
+	ndArray<ndRequest> m_sortedRequests;
+	ndArray<ndBatch*> m_batches;
+	ndArray<ndWorkItem> m_workItems;
+	ndSpinLock m_lock;
+};
+
+inline ndInt32 ndBrainInferenceServer::GetRequestCount() const
+{
+	return m_requests.GetCount();
+}
+
+#endif 
+
@@ -28,6 +28,7 @@ ndBrainInstance::ndBrainInstance(ndBrain* const brain)
 	:ndClassAlloc()
 	,m_z()
 	,m_zPrefixScan()
+	,m_zBatch()
 	,m_brain(brain)
 {
 	if (m_brain->GetCount())
@@ -40,12 +41,17 @@ ndBrainInstance::ndBrainInstance(const ndBrainInstance& src)
 	:ndClassAlloc()
 	,m_z(src.m_z)
 	,m_zPrefixScan(src.m_zPrefixScan)
+	,m_zBatch()
 	,m_brain(src.m_brain)
 {
 }
 
 ndBrainInstance::~ndBrainInstance()
 {
+	for (ndInt32 i = m_zBatch.GetCount() - 1; i >= 0; --i)
+	{
+		delete m_zBatch[i];
+	}
 }
 
 void ndBrainInstance::CalculatePrefixScan()
@@ -113,4 +119,90 @@ void ndBrainInstance::MakePrediction(ndThreadPool& threadPool, const ndBrainVect
 	output.SetCount(layers[layers.GetCount() - 1]->GetOuputSize());
 	const ndDeepBrainMemVector out(&m_z[m_zPrefixScan[layers.GetCount()]], output.GetCount());
 	output.Set(out);
-}
\ No newline at end of file
+}
+
+void ndBrainInstance::SetBatchSize(ndInt32 count)
+{
+	// the batch buffers only grow, smaller batches use the leading rows
+	if (m_zBatch.GetCount() && (m_zBatch[0]->GetCount() >= count))
+	{
+		return;
+	}
+
+	for (ndInt32 i = m_zBatch.GetCount() - 1; i >= 0; --i)
+	{
+		delete m_zBatch[i];
+	}
+	m_zBatch.SetCount(0);
+
+	const ndArray<ndBrainLayer*>& layers = (*m_brain);
+	for (ndInt32 i = 0; i < layers.GetCount(); ++i)
+	{
+		m_zBatch.PushBack(new ndBrainMatrix(count, layers[i]->GetOuputSize()));
+	}
+}
+
+void ndBrainInstance::MakeBatchPrediction(const ndBrainMatrix& input, ndInt32 start, ndInt32 count)
+{
+	const ndArray<ndBrainLayer*>& layers = (*m_brain);
+	ndAssert(layers.GetCount());
+	ndAssert(m_zBatch.GetCount() == layers.GetCount());
+	ndAssert(layers[0]->GetInputSize() == input.GetColumns());
+
+	layers[0]->MakePrediction(input, *m_zBatch[0], start, count);
+	for (ndInt32 i = 1; i < layers.GetCount(); ++i)
+	{
+		layers[i]->MakePrediction(*m_zBatch[i - 1], *m_zBatch[i], start, count);
+	}
+}
+
+void ndBrainInstance::MakeBatchPrediction(const ndBrainMatrix& input, ndArray<ndBrainMatrix*>& derivatives, ndInt32 start, ndInt32 count)
+{
+	const ndArray<ndBrainLayer*>& layers = (*m_brain);
+	ndAssert(layers.GetCount());
+	ndAssert(m_zBatch.GetCount() == layers.GetCount());
+	ndAssert(derivatives.GetCount() == layers.GetCount());
+	ndAssert(layers[0]->GetInputSize() == input.GetColumns());
+
+	layers[0]->MakePrediction(input, *m_zBatch[0], *derivatives[0], start, count);
+	for (ndInt32 i = 1; i < layers.GetCount(); ++i)
+	{
+		layers[i]->MakePrediction(*m_zBatch[i - 1], *m_zBatch[i], *derivatives[i], start, count);
+	}
+}
+
+void ndBrainInstance::CopyBatchOutput(ndBrainMatrix& output, ndInt32 start, ndInt32 count) const
+{
+	const ndBrainMatrix& z = *m_zBatch[m_zBatch.GetCount() - 1];
+	for (ndInt32 i = start + count - 1; i >= start; --i)
+	{
+		output[i].Set(z[i]);
+	}
+}
+
+void ndBrainInstance::MakePrediction(const ndBrainMatrix& input, ndBrainMatrix& output)
+{
+	ndAssert(output.GetCount() >= input.GetCount());
+	SetBatchSize(input.GetCount());
+	MakeBatchPrediction(input, 0, input.GetCount());
+	CopyBatchOutput(output, 0, input.GetCount());
+}
+
+void ndBrainInstance::MakePrediction(ndThreadPool& threadPool, const ndBrainMatrix& input, ndBrainMatrix& output)
+{
+	ndAssert(output.GetCount() >= input.GetCount());
+	SetBatchSize(input.GetCount());
+
+	// samples are independent, so each thread runs its slice through all the layers
+	auto MakePrediction = ndMakeObject::ndFunction([this, &input, &output](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		const ndStartEnd startEnd(input.GetCount(), threadIndex, threadCount);
+		const ndInt32 count(startEnd.m_end - startEnd.m_start);
+		if (count)
+		{
+			MakeBatchPrediction(input, startEnd.m_start, count);
+			CopyBatchOutput(output, startEnd.m_start, count);
+		}
+	});
+	threadPool.ParallelExecute(MakePrediction);
+}
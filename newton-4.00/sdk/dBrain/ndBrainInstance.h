@@ -25,6 +25,7 @@
 #include "ndBrainStdafx.h"
 #include "ndBrainTypes.h"
 #include "ndBrainVector.h"
+#include "ndBrainMatrix.h"
 
 class ndBrain;
 class ndBrainLayer;
@@ -46,10 +47,23 @@ class ndBrainInstance: public ndClassAlloc
 	void MakePrediction(const ndBrainVector& input, ndBrainVector& output);
 	void MakePrediction(ndThreadPool& threadPool, const ndBrainVector& input, ndBrainVector& output);
 
+	// minibatch prediction, one sample per matrix row
+	void MakePrediction(const ndBrainMatrix& input, ndBrainMatrix& output);
+	void MakePrediction(ndThreadPool& threadPool, const ndBrainMatrix& input, ndBrainMatrix& output);
+
 	protected:
+	void SetBatchSize(ndInt32 count);
+	void MakeBatchPrediction(const ndBrainMatrix& input, ndInt32 start, ndInt32 count);
+	void MakeBatchPrediction(const ndBrainMatrix& input, ndArray<ndBrainMatrix*>& derivatives, ndInt32 start, ndInt32 count);
+	void CopyBatchOutput(ndBrainMatrix& output, ndInt32 start, ndInt32 count) const;
+
 	ndBrainVector m_z;
 	ndBrainPrefixScan m_zPrefixScan;
+	ndArray<ndBrainMatrix*> m_zBatch;
 	ndBrain* m_brain;
+
+	friend class ndBrainTrainer;
+	friend class ndBrainInferenceServer;
 };
 
 inline ndBrain* ndBrainInstance::GetBrain() const
@@ -234,53 +234,234 @@ void ndBrainLayer::InitGaussianWeights(ndReal mean, ndReal variance)
 	}
 }
 
-void ndBrainLayer::LinealActivation(ndBrainVector&) const
+// branch free approximations, the loops calling them compile to simd code.
+// float selects with constant or computed arms stop the vectorizer, 
+// so clamps and roundings are done on the integer bits instead.
+union ndBrainFloatBits
 {
+	ndInt32 m_iVal;
+	ndReal m_fVal;
+};
+
+// exp reduces the argument to exp(r) * 2^n with |r| <= ln(2) / 2, 
+// and evaluates exp(r) with a polynomial, the relative error is below 1.0e-7
+static inline ndReal ndBrainExp(ndReal x)
+{
+	// clamp |x| to 87, so that 2^n is a normal float
+	ndBrainFloatBits value;
+	value.m_fVal = x;
+	const ndInt32 sign = value.m_iVal & ndInt32(0x80000000);
+	value.m_iVal = ndMin(ndInt32(value.m_iVal & 0x7fffffff), ndInt32(0x42ae0000)) | sign;
+
+	// adding 1.5 * 2^23 rounds to the nearest integer, which ends up in the low mantissa bits
+	ndBrainFloatBits round;
+	round.m_fVal = value.m_fVal * ndReal(1.44269504f) + ndReal(12582912.0f);
+	const ndReal fn = round.m_fVal - ndReal(12582912.0f);
+	const ndInt32 n = round.m_iVal - 0x4b400000;
+	const ndReal r = value.m_fVal - fn * ndReal(0.693359375f) + fn * ndReal(2.12194440e-4f);
+
+	ndReal p = ndReal(1.9875691500e-4f);
+	p = p * r + ndReal(1.3981999507e-3f);
+	p = p * r + ndReal(8.3334519073e-3f);
+	p = p * r + ndReal(4.1665795894e-2f);
+	p = p * r + ndReal(1.6666665459e-1f);
+	p = p * r + ndReal(5.0000001201e-1f);
+	const ndReal e = p * r * r + r + ndReal(1.0f);
+
+	ndBrainFloatBits scale;
+	scale.m_iVal = (n + 127) << 23;
+	return e * scale.m_fVal;
 }
 
-void ndBrainLayer::ReluActivation(ndBrainVector& output) const
+// log(1 + exp(-|x|)), the argument of the log is in (1, 2], 
+// so the atanh series converges without a range reduction
+static inline ndReal ndBrainLogOnePlusExp(ndReal x)
 {
-	for (ndInt32 i = output.GetCount() - 1; i >= 0; --i)
+	const ndReal u = ndReal(1.0f) + ndBrainExp(-ndAbs(x));
+	const ndReal s = (u - ndReal(1.0f)) / (u + ndReal(1.0f));
+	const ndReal s2 = s * s;
+	ndReal p = ndReal(1.0f / 11.0f);
+	p = p * s2 + ndReal(1.0f / 9.0f);
+	p = p * s2 + ndReal(1.0f / 7.0f);
+	p = p * s2 + ndReal(1.0f / 5.0f);
+	p = p * s2 + ndReal(1.0f / 3.0f);
+	p = p * s2 + ndReal(1.0f);
+	return ndReal(2.0f) * s * p;
+}
+
+static inline ndReal ndBrainRelu(ndReal x)
+{
+	return ndMax(ndReal(0.0f), x);
+}
+
+// the slope is less than one
+static inline ndReal ndBrainLeakyRelu(ndReal x)
+{
+	return ndMax(x, x * D_BRAIN_LEAKY_RELU_SLOPE);
+}
+
+static inline ndReal ndBrainSigmoid(ndReal x)
+{
+	return ndReal(1.0f) / (ndReal(1.0f) + ndBrainExp(-x));
+}
+
+static inline ndReal ndBrainTanh(ndReal x)
+{
+	return ndReal(1.0f) - ndReal(2.0f) / (ndBrainExp(ndReal(2.0f) * x) + ndReal(1.0f));
+}
+
+static inline ndReal ndBrainElu(ndReal x)
+{
+	return ndMax(ndReal(0.0f), x) + ndMin(ndReal(0.0f), ndBrainExp(x) - ndReal(1.0f));
+}
+
+static inline ndReal ndBrainSoftplus(ndReal x)
+{
+	return ndMax(ndReal(0.0f), x) + ndBrainLogOnePlusExp(x);
+}
+
+// output = function(output + bias), a null bias skips the add
+template <typename ndFunction>
+static inline void ndBrainActivation(ndBrainVector& output, const ndBrainVector* const bias, ndFunction function)
+{
+	ndReal* const out = &output[0];
+	const ndInt32 count = output.GetCount();
+	if (bias)
 	{
-		output[i] = ndMax(ndReal(0.0f), output[i]);
-		ndAssert(ndCheckFloat(output[i]));
+		const ndReal* const b = &(*bias)[0];
+		for (ndInt32 i = 0; i < count; ++i)
+		{
+			out[i] = function(out[i] + b[i]);
+		}
+	}
+	else
+	{
+		for (ndInt32 i = 0; i < count; ++i)
+		{
+			out[i] = function(out[i]);
+		}
 	}
 }
 
-void ndBrainLayer::SigmoidActivation(ndBrainVector& output) const
+// same as above, but also writes the derivative as a function of the activation
+template <typename ndFunction, typename ndDerivative>
+static inline void ndBrainActivation(ndBrainVector& output, ndBrainVector& derivativeOutput, const ndBrainVector& bias, ndFunction function, ndDerivative derivative)
 {
-	for (ndInt32 i = output.GetCount() - 1; i >= 0; --i)
+	ndReal* const out = &output[0];
+	ndReal* const dOut = &derivativeOutput[0];
+	const ndReal* const b = &bias[0];
+	const ndInt32 count = output.GetCount();
+	for (ndInt32 i = 0; i < count; ++i)
 	{
-		ndReal value = ndClamp (output[i], ndReal(-50.0f), ndReal(50.0f));
-		const ndReal exp = ndReal(ndPow(ndEXP, value));
-		output[i] = exp / (exp + 1.0f);
-		ndAssert (ndCheckFloat(output[i]));
-		ndAssert(output[i] <= 1.0f);
-		ndAssert(output[i] >= 0.0f);
+		const ndReal y = function(out[i] + b[i]);
+		out[i] = y;
+		dOut[i] = derivative(y);
 	}
 }
 
-void ndBrainLayer::HyperbolicTanActivation(ndBrainVector& output) const
+// the derivatives are expressed in terms of the activation value y
+static inline ndReal ndBrainReluDerivative(ndReal y)
 {
-	for (ndInt32 i = output.GetCount() - 1; i >= 0; --i)
+	return (y > ndReal(0.0f)) ? ndReal(1.0f) : ndReal(0.0f);
+}
+
+static inline ndReal ndBrainLeakyReluDerivative(ndReal y)
+{
+	return (y > ndReal(0.0f)) ? ndReal(1.0f) : D_BRAIN_LEAKY_RELU_SLOPE;
+}
+
+static inline ndReal ndBrainLinealDerivative(ndReal)
+{
+	return ndReal(1.0f);
+}
+
+static inline ndReal ndBrainSigmoidDerivative(ndReal y)
+{
+	return y * (ndReal(1.0f) - y);
+}
+
+static inline ndReal ndBrainTanhDerivative(ndReal y)
+{
+	return ndReal(1.0f) - y * y;
+}
+
+static inline ndReal ndBrainEluDerivative(ndReal y)
+{
+	return ndMin(ndReal(1.0f), y + ndReal(1.0f));
+}
+
+static inline ndReal ndBrainSoftplusDerivative(ndReal y)
+{
+	return ndReal(1.0f) - ndBrainExp(-y);
+}
+
+template <typename ndDerivative>
+static inline void ndBrainDerivative(const ndBrainVector& input, ndBrainVector& derivativeOutput, ndDerivative derivative)
+{
+	ndAssert(input.GetCount() == derivativeOutput.GetCount());
+	const ndReal* const in = &input[0];
+	ndReal* const out = &derivativeOutput[0];
+	const ndInt32 count = input.GetCount();
+	for (ndInt32 i = 0; i < count; ++i)
 	{
-		ndReal value = ndClamp(output[i], ndReal(-25.0f), ndReal(25.0f));
-		const ndReal exp = ndReal(ndPow(ndEXP, 2.0f * value));
-		output[i] = (exp - 1.0f) / (exp + 1.0f);
-		ndAssert(ndCheckFloat(output[i]));
-		ndAssert(output[i] <= 1.0f);
-		ndAssert(output[i] >= -1.0f);
+		out[i] = derivative(in[i]);
 	}
 }
 
-void ndBrainLayer::SoftmaxActivation(ndBrainVector& output) const
+void ndBrainLayer::LinealActivation(ndBrainVector& output, const ndBrainVector* const bias) const
 {
+	if (bias)
+	{
+		output.Add(output, *bias);
+	}
+}
+
+void ndBrainLayer::ReluActivation(ndBrainVector& output, const ndBrainVector* const bias) const
+{
+	ndBrainActivation(output, bias, ndBrainRelu);
+}
+
+void ndBrainLayer::LeakyReluActivation(ndBrainVector& output, const ndBrainVector* const bias) const
+{
+	ndBrainActivation(output, bias, ndBrainLeakyRelu);
+}
+
+void ndBrainLayer::SigmoidActivation(ndBrainVector& output, const ndBrainVector* const bias) const
+{
+	ndBrainActivation(output, bias, ndBrainSigmoid);
+}
+
+void ndBrainLayer::HyperbolicTanActivation(ndBrainVector& output, const ndBrainVector* const bias) const
+{
+	ndBrainActivation(output, bias, ndBrainTanh);
+}
+
+void ndBrainLayer::EluActivation(ndBrainVector& output, const ndBrainVector* const bias) const
+{
+	ndBrainActivation(output, bias, ndBrainElu);
+}
+
+void ndBrainLayer::SoftplusActivation(ndBrainVector& output, const ndBrainVector* const bias) const
+{
+	ndBrainActivation(output, bias, ndBrainSoftplus);
+}
+
+void ndBrainLayer::SoftmaxActivation(ndBrainVector& output, const ndBrainVector* const bias) const
+{
+	LinealActivation(output, bias);
+
+	// subtracting the max does not change the result, but keeps the exponentials in range
+	ndReal maxValue = output[0];
+	for (ndInt32 i = output.GetCount() - 1; i > 0; --i)
+	{
+		maxValue = ndMax(maxValue, output[i]);
+	}
+
 	ndReal acc = 0.0f;
 	for (ndInt32 i = output.GetCount() - 1; i >= 0; --i)
 	{
-		const ndReal exp = ndReal(ndPow(ndEXP, output[i]));
+		const ndReal exp = ndBrainExp(output[i] - maxValue);
 		output[i] = exp;
-		ndAssert(ndCheckFloat(output[i]));
 		acc += exp;
 	}
 	
@@ -294,109 +475,189 @@ void ndBrainLayer::SoftmaxActivation(ndBrainVector& output) const
 	}
 }
 
-void ndBrainLayer::SigmoidDerivative(const ndBrainVector& input, ndBrainVector& derivativeOutput) const
+void ndBrainLayer::ApplyActivation(ndBrainVector& output, const ndBrainVector* const bias) const
 {
-	ndAssert(input.GetCount() == derivativeOutput.GetCount());
-	for (ndInt32 i = input.GetCount() - 1; i >= 0; --i)
+	if (!output.GetCount())
 	{
-		ndReal val = input[i];
-		derivativeOutput[i] = val * (ndReal(1.0f) - val);
+		return;
 	}
-}
 
-void ndBrainLayer::LinealActivationDerivative(const ndBrainVector& input, ndBrainVector& derivativeOutput) const
-{
-	ndAssert(input.GetCount() == derivativeOutput.GetCount());
-	for (ndInt32 i = input.GetCount() - 1; i >= 0; --i)
+	switch (m_activation)
 	{
-		derivativeOutput[i] = 1.0f;
+		case m_relu:
+		{
+			ReluActivation(output, bias);
+			break;
+		}
+
+		case m_lineal:
+		{
+			LinealActivation(output, bias);
+			break;
+		}
+
+		case m_tanh:
+		{
+			HyperbolicTanActivation(output, bias);
+			break;
+		}
+
+		case m_sigmoid:
+		{
+			SigmoidActivation(output, bias);
+			break;
+		}
+
+		case m_softmax:
+		{
+			SoftmaxActivation(output, bias);
+			break;
+		}
+
+		case m_leakyRelu:
+		{
+			LeakyReluActivation(output, bias);
+			break;
+		}
+
+		case m_elu:
+		{
+			EluActivation(output, bias);
+			break;
+		}
+
+		case m_softplus:
+		{
+			SoftplusActivation(output, bias);
+			break;
+		}
+
+		default:
+			ndAssert(0);
 	}
 }
 
-void ndBrainLayer::ReluActivationDerivative(const ndBrainVector& input, ndBrainVector& derivativeOutput) const
+void ndBrainLayer::ApplyActivation(ndBrainVector& output) const
 {
-	ndAssert(input.GetCount() == derivativeOutput.GetCount());
-	for (ndInt32 i = input.GetCount() - 1; i >= 0; --i)
-	{
-		ndReal val = input[i];
-		derivativeOutput[i] = (val > 0.0f) ? 1.0f : 0.0f;
-	}
+	ApplyActivation(output, nullptr);
 }
 
-void ndBrainLayer::HyperbolicTanDerivative(const ndBrainVector& input, ndBrainVector& derivativeOutput) const
+void ndBrainLayer::ApplyBiasActivation(ndBrainVector& output) const
 {
-	ndAssert(input.GetCount() == derivativeOutput.GetCount());
-	for (ndInt32 i = input.GetCount() - 1; i >= 0; --i)
-	{
-		ndReal val = input[i];
-		derivativeOutput[i] = ndReal(1.0f) - val * val;
-	}
+	ndAssert(output.GetCount() == m_bias.GetCount());
+	ApplyActivation(output, &m_bias);
 }
 
-void ndBrainLayer::ApplyActivation(ndBrainVector& output) const
+void ndBrainLayer::ApplyBiasActivation(ndBrainVector& output, ndBrainVector& derivativeOutput) const
 {
+	ndAssert(output.GetCount() == m_bias.GetCount());
+	ndAssert(output.GetCount() == derivativeOutput.GetCount());
+	if (!output.GetCount())
+	{
+		return;
+	}
+
 	switch (m_activation)
 	{
 		case m_relu:
 		{
-			ReluActivation(output);
+			ndBrainActivation(output, derivativeOutput, m_bias, ndBrainRelu, ndBrainReluDerivative);
 			break;
 		}
 
 		case m_lineal:
 		{
-			LinealActivation(output);
+			output.Add(output, m_bias);
+			derivativeOutput.Set(ndReal(1.0f));
 			break;
 		}
 
 		case m_tanh:
 		{
-			HyperbolicTanActivation(output);
+			ndBrainActivation(output, derivativeOutput, m_bias, ndBrainTanh, ndBrainTanhDerivative);
 			break;
 		}
 
 		case m_sigmoid:
 		{
-			SigmoidActivation(output);
+			ndBrainActivation(output, derivativeOutput, m_bias, ndBrainSigmoid, ndBrainSigmoidDerivative);
 			break;
 		}
 
-		case m_softmax:
+		case m_leakyRelu:
+		{
+			ndBrainActivation(output, derivativeOutput, m_bias, ndBrainLeakyRelu, ndBrainLeakyReluDerivative);
+			break;
+		}
+
+		case m_elu:
+		{
+			ndBrainActivation(output, derivativeOutput, m_bias, ndBrainElu, ndBrainEluDerivative);
+			break;
+		}
+
+		case m_softplus:
 		{
-			SoftmaxActivation(output);
+			ndBrainActivation(output, derivativeOutput, m_bias, ndBrainSoftplus, ndBrainSoftplusDerivative);
 			break;
 		}
 
 		default:
-			ndAssert(0);
+		{
+			ApplyActivation(output, &m_bias);
+			ActivationDerivative(output, derivativeOutput);
+		}
 	}
 }
 
 void ndBrainLayer::ActivationDerivative(const ndBrainVector& input, ndBrainVector& derivativeOutput) const
 {
+	if (!input.GetCount())
+	{
+		return;
+	}
+
 	switch (m_activation)
 	{
 		case m_relu:
 		{
-			ReluActivationDerivative(input, derivativeOutput);
+			ndBrainDerivative(input, derivativeOutput, ndBrainReluDerivative);
 			break;
 		}
 
 		case m_lineal:
 		{
-			LinealActivationDerivative(input, derivativeOutput);
+			ndBrainDerivative(input, derivativeOutput, ndBrainLinealDerivative);
 			break;
 		}
 
 		case m_tanh:
 		{
-			HyperbolicTanDerivative(input, derivativeOutput);
+			ndBrainDerivative(input, derivativeOutput, ndBrainTanhDerivative);
 			break;
 		}
 
 		case m_sigmoid:
 		{
-			SigmoidDerivative(input, derivativeOutput);
+			ndBrainDerivative(input, derivativeOutput, ndBrainSigmoidDerivative);
+			break;
+		}
+
+		case m_leakyRelu:
+		{
+			ndBrainDerivative(input, derivativeOutput, ndBrainLeakyReluDerivative);
+			break;
+		}
+
+		case m_elu:
+		{
+			ndBrainDerivative(input, derivativeOutput, ndBrainEluDerivative);
+			break;
+		}
+
+		case m_softplus:
+		{
+			ndBrainDerivative(input, derivativeOutput, ndBrainSoftplusDerivative);
 			break;
 		}
 
@@ -415,8 +676,7 @@ void ndBrainLayer::ActivationDerivative(const ndBrainVector& input, ndBrainVecto
 void ndBrainLayer::MakePrediction(const ndBrainVector& input, ndBrainVector& output)
 {
 	Mul(input, output);
-	output.Add(output, m_bias);
-	ApplyActivation(output);
+	ApplyBiasActivation(output);
 }
 
 void ndBrainLayer::MakePrediction(ndThreadPool& threadPool, const ndBrainVector& input, ndBrainVector& output)
@@ -435,9 +695,58 @@ void ndBrainLayer::MakePrediction(ndThreadPool& threadPool, const ndBrainVector&
 			{
 				output[i] = input.Dot(matrix[i]);
 			}
-			out.Add(out, bias);
-			ApplyActivation(out);
+			ApplyActivation(out, &bias);
 		}
 	});
 	threadPool.ParallelExecute(MakePrediction);
-}
\ No newline at end of file
+}
+
+void ndBrainLayer::MakePrediction(const ndBrainMatrix& input, ndBrainMatrix& output)
+{
+	MakePrediction(input, output, 0, input.GetCount());
+}
+
+void ndBrainLayer::MakePrediction(ndThreadPool& threadPool, const ndBrainMatrix& input, ndBrainMatrix& output)
+{
+	auto MakePrediction = ndMakeObject::ndFunction([this, &input, &output](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		const ndStartEnd startEnd(input.GetCount(), threadIndex, threadCount);
+		const ndInt32 count(startEnd.m_end - startEnd.m_start);
+		if (count)
+		{
+			this->MakePrediction(input, output, startEnd.m_start, count);
+		}
+	});
+	threadPool.ParallelExecute(MakePrediction);
+}
+
+// the bias and activation epilogue runs on each block of samples 
+// right after its product, while the outputs are still in cache
+void ndBrainLayer::MakePrediction(const ndBrainMatrix& input, ndBrainMatrix& output, ndInt32 start, ndInt32 count)
+{
+	const ndInt32 end = start + count;
+	for (ndInt32 base = start; base < end; base += D_BRAIN_GEMM_SAMPLE_BLOCK)
+	{
+		const ndInt32 blockCount = ndMin(D_BRAIN_GEMM_SAMPLE_BLOCK, end - base);
+		Mul(input, output, base, blockCount);
+		for (ndInt32 i = base + blockCount - 1; i >= base; --i)
+		{
+			ApplyBiasActivation(output[i]);
+		}
+	}
+}
+
+// training forward pass, also writes the activation derivatives in the same epilogue
+void ndBrainLayer::MakePrediction(const ndBrainMatrix& input, ndBrainMatrix& output, ndBrainMatrix& derivative, ndInt32 start, ndInt32 count)
+{
+	const ndInt32 end = start + count;
+	for (ndInt32 base = start; base < end; base += D_BRAIN_GEMM_SAMPLE_BLOCK)
+	{
+		const ndInt32 blockCount = ndMin(D_BRAIN_GEMM_SAMPLE_BLOCK, end - base);
+		Mul(input, output, base, blockCount);
+		for (ndInt32 i = base + blockCount - 1; i >= base; --i)
+		{
+			ApplyBiasActivation(output[i], derivative[i]);
+		}
+	}
+}
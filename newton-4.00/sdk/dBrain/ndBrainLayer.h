@@ -45,10 +45,17 @@ class ndBrainLayer: public ndBrainMatrix
 
 	virtual ndInt32 GetOuputSize() const;
 	virtual ndInt32 GetInputSize() const;
+	ndBrainActivationType GetActivationType() const;
 	virtual void InitGaussianWeights(ndReal mean, ndReal variance);
 	virtual void MakePrediction(const ndBrainVector& input, ndBrainVector& output);
 	virtual void MakePrediction(ndThreadPool& threadPool, const ndBrainVector& input, ndBrainVector& output);
 
+	// minibatch prediction, one sample per matrix row
+	virtual void MakePrediction(const ndBrainMatrix& input, ndBrainMatrix& output);
+	virtual void MakePrediction(ndThreadPool& threadPool, const ndBrainMatrix& input, ndBrainMatrix& output);
+	virtual void MakePrediction(const ndBrainMatrix& input, ndBrainMatrix& output, ndInt32 start, ndInt32 count);
+	virtual void MakePrediction(const ndBrainMatrix& input, ndBrainMatrix& output, ndBrainMatrix& derivative, ndInt32 start, ndInt32 count);
+
 	virtual void CopyFrom(const ndBrainLayer& src);
 	virtual bool Compare(const ndBrainLayer& src) const;
 
@@ -56,19 +63,20 @@ class ndBrainLayer: public ndBrainMatrix
 	//virtual void Save(nd::TiXmlElement* const layerNode) const;
 
 	void ApplyActivation(ndBrainVector& output) const;
+	void ApplyBiasActivation(ndBrainVector& output) const;
+	void ApplyBiasActivation(ndBrainVector& output, ndBrainVector& outputDerivative) const;
 	void ActivationDerivative(const ndBrainVector& input, ndBrainVector& outputDerivative) const;
 
 	protected:
-	void ReluActivation(ndBrainVector& output) const;
-	void LinealActivation(ndBrainVector& output) const;
-	void SigmoidActivation(ndBrainVector& output) const;
-	void SoftmaxActivation(ndBrainVector& output) const;
-	void HyperbolicTanActivation(ndBrainVector& output) const;
-
-	void SigmoidDerivative(const ndBrainVector& input, ndBrainVector& derivativeOutput) const;
-	void HyperbolicTanDerivative(const ndBrainVector& input, ndBrainVector& derivativeOutput) const;
-	void ReluActivationDerivative(const ndBrainVector& input, ndBrainVector& derivativeOutput) const;
-	void LinealActivationDerivative(const ndBrainVector& input, ndBrainVector& derivativeOutput) const;
+	void ApplyActivation(ndBrainVector& output, const ndBrainVector* const bias) const;
+	void ReluActivation(ndBrainVector& output, const ndBrainVector* const bias) const;
+	void EluActivation(ndBrainVector& output, const ndBrainVector* const bias) const;
+	void LinealActivation(ndBrainVector& output, const ndBrainVector* const bias) const;
+	void SigmoidActivation(ndBrainVector& output, const ndBrainVector* const bias) const;
+	void SoftmaxActivation(ndBrainVector& output, const ndBrainVector* const bias) const;
+	void SoftplusActivation(ndBrainVector& output, const ndBrainVector* const bias) const;
+	void LeakyReluActivation(ndBrainVector& output, const ndBrainVector* const bias) const;
+	void HyperbolicTanActivation(ndBrainVector& output, const ndBrainVector* const bias) const;
 
 	ndDeepBrainMemVector m_bias;
 	ndBrainActivationType m_activation;
@@ -85,6 +93,11 @@ inline ndInt32 ndBrainLayer::GetInputSize() const
 	return m_columns;
 }
 
+inline ndBrainActivationType ndBrainLayer::GetActivationType() const
+{
+	return m_activation;
+}
+
 inline ndBrainVector& ndBrainLayer::GetBias()
 {
 	return m_bias;
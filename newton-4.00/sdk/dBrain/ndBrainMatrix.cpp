@@ -25,50 +25,60 @@
 
 ndBrainMatrix::ndBrainMatrix()
 	:ndArray<ndBrainVector>()
+	,m_memory(nullptr)
 {
 }
 
 ndBrainMatrix::ndBrainMatrix(ndInt32 rows, ndInt32 columns)
 	:ndArray<ndBrainVector>()
+	,m_memory(nullptr)
 {
 	Init(rows, columns);
 }
 
 ndBrainMatrix::ndBrainMatrix(const ndBrainMatrix& src)
-	:ndArray<ndBrainVector>(src)
+	:ndArray<ndBrainVector>()
+	,m_memory(nullptr)
 {
-	ndBrainMatrix& me = *this;
-	for (ndInt32 i = 0; i < src.GetRows(); ++i)
-	{
-		ndBrainVector& row = me[i];
-		row.ResetMembers();
-		row.SetCount(src.GetColumns());
-		row.Set(src[i]);
-	}
+	Init(src.GetRows(), src.GetColumns());
+	Set(src);
 }
 
 ndBrainMatrix::~ndBrainMatrix()
 {
-	if (m_array)
+	FreeMemory();
+}
+
+void ndBrainMatrix::FreeMemory()
+{
+	if (m_memory)
 	{
 		ndBrainMatrix& me = *this;
 		for (ndInt32 i = GetCount() - 1; i >= 0; --i)
 		{
-			ndBrainVector& row = me[i];
-			row.~ndBrainVector();
+			me[i].ResetMembers();
 		}
+		ndMemory::Free(m_memory);
+		m_memory = nullptr;
 	}
 }
 
 void ndBrainMatrix::Init(ndInt32 rows, ndInt32 columns)
 {
+	FreeMemory();
 	SetCount(rows);
+
+	// all rows share one aligned allocation,
+	// each row padded to D_DEEP_BRAIN_DATA_ALIGMENT elements.
+	const ndInt32 stride = (columns + D_DEEP_BRAIN_DATA_ALIGMENT - 1) & -D_DEEP_BRAIN_DATA_ALIGMENT;
+	const size_t size = size_t(ndMax(rows * stride, 1)) * sizeof(ndReal);
+	m_memory = (ndReal*)ndMemory::Malloc(size);
+	memset(m_memory, 0, size);
+
 	ndBrainMatrix& me = *this;
 	for (ndInt32 i = 0; i < rows; ++i)
 	{
-		ndBrainVector& row = me[i];
-		row.ResetMembers();
-		row.SetCount(columns);
+		me[i].SetMembers(columns, &m_memory[i * stride]);
 	}
 }
 
@@ -136,4 +146,119 @@ void ndBrainMatrix::Mul(const ndBrainVector& input, ndBrainVector& output) const
 		const ndBrainVector& row = me[i];
 		output[i] = ndDotProduct(columns, &row[0], &input[0]);
 	}
-}
\ No newline at end of file
+}
+
+// register tile of up to four weight rows times four samples.
+// each dot product is split in D_BRAIN_GEMM_LANES partial sums,
+// so that the compiler can map the inner loop to simd registers.
+template <bool fullTile>
+static inline void ndBrainGemmTile(ndInt32 rowCount, ndInt32 sampleCount, ndInt32 k0, ndInt32 k1, const ndReal* const* const weights, const ndReal* const* const inputs, ndReal* const* const outputs)
+{
+	const ndInt32 rows = fullTile ? D_BRAIN_GEMM_TILE : rowCount;
+	const ndInt32 samples = fullTile ? D_BRAIN_GEMM_TILE : sampleCount;
+
+	ndReal acc[D_BRAIN_GEMM_TILE][D_BRAIN_GEMM_TILE][D_BRAIN_GEMM_LANES];
+	for (ndInt32 i = 0; i < rows; ++i)
+	{
+		for (ndInt32 j = 0; j < samples; ++j)
+		{
+			for (ndInt32 n = 0; n < D_BRAIN_GEMM_LANES; ++n)
+			{
+				acc[i][j][n] = ndReal(0.0f);
+			}
+		}
+	}
+
+	const ndInt32 k2 = k0 + ((k1 - k0) & -D_BRAIN_GEMM_LANES);
+	for (ndInt32 k = k0; k < k2; k += D_BRAIN_GEMM_LANES)
+	{
+		for (ndInt32 i = 0; i < rows; ++i)
+		{
+			const ndReal* const weight = &weights[i][k];
+			for (ndInt32 j = 0; j < samples; ++j)
+			{
+				const ndReal* const input = &inputs[j][k];
+				for (ndInt32 n = 0; n < D_BRAIN_GEMM_LANES; ++n)
+				{
+					acc[i][j][n] = acc[i][j][n] + weight[n] * input[n];
+				}
+			}
+		}
+	}
+
+	for (ndInt32 i = 0; i < rows; ++i)
+	{
+		for (ndInt32 j = 0; j < samples; ++j)
+		{
+			ndReal sum = k0 ? outputs[j][i] : ndReal(0.0f);
+			for (ndInt32 n = 0; n < D_BRAIN_GEMM_LANES; ++n)
+			{
+				sum += acc[i][j][n];
+			}
+			for (ndInt32 k = k2; k < k1; ++k)
+			{
+				sum += weights[i][k] * inputs[j][k];
+			}
+			ndAssert(ndCheckFloat(sum));
+			outputs[j][i] = sum;
+		}
+	}
+}
+
+void ndBrainMatrix::Mul(const ndBrainMatrix& input, ndBrainMatrix& output) const
+{
+	Mul(input, output, 0, input.GetCount());
+}
+
+void ndBrainMatrix::Mul(const ndBrainMatrix& input, ndBrainMatrix& output, ndInt32 start, ndInt32 count) const
+{
+	const ndBrainMatrix& me = *this;
+	const ndInt32 rows = GetRows();
+	const ndInt32 columns = GetColumns();
+	ndAssert((start + count) <= input.GetCount());
+	ndAssert((start + count) <= output.GetCount());
+
+	const ndReal* weights[D_BRAIN_GEMM_TILE];
+	const ndReal* inputs[D_BRAIN_GEMM_TILE];
+	ndReal* outputs[D_BRAIN_GEMM_TILE];
+
+	// samples are processed in blocks, so that the column slices of a
+	// block stay in cache while all the weight rows are streamed over them.
+	const ndInt32 end = start + count;
+	for (ndInt32 sampleBlock = start; sampleBlock < end; sampleBlock += D_BRAIN_GEMM_SAMPLE_BLOCK)
+	{
+		const ndInt32 sampleBlockEnd = ndMin(sampleBlock + D_BRAIN_GEMM_SAMPLE_BLOCK, end);
+		for (ndInt32 k0 = 0; k0 < columns; k0 += D_BRAIN_GEMM_COLUMN_BLOCK)
+		{
+			const ndInt32 k1 = ndMin(k0 + D_BRAIN_GEMM_COLUMN_BLOCK, columns);
+			for (ndInt32 i = 0; i < rows; i += D_BRAIN_GEMM_TILE)
+			{
+				const ndInt32 rowCount = ndMin(D_BRAIN_GEMM_TILE, rows - i);
+				for (ndInt32 j = 0; j < rowCount; ++j)
+				{
+					weights[j] = &me[i + j][0];
+				}
+
+				for (ndInt32 j = sampleBlock; j < sampleBlockEnd; j += D_BRAIN_GEMM_TILE)
+				{
+					const ndInt32 sampleCount = ndMin(D_BRAIN_GEMM_TILE, sampleBlockEnd - j);
+					for (ndInt32 k = 0; k < sampleCount; ++k)
+					{
+						ndAssert(input[j + k].GetCount() == columns);
+						ndAssert(output[j + k].GetCount() == rows);
+						inputs[k] = &input[j + k][0];
+						outputs[k] = &output[j + k][i];
+					}
+					if ((rowCount == D_BRAIN_GEMM_TILE) && (sampleCount == D_BRAIN_GEMM_TILE))
+					{
+						ndBrainGemmTile<true>(rowCount, sampleCount, k0, k1, weights, inputs, outputs);
+					}
+					else
+					{
+						ndBrainGemmTile<false>(rowCount, sampleCount, k0, k1, weights, inputs, outputs);
+					}
+				}
+			}
+		}
+	}
+}
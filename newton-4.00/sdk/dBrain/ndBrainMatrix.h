@@ -42,9 +42,16 @@ class ndBrainMatrix: public ndArray<ndBrainVector>
 	void SetTranspose(const ndBrainMatrix& src);
 	void Mul(const ndBrainVector& input, ndBrainVector& output) const;
 
+	// batched product, output[i] = (*this) * input[i] for each sample row
+	void Mul(const ndBrainMatrix& input, ndBrainMatrix& output) const;
+	void Mul(const ndBrainMatrix& input, ndBrainMatrix& output, ndInt32 start, ndInt32 count) const;
+
 	protected:
+	void FreeMemory();
 	ndUnsigned8* SetPointer(ndUnsigned8* const mem);
 	ndReal* SetFloatPointers(ndReal* const mem, ndInt32 columns);
+
+	ndReal* m_memory;
 };
 
 inline ndInt32 ndBrainMatrix::GetRows() const
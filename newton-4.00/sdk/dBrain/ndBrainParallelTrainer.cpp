@@ -28,13 +28,21 @@ class ndBrainParallelTrainer::ndBrainTrainerChannel : public ndBrainTrainer
 {	
 	public:
 	ndBrainTrainerChannel(const ndBrainParallelTrainer& src)
-		:ndBrainTrainer(src)
+		:ndBrainTrainer(src.GetBrain())
+		,m_input()
+		,m_truth()
 	{
 		for (ndInt32 i = 0; i < m_weightsLayersTranspose.GetCount(); ++i)
 		{
 			delete m_weightsLayersTranspose[i];
 			m_weightsLayersTranspose[i] = src.m_weightsLayersTranspose[i];
 		}
+
+		// the workers never run the optimizer, so they do not need its state
+		ReleaseVector(m_biasGradient_u);
+		ReleaseVector(m_biasGradient_v);
+		ReleaseVector(m_weightGradient_u);
+		ReleaseVector(m_weightGradient_v);
 	}
 
 	~ndBrainTrainerChannel()
@@ -44,6 +52,15 @@ class ndBrainParallelTrainer::ndBrainTrainerChannel : public ndBrainTrainer
 			m_weightsLayersTranspose[i] = nullptr;
 		}
 	}
+
+	static void ReleaseVector(ndBrainVector& vector)
+	{
+		ndBrainVector empty;
+		vector.Swap(empty);
+	}
+
+	ndBrainMatrix m_input;
+	ndBrainMatrix m_truth;
 };
 
 ndBrainParallelTrainer::ndBrainParallelTrainer(ndBrain* const brain, ndInt32 threads)
@@ -52,13 +69,13 @@ ndBrainParallelTrainer::ndBrainParallelTrainer(ndBrain* const brain, ndInt32 thr
 	,m_inputBatch(nullptr)
 	,m_groundTruth(nullptr)
 	,m_validator(nullptr)
+	,m_samplesPerSecond(0.0f)
 	,m_learnRate(0.0f)
 	,m_steps(0)
 {
-	threads = ndMin(threads, D_MAX_THREADS_COUNT);
-	SetThreadCount(threads);
-
-	for (ndInt32 i = 0; i < threads; i++)
+	// the pool clamps the thread count, one channel per effective thread
+	SetThreadCount(ndMin(threads, D_MAX_THREADS_COUNT));
+	for (ndInt32 i = 0; i < GetThreadCount(); i++)
 	{
 		ndBrainTrainerChannel* const channel = new ndBrainTrainerChannel(*this);
 		m_threadData.PushBack(channel);
@@ -92,35 +109,28 @@ void ndBrainParallelTrainer::Optimize(ndValidation& validator, const ndBrainMatr
 	Sync();
 }
 
-void ndBrainParallelTrainer::AverageWeights()
+// reduce scatter of the worker gradients, each thread sums
+// its slice of the accumulators over all the workers.
+void ndBrainParallelTrainer::ReduceGradients()
 {
-	const ndInt32 threads = m_threadData.GetCount();
-	const ndReal weightFactor = 1.0f / ndReal(threads);
-	
-	const ndArray<ndBrainLayer*>& layers = (*m_instance.GetBrain());
-	for (ndInt32 j = layers.GetCount() - 1; j >= 0; --j)
+	ClearGradientsAcc();
+	auto AddGradients = ndMakeObject::ndFunction([this](ndInt32 threadIndex, ndInt32 threadCount)
 	{
-		ndBrainLayer& layer = *layers[j];
-		ndBrainVector& bias = layer.GetBias();
-	
-		layer.Set(0);
-		bias.Set(0.0f);
-		for (ndInt32 i = 0; i < threads; ++i)
-		{
-			const ndBrainLayer& srcLayer = *(*m_threadData[i]->GetBrain())[j];
-			bias.Add(bias, srcLayer.GetBias());
-			for (ndInt32 k = 0; k < layer.GetOuputSize(); k++)
-			{
-				layer[k].Add(layer[k], srcLayer[k]);
-			}
-		}
-		
-		layer.GetBias().ScaleSet(layer.GetBias(), weightFactor);
-		for (ndInt32 k = 0; k < layer.GetOuputSize(); k++)
+		const ndStartEnd biasStartEnd(m_biasGradientsAcc.GetCount(), threadIndex, threadCount);
+		const ndStartEnd weightStartEnd(m_weightGradients.GetCount(), threadIndex, threadCount);
+
+		ndDeepBrainMemVector biasAcc(&m_biasGradientsAcc[biasStartEnd.m_start], biasStartEnd.m_end - biasStartEnd.m_start);
+		ndDeepBrainMemVector weightAcc(&m_weightGradients[weightStartEnd.m_start], weightStartEnd.m_end - weightStartEnd.m_start);
+		for (ndInt32 i = 0; i < GetThreadCount(); ++i)
 		{
-			layer[k].ScaleSet(layer[k], weightFactor);
+			const ndBrainTrainer& optimizer = *m_threadData[i];
+			const ndDeepBrainMemVector biasSrc(&optimizer.m_biasGradientsAcc[biasStartEnd.m_start], biasStartEnd.m_end - biasStartEnd.m_start);
+			const ndDeepBrainMemVector weightSrc(&optimizer.m_weightGradients[weightStartEnd.m_start], weightStartEnd.m_end - weightStartEnd.m_start);
+			biasAcc.Add(biasAcc, biasSrc);
+			weightAcc.Add(weightAcc, weightSrc);
 		}
-	}
+	});
+	ParallelExecute(AddGradients);
 }
 
 ndReal ndBrainParallelTrainer::Validate(const ndBrainMatrix& inputBatch, const ndBrainMatrix& groundTruth, ndBrainVector&)
@@ -178,9 +188,24 @@ void ndBrainParallelTrainer::Optimize()
 	const ndInt32 miniBatchSize = ndMin(m_miniBatchSize, inputBatch.GetCount());
 	const ndInt32 batchCount = (inputBatch.GetCount() + miniBatchSize - 1) / miniBatchSize;
 
+	// each worker gathers its slice of the minibatch in a contiguous batch
+	const ndInt32 sliceSize = (miniBatchSize + GetThreadCount() - 1) / GetThreadCount();
+	for (ndInt32 i = 0; i < GetThreadCount(); ++i)
+	{
+		ndBrainTrainerChannel& channel = *m_threadData[i];
+		if (channel.m_input.GetCount() < sliceSize)
+		{
+			channel.m_input.Init(sliceSize, inputBatch.GetColumns());
+			channel.m_truth.Init(sliceSize, groundTruth.GetColumns());
+		}
+	}
+
+	ndUnsigned64 trainTime = 0;
+	ndUnsigned64 trainSamples = 0;
 	m_bestCost = validator.Validate(inputBatch, groundTruth);
 	for (ndInt32 i = 0; (i < m_steps) && (m_bestCost > 0.0f); ++i)
 	{
+		const ndUnsigned64 startTime = ndGetTimeInMicroseconds();
 		for (ndInt32 j = 0; j < batchCount; ++j)
 		{
 			const ndInt32 batchStart = j * miniBatchSize;
@@ -188,42 +213,30 @@ void ndBrainParallelTrainer::Optimize()
 
 			auto CalculateGradients = ndMakeObject::ndFunction([this, batchStart, batchSize, &randomizeVector](ndInt32 threadIndex, ndInt32 threadCount)
 			{
-				ndBrainTrainer& optimizer = *m_threadData[threadIndex];
+				ndBrainTrainerChannel& optimizer = *m_threadData[threadIndex];
 
 				optimizer.ClearGradientsAcc();
 				const ndStartEnd startEnd(batchSize, threadIndex, threadCount);
-				for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+				const ndInt32 count = startEnd.m_end - startEnd.m_start;
+				if (count)
 				{
-					ndInt32 k = randomizeVector[batchStart + i];
-					const ndBrainVector& input = (*m_inputBatch)[k];
-					const ndBrainVector& truth = (*m_groundTruth)[k];
-					optimizer.MakePrediction(input);
-					optimizer.BackPropagate(truth);
+					for (ndInt32 i = 0; i < count; ++i)
+					{
+						ndInt32 k = randomizeVector[batchStart + startEnd.m_start + i];
+						optimizer.m_input[i].Set((*m_inputBatch)[k]);
+						optimizer.m_truth[i].Set((*m_groundTruth)[k]);
+					}
+					optimizer.MakeBatchPrediction(optimizer.m_input, count);
+					optimizer.BackPropagateBatch(optimizer.m_input, optimizer.m_truth, count);
 				}
 			});
 			ParallelExecute(CalculateGradients);
 
-			ClearGradientsAcc();
-			auto AddGradients = ndMakeObject::ndFunction([this](ndInt32 threadIndex, ndInt32 threadCount)
-			{
-				const ndStartEnd biasStartEnd(m_biasGradientsAcc.GetCount(), threadIndex, threadCount);
-				const ndStartEnd weightStartEnd(m_weightGradients.GetCount(), threadIndex, threadCount);
-
-				ndDeepBrainMemVector biasAcc(&m_biasGradientsAcc[biasStartEnd.m_start], biasStartEnd.m_end - biasStartEnd.m_start);
-				ndDeepBrainMemVector weightAcc(&m_weightGradients[weightStartEnd.m_start], weightStartEnd.m_end - weightStartEnd.m_start);
-				for (ndInt32 i = 0; i < threadCount; ++i)
-				{
-					const ndBrainTrainer& optimizer = *m_threadData[i];
-					const ndDeepBrainMemVector biasSrc(&optimizer.m_biasGradientsAcc[biasStartEnd.m_start], biasStartEnd.m_end - biasStartEnd.m_start);
-					const ndDeepBrainMemVector weightSrc(&optimizer.m_weightGradients[weightStartEnd.m_start], weightStartEnd.m_end - weightStartEnd.m_start);
-					biasAcc.Add(biasAcc, biasSrc);
-					weightAcc.Add(weightAcc, weightSrc);
-				}
-				threadIndex *= 1;
-			});
-			ParallelExecute(AddGradients);
+			ReduceGradients();
 			UpdateWeights(m_learnRate, batchSize);
 		}
+		trainTime += ndGetTimeInMicroseconds() - startTime;
+		trainSamples += ndUnsigned64(inputBatch.GetCount());
 
 		ApplyWeightTranspose();
 		randomizeVector.RandomShuffle(randomizeVector.GetCount());
@@ -236,4 +249,5 @@ void ndBrainParallelTrainer::Optimize()
 		}
 	}
 	m_instance.GetBrain()->CopyFrom(bestNetwork);
+	m_samplesPerSecond = trainTime ? ndFloat64(trainSamples) * 1000000.0f / ndFloat64(trainTime) : 0.0f;
 }
\ No newline at end of file
@@ -26,6 +26,9 @@
 #include "ndBrainTrainer.h"
 
 
+// data parallel trainer, each minibatch is split across the threads.
+// the workers only keep the gradient accumulators, their gradients are
+// reduced into this trainer, which owns the single optimizer state.
 class ndBrainParallelTrainer: public ndBrainTrainer, public ndThreadPool
 {
 	public: 
@@ -35,22 +38,30 @@ class ndBrainParallelTrainer: public ndBrainTrainer, public ndThreadPool
 
 	virtual void Optimize(ndValidation& validator, const ndBrainMatrix& inputBatch, const ndBrainMatrix& groundTruth, ndReal learnRate, ndInt32 steps);
 
+	// training throughput of the last call to Optimize, validation excluded
+	ndFloat64 GetSamplesPerSecond() const;
+
 	private:
 	void Optimize();
 	ndReal Validate(const ndBrainMatrix& inputBatch, const ndBrainMatrix& groundTruth, ndBrainVector& output);
 	virtual void ThreadFunction();
 
 	private:
-	void AverageWeights();
+	void ReduceGradients();
 	ndFixSizeArray<ndBrainTrainerChannel*, D_MAX_THREADS_COUNT> m_threadData;
 
 	const ndBrainMatrix* m_inputBatch;
 	const ndBrainMatrix* m_groundTruth;
 	ndValidation* m_validator;
+	ndFloat64 m_samplesPerSecond;
 	ndReal m_learnRate;
 	ndInt32 m_steps;
 };
 
+inline ndFloat64 ndBrainParallelTrainer::GetSamplesPerSecond() const
+{
+	return m_samplesPerSecond;
+}
 
 #endif 
 
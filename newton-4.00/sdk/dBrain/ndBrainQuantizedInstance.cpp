@@ -0,0 +1,170 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "ndBrainStdafx.h"
+#include "ndBrain.h"
+#include "ndBrainLayer.h"
+#include "ndBrainQuantizedInstance.h"
+
+// integer sums can be reordered freely, so the compiler vectorizes this
+// loop with the 16 bit multiply add of the baseline simd instructions
+static ndInt32 ndQuantizedDot(const ndInt16* const a, const ndInt16* const b, ndInt32 count)
+{
+	ndInt32 sum = 0;
+	for (ndInt32 i = 0; i < count; ++i)
+	{
+		sum += ndInt32(a[i]) * ndInt32(b[i]);
+	}
+	return sum;
+}
+
+// symmetric quantization, returns the scale that maps the int8 values back
+static ndReal ndQuantize(const ndReal* const src, ndInt16* const dst, ndInt32 count)
+{
+	ndReal maxValue = ndReal(0.0f);
+	for (ndInt32 i = 0; i < count; ++i)
+	{
+		maxValue = ndMax(maxValue, ndReal(ndAbs(src[i])));
+	}
+
+	if (maxValue == ndReal(0.0f))
+	{
+		memset(dst, 0, size_t(count) * sizeof(ndInt16));
+		return ndReal(0.0f);
+	}
+
+	const ndReal invScale = ndReal(127.0f) / maxValue;
+	for (ndInt32 i = 0; i < count; ++i)
+	{
+		dst[i] = ndInt16(ndFloor(src[i] * invScale + ndReal(0.5f)));
+	}
+	return maxValue / ndReal(127.0f);
+}
+
+ndBrainQuantizedInstance::ndLayer::ndLayer(const ndBrainLayer* const layer)
+	:ndClassAlloc()
+	,m_weights()
+	,m_scale()
+	,m_layer(layer)
+	,m_stride((layer->GetInputSize() + D_BRAIN_QUANTIZED_LANES - 1) & -D_BRAIN_QUANTIZED_LANES)
+{
+	const ndInt32 rows = layer->GetOuputSize();
+	m_scale.SetCount(rows);
+	m_weights.SetCount(rows * m_stride);
+	memset(&m_weights[0], 0, size_t(m_weights.GetCount()) * sizeof(ndInt16));
+	for (ndInt32 i = 0; i < rows; ++i)
+	{
+		const ndBrainVector& row = (*layer)[i];
+		m_scale[i] = ndQuantize(&row[0], &m_weights[i * m_stride], row.GetCount());
+	}
+}
+
+ndBrainQuantizedInstance::ndBrainQuantizedInstance(ndBrain* const brain)
+	:ndClassAlloc()
+	,m_layers()
+	,m_brain(brain)
+	,m_maxWidth(D_BRAIN_QUANTIZED_LANES)
+{
+	const ndArray<ndBrainLayer*>& layers = *brain;
+	for (ndInt32 i = 0; i < layers.GetCount(); ++i)
+	{
+		ndLayer* const layer = new ndLayer(layers[i]);
+		m_layers.PushBack(layer);
+		m_maxWidth = ndMax(m_maxWidth, ndMax(layer->m_stride, layers[i]->GetOuputSize()));
+	}
+}
+
+ndBrainQuantizedInstance::~ndBrainQuantizedInstance()
+{
+	for (ndInt32 i = m_layers.GetCount() - 1; i >= 0; --i)
+	{
+		delete m_layers[i];
+	}
+}
+
+void ndBrainQuantizedInstance::LayerPrediction(const ndLayer& layer, const ndBrainVector& input, ndBrainVector& output, ndInt16* const quantizedInput) const
+{
+	const ndInt32 inputs = input.GetCount();
+	const ndReal inputScale = ndQuantize(&input[0], quantizedInput, inputs);
+	for (ndInt32 i = inputs; i < layer.m_stride; ++i)
+	{
+		quantizedInput[i] = 0;
+	}
+
+	const ndBrainVector& bias = layer.m_layer->GetBias();
+	for (ndInt32 i = output.GetCount() - 1; i >= 0; --i)
+	{
+		const ndInt32 dot = ndQuantizedDot(&layer.m_weights[i * layer.m_stride], quantizedInput, layer.m_stride);
+		output[i] = ndReal(dot) * layer.m_scale[i] * inputScale + bias[i];
+	}
+	layer.m_layer->ApplyActivation(output);
+}
+
+void ndBrainQuantizedInstance::MakePrediction(const ndBrainVector& input, ndBrainVector& output) const
+{
+	// the scratch buffers live in the caller stack, so that many threads can share the instance
+	ndReal* const buffer0 = ndAlloca(ndReal, m_maxWidth);
+	ndReal* const buffer1 = ndAlloca(ndReal, m_maxWidth);
+	ndInt16* const quantizedInput = ndAlloca(ndInt16, m_maxWidth);
+
+	ndDeepBrainMemVector z0;
+	ndDeepBrainMemVector z1;
+	z0.SetPointer(buffer0);
+	z1.SetPointer(buffer1);
+	z0.SetSize(input.GetCount());
+	memcpy(buffer0, &input[0], input.GetCount() * sizeof(ndReal));
+
+	for (ndInt32 i = 0; i < m_layers.GetCount(); ++i)
+	{
+		const ndLayer& layer = *m_layers[i];
+		ndAssert(z0.GetCount() == layer.m_layer->GetInputSize());
+		z1.SetSize(layer.m_layer->GetOuputSize());
+		LayerPrediction(layer, z0, z1, quantizedInput);
+		z0.Swap(z1);
+	}
+
+	output.SetCount(z0.GetCount());
+	memcpy(&output[0], &z0[0], z0.GetCount() * sizeof(ndReal));
+}
+
+void ndBrainQuantizedInstance::MakePrediction(const ndBrainMatrix& input, ndBrainMatrix& output) const
+{
+	ndAssert(input.GetRows() == output.GetRows());
+	for (ndInt32 i = 0; i < input.GetRows(); ++i)
+	{
+		MakePrediction(input[i], output[i]);
+	}
+}
+
+void ndBrainQuantizedInstance::MakePrediction(ndThreadPool& threadPool, const ndBrainMatrix& input, ndBrainMatrix& output) const
+{
+	ndAssert(input.GetRows() == output.GetRows());
+	auto QuantizedPrediction = ndMakeObject::ndFunction([this, &input, &output](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(QuantizedPrediction);
+		const ndStartEnd startEnd(input.GetRows(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			MakePrediction(input[i], output[i]);
+		}
+	});
+	threadPool.ParallelExecute(QuantizedPrediction);
+}
@@ -0,0 +1,81 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef _ND_BRAIN_QUANTIZED_INSTANCE_H__
+#define _ND_BRAIN_QUANTIZED_INSTANCE_H__
+
+#include "ndBrainStdafx.h"
+#include "ndBrainTypes.h"
+#include "ndBrainVector.h"
+#include "ndBrainMatrix.h"
+
+class ndBrain;
+class ndBrainLayer;
+
+// quantized rows are padded to this many elements
+#define D_BRAIN_QUANTIZED_LANES	16
+
+// post training int8 quantization of a brain, for inference only.
+// the weights are quantized once with one scale per row, and the input
+// of each layer is quantized on the fly with one scale per sample.
+// the dot products accumulate in 32 bit integers, so the result differs
+// from the float model only by the rounding of the weights and the inputs.
+// the int8 values are kept in 16 bit lanes, since the baseline simd
+// instructions only have a multiply add for 16 bit integers.
+// bias and activation are read from the brain, which must outlive the instance.
+class ndBrainQuantizedInstance: public ndClassAlloc
+{
+	public: 
+	ndBrainQuantizedInstance(ndBrain* const brain);
+	~ndBrainQuantizedInstance();
+
+	ndBrain* GetBrain() const;
+
+	void MakePrediction(const ndBrainVector& input, ndBrainVector& output) const;
+	void MakePrediction(const ndBrainMatrix& input, ndBrainMatrix& output) const;
+	void MakePrediction(ndThreadPool& threadPool, const ndBrainMatrix& input, ndBrainMatrix& output) const;
+
+	private:
+	class ndLayer: public ndClassAlloc
+	{
+		public:
+		ndLayer(const ndBrainLayer* const layer);
+
+		ndArray<ndInt16> m_weights;
+		ndBrainVector m_scale;
+		const ndBrainLayer* m_layer;
+		ndInt32 m_stride;
+	};
+
+	void LayerPrediction(const ndLayer& layer, const ndBrainVector& input, ndBrainVector& output, ndInt16* const quantizedInput) const;
+
+	ndArray<ndLayer*> m_layers;
+	ndBrain* m_brain;
+	ndInt32 m_maxWidth;
+};
+
+inline ndBrain* ndBrainQuantizedInstance::GetBrain() const
+{
+	return m_brain;
+}
+
+#endif 
+
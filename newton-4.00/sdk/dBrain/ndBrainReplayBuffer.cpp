@@ -44,96 +44,268 @@ void ndBrainReiforcementTransition::CopyFrom(const ndBrainReiforcementTransition
 	memcpy(&m_nextState[0], &src.m_nextState[0], src.m_nextState.GetCount() * sizeof(ndReal));
 }
 
+ndBrainReplaySumTree::ndBrainReplaySumTree()
+	:ndClassAlloc()
+	,m_nodes()
+	,m_leafCount(0)
+{
+}
+
+void ndBrainReplaySumTree::Init(ndInt32 capacity)
+{
+	m_leafCount = 1;
+	while (m_leafCount < capacity)
+	{
+		m_leafCount *= 2;
+	}
+
+	// node 1 is the root, leaves start at m_leafCount
+	m_nodes.SetCount(2 * m_leafCount);
+	for (ndInt32 i = m_nodes.GetCount() - 1; i >= 0; --i)
+	{
+		m_nodes[i] = ndFloat64(0.0f);
+	}
+}
+
+void ndBrainReplaySumTree::SetPriority(ndInt32 index, ndFloat64 priority)
+{
+	ndAssert(priority >= ndFloat64(0.0f));
+	ndAssert(index >= 0);
+	ndAssert(index < m_leafCount);
+
+	// parents are recomputed from the children instead of adding
+	// the difference, so rounding errors do not accumulate over time
+	ndInt32 node = m_leafCount + index;
+	m_nodes[node] = priority;
+	for (node = node >> 1; node; node = node >> 1)
+	{
+		m_nodes[node] = m_nodes[2 * node] + m_nodes[2 * node + 1];
+	}
+}
+
+ndInt32 ndBrainReplaySumTree::Find(ndFloat64 value) const
+{
+	ndAssert(GetSum() > ndFloat64(0.0f));
+	ndInt32 node = 1;
+	while (node < m_leafCount)
+	{
+		const ndInt32 left = 2 * node;
+		if ((value < m_nodes[left]) || (m_nodes[left + 1] <= ndFloat64(0.0f)))
+		{
+			node = left;
+		}
+		else
+		{
+			value -= m_nodes[left];
+			node = left + 1;
+		}
+	}
+	return node - m_leafCount;
+}
+
 ndBrainReplayBuffer::ndBrainReplayBuffer()
-	:ndArray<ndBrainReiforcementTransition>()
-	,m_randomShaffle()
+	:ndClassAlloc()
 	,m_inputBatch()
 	,m_outputBatch()
 	,m_nextInputBatch()
 	,m_groundTruthBatch()
 	,n_rewardBatch()
 	,n_terminalBatch()
+	,m_weightBatch()
+	,m_indexBatch()
 	,m_learnBatchSize(0)
+	,m_state()
+	,m_action()
+	,m_nextState()
+	,m_reward()
+	,m_terminal()
+	,m_randomShaffle()
+	,m_priorities()
 	,m_replayBufferIndex(0)
+	,m_prioritizedIndex(0)
+	,m_maxPriority(1.0f)
+	,m_alpha(0.6f)
+	,m_beta(0.4f)
+	,m_prioritized(false)
 {
 }
 
 ndBrainReplayBuffer::~ndBrainReplayBuffer()
 {
-	for (ndInt32 i = 0; i < GetCount(); i++)
-	{
-		ndBrainReiforcementTransition& transition = (*this)[i];
-		transition.m_state.~ndBrainVector();
-		transition.m_action.~ndBrainVector();
-		transition.m_nextState.~ndBrainVector();
-	}
 }
 
 void ndBrainReplayBuffer::SetCount(ndInt32 replayBufferSize, ndInt32 replayBatchSize, ndInt32 stateSize, ndInt32 actionSize)
 {
-	ndAssert(GetCount() == 0);
+	ndAssert(GetCapacity() == 0);
 	ndAssert(m_learnBatchSize == 0);
 	ndAssert(replayBufferSize > replayBatchSize);
 
-	m_replayBufferIndex = 0;
+	m_replayBufferIndex.store(0);
+	m_prioritizedIndex = 0;
 	m_learnBatchSize = replayBatchSize;
 
+	m_state.Init(replayBufferSize, stateSize);
+	m_action.Init(replayBufferSize, actionSize);
+	m_nextState.Init(replayBufferSize, stateSize);
+	m_reward.SetCount(replayBufferSize);
+	m_terminal.SetCount(replayBufferSize);
 	m_randomShaffle.SetCount(replayBufferSize);
-	ndArray<ndBrainReiforcementTransition>::SetCount(replayBufferSize);
-
 	for (ndInt32 i = 0; i < replayBufferSize; i++)
 	{
-		ndBrainReiforcementTransition& transition = (*this)[i];
-
+		m_reward[i] = ndReal(0.0f);
+		m_terminal[i] = ndReal(0.0f);
 		m_randomShaffle[i] = ndUnsigned32(i);
-		transition.m_state = ndBrainVector();
-		transition.m_nextState = ndBrainVector();
-		transition.m_action = ndBrainVector();
-		transition.m_reward = 1.0f;
-		transition.m_terminalState = false;
-
-		transition.m_state.SetCount(stateSize);
-		transition.m_nextState.SetCount(stateSize);
-		transition.m_action.SetCount(actionSize);
 	}
 
+	m_indexBatch.SetCount(m_learnBatchSize);
+	m_weightBatch.SetCount(m_learnBatchSize);
 	n_rewardBatch.SetCount(m_learnBatchSize);
 	n_terminalBatch.SetCount(m_learnBatchSize);
-	m_inputBatch.Init(m_learnBatchSize, stateSize);
-	m_outputBatch.Init(m_learnBatchSize, actionSize);
-	m_nextInputBatch.Init(m_learnBatchSize, stateSize);
 	m_groundTruthBatch.Init(m_learnBatchSize, actionSize);
+	for (ndInt32 i = 0; i < m_learnBatchSize; i++)
+	{
+		m_indexBatch[i] = 0;
+		m_weightBatch[i] = ndReal(1.0f);
+	}
+
+	// the batch matrices do not own memory,
+	// their rows are pointed to the sampled entries
+	m_inputBatch.SetCount(m_learnBatchSize);
+	m_outputBatch.SetCount(m_learnBatchSize);
+	m_nextInputBatch.SetCount(m_learnBatchSize);
+	SetBatchViews();
 }
 
-ndBrainReiforcementTransition& ndBrainReplayBuffer::GetTransitionEntry()
+void ndBrainReplayBuffer::SetPrioritizedSampling(ndReal alpha, ndReal beta)
 {
-	ndInt32 replayIndex = m_replayBufferIndex % GetCount();
-	ndBrainReiforcementTransition& transition = (*this)[replayIndex];
-	m_replayBufferIndex++;
-	return transition;
+	ndAssert(GetCapacity());
+	m_alpha = alpha;
+	m_beta = beta;
+	m_prioritized = true;
+
+	// all the transitions already in the buffer start with the same priority
+	m_maxPriority = ndFloat64(1.0f);
+	m_prioritizedIndex = 0;
+	m_priorities.Init(GetCapacity());
 }
 
-void ndBrainReplayBuffer::MakeRandomBatch()
+void ndBrainReplayBuffer::SetImportanceBeta(ndReal beta)
+{
+	m_beta = beta;
+}
+
+ndInt32 ndBrainReplayBuffer::AddTransition(const ndBrainReiforcementTransition& transition)
+{
+	return AddTransition(transition.m_state, transition.m_action, transition.m_nextState, transition.m_reward, transition.m_terminalState);
+}
+
+ndInt32 ndBrainReplayBuffer::AddTransition(const ndBrainVector& state, const ndBrainVector& action, const ndBrainVector& nextState, ndReal reward, bool terminalState)
+{
+	ndAssert(GetCapacity());
+
+	// each producer claims its own slot, so the rows can be written without a lock
+	const ndUnsigned64 slot = m_replayBufferIndex.fetch_add(1);
+	const ndInt32 index = ndInt32(slot % ndUnsigned64(GetCapacity()));
+
+	m_state[index].Set(state);
+	m_action[index].Set(action);
+	m_nextState[index].Set(nextState);
+	m_reward[index] = reward;
+	m_terminal[index] = terminalState ? ndReal(0.0f) : ndReal(1.0f);
+	return index;
+}
+
+void ndBrainReplayBuffer::SetBatchViews()
 {
-	ndInt32 count = ndMin(m_randomShaffle.GetCount(), m_replayBufferIndex);
-	m_randomShaffle.RandomShuffle(count);
-	ndAssert(m_learnBatchSize == m_inputBatch.GetRows());
 	for (ndInt32 i = 0; i < m_learnBatchSize; ++i)
 	{
-		ndInt32 index = ndInt32(m_randomShaffle[i]);
-		const ndBrainReiforcementTransition& transition = (*this)[index];
+		const ndInt32 index = m_indexBatch[i];
+		m_inputBatch[i].SetMembers(m_state.GetColumns(), &m_state[index][0]);
+		m_outputBatch[i].SetMembers(m_action.GetColumns(), &m_action[index][0]);
+		m_nextInputBatch[i].SetMembers(m_nextState.GetColumns(), &m_nextState[index][0]);
+		n_rewardBatch[i] = m_reward[index];
+		n_terminalBatch[i] = m_terminal[index];
+	}
+}
 
-		n_rewardBatch[i] = transition.m_reward;
-		n_terminalBatch[i] = transition.m_terminalState ? 0.0f : 1.0f;
-		for (ndInt32 j = 0; j < m_inputBatch.GetColumns(); ++j)
-		{
-			m_inputBatch[i][j] = transition.m_state[j];
-			m_nextInputBatch[i][j] = transition.m_nextState[j];
-		}
+void ndBrainReplayBuffer::MakeUniformBatch(ndInt32 count)
+{
+	// partial shuffle, only the first m_learnBatchSize entries are drawn
+	for (ndInt32 i = 0; i < m_learnBatchSize; ++i)
+	{
+		const ndInt32 j = i + ndInt32(ndRandInt() % ndUnsigned32(count - i));
+		ndSwap(m_randomShaffle[i], m_randomShaffle[j]);
+		m_indexBatch[i] = ndInt32(m_randomShaffle[i]);
+		m_weightBatch[i] = ndReal(1.0f);
+	}
+}
 
-		for (ndInt32 j = 0; j < m_outputBatch.GetColumns(); ++j)
-		{
-			m_outputBatch[i][j] = transition.m_action[j];
-		}
+void ndBrainReplayBuffer::UpdatePendingPriorities()
+{
+	// new transitions enter with the largest priority seen so far,
+	// so that each one is likely to be replayed at least once
+	const ndUnsigned64 index = m_replayBufferIndex.load();
+	const ndUnsigned64 capacity = ndUnsigned64(GetCapacity());
+	const ndUnsigned64 start = ndMax(m_prioritizedIndex, (index > capacity) ? index - capacity : ndUnsigned64(0));
+	for (ndUnsigned64 i = start; i < index; ++i)
+	{
+		m_priorities.SetPriority(ndInt32(i % capacity), m_maxPriority);
 	}
-}
\ No newline at end of file
+	m_prioritizedIndex = index;
+}
+
+void ndBrainReplayBuffer::MakePrioritizedBatch(ndInt32 count)
+{
+	UpdatePendingPriorities();
+
+	// stratified sampling, one sample from each of m_learnBatchSize equal ranges
+	const ndFloat64 sum = m_priorities.GetSum();
+	const ndFloat64 segment = sum / ndFloat64(m_learnBatchSize);
+	ndFloat32 maxWeight = ndFloat32(0.0f);
+	for (ndInt32 i = 0; i < m_learnBatchSize; ++i)
+	{
+		const ndFloat64 value = segment * (ndFloat64(i) + ndFloat64(ndRand()));
+		const ndInt32 index = m_priorities.Find(ndMin(value, sum));
+		ndAssert(index < count);
+
+		// importance weight (count * probability)^-beta corrects the sampling bias
+		const ndFloat64 probability = m_priorities.GetPriority(index) / sum;
+		const ndFloat32 weight = ndPow(ndFloat64(count) * probability, -m_beta);
+		maxWeight = ndMax(maxWeight, weight);
+		m_indexBatch[i] = index;
+		m_weightBatch[i] = ndReal(weight);
+	}
+
+	const ndReal invMaxWeight = ndReal(1.0f / maxWeight);
+	for (ndInt32 i = 0; i < m_learnBatchSize; ++i)
+	{
+		m_weightBatch[i] *= invMaxWeight;
+	}
+}
+
+void ndBrainReplayBuffer::MakeRandomBatch()
+{
+	const ndInt32 count = GetCount();
+	ndAssert(count >= m_learnBatchSize);
+	if (m_prioritized)
+	{
+		MakePrioritizedBatch(count);
+	}
+	else
+	{
+		MakeUniformBatch(count);
+	}
+	SetBatchViews();
+}
+
+void ndBrainReplayBuffer::UpdatePriorities(const ndBrainVector& tdErrors)
+{
+	ndAssert(m_prioritized);
+	ndAssert(tdErrors.GetCount() == m_learnBatchSize);
+	for (ndInt32 i = 0; i < m_learnBatchSize; ++i)
+	{
+		const ndFloat64 priority = ndPow(ndAbs(tdErrors[i]) + D_BRAIN_REPLAY_PRIORITY_EPSILON, m_alpha);
+		m_priorities.SetPriority(m_indexBatch[i], priority);
+		m_maxPriority = ndMax(m_maxPriority, priority);
+	}
+}
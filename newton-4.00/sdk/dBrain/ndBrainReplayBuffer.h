@@ -27,6 +27,9 @@
 #include "ndBrainMatrix.h"
 #include "ndBrainInstance.h"
 
+// keeps transitions with zero td error reachable by the prioritized sampler
+#define D_BRAIN_REPLAY_PRIORITY_EPSILON	ndReal(1.0e-4f)
+
 class ndBrainReiforcementTransition
 {
 	public:
@@ -40,7 +43,35 @@ class ndBrainReiforcementTransition
 	bool m_terminalState;
 };
 
-class ndBrainReplayBuffer : public ndArray<ndBrainReiforcementTransition>
+// binary sum tree over the transition priorities.
+// each node stores the sum of its children, so sampling a transition
+// proportional to its priority and updating a priority are both log(n)
+class ndBrainReplaySumTree: public ndClassAlloc
+{
+	public:
+	ndBrainReplaySumTree();
+
+	void Init(ndInt32 capacity);
+
+	ndFloat64 GetSum() const;
+	ndFloat64 GetPriority(ndInt32 index) const;
+	void SetPriority(ndInt32 index, ndFloat64 priority);
+
+	// returns the index of the leaf where the prefix sum reaches value
+	ndInt32 Find(ndFloat64 value) const;
+
+	private:
+	ndArray<ndFloat64> m_nodes;
+	ndInt32 m_leafCount;
+};
+
+// ring buffer of transitions stored as structure of arrays.
+// states, actions and next states are rows of three contiguous matrices,
+// and the batch matrices are views whose rows alias the sampled entries,
+// so making a batch does not copy any state data.
+// AddTransition is lock free and can be called from many simulation threads
+// at once, but not while MakeRandomBatch or UpdatePriorities are running.
+class ndBrainReplayBuffer: public ndClassAlloc
 {
 	public:
 	ndBrainReplayBuffer();
@@ -48,20 +79,80 @@ class ndBrainReplayBuffer : public ndArray<ndBrainReiforcementTransition>
 
 	void SetCount(ndInt32 replayBufferSize, ndInt32 replayBatchSize, ndInt32 stateSize, ndInt32 actionSize);
 
-	ndBrainReiforcementTransition& GetTransitionEntry();
+	// number of valid transitions
+	ndInt32 GetCount() const;
+	ndInt32 GetCapacity() const;
+
+	ndInt32 AddTransition(const ndBrainReiforcementTransition& transition);
+	ndInt32 AddTransition(const ndBrainVector& state, const ndBrainVector& action, const ndBrainVector& nextState, ndReal reward, bool terminalState);
+
+	// enables prioritized sampling. alpha controls how much the priorities
+	// shape the distribution, beta how much the importance weights correct it.
+	void SetPrioritizedSampling(ndReal alpha, ndReal beta);
+	void SetImportanceBeta(ndReal beta);
+	bool IsPrioritized() const;
+
+	// sets the priorities of the last sampled batch from their td errors
+	void UpdatePriorities(const ndBrainVector& tdErrors);
 
 	void MakeRandomBatch();
 
-	ndArray<ndUnsigned32> m_randomShaffle;
 	ndBrainMatrix m_inputBatch;
 	ndBrainMatrix m_outputBatch;
 	ndBrainMatrix m_nextInputBatch;
 	ndBrainMatrix m_groundTruthBatch;
 	ndBrainVector n_rewardBatch;
 	ndBrainVector n_terminalBatch;
+	ndBrainVector m_weightBatch;
+	ndArray<ndInt32> m_indexBatch;
 	ndInt32 m_learnBatchSize;
-	ndInt32 m_replayBufferIndex;
+
+	protected:
+	void SetBatchViews();
+	void MakeUniformBatch(ndInt32 count);
+	void MakePrioritizedBatch(ndInt32 count);
+	void UpdatePendingPriorities();
+
+	ndBrainMatrix m_state;
+	ndBrainMatrix m_action;
+	ndBrainMatrix m_nextState;
+	ndBrainVector m_reward;
+	ndBrainVector m_terminal;
+	ndArray<ndUnsigned32> m_randomShaffle;
+	ndBrainReplaySumTree m_priorities;
+	ndAtomic<ndUnsigned64> m_replayBufferIndex;
+	ndUnsigned64 m_prioritizedIndex;
+	ndFloat64 m_maxPriority;
+	ndReal m_alpha;
+	ndReal m_beta;
+	bool m_prioritized;
 };
 
+inline ndFloat64 ndBrainReplaySumTree::GetSum() const
+{
+	return m_nodes.GetCount() ? m_nodes[1] : ndFloat64(0.0f);
+}
+
+inline ndFloat64 ndBrainReplaySumTree::GetPriority(ndInt32 index) const
+{
+	return m_nodes[m_leafCount + index];
+}
+
+inline ndInt32 ndBrainReplayBuffer::GetCapacity() const
+{
+	return m_state.GetRows();
+}
+
+inline ndInt32 ndBrainReplayBuffer::GetCount() const
+{
+	const ndUnsigned64 count = m_replayBufferIndex.load();
+	return ndInt32(ndMin(count, ndUnsigned64(GetCapacity())));
+}
+
+inline bool ndBrainReplayBuffer::IsPrioritized() const
+{
+	return m_prioritized;
+}
+
 #endif 
 
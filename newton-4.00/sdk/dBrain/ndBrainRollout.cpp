@@ -0,0 +1,148 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "ndBrainStdafx.h"
+#include "ndBrain.h"
+#include "ndBrainRollout.h"
+#include "ndBrainReplayBuffer.h"
+
+ndBrainRollout::ndEnvironment::ndEnvironment()
+	:ndClassAlloc()
+{
+}
+
+ndBrainRollout::ndEnvironment::~ndEnvironment()
+{
+}
+
+ndBrainRollout::ndBrainRollout(ndBrain* const policy, ndBrainReplayBuffer* const replayBuffer)
+	:ndClassAlloc()
+	,m_policy(policy)
+	,m_replayBuffer(replayBuffer)
+	,m_environments()
+	,m_observations()
+	,m_actions()
+	,m_stepCount(0)
+	,m_stepTime(0)
+	,m_current(0)
+{
+}
+
+ndBrainRollout::~ndBrainRollout()
+{
+}
+
+void ndBrainRollout::AddEnvironment(ndEnvironment* const environment)
+{
+	m_environments.PushBack(environment);
+}
+
+ndFloat64 ndBrainRollout::GetStepsPerSecond() const
+{
+	return m_stepTime ? ndFloat64(m_stepCount) * ndFloat64(1.0e6f) / ndFloat64(m_stepTime) : ndFloat64(0.0f);
+}
+
+void ndBrainRollout::InitObservations()
+{
+	// only when environments were added since the last step
+	const ndInt32 count = m_environments.GetCount();
+	if (m_actions.GetRows() != count)
+	{
+		const ndBrain* const brain = m_policy.GetBrain();
+		m_current = 0;
+		m_actions.Init(count, brain->GetOutputSize());
+		m_observations[0].Init(count, brain->GetInputSize());
+		m_observations[1].Init(count, brain->GetInputSize());
+		for (ndInt32 i = 0; i < count; ++i)
+		{
+			m_environments[i]->GetObservation(m_observations[0][i]);
+		}
+	}
+}
+
+void ndBrainRollout::StepEnvironment(ndInt32 index, ndFloat32 timestep)
+{
+	ndEnvironment* const environment = m_environments[index];
+	ndBrainVector& action = m_actions[index];
+	const ndBrainVector& state = m_observations[m_current][index];
+	ndBrainVector& nextState = m_observations[1 - m_current][index];
+
+	environment->ApplyAction(action);
+	environment->Step(timestep);
+	environment->GetObservation(nextState);
+
+	const bool terminal = environment->IsTerminal();
+	if (m_replayBuffer)
+	{
+		m_replayBuffer->AddTransition(state, action, nextState, environment->GetReward(), terminal);
+	}
+
+	if (terminal)
+	{
+		// the next step starts the new episode
+		environment->Reset();
+		environment->GetObservation(nextState);
+	}
+}
+
+void ndBrainRollout::Step(ndFloat32 timestep)
+{
+	D_TRACKTIME();
+	const ndUnsigned64 time = ndGetTimeInMicroseconds();
+	InitObservations();
+
+	m_policy.MakePrediction(m_observations[m_current], m_actions);
+	for (ndInt32 i = 0; i < m_environments.GetCount(); ++i)
+	{
+		StepEnvironment(i, timestep);
+	}
+
+	m_current = 1 - m_current;
+	m_stepCount += ndUnsigned64(m_environments.GetCount());
+	m_stepTime += ndGetTimeInMicroseconds() - time;
+}
+
+void ndBrainRollout::Step(ndThreadPool& threadPool, ndFloat32 timestep)
+{
+	D_TRACKTIME();
+	const ndUnsigned64 time = ndGetTimeInMicroseconds();
+	InitObservations();
+
+	m_policy.MakePrediction(threadPool, m_observations[m_current], m_actions);
+
+	// environments can take very different times to step,
+	// so they are handed out one at the time
+	ndAtomic<ndInt32> iterator(0);
+	const ndInt32 count = m_environments.GetCount();
+	auto StepEnvironments = ndMakeObject::ndFunction([this, &iterator, count, timestep](ndInt32, ndInt32)
+	{
+		D_TRACKTIME_NAMED(StepEnvironments);
+		for (ndInt32 i = iterator.fetch_add(1); i < count; i = iterator.fetch_add(1))
+		{
+			StepEnvironment(i, timestep);
+		}
+	});
+	threadPool.ParallelExecute(StepEnvironments);
+
+	m_current = 1 - m_current;
+	m_stepCount += ndUnsigned64(count);
+	m_stepTime += ndGetTimeInMicroseconds() - time;
+}
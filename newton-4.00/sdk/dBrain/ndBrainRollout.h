@@ -0,0 +1,100 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef _ND_BRAIN_ROLLOUT_H__
+#define _ND_BRAIN_ROLLOUT_H__
+
+#include "ndBrainStdafx.h"
+#include "ndBrainVector.h"
+#include "ndBrainMatrix.h"
+#include "ndBrainInstance.h"
+
+class ndBrain;
+class ndBrainReplayBuffer;
+
+// steps many independent environments with one policy.
+// each step evaluates the observations of all environments in one batched
+// prediction, then steps the environments in parallel and pushes their
+// transitions to a shared replay buffer.
+// environments are not owned and must outlive the rollout.
+class ndBrainRollout: public ndClassAlloc
+{
+	public: 
+	class ndEnvironment: public ndClassAlloc
+	{
+		public:
+		ndEnvironment();
+		virtual ~ndEnvironment();
+
+		// observation and action are sized to the policy input and output
+		virtual void GetObservation(ndBrainVector& observation) const = 0;
+
+		// the environment can modify the action, for example to add
+		// exploration noise, the replay buffer gets the modified action
+		virtual void ApplyAction(ndBrainVector& action) = 0;
+
+		// called from a worker thread, environments must not share state
+		virtual void Step(ndFloat32 timestep) = 0;
+
+		virtual ndReal GetReward() const = 0;
+		virtual bool IsTerminal() const = 0;
+		virtual void Reset() = 0;
+	};
+
+	ndBrainRollout(ndBrain* const policy, ndBrainReplayBuffer* const replayBuffer);
+	~ndBrainRollout();
+
+	void AddEnvironment(ndEnvironment* const environment);
+	ndInt32 GetEnvironmentCount() const;
+
+	void Step(ndThreadPool& threadPool, ndFloat32 timestep);
+	void Step(ndFloat32 timestep);
+
+	// environment steps and throughput since the rollout was created
+	ndUnsigned64 GetStepCount() const;
+	ndFloat64 GetStepsPerSecond() const;
+
+	private:
+	void InitObservations();
+	void StepEnvironment(ndInt32 index, ndFloat32 timestep);
+
+	ndBrainInstance m_policy;
+	ndBrainReplayBuffer* m_replayBuffer;
+	ndArray<ndEnvironment*> m_environments;
+	ndBrainMatrix m_observations[2];
+	ndBrainMatrix m_actions;
+	ndUnsigned64 m_stepCount;
+	ndUnsigned64 m_stepTime;
+	ndInt32 m_current;
+};
+
+inline ndInt32 ndBrainRollout::GetEnvironmentCount() const
+{
+	return m_environments.GetCount();
+}
+
+inline ndUnsigned64 ndBrainRollout::GetStepCount() const
+{
+	return m_stepCount;
+}
+
+#endif 
+
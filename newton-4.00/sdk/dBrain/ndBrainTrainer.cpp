@@ -37,6 +37,8 @@ ndBrainTrainer::ndBrainTrainer(ndBrain* const brain)
 	,m_weightGradient_v()
 	,m_weightGradientsPrefixScan()
 	,m_weightsLayersTranspose()
+	,m_zDerivativeBatch()
+	,m_biasGradientsBatch()
 	,m_regularizer(1.0e-6f)
 	,m_bestCost(1.0e10f)
 	,m_alpha(0.9f)
@@ -70,6 +72,8 @@ ndBrainTrainer::ndBrainTrainer(const ndBrainTrainer& src)
 	,m_weightGradient_v(src.m_weightGradient_v)
 	,m_weightGradientsPrefixScan(src.m_weightGradientsPrefixScan)
 	,m_weightsLayersTranspose()
+	,m_zDerivativeBatch()
+	,m_biasGradientsBatch()
 	,m_regularizer(src.m_regularizer)
 	,m_alpha(src.m_alpha)
 	,m_beta(src.m_beta)
@@ -90,6 +94,12 @@ ndBrainTrainer::~ndBrainTrainer()
 	{
 		delete (m_weightsLayersTranspose[i]);
 	}
+
+	for (ndInt32 i = 0; i < m_zDerivativeBatch.GetCount(); i++)
+	{
+		delete (m_zDerivativeBatch[i]);
+		delete (m_biasGradientsBatch[i]);
+	}
 }
 
 void ndBrainTrainer::PrefixScan()
@@ -329,6 +339,143 @@ void ndBrainTrainer::BackPropagate(const ndBrainVector& groundTruth)
 	}
 }
 
+void ndBrainTrainer::SetBatchSize(ndInt32 count)
+{
+	m_instance.SetBatchSize(count);
+	if (m_zDerivativeBatch.GetCount() && (m_zDerivativeBatch[0]->GetCount() >= count))
+	{
+		return;
+	}
+
+	for (ndInt32 i = 0; i < m_zDerivativeBatch.GetCount(); i++)
+	{
+		delete (m_zDerivativeBatch[i]);
+		delete (m_biasGradientsBatch[i]);
+	}
+	m_zDerivativeBatch.SetCount(0);
+	m_biasGradientsBatch.SetCount(0);
+
+	const ndArray<ndBrainLayer*>& layers = (*m_instance.GetBrain());
+	for (ndInt32 i = 0; i < layers.GetCount(); ++i)
+	{
+		m_zDerivativeBatch.PushBack(new ndBrainMatrix(count, layers[i]->GetOuputSize()));
+		m_biasGradientsBatch.PushBack(new ndBrainMatrix(count, layers[i]->GetOuputSize()));
+	}
+}
+
+void ndBrainTrainer::MakePrediction(const ndBrainMatrix& inputBatch)
+{
+	MakeBatchPrediction(inputBatch, inputBatch.GetCount());
+}
+
+void ndBrainTrainer::BackPropagate(const ndBrainMatrix& inputBatch, const ndBrainMatrix& groundTruth)
+{
+	BackPropagateBatch(inputBatch, groundTruth, inputBatch.GetCount());
+}
+
+// batched passes over the leading count rows of the matrices
+void ndBrainTrainer::MakeBatchPrediction(const ndBrainMatrix& inputBatch, ndInt32 count)
+{
+	ndAssert(count <= inputBatch.GetCount());
+	SetBatchSize(count);
+	m_instance.MakeBatchPrediction(inputBatch, m_zDerivativeBatch, 0, count);
+}
+
+// accumulate the outer products of the bias gradients and the layer inputs.
+// each gradient row is read and written once for every four samples, and each
+// element still adds the samples in order, same as one ScaleAdd per sample.
+void ndBrainTrainer::BackPropagateWeightGradients(ndInt32 layerIndex, const ndBrainMatrix& input, const ndBrainMatrix& biasGradients, ndInt32 count)
+{
+	const ndArray<ndBrainLayer*>& layers = (*m_instance.GetBrain());
+	ndBrainLayer* const layer = layers[layerIndex];
+	const ndInt32 inputCount = layer->GetInputSize();
+	const ndInt32 outputCount = layer->GetOuputSize();
+	const ndInt32 stride = (inputCount + D_DEEP_BRAIN_DATA_ALIGMENT - 1) & -D_DEEP_BRAIN_DATA_ALIGMENT;
+	ndReal* const weightGradientPtr = &m_weightGradients[m_weightGradientsPrefixScan[layerIndex]];
+
+	ndInt32 j = 0;
+	for (; j <= (count - D_BRAIN_GEMM_TILE); j += D_BRAIN_GEMM_TILE)
+	{
+		const ndReal* const z0 = &input[j + 0][0];
+		const ndReal* const z1 = &input[j + 1][0];
+		const ndReal* const z2 = &input[j + 2][0];
+		const ndReal* const z3 = &input[j + 3][0];
+		const ndBrainVector& g0 = biasGradients[j + 0];
+		const ndBrainVector& g1 = biasGradients[j + 1];
+		const ndBrainVector& g2 = biasGradients[j + 2];
+		const ndBrainVector& g3 = biasGradients[j + 3];
+		for (ndInt32 i = 0; i < outputCount; ++i)
+		{
+			const ndReal d0 = g0[i];
+			const ndReal d1 = g1[i];
+			const ndReal d2 = g2[i];
+			const ndReal d3 = g3[i];
+			ndReal* const weightGradient = &weightGradientPtr[i * stride];
+			for (ndInt32 k = 0; k < inputCount; ++k)
+			{
+				weightGradient[k] = weightGradient[k] + z0[k] * d0 + z1[k] * d1 + z2[k] * d2 + z3[k] * d3;
+			}
+		}
+	}
+
+	for (; j < count; ++j)
+	{
+		const ndBrainVector& z = input[j];
+		const ndBrainVector& g = biasGradients[j];
+		for (ndInt32 i = 0; i < outputCount; ++i)
+		{
+			ndDeepBrainMemVector weightGradient(&weightGradientPtr[i * stride], inputCount);
+			weightGradient.ScaleAdd(z, g[i]);
+		}
+	}
+}
+
+void ndBrainTrainer::BackPropagateBatch(const ndBrainMatrix& inputBatch, const ndBrainMatrix& groundTruth, ndInt32 count)
+{
+	ndAssert(count <= inputBatch.GetCount());
+	ndAssert(count <= groundTruth.GetCount());
+	ndAssert(m_zDerivativeBatch.GetCount() && (m_zDerivativeBatch[0]->GetCount() >= count));
+
+	const ndArray<ndBrainLayer*>& layers = (*m_instance.GetBrain());
+	const ndBrainPrefixScan& preFixScan = m_instance.GetPrefixScan();
+
+	// output layer
+	const ndInt32 outputIndex = layers.GetCount() - 1;
+	const ndInt32 outputCount = layers[outputIndex]->GetOuputSize();
+	const ndBrainMatrix& z = *m_instance.m_zBatch[outputIndex];
+	const ndBrainMatrix& zDerivative = *m_zDerivativeBatch[outputIndex];
+	ndBrainMatrix& outputGradients = *m_biasGradientsBatch[outputIndex];
+	ndDeepBrainMemVector outputGradientsAcc(&m_biasGradientsAcc[preFixScan[outputIndex + 1]], outputCount);
+	for (ndInt32 i = 0; i < count; ++i)
+	{
+		ndBrainVector& biasGradients = outputGradients[i];
+		biasGradients.Sub(z[i], groundTruth[i]);
+		biasGradients.Mul(biasGradients, zDerivative[i]);
+		outputGradientsAcc.Add(outputGradientsAcc, biasGradients);
+	}
+	const ndBrainMatrix& outputInput = outputIndex ? *m_instance.m_zBatch[outputIndex - 1] : inputBatch;
+	BackPropagateWeightGradients(outputIndex, outputInput, outputGradients, count);
+
+	// hidden layers
+	for (ndInt32 i = outputIndex - 1; i >= 0; --i)
+	{
+		const ndInt32 layerCount = layers[i]->GetOuputSize();
+		const ndBrainMatrix& hiddenDerivative = *m_zDerivativeBatch[i];
+		ndBrainMatrix& hiddenGradients = *m_biasGradientsBatch[i];
+		ndDeepBrainMemVector hiddenGradientsAcc(&m_biasGradientsAcc[preFixScan[i + 1]], layerCount);
+
+		m_weightsLayersTranspose[i + 1]->Mul(*m_biasGradientsBatch[i + 1], hiddenGradients, 0, count);
+		for (ndInt32 j = 0; j < count; ++j)
+		{
+			ndBrainVector& biasGradients = hiddenGradients[j];
+			biasGradients.Mul(biasGradients, hiddenDerivative[j]);
+			hiddenGradientsAcc.Add(hiddenGradientsAcc, biasGradients);
+		}
+		const ndBrainMatrix& hiddenInput = i ? *m_instance.m_zBatch[i - 1] : inputBatch;
+		BackPropagateWeightGradients(i, hiddenInput, hiddenGradients, count);
+	}
+}
+
 void ndBrainTrainer::ClearGradientsAcc()
 {
 	m_biasGradients.Set(0.0f);
@@ -353,6 +500,10 @@ void ndBrainTrainer::Optimize(ndValidation& validator, const ndBrainMatrix& inpu
 	const ndInt32 miniBatchSize = ndMin(m_miniBatchSize, inputBatch.GetCount());
 	const ndInt32 batchCount = (inputBatch.GetCount() + miniBatchSize - 1) / miniBatchSize;
 
+	// the shuffled samples are gathered into contiguous minibatches
+	ndBrainMatrix miniBatchInput(miniBatchSize, inputBatch.GetColumns());
+	ndBrainMatrix miniBatchTruth(miniBatchSize, groundTruth.GetColumns());
+
 	m_bestCost = validator.Validate(inputBatch, groundTruth);
 	for (ndInt32 i = 0; (i < steps) && (m_bestCost > 0.0f); ++i)
 	{
@@ -363,12 +514,12 @@ void ndBrainTrainer::Optimize(ndValidation& validator, const ndBrainMatrix& inpu
 			const ndInt32 count = ((start + miniBatchSize) < inputBatch.GetCount()) ? miniBatchSize : inputBatch.GetCount() - start;
 			for (ndInt32 k = 0; k < count; ++k)
 			{
-					ndInt32 index = randomizeVector[start + k];
-					const ndBrainVector& input = inputBatch[index];
-					const ndBrainVector& truth = groundTruth[index];
-					MakePrediction(input);
-					BackPropagate(truth);
+				ndInt32 index = randomizeVector[start + k];
+				miniBatchInput[k].Set(inputBatch[index]);
+				miniBatchTruth[k].Set(groundTruth[index]);
 			}
+			MakeBatchPrediction(miniBatchInput, count);
+			BackPropagateBatch(miniBatchInput, miniBatchTruth, count);
 			UpdateWeights(learnRate, count);
 		}
 		ApplyWeightTranspose();
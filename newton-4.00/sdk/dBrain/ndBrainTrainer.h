@@ -37,6 +37,11 @@ class ndBrainTrainer: public ndBrainTrainerBase
 	virtual void UpdateWeights(ndReal learnRate, ndInt32 batchSize);
 	virtual void MakePrediction(const ndBrainVector& input);
 	virtual void BackPropagate(const ndBrainVector& groundTruth);
+
+	// minibatch forward and backward passes, one sample per matrix row.
+	// gradients are accumulated the same way as the single sample calls.
+	virtual void MakePrediction(const ndBrainMatrix& inputBatch);
+	virtual void BackPropagate(const ndBrainMatrix& inputBatch, const ndBrainMatrix& groundTruth);
 	virtual void Optimize(ndValidation& validator, const ndBrainMatrix& inputBatch, const ndBrainMatrix& groundTruth, ndReal learnRate, ndInt32 steps);
 
 	protected:
@@ -48,6 +53,10 @@ class ndBrainTrainer: public ndBrainTrainerBase
 	virtual void BackPropagateOutputLayer(const ndBrainVector& groundTruth);
 
 	void ApplyAdamCorrection();
+	void SetBatchSize(ndInt32 count);
+	void MakeBatchPrediction(const ndBrainMatrix& inputBatch, ndInt32 count);
+	void BackPropagateBatch(const ndBrainMatrix& inputBatch, const ndBrainMatrix& groundTruth, ndInt32 count);
+	void BackPropagateWeightGradients(ndInt32 layerIndex, const ndBrainMatrix& input, const ndBrainMatrix& biasGradients, ndInt32 count);
 
 	ndBrainVector m_output;
 	ndBrainVector m_zDerivative;
@@ -60,6 +69,8 @@ class ndBrainTrainer: public ndBrainTrainerBase
 	ndBrainVector m_weightGradient_v;
 	ndBrainPrefixScan m_weightGradientsPrefixScan;
 	ndArray <ndBrainMatrix*> m_weightsLayersTranspose;
+	ndArray <ndBrainMatrix*> m_zDerivativeBatch;
+	ndArray <ndBrainMatrix*> m_biasGradientsBatch;
 	ndReal m_regularizer;
 	ndReal m_bestCost;
 	ndReal m_alpha;
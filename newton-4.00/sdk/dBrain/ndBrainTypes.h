@@ -27,13 +27,25 @@
 
 #define D_DEEP_BRAIN_DATA_ALIGMENT 8
 
+// blocking of the batched matrix products
+#define D_BRAIN_GEMM_TILE			4
+#define D_BRAIN_GEMM_LANES			8
+#define D_BRAIN_GEMM_SAMPLE_BLOCK	64
+#define D_BRAIN_GEMM_COLUMN_BLOCK	256
+
+#define D_BRAIN_LEAKY_RELU_SLOPE	ndReal(0.01f)
+
+// new types are added at the end, the binary model format stores these values
 enum ndBrainActivationType
 {
 	m_relu,
 	m_lineal,
 	m_tanh,
 	m_sigmoid,
-	m_softmax
+	m_softmax,
+	m_leakyRelu,
+	m_elu,
+	m_softplus,
 };
 
 class ndBrainPrefixScan : public ndFixSizeArray<ndInt32, 256>
@@ -31,6 +31,7 @@ class ndBodyNotify;
 class ndBodyDynamic;
 class ndBodySentinel;
 class ndBodySphFluid;
+class ndBodySoftBody;
 class ndBodyKinematic;
 class ndRayCastNotify;
 class ndBodyParticleSet;
@@ -51,6 +52,7 @@ class ndBody : public ndContainersFreeListAlloc<ndBody>
 	virtual ndBodyDynamic* GetAsBodyDynamic() { return nullptr; }
 	virtual ndBodySentinel* GetAsBodySentinel() { return nullptr; }
 	virtual ndBodySphFluid* GetAsBodySphFluid() { return nullptr; }
+	virtual ndBodySoftBody* GetAsBodySoftBody() { return nullptr; }
 	virtual ndBodyKinematic* GetAsBodyKinematic() { return nullptr; }
 	virtual ndBodyParticleSet* GetAsBodyParticleSet() { return nullptr; }
 	virtual ndBodyPlayerCapsule* GetAsBodyPlayerCapsule() { return nullptr; }
@@ -134,6 +136,7 @@ class ndBody : public ndContainersFreeListAlloc<ndBody>
 	friend class ndScene;
 	friend class ndConstraint;
 	friend class ndBodyPlayerCapsuleImpulseSolver;
+	friend class ndPlayerCapsuleCrowd;
 } D_GCC_NEWTON_ALIGN_32;
 
 inline ndUnsigned32 ndBody::GetId() const
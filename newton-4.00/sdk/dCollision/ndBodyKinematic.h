@@ -173,7 +173,7 @@ class ndBodyKinematic : public ndBody
 	D_COLLISION_API virtual void IntegrateExternalForce(ndFloat32 timestep);
 
 	void SetAccel(const ndJacobian& accel);
-	virtual void SpecialUpdate(ndFloat32 timestep);
+	virtual void SpecialUpdate(ndInt32 threadIndex, ndFloat32 timestep);
 	virtual void IntegrateGyroSubstep(const ndVector& timestep);
 	virtual void ApplyExternalForces(ndInt32 threadIndex, ndFloat32 timestep);
 	virtual ndJacobian IntegrateForceAndToque(const ndVector& force, const ndVector& torque, const ndVector& timestep) const;
@@ -521,7 +521,7 @@ inline void ndBodyKinematic::ApplyImpulsesAtPoint(ndInt32, const ndVector* const
 {
 }
 
-inline void ndBodyKinematic::SpecialUpdate(ndFloat32)
+inline void ndBodyKinematic::SpecialUpdate(ndInt32, ndFloat32)
 {
 	ndAssert(0);
 }
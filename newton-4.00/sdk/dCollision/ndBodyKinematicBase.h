@@ -33,7 +33,7 @@ class ndBodyKinematicBase : public ndBodyKinematic
 	D_COLLISION_API ndBodyKinematicBase();
 	D_COLLISION_API virtual ~ndBodyKinematicBase();
 
-	void SpecialUpdate(ndFloat32 timestep);
+	void SpecialUpdate(ndInt32 threadIndex, ndFloat32 timestep);
 	ndBodyKinematicBase* GetAsBodyKinematicSpecial();
 	friend class ndFileFormatBodyKinematicBase;
 } D_GCC_NEWTON_ALIGN_32;
@@ -43,7 +43,7 @@ inline ndBodyKinematicBase* ndBodyKinematicBase::GetAsBodyKinematicSpecial()
 	return this; 
 }
 
-inline void ndBodyKinematicBase::SpecialUpdate(ndFloat32)
+inline void ndBodyKinematicBase::SpecialUpdate(ndInt32, ndFloat32)
 {
 	ndAssert(0);
 }
@@ -32,9 +32,18 @@ ndBodyParticleSet::ndBodyParticleSet()
 	,m_gravity(ndVector::m_zero)
 	,m_posit(1024)
 	,m_veloc(1024)
+	,m_reorderBuffer(1024)
+	,m_reorderKeys(1024)
+	,m_reorderScratch(1024)
+	,m_renderPosit(1024)
+	,m_renderBuffer(1024)
+	,m_renderLock()
 	,m_listNode(nullptr)
 	,m_radius(ndFloat32 (0.125f))
 	,m_timestep(ndFloat32(0.0f))
+	,m_reorderPeriod(0)
+	,m_reorderFrame(0)
+	,m_renderFrame(0)
 	,m_updateInBackground(true)
 {
 }
@@ -42,3 +51,260 @@ ndBodyParticleSet::ndBodyParticleSet()
 ndBodyParticleSet::~ndBodyParticleSet()
 {
 }
+
+void ndBodyParticleSet::SyncUpdate(const ndScene* const)
+{
+	D_TRACKTIME();
+	Sync();
+	PublishRenderPositions();
+}
+
+void ndBodyParticleSet::PublishRenderPositions()
+{
+	D_TRACKTIME();
+	// fill the back buffer outside the lock, so readers only wait for the swap
+	m_renderBuffer.SetCount(m_posit.GetCount());
+	if (m_posit.GetCount())
+	{
+		ndMemCpy(&m_renderBuffer[0], &m_posit[0], ndInt32(m_posit.GetCount()));
+	}
+
+	ndScopeSpinLock lock(m_renderLock);
+	m_renderPosit.Swap(m_renderBuffer);
+	m_renderFrame++;
+}
+
+ndUnsigned32 ndBodyParticleSet::GetRenderPositions(ndArray<ndVector>& positions) const
+{
+	ndScopeSpinLock lock(m_renderLock);
+	positions.SetCount(m_renderPosit.GetCount());
+	if (m_renderPosit.GetCount())
+	{
+		ndMemCpy(&positions[0], &m_renderPosit[0], ndInt32(m_renderPosit.GetCount()));
+	}
+	return m_renderFrame;
+}
+
+// sort keys pack the z order code of the particle cell in the high word
+// and the particle index in the low word
+class ndParticleMortonKey
+{
+	public:
+	template <ndInt32 shift>
+	class ndDigit
+	{
+		public:
+		ndDigit(void* const)
+		{
+		}
+
+		ndInt32 GetKey(const ndUnsigned64 key) const
+		{
+			return ndInt32((key >> (32 + shift)) & 0xff);
+		}
+	};
+
+	static ndUnsigned32 SpreadBits(ndUnsigned32 x)
+	{
+		x = (x | (x << 16)) & 0x030000ff;
+		x = (x | (x << 8)) & 0x0300f00f;
+		x = (x | (x << 4)) & 0x030c30c3;
+		x = (x | (x << 2)) & 0x09249249;
+		return x;
+	}
+
+	static ndUnsigned32 Key(const ndVector& cell)
+	{
+		const ndVector index(cell.GetInt());
+		return SpreadBits(ndUnsigned32(index.m_ix)) | (SpreadBits(ndUnsigned32(index.m_iy)) << 1) | (SpreadBits(ndUnsigned32(index.m_iz)) << 2);
+	}
+};
+
+void ndBodyParticleSet::ReorderParticles(ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+	const ndInt32 mortonBits = 10;
+	const ndInt32 count = ndInt32(m_posit.GetCount());
+	const ndVector size((m_box1 - m_box0) & ndVector::m_triplexMask);
+	const ndFloat32 extent = ndMax(ndMax(size.m_x, size.m_y), size.m_z);
+	if ((count < 2) || (extent <= ndFloat32(0.0f)) || (extent > ndFloat32(1.0e6f)))
+	{
+		return;
+	}
+
+	// cells are at least a particle wide, and at most 1024 of them per axis
+	const ndFloat32 cellSize = ndMax(ndFloat32(2.0f) * m_radius, extent / ndFloat32(1 << mortonBits));
+	const ndVector maxCell(ndFloat32((1 << mortonBits) - 1));
+	const ndVector origin(m_box0 & ndVector::m_triplexMask);
+	const ndVector invCellSize(ndFloat32(1.0f) / cellSize);
+	const ndUnsigned32 maxKey = ndParticleMortonKey::Key((size * invCellSize).GetMin(maxCell).Floor());
+
+	m_reorderKeys.SetCount(count);
+	m_reorderBuffer.SetCount(count);
+	auto CalculateKeys = ndMakeObject::ndFunction([this, &origin, &invCellSize, &maxCell](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateKeys);
+		const ndStartEnd startEnd(m_posit.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndVector cell(((m_posit[i] - origin) * invCellSize).GetMax(ndVector::m_zero).GetMin(maxCell).Floor());
+			m_reorderKeys[i] = (ndUnsigned64(ndParticleMortonKey::Key(cell)) << 32) | ndUnsigned64(i);
+		}
+	});
+	threadPool->ParallelExecute(CalculateKeys);
+
+	ndCountingSort<ndUnsigned64, ndParticleMortonKey::ndDigit<0>, 8>(*threadPool, m_reorderKeys, m_reorderScratch, nullptr, nullptr);
+	if (maxKey >= (1 << 8))
+	{
+		ndCountingSort<ndUnsigned64, ndParticleMortonKey::ndDigit<8>, 8>(*threadPool, m_reorderKeys, m_reorderScratch, nullptr, nullptr);
+	}
+	if (maxKey >= (1 << 16))
+	{
+		ndCountingSort<ndUnsigned64, ndParticleMortonKey::ndDigit<16>, 8>(*threadPool, m_reorderKeys, m_reorderScratch, nullptr, nullptr);
+	}
+	if (maxKey >= (1 << 24))
+	{
+		ndCountingSort<ndUnsigned64, ndParticleMortonKey::ndDigit<24>, 8>(*threadPool, m_reorderKeys, m_reorderScratch, nullptr, nullptr);
+	}
+
+	auto GatherPositions = ndMakeObject::ndFunction([this](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(GatherPositions);
+		const ndStartEnd startEnd(m_posit.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			m_reorderBuffer[i] = m_posit[ndInt32(m_reorderKeys[i] & 0xffffffff)];
+		}
+	});
+
+	auto GatherVelocities = ndMakeObject::ndFunction([this](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(GatherVelocities);
+		const ndStartEnd startEnd(m_veloc.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			m_reorderBuffer[i] = m_veloc[ndInt32(m_reorderKeys[i] & 0xffffffff)];
+		}
+	});
+
+	threadPool->ParallelExecute(GatherPositions);
+	m_posit.Swap(m_reorderBuffer);
+	threadPool->ParallelExecute(GatherVelocities);
+	m_veloc.Swap(m_reorderBuffer);
+}
+
+ndBodyParticleSet::ndBodyGrid::ndBodyGrid()
+	:m_origin(ndVector::m_zero)
+	,m_invCellSize(ndVector::m_zero)
+	,m_gridMax(ndVector::m_zero)
+	,m_bodyBoxes(256)
+	,m_threadBounds(D_MAX_THREADS_COUNT * 3)
+	,m_cellStart(1024)
+	,m_cellBodies(1024)
+	,m_sizeX(1)
+	,m_sizeY(1)
+{
+}
+
+void ndBodyParticleSet::ndBodyGrid::BuildCells(ndThreadPool* const threadPool, const ndArray<ndVector>& posit, const ndArray<ndVector>& positBase, const ndVector& bodyReach, ndFloat32 radius, ndFloat32 skin)
+{
+	D_TRACKTIME();
+	const ndInt32 threadCount = threadPool->GetThreadCount();
+	m_threadBounds.SetCount(threadCount * 3);
+	auto CalculateBounds = ndMakeObject::ndFunction([this, &posit, &positBase](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateBounds);
+		ndVector box0(ndFloat32(1.0e10f));
+		ndVector box1(ndFloat32(-1.0e10f));
+		ndVector reach(ndVector::m_zero);
+		const ndStartEnd startEnd(posit.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			box0 = box0.GetMin(posit[i]);
+			box1 = box1.GetMax(posit[i]);
+			reach = reach.GetMax((posit[i] - positBase[i]).Abs());
+		}
+		m_threadBounds[threadIndex * 3 + 0] = box0;
+		m_threadBounds[threadIndex * 3 + 1] = box1;
+		m_threadBounds[threadIndex * 3 + 2] = reach;
+	});
+	threadPool->ParallelExecute(CalculateBounds);
+
+	ndVector box0(ndFloat32(1.0e10f));
+	ndVector box1(ndFloat32(-1.0e10f));
+	ndVector reach(ndVector::m_zero);
+	for (ndInt32 i = 0; i < threadCount; ++i)
+	{
+		box0 = box0.GetMin(m_threadBounds[i * 3 + 0]);
+		box1 = box1.GetMax(m_threadBounds[i * 3 + 1]);
+		reach = reach.GetMax(m_threadBounds[i * 3 + 2]);
+	}
+
+	// a particle pushed out of one body must still find the next ones
+	const ndVector padding(((reach + bodyReach).Scale(ndFloat32(2.0f)) + ndVector(skin)) & ndVector::m_triplexMask);
+
+	// at most 32 cells per axis, the cells are never smaller than a few particles
+	m_origin = box0 & ndVector::m_triplexMask;
+	const ndVector extent((box1 - box0).GetMax(ndVector::m_zero) & ndVector::m_triplexMask);
+	const ndVector cellSize(extent.Scale(ndFloat32(1.0f / 32.0f)).GetMax(ndVector(ndFloat32(8.0f) * radius)));
+	m_invCellSize = cellSize.Reciproc() & ndVector::m_triplexMask;
+	m_gridMax = (extent * m_invCellSize).Floor();
+	const ndVector gridSize(m_gridMax.GetInt());
+	m_sizeX = ndInt32(gridSize.m_ix) + 1;
+	m_sizeY = ndInt32(gridSize.m_iy) + 1;
+	const ndInt32 cellCount = m_sizeX * m_sizeY * (ndInt32(gridSize.m_iz) + 1);
+
+	// the body boxes are clamped to the grid like the particles, so nothing is missed
+	auto CellCoordinate = [this](const ndVector& point)
+	{
+		return ((point - m_origin) * m_invCellSize).Floor().GetMax(ndVector::m_zero).GetMin(m_gridMax).GetInt();
+	};
+
+	const ndInt32 bodyCount = ndInt32(m_bodyBoxes.GetCount() / 2);
+	m_cellStart.SetCount(cellCount + 1);
+	for (ndInt32 i = 0; i <= cellCount; ++i)
+	{
+		m_cellStart[i] = 0;
+	}
+	for (ndInt32 i = 0; i < bodyCount; ++i)
+	{
+		const ndVector cell0(CellCoordinate(m_bodyBoxes[i * 2 + 0] - padding));
+		const ndVector cell1(CellCoordinate(m_bodyBoxes[i * 2 + 1] + padding));
+		for (ndInt32 z = ndInt32(cell0.m_iz); z <= ndInt32(cell1.m_iz); ++z)
+		{
+			for (ndInt32 y = ndInt32(cell0.m_iy); y <= ndInt32(cell1.m_iy); ++y)
+			{
+				for (ndInt32 x = ndInt32(cell0.m_ix); x <= ndInt32(cell1.m_ix); ++x)
+				{
+					m_cellStart[(z * m_sizeY + y) * m_sizeX + x]++;
+				}
+			}
+		}
+	}
+
+	ndInt32 sum = 0;
+	for (ndInt32 i = 0; i < cellCount; ++i)
+	{
+		sum += m_cellStart[i];
+		m_cellStart[i] = sum;
+	}
+	m_cellStart[cellCount] = sum;
+
+	// filled backward, so each cell keeps the bodies in the original order
+	m_cellBodies.SetCount(sum);
+	for (ndInt32 i = bodyCount - 1; i >= 0; --i)
+	{
+		const ndVector cell0(CellCoordinate(m_bodyBoxes[i * 2 + 0] - padding));
+		const ndVector cell1(CellCoordinate(m_bodyBoxes[i * 2 + 1] + padding));
+		for (ndInt32 z = ndInt32(cell0.m_iz); z <= ndInt32(cell1.m_iz); ++z)
+		{
+			for (ndInt32 y = ndInt32(cell0.m_iy); y <= ndInt32(cell1.m_iy); ++y)
+			{
+				for (ndInt32 x = ndInt32(cell0.m_ix); x <= ndInt32(cell1.m_ix); ++x)
+				{
+					m_cellBodies[--m_cellStart[(z * m_sizeY + y) * m_sizeX + x]] = i;
+				}
+			}
+		}
+	}
+}
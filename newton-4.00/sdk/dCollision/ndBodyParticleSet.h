@@ -49,17 +49,72 @@ class ndBodyParticleSet: public ndBody, public ndBackgroundTask
 	ndFloat32 GetParticleRadius() const;
 	virtual void SetParticleRadius(ndFloat32 radius);
 
+	// every that many updates the particles are sorted along a z order curve,
+	// zero disables it. sorting changes the particle indices.
+	ndInt32 GetReorderPeriod() const;
+	void SetReorderPeriod(ndInt32 updates);
+
+	// copies the positions of the last completed update and returns its frame number, 
+	// safe to call from the render thread while the next update is running.
+	D_COLLISION_API ndUnsigned32 GetRenderPositions(ndArray<ndVector>& positions) const;
+
+	// starts the update at the beginning of the frame, 
+	// it runs in the background while the rigid bodies step.
 	D_COLLISION_API virtual void Update(const ndScene* const scene, ndFloat32 timestep) = 0;
 
+	// waits for the update at the end of the frame, 
+	// and hands the results over to the rendering.
+	D_COLLISION_API virtual void SyncUpdate(const ndScene* const scene);
+
 	protected:
+	// bins the boxes of the bodies around the particles in a coarse grid, 
+	// so each particle only visits the bodies of its own cell.
+	class ndBodyGrid
+	{
+		public:
+		D_COLLISION_API ndBodyGrid();
+
+		// the bodies need m_box0, m_box1, m_stepVeloc and m_omega.
+		template <class ndBodyBox>
+		void Build(ndThreadPool* const threadPool, const ndArray<ndVector>& posit, const ndArray<ndVector>& positBase, const ndArray<ndBodyBox>& bodies, ndFloat32 timestep, ndFloat32 radius, ndFloat32 skin);
+
+		// the bodies that can touch a particle at this point, in the original order
+		const ndInt32* GetBodies(const ndVector& point, ndInt32& count) const;
+
+		private:
+		D_COLLISION_API void BuildCells(ndThreadPool* const threadPool, const ndArray<ndVector>& posit, const ndArray<ndVector>& positBase, const ndVector& bodyReach, ndFloat32 radius, ndFloat32 skin);
+
+		ndVector m_origin;
+		ndVector m_invCellSize;
+		ndVector m_gridMax;
+		ndArray<ndVector> m_bodyBoxes;
+		ndArray<ndVector> m_threadBounds;
+		ndArray<ndInt32> m_cellStart;
+		ndArray<ndInt32> m_cellBodies;
+		ndInt32 m_sizeX;
+		ndInt32 m_sizeY;
+	};
+
+	D_COLLISION_API void ReorderParticles(ndThreadPool* const threadPool);
+	D_COLLISION_API void PublishRenderPositions();
+
 	ndVector m_box0;
 	ndVector m_box1;
 	ndVector m_gravity;
 	ndArray<ndVector> m_posit;
 	ndArray<ndVector> m_veloc;
+	ndArray<ndVector> m_reorderBuffer;
+	ndArray<ndUnsigned64> m_reorderKeys;
+	ndArray<ndUnsigned64> m_reorderScratch;
+	ndArray<ndVector> m_renderPosit;
+	ndArray<ndVector> m_renderBuffer;
+	mutable ndSpinLock m_renderLock;
 	ndBodyList::ndNode* m_listNode;
 	ndFloat32 m_radius;
 	ndFloat32 m_timestep;
+	ndInt32 m_reorderPeriod;
+	ndInt32 m_reorderFrame;
+	ndUnsigned32 m_renderFrame;
 	bool m_updateInBackground;
 	friend class ndWorld;
 	friend class ndScene;
@@ -110,6 +165,16 @@ inline void ndBodyParticleSet::SetGravity(const ndVector& gravity)
 	m_gravity = gravity & ndVector::m_triplexMask;
 }
 
+inline ndInt32 ndBodyParticleSet::GetReorderPeriod() const
+{
+	return m_reorderPeriod;
+}
+
+inline void ndBodyParticleSet::SetReorderPeriod(ndInt32 updates)
+{
+	m_reorderPeriod = ndMax(updates, 0);
+}
+
 inline bool ndBodyParticleSet::GetAsynUpdate() const
 {
 	return m_updateInBackground;
@@ -120,6 +185,36 @@ inline void ndBodyParticleSet::SetAsynUpdate(bool updatType)
 	m_updateInBackground = updatType;
 }
 
+template <class ndBodyBox>
+void ndBodyParticleSet::ndBodyGrid::Build(ndThreadPool* const threadPool, const ndArray<ndVector>& posit, const ndArray<ndVector>& positBase, const ndArray<ndBodyBox>& bodies, ndFloat32 timestep, ndFloat32 radius, ndFloat32 skin)
+{
+	// the body motion over the step is bounded at the corners of its box
+	ndVector bodyReach(ndVector::m_zero);
+	m_bodyBoxes.SetCount(bodies.GetCount() * 2);
+	for (ndInt32 i = 0; i < ndInt32(bodies.GetCount()); ++i)
+	{
+		const ndBodyBox& body = bodies[i];
+		m_bodyBoxes[i * 2 + 0] = body.m_box0;
+		m_bodyBoxes[i * 2 + 1] = body.m_box1;
+
+		const ndVector size(body.m_box1 - body.m_box0);
+		const ndFloat32 bodyRadius = ndSqrt(size.DotProduct(size).GetScalar());
+		const ndFloat32 omega = ndSqrt(body.m_omega.DotProduct(body.m_omega).GetScalar());
+		const ndVector speed(body.m_stepVeloc.Abs() + ndVector(omega * bodyRadius));
+		bodyReach = bodyReach.GetMax(speed.Scale(timestep));
+	}
+	BuildCells(threadPool, posit, positBase, bodyReach & ndVector::m_triplexMask, radius, skin);
+}
+
+inline const ndInt32* ndBodyParticleSet::ndBodyGrid::GetBodies(const ndVector& point, ndInt32& count) const
+{
+	const ndVector cell(((point - m_origin) * m_invCellSize).Floor().GetMax(ndVector::m_zero).GetMin(m_gridMax).GetInt());
+	const ndInt32 index = (ndInt32(cell.m_iz) * m_sizeY + ndInt32(cell.m_iy)) * m_sizeX + ndInt32(cell.m_ix);
+	const ndInt32 start = m_cellStart[index];
+	count = m_cellStart[index + 1] - start;
+	return &m_cellBodies[0] + start;
+}
+
 
 #endif 
 
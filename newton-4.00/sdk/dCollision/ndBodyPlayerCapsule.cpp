@@ -26,11 +26,13 @@
 #include "ndContact.h"
 #include "ndShapeCapsule.h"
 #include "ndContactSolver.h"
+#include "ndConvexCastNotify.h"
 #include "ndBodyPlayerCapsule.h"
+#include "ndPlayerCapsuleCrowd.h"
 
 #define D_DESCRETE_MOTION_STEPS		4
 #define D_PLAYER_MAX_CONTACTS		8
-#define D_PLAYER_MAX_ROWS			(3 * D_PLAYER_MAX_CONTACTS)
+#define D_PLAYER_MAX_ROWS			(3 * D_PLAYER_MAX_CONTACTS + 4)
 
 #define D_MAX_COLLIONSION_STEPS		8
 #define D_SLOP_JUMP_ANGLE			ndFloat32(0.8f)
@@ -40,12 +42,15 @@ D_MSV_NEWTON_ALIGN_32
 class ndBodyPlayerCapsuleContactSolver
 {
 	public:
-	ndBodyPlayerCapsuleContactSolver(ndBodyPlayerCapsule* const player);
+	ndBodyPlayerCapsuleContactSolver(ndBodyPlayerCapsule* const player, ndInt32 threadIndex);
 	void CalculateContacts();
+	ndFloat32 PredictTimeOfImpact(const ndVector& veloc, ndFloat32 timestep) const;
 
 	ndContactPoint m_contactBuffer[D_PLAYER_MAX_ROWS];
+	ndVector m_scenePosit;
 	ndBodyPlayerCapsule* m_player;
 	ndInt32 m_contactCount;
+	ndInt32 m_threadIndex;
 } D_GCC_NEWTON_ALIGN_32;
 
 D_MSV_NEWTON_ALIGN_32
@@ -60,7 +65,7 @@ class ndBodyPlayerCapsuleImpulseSolver
 	void AddAngularRows();
 	ndInt32 AddLinearRow(const ndVector& dir, const ndVector& r, ndFloat32 speed, ndFloat32 low, ndFloat32 high, ndInt32 normalIndex = -1);
 	ndInt32 AddContactRow(const ndContactPoint* const contact, const ndVector& dir, const ndVector& r, ndFloat32 speed, ndFloat32 low, ndFloat32 high, ndInt32 normalIndex = -1);
-	void ApplyReaction(ndFloat32 timestep);
+	void ApplyReaction(ndInt32 threadIndex, ndFloat32 timestep);
 
 	ndMatrix m_invInertia;
 	ndVector m_veloc;
@@ -79,17 +84,27 @@ class ndBodyPlayerCapsuleImpulseSolver
 
 ndBodyPlayerCapsule::ndBodyPlayerCapsule()
 	:ndBodyKinematicBase()
+	,m_crowd(nullptr)
+	,m_crowdIndex(-1)
+	,m_crowdUpdated(false)
 {
 }
 
 ndBodyPlayerCapsule::ndBodyPlayerCapsule(const ndMatrix& localAxis, ndFloat32 mass, ndFloat32 radius, ndFloat32 height, ndFloat32 stepHeight)
 	:ndBodyKinematicBase()
+	,m_crowd(nullptr)
+	,m_crowdIndex(-1)
+	,m_crowdUpdated(false)
 {
 	Init(localAxis, mass, radius, height, stepHeight);
 }
 
 ndBodyPlayerCapsule::~ndBodyPlayerCapsule()
 {
+	if (m_crowd)
+	{
+		m_crowd->RemovePlayer(this);
+	}
 }
 
 void ndBodyPlayerCapsule::Init(const ndMatrix& localAxis, ndFloat32 mass, ndFloat32 radius, ndFloat32 height, ndFloat32 stepHeight)
@@ -306,85 +321,11 @@ void ndBodyPlayerCapsule::UpdatePlayerStatus(ndBodyPlayerCapsuleContactSolver& c
 	}
 }
 
-ndBodyPlayerCapsule::dCollisionState ndBodyPlayerCapsule::TestPredictCollision(const ndBodyPlayerCapsuleContactSolver& contactSolver, const ndVector& veloc) const
-{
-	for (ndInt32 i = 0; i < contactSolver.m_contactCount; ++i) 
-	{
-		const ndContactPoint* const contact = &contactSolver.m_contactBuffer[i];
-		if (contact->m_penetration >= D_MAX_COLLISION_PENETRATION) 
-		{
-			return m_deepPenetration;
-		}
-	}
-
-	for (ndInt32 i = 0; i < contactSolver.m_contactCount; ++i) 
-	{
-		const ndContactPoint* const contact = &contactSolver.m_contactBuffer[i];
-		ndFloat32 projecSpeed = veloc.DotProduct(contact->m_normal).GetScalar();
-		if (projecSpeed < ndFloat32(0.0f)) 
-		{
-			return m_colliding;
-		}
-	}
-	return m_freeMovement;
-}
-
 ndFloat32 ndBodyPlayerCapsule::PredictTimestep(ndBodyPlayerCapsuleContactSolver& contactSolver, ndFloat32 timestep)
 {
-	ndMatrix matrix(m_matrix);
-	ndVector veloc(GetVelocity());
-	ndBodyKinematic::IntegrateVelocity(timestep);
-	dCollisionState playerCollide = TestPredictCollision(contactSolver, veloc);
-	SetMatrix(matrix);
-
-	if (playerCollide == m_deepPenetration) 
-	{
-		ndFloat32 savedTimeStep = timestep;
-		timestep *= 0.5f;
-		ndFloat32 dt = timestep;
-		for (ndInt32 i = 0; i < D_MAX_COLLIONSION_STEPS; ++i) 
-		{
-			ndBodyKinematic::IntegrateVelocity(timestep);
-			contactSolver.CalculateContacts();
-			SetMatrix(matrix);
-		
-			dt *= 0.5f;
-			playerCollide = TestPredictCollision(contactSolver, veloc);
-			if (playerCollide == m_colliding) 
-			{
-				return timestep;
-			}
-			if (playerCollide == m_deepPenetration) 
-			{
-				timestep -= dt;
-			}
-			else 
-			{
-				timestep += dt;
-			}
-		}
-		if (timestep > dt * 2.0f) 
-		{
-			return timestep;
-		}
-		
-		dt = savedTimeStep / D_MAX_COLLIONSION_STEPS;
-		timestep = dt;
-		for (ndInt32 i = 1; i < D_MAX_COLLIONSION_STEPS; ++i) 
-		{
-			ndBodyKinematic::IntegrateVelocity(timestep);
-			contactSolver.CalculateContacts();
-			SetMatrix(matrix);
-			playerCollide = TestPredictCollision(contactSolver, veloc);
-			if (playerCollide != m_freeMovement) 
-			{
-				return timestep;
-			}
-			timestep += dt;
-		}
-	}
-
-	return timestep;
+	// the contacts are at the current position, so sweep them along the
+	// velocity instead of bisecting the step with the narrow phase.
+	return contactSolver.PredictTimeOfImpact(GetVelocity(), timestep);
 }
 
 void ndBodyPlayerCapsule::ResolveInterpenetrations(ndBodyPlayerCapsuleContactSolver& contactSolver, ndBodyPlayerCapsuleImpulseSolver& impulseSolver)
@@ -487,7 +428,7 @@ void ndBodyPlayerCapsule::ResolveCollision(ndBodyPlayerCapsuleContactSolver& con
 	impulseSolver.AddAngularRows();
 
 	veloc += impulseSolver.CalculateImpulse().Scale(m_invMass);
-	impulseSolver.ApplyReaction(timestep);
+	impulseSolver.ApplyReaction(contactSolver.m_threadIndex, timestep);
 
 	SetVelocity(veloc);
 }
@@ -506,53 +447,173 @@ void ndBodyPlayerCapsuleImpulseSolver::Reset(ndBodyPlayerCapsule* const controll
 	m_veloc = controller->GetVelocity();
 }
 
-ndBodyPlayerCapsuleContactSolver::ndBodyPlayerCapsuleContactSolver(ndBodyPlayerCapsule* const player)
-	:m_player(player)
+ndBodyPlayerCapsuleContactSolver::ndBodyPlayerCapsuleContactSolver(ndBodyPlayerCapsule* const player, ndInt32 threadIndex)
+	:m_scenePosit(player->GetMatrix().m_posit)
+	,m_player(player)
 	,m_contactCount(0)
+	,m_threadIndex(threadIndex)
 {
 }
 
 void ndBodyPlayerCapsuleContactSolver::CalculateContacts()
 {
 	m_contactCount = 0;
+
+	// the heading does not change the shape of the capsule, so as long as the
+	// player is where the scene left it, the scene manifold is still good.
+	const bool atScenePosit = (m_player->GetMatrix().m_posit == m_scenePosit).GetSignMask() == 0x0f;
+
 	ndScene* const scene = m_player->GetScene();
-	ndContactNotify* const contactNotify = m_player->GetScene()->GetContactNotify();
 	ndBodyKinematic::ndContactMap::Iterator it(m_player->GetContactMap());
 	for (it.Begin(); it; it++)
 	{
 		const ndContact* const srcContact = *it;
-		if (srcContact->IsActive())
+		ndBodyKinematic* body0 = srcContact->GetBody0();
+		ndBodyKinematic* body1 = srcContact->GetBody1();
+		const bool swapped = (body1 == m_player);
+		if (swapped)
 		{
-			ndBodyKinematic* body0 = srcContact->GetBody0();
-			ndBodyKinematic* body1 = srcContact->GetBody1();
-			if (body1 == m_player)
+			ndSwap(body0, body1);
+		}
+
+		// players walk through trigger volumes
+		if (srcContact->IsActive() && !body1->GetAsBodyTriggerVolume())
+		{
+			// other special bodies may have moved since the scene built the manifold
+			if (atScenePosit && !body1->GetAsBodyKinematicSpecial())
 			{
-				ndSwap(body0, body1);
+				const ndContactPointList& points = srcContact->GetContactPoints();
+				for (ndContactPointList::ndNode* node = points.GetFirst(); node; node = node->GetNext())
+				{
+					if (m_contactCount < ndInt32(sizeof(m_contactBuffer) / sizeof(m_contactBuffer[0])))
+					{
+						ndContactPoint& point = m_contactBuffer[m_contactCount];
+						point = node->GetInfo();
+						if (swapped)
+						{
+							point.m_normal = point.m_normal.Scale(ndFloat32(-1.0f));
+							ndSwap(point.m_body0, point.m_body1);
+							ndSwap(point.m_shapeInstance0, point.m_shapeInstance1);
+							ndSwap(point.m_shapeId0, point.m_shapeId1);
+						}
+						m_contactCount++;
+					}
+				}
 			}
-			ndContact contact;
-			contact.SetBodies(body0, body1);
-			contact.m_material = contactNotify->GetMaterial(&contact, body0->GetCollisionShape(), body1->GetCollisionShape());
-	
-			ndContactPoint contactBuffer[D_MAX_CONTATCS];
-			ndContactSolver contactSolver(&contact, scene->GetContactNotify(), ndFloat32(1.0f), 0);
-			contactSolver.m_instance0.SetGlobalMatrix(contactSolver.m_instance0.GetLocalMatrix() * body0->GetMatrix());
-			contactSolver.m_instance1.SetGlobalMatrix(contactSolver.m_instance1.GetLocalMatrix() * body1->GetMatrix());
-			contactSolver.m_separatingVector = srcContact->m_separatingVector;
-			//contactSolver.m_timestep = ndFloat32 (1.0f);
-			//contactSolver.m_ccdMode = 0;
-			contactSolver.m_intersectionTestOnly = 0;
-			contactSolver.m_contactBuffer = contactBuffer;
-			const ndInt32 count = contactSolver.CalculateContactsDiscrete ();
-			for (ndInt32 i = 0; i < count; ++i)
+			else
+			{
+				ndContact contact;
+				contact.SetBodies(body0, body1);
+				contact.m_material = srcContact->m_material;
+
+				ndContactPoint contactBuffer[D_MAX_CONTATCS];
+				ndContactSolver contactSolver(&contact, scene->GetContactNotify(), ndFloat32(1.0f), m_threadIndex);
+				contactSolver.m_instance0.SetGlobalMatrix(contactSolver.m_instance0.GetLocalMatrix() * body0->GetMatrix());
+				contactSolver.m_instance1.SetGlobalMatrix(contactSolver.m_instance1.GetLocalMatrix() * body1->GetMatrix());
+				contactSolver.m_separatingVector = srcContact->m_separatingVector;
+				contactSolver.m_intersectionTestOnly = 0;
+				contactSolver.m_contactBuffer = contactBuffer;
+				const ndInt32 count = contactSolver.CalculateContactsDiscrete();
+				for (ndInt32 i = 0; i < count; ++i)
+				{
+					if (m_contactCount < ndInt32(sizeof(m_contactBuffer) / sizeof(m_contactBuffer[0])))
+					{
+						m_contactBuffer[m_contactCount] = contactBuffer[i];
+						m_contactCount++;
+					}
+				}
+			}
+		}
+	}
+
+	// the impulse solver only has rows for a few contacts, keep the deepest
+	if (m_contactCount > D_PLAYER_MAX_CONTACTS)
+	{
+		for (ndInt32 i = 0; i < D_PLAYER_MAX_CONTACTS; ++i)
+		{
+			ndInt32 index = i;
+			for (ndInt32 j = i + 1; j < m_contactCount; ++j)
 			{
-				m_contactBuffer[m_contactCount] = contactBuffer[i];
-				m_contactCount++;
-				ndAssert(m_contactCount < ndInt32 (sizeof(m_contactBuffer) / sizeof(m_contactBuffer[0])));
+				if (m_contactBuffer[j].m_penetration > m_contactBuffer[index].m_penetration)
+				{
+					index = j;
+				}
 			}
+			ndSwap(m_contactBuffer[i], m_contactBuffer[index]);
 		}
+		m_contactCount = D_PLAYER_MAX_CONTACTS;
 	}
 }
 
+// sweeps the capsule against the bodies that are not in its contact map yet
+class ndBodyPlayerCapsuleCastNotify: public ndConvexCastNotify
+{
+	public:
+	ndBodyPlayerCapsuleCastNotify(const ndBodyPlayerCapsule* const player, ndInt32 threadIndex)
+		:ndConvexCastNotify()
+		,m_player(player)
+	{
+		m_threadIndex = threadIndex;
+	}
+
+	virtual ndUnsigned32 OnRayPrecastAction(const ndBody* const body, const ndShapeInstance* const)
+	{
+		// the bodies with contact points are already in the manifold, the other
+		// special bodies may be moving in another thread, and the dynamic bodies
+		// are pushed by the capsule, so only sweep against the static bodies.
+		ndBodyKinematic* const kinBody = ((ndBody*)body)->GetAsBodyKinematic();
+		if ((body == m_player) || !kinBody || (kinBody->GetInvMass() != ndFloat32(0.0f)) || kinBody->GetAsBodyKinematicSpecial() || kinBody->GetAsBodyTriggerVolume())
+		{
+			return 0;
+		}
+		const ndContact* const contact = m_player->GetContactMap().FindContact(m_player, body);
+		return (contact && contact->IsActive() && contact->GetContactPoints().GetCount()) ? 0 : 1;
+	}
+
+	const ndBodyPlayerCapsule* m_player;
+};
+
+ndFloat32 ndBodyPlayerCapsuleContactSolver::PredictTimeOfImpact(const ndVector& veloc, ndFloat32 timestep) const
+{
+	// the penetration of each contact grows linearly with the approach speed,
+	// find the first time one of them goes deeper than the allowed penetration.
+	ndFloat32 timeOfImpact = timestep;
+	for (ndInt32 i = 0; i < m_contactCount; ++i)
+	{
+		const ndContactPoint& contact = m_contactBuffer[i];
+		const ndFloat32 approachSpeed = -veloc.DotProduct(contact.m_normal).GetScalar();
+		if (approachSpeed > ndFloat32(1.0e-4f))
+		{
+			const ndFloat32 time = (D_MAX_COLLISION_PENETRATION - contact.m_penetration) / approachSpeed;
+			timeOfImpact = ndMin(timeOfImpact, time);
+		}
+	}
+
+	// the manifold only has the bodies close enough to have contact points, a step
+	// longer than the box padding can reach a body that has no contact points yet.
+	const ndVector step((veloc & ndVector::m_triplexMask).Scale(timeOfImpact));
+	if (step.DotProduct(step).GetScalar() > D_MAX_SHAPE_AABB_PADDING * D_MAX_SHAPE_AABB_PADDING)
+	{
+		// the cast takes the shape global matrix as the origin, so the cast
+		// shape is a copy of the capsule without its local offset.
+		const ndShapeInstance& shape = m_player->GetCollisionShape();
+		const ndMatrix origin(shape.GetLocalMatrix() * m_player->GetMatrix());
+		ndShapeInstance castShape(shape);
+		castShape.SetLocalMatrix(ndGetIdentityMatrix());
+		ndBodyPlayerCapsuleCastNotify castNotify(m_player, m_threadIndex);
+		m_player->GetScene()->ConvexCast(castNotify, castShape, origin, origin.m_posit + step);
+		// stop at the new body, the next update has it in the contact map.
+		// a body that already overlaps the capsule is left to the next update.
+		if ((castNotify.m_param > ndFloat32(0.0f)) && (castNotify.m_param < ndFloat32(1.0f)))
+		{
+			return timeOfImpact * castNotify.m_param;
+		}
+	}
+
+	// always move a little, the next step resolves the contacts
+	return ndMax(timeOfImpact, timestep / D_MAX_COLLIONSION_STEPS);
+}
+
 ndInt32 ndBodyPlayerCapsuleImpulseSolver::AddLinearRow(const ndVector& dir, const ndVector& r, ndFloat32 speed, ndFloat32 low, ndFloat32 high, ndInt32 normalIndex)
 {
 	m_contactPoint[m_rowCount] = nullptr;
@@ -694,7 +755,7 @@ void ndBodyPlayerCapsuleImpulseSolver::AddAngularRows()
 	}
 }
 
-void ndBodyPlayerCapsuleImpulseSolver::ApplyReaction(ndFloat32 timestep)
+void ndBodyPlayerCapsuleImpulseSolver::ApplyReaction(ndInt32 threadIndex, ndFloat32 timestep)
 {
 	ndFloat32 invTimeStep = 0.1f / timestep;
 	for (ndInt32 i = 0; i < m_rowCount; ++i) 
@@ -705,16 +766,23 @@ void ndBodyPlayerCapsuleImpulseSolver::ApplyReaction(ndFloat32 timestep)
 			ndBodyKinematic* const body1 = ((ndBodyKinematic*)m_contactPoint[i]->m_body1);
 			ndVector force(m_jacobianPairs[i].m_jacobianM1.m_linear.Scale(m_impulseMag[i] * invTimeStep));
 			ndVector torque(m_jacobianPairs[i].m_jacobianM1.m_angular.Scale(m_impulseMag[i] * invTimeStep));
-			body1->SetForce(force + body1->GetForce());
-			body1->SetTorque(torque + body1->GetTorque());
+			// other players may be pushing the same body, the scene applies the force after the update
+			body0->GetScene()->AddSpecialReaction(threadIndex, body1, force, torque);
 			body0->m_equilibriumOverride = 1;
 		}
 	}
 }
 
-void ndBodyPlayerCapsule::SpecialUpdate(ndFloat32 timestep)
+void ndBodyPlayerCapsule::SpecialUpdate(ndInt32 threadIndex, ndFloat32 timestep)
 {
-	ndBodyPlayerCapsuleContactSolver contactSolver(this);
+	if (m_crowdUpdated)
+	{
+		// the crowd already moved this player
+		m_crowdUpdated = false;
+		return;
+	}
+
+	ndBodyPlayerCapsuleContactSolver contactSolver(this, threadIndex);
 	ndFloat32 timeLeft = timestep;
 	const ndFloat32 timeEpsilon = timestep * (1.0f / 16.0f);
 
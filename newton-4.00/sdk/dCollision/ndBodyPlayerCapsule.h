@@ -25,6 +25,7 @@
 #include "ndCollisionStdafx.h"
 #include "ndBodyKinematicBase.h"
 
+class ndPlayerCapsuleCrowd;
 class ndBodyPlayerCapsuleContactSolver;
 class ndBodyPlayerCapsuleImpulseSolver;
 
@@ -55,24 +56,16 @@ class ndBodyPlayerCapsule : public ndBodyKinematicBase
 	virtual ndFloat32 ContactFrictionCallback(const ndVector& position, const ndVector& normal, ndInt32 contactId, const ndBodyKinematic* const otherbody) const;
 
 	private:
-	enum dCollisionState
-	{
-		m_colliding,
-		m_freeMovement,
-		m_deepPenetration,
-	};
-
 	virtual void IntegrateExternalForce(ndFloat32 timestep);
 	virtual void SetCollisionShape(const ndShapeInstance& shapeInstance);
 	void UpdatePlayerStatus(ndBodyPlayerCapsuleContactSolver& contactSolver);
 	void ResolveStep(ndBodyPlayerCapsuleContactSolver& contactSolver, ndFloat32 timestep);
 	void ResolveCollision(ndBodyPlayerCapsuleContactSolver& contactSolver, ndFloat32 timestep);
 	ndFloat32 PredictTimestep(ndBodyPlayerCapsuleContactSolver& contactSolver, ndFloat32 timestep);
-	dCollisionState TestPredictCollision(const ndBodyPlayerCapsuleContactSolver& contactSolver, const ndVector& veloc) const;
 	void ResolveInterpenetrations(ndBodyPlayerCapsuleContactSolver& contactSolver, ndBodyPlayerCapsuleImpulseSolver& impulseSolver);
 	void IntegrateVelocity(ndFloat32 timestep);
 
-	D_COLLISION_API virtual void SpecialUpdate(ndFloat32 timestep);
+	D_COLLISION_API virtual void SpecialUpdate(ndInt32 threadIndex, ndFloat32 timestep);
 	D_COLLISION_API void Init(const ndMatrix& localAxis, ndFloat32 mass, ndFloat32 radius, ndFloat32 height, ndFloat32 stepHeight);
 
 	protected: 
@@ -92,6 +85,12 @@ class ndBodyPlayerCapsule : public ndBodyKinematicBase
 	bool m_isAirbone;
 	bool m_isOnFloor;
 	bool m_isCrouched;
+
+	ndPlayerCapsuleCrowd* m_crowd;
+	ndInt32 m_crowdIndex;
+	bool m_crowdUpdated;
+
+	friend class ndPlayerCapsuleCrowd;
 	friend class ndFileFormatBodyKinematicPlayerCapsule;
 } D_GCC_NEWTON_ALIGN_32;
 
@@ -0,0 +1,745 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "ndCoreStdafx.h"
+#include "ndCollisionStdafx.h"
+#include "ndWorld.h"
+#include "ndBodySoftBody.h"
+
+#define D_SOFT_BODY_MAX_COLORS		64
+#define D_SOFT_BODY_COLLISION_SKIN	ndFloat32(0.05f)
+
+class ndBodySoftBody::ndSpring
+{
+	public:
+	ndInt32 m_i0;
+	ndInt32 m_i1;
+	ndFloat32 m_restLength;
+	ndFloat32 m_compliance;
+	ndFloat32 m_damping;
+	ndFloat32 m_lambda;
+};
+
+class ndBodySoftBody::ndTetrahedron
+{
+	public:
+	ndInt32 m_index[4];
+	ndFloat32 m_restVolume;
+	ndFloat32 m_compliance;
+	ndFloat32 m_lambda;
+};
+
+class ndBodySoftBody::ndCollider
+{
+	public:
+	ndMatrix m_matrix;
+	ndMatrix m_shapeMatrix;
+	ndVector m_veloc;
+	ndVector m_omega;
+	ndVector m_accel;
+	ndVector m_stepVeloc;
+	ndVector m_com;
+	ndVector m_localCom;
+	ndVector m_box0;
+	ndVector m_box1;
+	ndVector m_impulse;
+	ndVector m_angularImpulse;
+	ndBodyKinematic* m_body;
+	const ndShapeInstance* m_shape;
+};
+
+class ndBodySoftBody::ndWorkingBuffers
+{
+	public:
+	ndWorkingBuffers()
+		:m_springs(1024)
+		,m_tetrahedra(1024)
+		,m_springsScratch(1024)
+		,m_tetrahedraScratch(1024)
+		,m_springBatches(D_SOFT_BODY_MAX_COLORS + 2)
+		,m_tetrahedraBatches(D_SOFT_BODY_MAX_COLORS + 2)
+		,m_colorMask(1024)
+		,m_positBase(1024)
+		,m_colliders(256)
+		,m_colliderImpulses(256)
+		,m_colliderGrid()
+		,m_colliderReferences()
+	{
+	}
+
+	// assigns each constraint the first color not used by its particles,
+	// and sorts the constraints by color. the last batch holds the ones
+	// that ran out of colors, they are solved in a single thread.
+	template <class T, ndInt32 count>
+	void ColorConstraints(ndArray<T>& constraints, ndArray<T>& scratch, ndArray<ndInt32>& batches, ndInt32 particleCount)
+	{
+		m_colorMask.SetCount(particleCount);
+		for (ndInt32 i = 0; i < particleCount; ++i)
+		{
+			m_colorMask[i] = 0;
+		}
+
+		ndInt32 histogram[D_SOFT_BODY_MAX_COLORS + 1];
+		for (ndInt32 i = 0; i <= D_SOFT_BODY_MAX_COLORS; ++i)
+		{
+			histogram[i] = 0;
+		}
+
+		ndArray<ndUnsigned8> colors;
+		colors.SetCount(constraints.GetCount());
+		for (ndInt32 i = 0; i < constraints.GetCount(); ++i)
+		{
+			const ndInt32* const index = GetIndices(constraints[i]);
+			ndUnsigned64 used = 0;
+			for (ndInt32 j = 0; j < count; ++j)
+			{
+				used |= m_colorMask[index[j]];
+			}
+
+			ndInt32 color = 0;
+			while ((color < D_SOFT_BODY_MAX_COLORS) && (used & (ndUnsigned64(1) << color)))
+			{
+				color++;
+			}
+			if (color < D_SOFT_BODY_MAX_COLORS)
+			{
+				for (ndInt32 j = 0; j < count; ++j)
+				{
+					m_colorMask[index[j]] |= ndUnsigned64(1) << color;
+				}
+			}
+			colors[i] = ndUnsigned8(color);
+			histogram[color]++;
+		}
+
+		ndInt32 sum = 0;
+		batches.SetCount(0);
+		for (ndInt32 i = 0; i <= D_SOFT_BODY_MAX_COLORS; ++i)
+		{
+			const ndInt32 start = sum;
+			sum += histogram[i];
+			histogram[i] = start;
+			if ((sum > start) || (i == D_SOFT_BODY_MAX_COLORS))
+			{
+				batches.PushBack(start);
+			}
+		}
+		batches.PushBack(sum);
+
+		scratch.SetCount(constraints.GetCount());
+		for (ndInt32 i = 0; i < constraints.GetCount(); ++i)
+		{
+			const ndInt32 color = colors[i];
+			scratch[histogram[color]] = constraints[i];
+			histogram[color]++;
+		}
+		constraints.Swap(scratch);
+	}
+
+	static const ndInt32* GetIndices(const ndSpring& spring)
+	{
+		return &spring.m_i0;
+	}
+
+	static const ndInt32* GetIndices(const ndTetrahedron& tetrahedron)
+	{
+		return tetrahedron.m_index;
+	}
+
+	ndArray<ndSpring> m_springs;
+	ndArray<ndTetrahedron> m_tetrahedra;
+	ndArray<ndSpring> m_springsScratch;
+	ndArray<ndTetrahedron> m_tetrahedraScratch;
+	ndArray<ndInt32> m_springBatches;
+	ndArray<ndInt32> m_tetrahedraBatches;
+	ndArray<ndUnsigned64> m_colorMask;
+	ndArray<ndVector> m_positBase;
+	ndArray<ndCollider> m_colliders;
+	ndArray<ndVector> m_colliderImpulses;
+	ndBodyGrid m_colliderGrid;
+	ndList<ndSharedPtr<ndBody>> m_colliderReferences;
+};
+
+ndBodySoftBody::ndBodySoftBody()
+	:ndBodyParticleSet()
+	,m_invMass(1024)
+	,m_workingBuffers(new ndWorkingBuffers)
+	,m_damping(ndFloat32(0.1f))
+	,m_friction(ndFloat32(0.5f))
+	,m_solverIterations(2)
+	,m_subSteps(4)
+	,m_bodyCollision(true)
+	,m_batchesDirty(false)
+{
+	SetParticleRadius(ndFloat32(0.05f));
+}
+
+ndBodySoftBody::~ndBodySoftBody()
+{
+	Sync();
+	delete m_workingBuffers;
+}
+
+ndInt32 ndBodySoftBody::AddParticle(const ndVector& posit, ndFloat32 mass)
+{
+	ndAssert(TaskState() == ndBackgroundTask::m_taskCompleted);
+	const ndInt32 index = ndInt32(m_posit.GetCount());
+	m_posit.PushBack(posit & ndVector::m_triplexMask);
+	m_veloc.PushBack(ndVector::m_zero);
+	m_invMass.PushBack((mass > ndFloat32(0.0f)) ? ndFloat32(1.0f) / mass : ndFloat32(0.0f));
+	return index;
+}
+
+void ndBodySoftBody::SetParticleMass(ndInt32 index, ndFloat32 mass)
+{
+	ndAssert(TaskState() == ndBackgroundTask::m_taskCompleted);
+	m_invMass[index] = (mass > ndFloat32(0.0f)) ? ndFloat32(1.0f) / mass : ndFloat32(0.0f);
+}
+
+void ndBodySoftBody::AddSpring(ndInt32 i0, ndInt32 i1, ndFloat32 compliance, ndFloat32 damping)
+{
+	ndAssert(i0 != i1);
+	ndAssert(TaskState() == ndBackgroundTask::m_taskCompleted);
+	ndAssert((i0 >= 0) && (i0 < m_posit.GetCount()));
+	ndAssert((i1 >= 0) && (i1 < m_posit.GetCount()));
+
+	const ndVector dist(m_posit[i0] - m_posit[i1]);
+	ndSpring spring;
+	spring.m_i0 = i0;
+	spring.m_i1 = i1;
+	spring.m_restLength = ndSqrt(dist.DotProduct(dist).GetScalar());
+	spring.m_compliance = ndMax(compliance, ndFloat32(0.0f));
+	spring.m_damping = ndMax(damping, ndFloat32(0.0f));
+	spring.m_lambda = ndFloat32(0.0f);
+	m_workingBuffers->m_springs.PushBack(spring);
+	m_batchesDirty = true;
+}
+
+void ndBodySoftBody::AddTetrahedron(ndInt32 i0, ndInt32 i1, ndInt32 i2, ndInt32 i3, ndFloat32 compliance)
+{
+	ndAssert(TaskState() == ndBackgroundTask::m_taskCompleted);
+	ndTetrahedron tetrahedron;
+	tetrahedron.m_index[0] = i0;
+	tetrahedron.m_index[1] = i1;
+	tetrahedron.m_index[2] = i2;
+	tetrahedron.m_index[3] = i3;
+
+	const ndVector e1(m_posit[i1] - m_posit[i0]);
+	const ndVector e2(m_posit[i2] - m_posit[i0]);
+	const ndVector e3(m_posit[i3] - m_posit[i0]);
+	tetrahedron.m_restVolume = e1.DotProduct(e2.CrossProduct(e3)).GetScalar() * ndFloat32(1.0f / 6.0f);
+	tetrahedron.m_compliance = ndMax(compliance, ndFloat32(0.0f));
+	tetrahedron.m_lambda = ndFloat32(0.0f);
+	m_workingBuffers->m_tetrahedra.PushBack(tetrahedron);
+	m_batchesDirty = true;
+}
+
+ndInt32 ndBodySoftBody::GetSpringCount() const
+{
+	return ndInt32(m_workingBuffers->m_springs.GetCount());
+}
+
+ndInt32 ndBodySoftBody::GetTetrahedronCount() const
+{
+	return ndInt32(m_workingBuffers->m_tetrahedra.GetCount());
+}
+
+ndInt32 ndBodySoftBody::GetBatchCount()
+{
+	ndAssert(TaskState() == ndBackgroundTask::m_taskCompleted);
+	BuildBatches();
+	ndWorkingBuffers& data = *m_workingBuffers;
+	return ndInt32(data.m_springBatches.GetCount() + data.m_tetrahedraBatches.GetCount()) - 2;
+}
+
+void ndBodySoftBody::BuildBatches()
+{
+	if (m_batchesDirty)
+	{
+		D_TRACKTIME();
+		ndWorkingBuffers& data = *m_workingBuffers;
+		const ndInt32 particleCount = ndInt32(m_posit.GetCount());
+		data.ColorConstraints<ndSpring, 2>(data.m_springs, data.m_springsScratch, data.m_springBatches, particleCount);
+		data.ColorConstraints<ndTetrahedron, 4>(data.m_tetrahedra, data.m_tetrahedraScratch, data.m_tetrahedraBatches, particleCount);
+		m_batchesDirty = false;
+	}
+}
+
+void ndBodySoftBody::CalculateAabb(ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+	class ndBox
+	{
+		public:
+		ndBox()
+			:m_min(ndFloat32(1.0e10f))
+			,m_max(ndFloat32(-1.0e10f))
+		{
+		}
+		ndVector m_min;
+		ndVector m_max;
+	};
+
+	ndBox boxes[D_MAX_THREADS_COUNT];
+	auto CalculateAabb = ndMakeObject::ndFunction([this, &boxes](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateAabb);
+		// include where the particles go in the next frame
+		ndBox box;
+		const ndVector timestep(m_timestep);
+		const ndStartEnd startEnd(m_posit.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndVector p1(m_posit[i] + m_veloc[i] * timestep);
+			box.m_min = box.m_min.GetMin(m_posit[i]).GetMin(p1);
+			box.m_max = box.m_max.GetMax(m_posit[i]).GetMax(p1);
+		}
+		boxes[threadIndex] = box;
+	});
+	threadPool->ParallelExecute(CalculateAabb);
+
+	ndBox box;
+	for (ndInt32 i = 0; i < threadPool->GetThreadCount(); ++i)
+	{
+		box.m_min = box.m_min.GetMin(boxes[i].m_min);
+		box.m_max = box.m_max.GetMax(boxes[i].m_max);
+	}
+	const ndVector padding(ndFloat32(2.0f) * GetParticleRadius());
+	m_box0 = (box.m_min - padding) & ndVector::m_triplexMask;
+	m_box1 = (box.m_max + padding) & ndVector::m_triplexMask;
+}
+
+void ndBodySoftBody::PredictPositions(ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+	ndWorkingBuffers& data = *m_workingBuffers;
+	auto PredictPositions = ndMakeObject::ndFunction([this, &data](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(PredictPositions);
+		const ndFloat32 timestep = m_timestep / ndFloat32(m_subSteps);
+		const ndVector step(timestep);
+		const ndVector gravityStep(m_gravity.Scale(timestep));
+		const ndStartEnd startEnd(m_posit.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			data.m_positBase[i] = m_posit[i];
+			if (m_invMass[i] > ndFloat32(0.0f))
+			{
+				m_veloc[i] += gravityStep;
+				m_posit[i] += m_veloc[i] * step;
+			}
+			else
+			{
+				m_veloc[i] = ndVector::m_zero;
+			}
+		}
+
+		// the multipliers accumulate over the iterations of one sub step
+		const ndStartEnd springStartEnd(data.m_springs.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = springStartEnd.m_start; i < springStartEnd.m_end; ++i)
+		{
+			data.m_springs[i].m_lambda = ndFloat32(0.0f);
+		}
+		const ndStartEnd tetrahedraStartEnd(data.m_tetrahedra.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = tetrahedraStartEnd.m_start; i < tetrahedraStartEnd.m_end; ++i)
+		{
+			data.m_tetrahedra[i].m_lambda = ndFloat32(0.0f);
+		}
+	});
+	threadPool->ParallelExecute(PredictPositions);
+}
+
+void ndBodySoftBody::SolveSprings(ndThreadPool* const threadPool, ndFloat32 timestep)
+{
+	D_TRACKTIME();
+	ndWorkingBuffers& data = *m_workingBuffers;
+	const ndFloat32 invTimestep2 = ndFloat32(1.0f) / (timestep * timestep);
+	for (ndInt32 batch = 0; batch < data.m_springBatches.GetCount() - 1; ++batch)
+	{
+		const ndInt32 start = data.m_springBatches[batch];
+		const ndInt32 count = data.m_springBatches[batch + 1] - start;
+		auto SolveSprings = ndMakeObject::ndFunction([this, &data, start, count, timestep, invTimestep2](ndInt32 threadIndex, ndInt32 threadCount)
+		{
+			D_TRACKTIME_NAMED(SolveSprings);
+			const ndStartEnd startEnd(count, threadIndex, threadCount);
+			for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+			{
+				ndSpring& spring = data.m_springs[start + i];
+				const ndInt32 i0 = spring.m_i0;
+				const ndInt32 i1 = spring.m_i1;
+				const ndFloat32 w0 = m_invMass[i0];
+				const ndFloat32 w1 = m_invMass[i1];
+				const ndFloat32 w = w0 + w1;
+				const ndVector dist(m_posit[i0] - m_posit[i1]);
+				const ndFloat32 length2 = dist.DotProduct(dist).GetScalar();
+				if ((w <= ndFloat32(0.0f)) || (length2 < ndFloat32(1.0e-12f)))
+				{
+					continue;
+				}
+
+				const ndFloat32 length = ndSqrt(length2);
+				const ndVector normal(dist.Scale(ndFloat32(1.0f) / length));
+				const ndFloat32 alpha = spring.m_compliance * invTimestep2;
+				const ndFloat32 gamma = spring.m_compliance * spring.m_damping / timestep;
+				const ndVector relativeStep((m_posit[i0] - data.m_positBase[i0]) - (m_posit[i1] - data.m_positBase[i1]));
+				const ndFloat32 c = length - spring.m_restLength;
+				const ndFloat32 deltaLambda = (-c - alpha * spring.m_lambda - gamma * normal.DotProduct(relativeStep).GetScalar()) / ((ndFloat32(1.0f) + gamma) * w + alpha);
+
+				spring.m_lambda += deltaLambda;
+				m_posit[i0] += normal.Scale(w0 * deltaLambda);
+				m_posit[i1] -= normal.Scale(w1 * deltaLambda);
+			}
+		});
+
+		if (batch < data.m_springBatches.GetCount() - 2)
+		{
+			threadPool->ParallelExecute(SolveSprings);
+		}
+		else
+		{
+			// the constraints that ran out of colors
+			SolveSprings(0, 1);
+		}
+	}
+}
+
+void ndBodySoftBody::SolveTetrahedra(ndThreadPool* const threadPool, ndFloat32 timestep)
+{
+	D_TRACKTIME();
+	ndWorkingBuffers& data = *m_workingBuffers;
+	const ndFloat32 invTimestep2 = ndFloat32(1.0f) / (timestep * timestep);
+	for (ndInt32 batch = 0; batch < data.m_tetrahedraBatches.GetCount() - 1; ++batch)
+	{
+		const ndInt32 start = data.m_tetrahedraBatches[batch];
+		const ndInt32 count = data.m_tetrahedraBatches[batch + 1] - start;
+		auto SolveTetrahedra = ndMakeObject::ndFunction([this, &data, start, count, invTimestep2](ndInt32 threadIndex, ndInt32 threadCount)
+		{
+			D_TRACKTIME_NAMED(SolveTetrahedra);
+			const ndStartEnd startEnd(count, threadIndex, threadCount);
+			for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+			{
+				ndTetrahedron& tetrahedron = data.m_tetrahedra[start + i];
+				const ndInt32* const index = tetrahedron.m_index;
+				const ndVector e1(m_posit[index[1]] - m_posit[index[0]]);
+				const ndVector e2(m_posit[index[2]] - m_posit[index[0]]);
+				const ndVector e3(m_posit[index[3]] - m_posit[index[0]]);
+
+				// gradients of the volume with respect to each corner
+				ndVector gradient[4];
+				gradient[1] = e2.CrossProduct(e3).Scale(ndFloat32(1.0f / 6.0f));
+				gradient[2] = e3.CrossProduct(e1).Scale(ndFloat32(1.0f / 6.0f));
+				gradient[3] = e1.CrossProduct(e2).Scale(ndFloat32(1.0f / 6.0f));
+				gradient[0] = (gradient[1] + gradient[2] + gradient[3]).Scale(ndFloat32(-1.0f));
+
+				ndFloat32 w = ndFloat32(0.0f);
+				for (ndInt32 j = 0; j < 4; ++j)
+				{
+					w += m_invMass[index[j]] * gradient[j].DotProduct(gradient[j]).GetScalar();
+				}
+				const ndFloat32 alpha = tetrahedron.m_compliance * invTimestep2;
+				if ((w + alpha) < ndFloat32(1.0e-20f))
+				{
+					continue;
+				}
+
+				const ndFloat32 volume = e1.DotProduct(gradient[1]).GetScalar();
+				const ndFloat32 c = volume - tetrahedron.m_restVolume;
+				const ndFloat32 deltaLambda = (-c - alpha * tetrahedron.m_lambda) / (w + alpha);
+				tetrahedron.m_lambda += deltaLambda;
+				for (ndInt32 j = 0; j < 4; ++j)
+				{
+					m_posit[index[j]] += gradient[j].Scale(m_invMass[index[j]] * deltaLambda);
+				}
+			}
+		});
+
+		if (batch < data.m_tetrahedraBatches.GetCount() - 2)
+		{
+			threadPool->ParallelExecute(SolveTetrahedra);
+		}
+		else
+		{
+			// the constraints that ran out of colors
+			SolveTetrahedra(0, 1);
+		}
+	}
+}
+
+void ndBodySoftBody::UpdateVelocities(ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+	ndWorkingBuffers& data = *m_workingBuffers;
+	auto UpdateVelocities = ndMakeObject::ndFunction([this, &data](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(UpdateVelocities);
+		const ndFloat32 timestep = m_timestep / ndFloat32(m_subSteps);
+		const ndVector invTimestep(ndFloat32(1.0f) / timestep);
+		const ndVector damping(ndMax(ndFloat32(1.0f) - m_damping * timestep, ndFloat32(0.0f)));
+		const ndStartEnd startEnd(m_posit.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			m_veloc[i] = (m_posit[i] - data.m_positBase[i]) * invTimestep * damping;
+		}
+	});
+	threadPool->ParallelExecute(UpdateVelocities);
+}
+
+void ndBodySoftBody::CollectBodies(const ndScene* const scene)
+{
+	D_TRACKTIME();
+	ndWorkingBuffers& data = *m_workingBuffers;
+	data.m_colliders.SetCount(0);
+	data.m_colliderReferences.RemoveAll();
+	if (!m_bodyCollision)
+	{
+		return;
+	}
+
+	// the particles aabb is the one calculated by the last update
+	ndBodiesInAabbNotify notify;
+	scene->BodiesInAabb(notify, m_box0, m_box1);
+
+	const ndVector padding(ndFloat32(2.0f) * GetParticleRadius());
+	const ndVector timestep(m_timestep);
+	for (ndInt32 i = 0; i < notify.m_bodyArray.GetCount(); ++i)
+	{
+		ndBodyKinematic* const body = ((ndBody*)notify.m_bodyArray[i])->GetAsBodyKinematic();
+		if (body->GetAsBodyTriggerVolume())
+		{
+			continue;
+		}
+		const ndShapeInstance& shape = body->GetCollisionShape();
+
+		ndCollider collider;
+		collider.m_body = body;
+		collider.m_shape = &shape;
+		collider.m_matrix = body->GetMatrix();
+		collider.m_shapeMatrix = shape.GetLocalMatrix() * collider.m_matrix;
+		collider.m_veloc = body->GetVelocity();
+		collider.m_accel = body->GetForce().Scale(body->GetInvMass()) & ndVector::m_triplexMask;
+		collider.m_stepVeloc = collider.m_veloc;
+		collider.m_omega = body->GetOmega();
+		collider.m_com = body->GetGlobalGetCentreOfMass();
+		collider.m_localCom = body->GetCentreOfMass();
+		collider.m_impulse = ndVector::m_zero;
+		collider.m_angularImpulse = ndVector::m_zero;
+
+		ndVector box0;
+		ndVector box1;
+		body->GetAABB(box0, box1);
+		const ndVector step(((collider.m_veloc.Abs() + (collider.m_accel * timestep).Abs()) * timestep) + padding);
+		collider.m_box0 = (box0 - step) & ndVector::m_triplexMask;
+		collider.m_box1 = (box1 + step) & ndVector::m_triplexMask;
+		data.m_colliders.PushBack(collider);
+
+		// keep the body alive while the update runs in the background
+		data.m_colliderReferences.Append(scene->GetBody(body));
+	}
+}
+
+void ndBodySoftBody::CollideBodies(ndThreadPool* const threadPool, ndInt32 subStep)
+{
+	D_TRACKTIME();
+	ndWorkingBuffers& data = *m_workingBuffers;
+	const ndInt32 bodyCount = ndInt32(data.m_colliders.GetCount());
+	if (!bodyCount)
+	{
+		return;
+	}
+
+	// the bodies were captured at the beginning of the frame,
+	// move them ahead to where they are at the end of this sub step.
+	const ndFloat32 aheadStep = m_timestep * ndFloat32(subStep + 1) / ndFloat32(m_subSteps);
+	for (ndInt32 i = 0; i < bodyCount; ++i)
+	{
+		ndCollider& collider = data.m_colliders[i];
+		ndMatrix matrix(collider.m_matrix);
+		const ndFloat32 omegaMag2 = collider.m_omega.DotProduct(collider.m_omega).GetScalar();
+		if (omegaMag2 > ndFloat32(1.0e-12f))
+		{
+			const ndFloat32 omegaMag = ndSqrt(omegaMag2);
+			const ndMatrix rotation(ndQuaternion(collider.m_omega.Scale(ndFloat32(1.0f) / omegaMag), omegaMag * aheadStep), ndVector::m_wOne);
+			const ndVector com(matrix.TransformVector(collider.m_localCom));
+			matrix = matrix * rotation;
+			matrix.m_posit = com + rotation.RotateVector(collider.m_matrix.m_posit - com);
+		}
+		collider.m_stepVeloc = collider.m_veloc + collider.m_accel.Scale(aheadStep);
+		matrix.m_posit += (collider.m_veloc + collider.m_stepVeloc).Scale(aheadStep * ndFloat32(0.5f));
+		matrix.m_posit.m_w = ndFloat32(1.0f);
+		collider.m_shapeMatrix = collider.m_shape->GetLocalMatrix() * matrix;
+		collider.m_com = matrix.TransformVector(collider.m_localCom);
+	}
+
+	const ndInt32 threadCount = threadPool->GetThreadCount();
+	data.m_colliderImpulses.SetCount(threadCount * bodyCount * 2);
+	for (ndInt32 i = 0; i < data.m_colliderImpulses.GetCount(); ++i)
+	{
+		data.m_colliderImpulses[i] = ndVector::m_zero;
+	}
+
+	const ndFloat32 subStepTime = m_timestep / ndFloat32(m_subSteps);
+	data.m_colliderGrid.Build(threadPool, m_posit, data.m_positBase, data.m_colliders, subStepTime, GetParticleRadius(), D_SOFT_BODY_COLLISION_SKIN * GetParticleRadius());
+
+	auto CollideBodies = ndMakeObject::ndFunction([this, &data, bodyCount](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CollideBodies);
+		const ndCollider* const colliders = &data.m_colliders[0];
+		ndVector* const impulses = &data.m_colliderImpulses[threadIndex * bodyCount * 2];
+
+		const ndFloat32 timestep = m_timestep / ndFloat32(m_subSteps);
+		const ndVector invTimestep(ndFloat32(1.0f) / timestep);
+		const ndVector skin(D_SOFT_BODY_COLLISION_SKIN * GetParticleRadius());
+		const ndFloat32 friction = m_friction;
+
+		ndRayCastClosestHitCallback callback;
+		const ndStartEnd startEnd(m_posit.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			if (m_invMass[i] == ndFloat32(0.0f))
+			{
+				continue;
+			}
+
+			ndVector p1(m_posit[i]);
+			ndInt32 cellCount;
+			const ndInt32* const cellBodies = data.m_colliderGrid.GetBodies(p1, cellCount);
+			for (ndInt32 k = 0; k < cellCount; ++k)
+			{
+				const ndInt32 j = cellBodies[k];
+				// trace the particle motion relative to the body,
+				// in the frame the body has at the end of the step.
+				const ndCollider& collider = colliders[j];
+				const ndVector bodyVeloc(collider.m_stepVeloc + collider.m_omega.CrossProduct(p1 - collider.m_com));
+				const ndVector p0(data.m_positBase[i] + bodyVeloc.Scale(timestep));
+				if (!ndOverlapTest(p0.GetMin(p1), p0.GetMax(p1), collider.m_box0, collider.m_box1))
+				{
+					continue;
+				}
+
+				ndContactPoint contact;
+				callback.m_param = ndFloat32(1.0f);
+				const ndVector localP0(collider.m_shapeMatrix.UntransformVector(p0) & ndVector::m_triplexMask);
+				const ndVector localP1(collider.m_shapeMatrix.UntransformVector(p1) & ndVector::m_triplexMask);
+				const ndFloat32 t = collider.m_shape->RayCast(callback, localP0, localP1, collider.m_body, contact);
+				if (t < ndFloat32(1.0f))
+				{
+					const ndVector normal(collider.m_shapeMatrix.RotateVector(contact.m_normal));
+					const ndVector point(p0 + (p1 - p0).Scale(t));
+
+					// the friction takes away part of the sliding relative to the body
+					const ndVector slide(p1 - p0);
+					const ndVector tangent(slide - normal.Scale(slide.DotProduct(normal).GetScalar()));
+					const ndVector target(point + normal * skin + tangent.Scale(t * (ndFloat32(1.0f) - friction)));
+
+					const ndVector momentum((target - p1).Scale(ndFloat32(1.0f) / m_invMass[i]) * invTimestep);
+					p1 = target;
+					impulses[j * 2 + 0] -= momentum;
+					impulses[j * 2 + 1] -= (point - collider.m_com).CrossProduct(momentum);
+				}
+			}
+			m_posit[i] = p1;
+		}
+	});
+	threadPool->ParallelExecute(CollideBodies);
+
+	for (ndInt32 i = 0; i < threadCount; ++i)
+	{
+		const ndVector* const impulses = &data.m_colliderImpulses[i * bodyCount * 2];
+		for (ndInt32 j = 0; j < bodyCount; ++j)
+		{
+			ndCollider& collider = data.m_colliders[j];
+			collider.m_impulse += impulses[j * 2 + 0];
+			collider.m_angularImpulse += impulses[j * 2 + 1];
+		}
+	}
+}
+
+void ndBodySoftBody::ApplyBodyImpulses()
+{
+	D_TRACKTIME();
+	ndWorkingBuffers& data = *m_workingBuffers;
+	for (ndInt32 i = 0; i < data.m_colliders.GetCount(); ++i)
+	{
+		const ndCollider& collider = data.m_colliders[i];
+		ndBodyKinematic* const body = collider.m_body;
+		const ndFloat32 invMass = body->GetInvMass();
+		const ndFloat32 mag2 = collider.m_impulse.DotProduct(collider.m_impulse).GetScalar() + collider.m_angularImpulse.DotProduct(collider.m_angularImpulse).GetScalar();
+		if ((invMass > ndFloat32(0.0f)) && (mag2 > ndFloat32(1.0e-12f)))
+		{
+			const ndMatrix invInertia(body->CalculateInvInertiaMatrix());
+			body->SetVelocity(body->GetVelocity() + collider.m_impulse.Scale(invMass));
+			body->SetOmega(body->GetOmega() + invInertia.RotateVector(collider.m_angularImpulse));
+		}
+	}
+	data.m_colliders.SetCount(0);
+	data.m_colliderReferences.RemoveAll();
+}
+
+void ndBodySoftBody::Update(const ndScene* const scene, ndFloat32 timestep)
+{
+	ndAssert(TaskState() == ndBackgroundTask::m_taskCompleted);
+	if (m_posit.GetCount())
+	{
+		m_timestep = timestep;
+		CollectBodies(scene);
+		((ndScene*)scene)->SendBackgroundTask(this);
+		if (!m_updateInBackground)
+		{
+			Sync();
+		}
+	}
+}
+
+void ndBodySoftBody::SyncUpdate(const ndScene* const scene)
+{
+	ndBodyParticleSet::SyncUpdate(scene);
+	ApplyBodyImpulses();
+}
+
+void ndBodySoftBody::Execute(ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+	ndWorkingBuffers& data = *m_workingBuffers;
+
+	// particles added directly to the positions array get a unit mass
+	const ndInt32 particleCount = ndInt32(m_posit.GetCount());
+	ndAssert(m_veloc.GetCount() == particleCount);
+	while (m_invMass.GetCount() < particleCount)
+	{
+		m_invMass.PushBack(ndFloat32(1.0f));
+	}
+	data.m_positBase.SetCount(particleCount);
+
+	BuildBatches();
+	const ndFloat32 timestep = m_timestep / ndFloat32(m_subSteps);
+	for (ndInt32 step = 0; step < m_subSteps; ++step)
+	{
+		PredictPositions(threadPool);
+		for (ndInt32 i = 0; i < m_solverIterations; ++i)
+		{
+			SolveSprings(threadPool, timestep);
+			SolveTetrahedra(threadPool, timestep);
+		}
+		CollideBodies(threadPool, step);
+		UpdateVelocities(threadPool);
+	}
+	CalculateAabb(threadPool);
+}
@@ -0,0 +1,166 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef __ND_BODY_SOFT_BODY_H__
+#define __ND_BODY_SOFT_BODY_H__
+
+#include "ndCollisionStdafx.h"
+#include "ndBodyParticleSet.h"
+
+// cloth and soft bodies made of particles linked by springs and tetrahedra,
+// solved with extended position based dynamics (xpbd).
+// the constraints are split in batches that do not share particles,
+// so each batch is solved in parallel.
+// the particles are never reordered, since the constraints index them.
+D_MSV_NEWTON_ALIGN_32
+class ndBodySoftBody: public ndBodyParticleSet
+{
+	public:
+	D_COLLISION_API ndBodySoftBody();
+	D_COLLISION_API virtual ~ndBodySoftBody ();
+
+	// a zero mass particle is pinned in place
+	D_COLLISION_API ndInt32 AddParticle(const ndVector& posit, ndFloat32 mass);
+	D_COLLISION_API void SetParticleMass(ndInt32 index, ndFloat32 mass);
+
+	// the compliance is the inverse of the stiffness, as in xpbd,
+	// so a zero compliance makes the constraint rigid.
+	// the damping only acts along the spring, and not on rigid springs.
+	D_COLLISION_API void AddSpring(ndInt32 i0, ndInt32 i1, ndFloat32 compliance, ndFloat32 damping);
+	D_COLLISION_API void AddTetrahedron(ndInt32 i0, ndInt32 i1, ndInt32 i2, ndInt32 i3, ndFloat32 compliance);
+
+	D_COLLISION_API ndInt32 GetSpringCount() const;
+	D_COLLISION_API ndInt32 GetTetrahedronCount() const;
+
+	// number of constraint batches solved one after the other
+	D_COLLISION_API ndInt32 GetBatchCount();
+
+	ndInt32 GetSolverIterations() const;
+	void SetSolverIterations(ndInt32 iterations);
+
+	ndInt32 GetSubSteps() const;
+	void SetSubSteps(ndInt32 subSteps);
+
+	ndFloat32 GetDamping() const;
+	void SetDamping(ndFloat32 damping);
+
+	ndFloat32 GetFriction() const;
+	void SetFriction(ndFloat32 friction);
+
+	bool GetBodyCollision() const;
+	void SetBodyCollision(bool state);
+
+	virtual ndBodySoftBody* GetAsBodySoftBody();
+	D_COLLISION_API void Execute(ndThreadPool* const threadPool);
+
+	protected:
+	D_COLLISION_API virtual void Update(const ndScene* const scene, ndFloat32 timestep);
+	D_COLLISION_API virtual void SyncUpdate(const ndScene* const scene);
+	virtual bool RayCast(ndRayCastNotify& callback, const ndFastRay& ray, const ndFloat32 maxT) const;
+
+	private:
+	class ndSpring;
+	class ndCollider;
+	class ndTetrahedron;
+	class ndWorkingBuffers;
+
+	void BuildBatches();
+	void CalculateAabb(ndThreadPool* const threadPool);
+	void PredictPositions(ndThreadPool* const threadPool);
+	void UpdateVelocities(ndThreadPool* const threadPool);
+	void SolveSprings(ndThreadPool* const threadPool, ndFloat32 timestep);
+	void SolveTetrahedra(ndThreadPool* const threadPool, ndFloat32 timestep);
+
+	void ApplyBodyImpulses();
+	void CollectBodies(const ndScene* const scene);
+	void CollideBodies(ndThreadPool* const threadPool, ndInt32 subStep);
+
+	ndArray<ndFloat32> m_invMass;
+	ndWorkingBuffers* m_workingBuffers;
+	ndFloat32 m_damping;
+	ndFloat32 m_friction;
+	ndInt32 m_solverIterations;
+	ndInt32 m_subSteps;
+	bool m_bodyCollision;
+	bool m_batchesDirty;
+} D_GCC_NEWTON_ALIGN_32 ;
+
+inline ndBodySoftBody* ndBodySoftBody::GetAsBodySoftBody()
+{
+	return this;
+}
+
+inline bool ndBodySoftBody::RayCast(ndRayCastNotify&, const ndFastRay&, const ndFloat32) const
+{
+	return false;
+}
+
+inline ndInt32 ndBodySoftBody::GetSolverIterations() const
+{
+	return m_solverIterations;
+}
+
+inline void ndBodySoftBody::SetSolverIterations(ndInt32 iterations)
+{
+	m_solverIterations = ndClamp(iterations, 1, 32);
+}
+
+inline ndInt32 ndBodySoftBody::GetSubSteps() const
+{
+	return m_subSteps;
+}
+
+inline void ndBodySoftBody::SetSubSteps(ndInt32 subSteps)
+{
+	m_subSteps = ndClamp(subSteps, 1, 32);
+}
+
+inline ndFloat32 ndBodySoftBody::GetDamping() const
+{
+	return m_damping;
+}
+
+inline void ndBodySoftBody::SetDamping(ndFloat32 damping)
+{
+	m_damping = ndMax(damping, ndFloat32(0.0f));
+}
+
+inline ndFloat32 ndBodySoftBody::GetFriction() const
+{
+	return m_friction;
+}
+
+inline void ndBodySoftBody::SetFriction(ndFloat32 friction)
+{
+	m_friction = ndClamp(friction, ndFloat32(0.0f), ndFloat32(1.0f));
+}
+
+inline bool ndBodySoftBody::GetBodyCollision() const
+{
+	return m_bodyCollision;
+}
+
+inline void ndBodySoftBody::SetBodyCollision(bool state)
+{
+	m_bodyCollision = state;
+}
+
+#endif
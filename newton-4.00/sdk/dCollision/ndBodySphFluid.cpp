@@ -34,6 +34,9 @@
 
 #define D_PARTICLE_BUCKET_SIZE		32
 #define D_GRID_SIZE_SCALER			(1.0f)
+#define D_SPH_FLOOR_ELEVATION		ndFloat32(1.0f)
+#define D_SPH_PBF_RELAXATION		ndFloat32(1.0f)
+#define D_SPH_BOUNDARY_SKIN			ndFloat32(0.05f)
 
 #if 0
 
@@ -1307,10 +1310,47 @@ class ndBodySphFluid::ndParticlePair
 	ndInt32 m_neighborg[D_PARTICLE_BUCKET_SIZE];
 };
 
-class ndBodySphFluid::ndParticleKernelDistance
+// the sorted particle ranges of the up to nine cell columns around a cell 
+class ndBodySphFluid::ndCellRange
 {
 	public:
-	ndFloat32 m_dist[D_PARTICLE_BUCKET_SIZE];
+	ndInt32 m_start[9];
+	ndInt32 m_end[9];
+	ndInt32 m_count;
+};
+
+// cell keys have the cell index in the high word and the particle in the low word.
+template <ndInt32 shift>
+class ndSphCellKeyDigit
+{
+	public:
+	ndSphCellKeyDigit(void* const)
+	{
+	}
+
+	ndInt32 GetKey(const ndUnsigned64 key) const
+	{
+		return ndInt32((key >> (32 + shift)) & 0xff);
+	}
+};
+
+class ndBodySphFluid::ndBoundaryBody
+{
+	public:
+	ndMatrix m_matrix;
+	ndMatrix m_shapeMatrix;
+	ndVector m_veloc;
+	ndVector m_omega;
+	ndVector m_accel;
+	ndVector m_stepVeloc;
+	ndVector m_com;
+	ndVector m_localCom;
+	ndVector m_box0;
+	ndVector m_box1;
+	ndVector m_impulse;
+	ndVector m_angularImpulse;
+	ndBodyKinematic* m_body;
+	const ndShapeInstance* m_shape;
 };
 
 class ndBodySphFluid::ndWorkingBuffers
@@ -1328,12 +1368,27 @@ class ndBodySphFluid::ndWorkingBuffers
 		, m_pairs(D_SPH_BUFFER_GRANULARITY)
 		, m_hashGridMap(D_SPH_BUFFER_GRANULARITY)
 		, m_hashGridMapScratchBuffer(D_SPH_BUFFER_GRANULARITY)
-		, m_kernelDistance(D_SPH_BUFFER_GRANULARITY)
+		, m_cellKeys(D_SPH_BUFFER_GRANULARITY)
+		, m_cellKeysScratch(D_SPH_BUFFER_GRANULARITY)
+		, m_cellStart(D_SPH_BUFFER_GRANULARITY)
+		, m_columnStart(D_SPH_BUFFER_GRANULARITY)
+		, m_particleCell(D_SPH_BUFFER_GRANULARITY)
+		, m_cellRanges(D_SPH_BUFFER_GRANULARITY)
+		, m_neighborStart(D_SPH_BUFFER_GRANULARITY)
+		, m_neighbors(D_SPH_BUFFER_GRANULARITY)
+		, m_lambda(D_SPH_BUFFER_GRANULARITY)
+		, m_positBase(D_SPH_BUFFER_GRANULARITY)
+		, m_deltaPosit(D_SPH_BUFFER_GRANULARITY)
+		, m_boundaryBodies(64)
+		, m_boundaryImpulses(256)
+		, m_boundaryGrid()
+		, m_boundaryReferences()
 		, m_worlToGridOrigin(ndFloat32(1.0f))
 		, m_worlToGridScale(ndFloat32(1.0f))
 		, m_hashGridSize(ndFloat32(0.0f))
 		, m_hashInvGridSize(ndFloat32(0.0f))
 		, m_particleDiameter(ndFloat32(0.0f))
+		, m_cellSearch(false)
 	{
 		for (ndInt32 i = 0; i < D_MAX_THREADS_COUNT; ++i)
 		{
@@ -1369,6 +1424,56 @@ class ndBodySphFluid::ndWorkingBuffers
 		return val;
 	}
 
+	// calls visitor(i1) for the particles of the cell list within a kernel radius of particle i0 
+	template <class ndVisitor>
+	void ForEachCellNeighbor(ndInt32 i0, const ndArray<ndVector>& posit, ndVisitor& visitor) const
+	{
+		const ndVector p0(posit[i0]);
+		const ndFloat32 h2 = m_particleDiameter * m_particleDiameter;
+		const ndCellRange& range = m_cellRanges[m_particleCell[i0]];
+		for (ndInt32 i = 0; i < range.m_count; ++i)
+		{
+			// the particles are stored in cell order, the ranges are particle indices
+			const ndInt32 end = range.m_end[i];
+			for (ndInt32 i1 = range.m_start[i]; i1 < end; ++i1)
+			{
+				const ndVector p10(p0 - posit[i1]);
+				if ((i1 != i0) && (p10.DotProduct(p10).GetScalar() <= h2))
+				{
+					visitor(i1);
+				}
+			}
+		}
+	}
+
+	// calls visitor(i1) for the neighbors of particle i0 
+	template <class ndVisitor>
+	void ForEachNeighbor(ndInt32 i0, const ndArray<ndVector>& posit, ndVisitor& visitor) const
+	{
+		if (m_neighborStart.GetCount())
+		{
+			// the cell list neighbors collected once for all the solver iterations
+			const ndInt32 end = m_neighborStart[i0 + 1];
+			for (ndInt32 j = m_neighborStart[i0]; j < end; ++j)
+			{
+				visitor(m_neighbors[j]);
+			}
+		}
+		else if (m_cellSearch)
+		{
+			ForEachCellNeighbor(i0, posit, visitor);
+		}
+		else
+		{
+			const ndParticlePair& pairs = m_pairs[i0];
+			const ndInt32 count = m_pairCount[i0];
+			for (ndInt32 j = 0; j < count; ++j)
+			{
+				visitor(pairs.m_neighborg[j]);
+			}
+		}
+	}
+
 	ndArray<ndVector> m_accel;
 	ndArray<ndSpinLock> m_locks;
 	ndArray<ndInt8> m_pairCount;
@@ -1378,13 +1483,28 @@ class ndBodySphFluid::ndWorkingBuffers
 	ndArray<ndParticlePair> m_pairs;
 	ndArray<ndGridHash> m_hashGridMap;
 	ndArray<ndGridHash> m_hashGridMapScratchBuffer;
-	ndArray<ndParticleKernelDistance> m_kernelDistance;
+	ndArray<ndUnsigned64> m_cellKeys;
+	ndArray<ndUnsigned64> m_cellKeysScratch;
+	ndArray<ndInt32> m_cellStart;
+	ndArray<ndInt32> m_columnStart;
+	ndArray<ndInt32> m_particleCell;
+	ndArray<ndCellRange> m_cellRanges;
+	ndArray<ndInt32> m_neighborStart;
+	ndArray<ndInt32> m_neighbors;
+	ndArray<ndFloat32> m_lambda;
+	ndArray<ndVector> m_positBase;
+	ndArray<ndVector> m_deltaPosit;
+	ndArray<ndBoundaryBody> m_boundaryBodies;
+	ndArray<ndVector> m_boundaryImpulses;
+	ndBodyGrid m_boundaryGrid;
+	ndList<ndSharedPtr<ndBody>> m_boundaryReferences;
 	ndArray<ndInt32> m_partialsGridScans[D_MAX_THREADS_COUNT];
 	ndFloat32 m_worlToGridOrigin;
 	ndFloat32 m_worlToGridScale;
 	ndFloat32 m_hashGridSize;
 	ndFloat32 m_hashInvGridSize;
 	ndFloat32 m_particleDiameter;
+	bool m_cellSearch;
 };
 
 ndBodySphFluid::ndBodySphFluid()
@@ -1394,6 +1514,11 @@ ndBodySphFluid::ndBodySphFluid()
 	,m_viscosity(ndFloat32(1.05f))
 	,m_restDensity(ndFloat32(1000.0f))
 	,m_gasConstant(ndFloat32(1.0f))
+	,m_solverMode(m_explicitPressure)
+	,m_solverIterations(4)
+	,m_subSteps(1)
+	,m_neighborSearch(m_pairList)
+	,m_bodyCoupling(false)
 {
 	SetRestDensity(m_restDensity);
 }
@@ -1716,7 +1841,6 @@ void ndBodySphFluid::BuildBuckets(ndThreadPool* const threadPool)
 	data.m_pairs.SetCount(m_posit.GetCount());
 	data.m_locks.SetCount(m_posit.GetCount());
 	data.m_pairCount.SetCount(m_posit.GetCount());
-	data.m_kernelDistance.SetCount(m_posit.GetCount());
 	for (ndInt32 i = countReset; i < data.m_locks.GetCount(); ++i)
 	{
 		data.m_locks[i].Unlock();
@@ -1739,9 +1863,8 @@ void ndBodySphFluid::BuildBuckets(ndThreadPool* const threadPool)
 		ndArray<ndSpinLock>& locks = data.m_locks;
 		ndArray<ndInt8>& pairCount = data.m_pairCount;
 		ndArray<ndParticlePair>& pair = data.m_pairs;
-		ndArray<ndParticleKernelDistance>& distance = data.m_kernelDistance;
 
-		auto ProccessCell = [this, &data, &hashGridMap, &pair, &pairCount, &locks, &distance, windowsTest, diameter2](ndInt32 start, ndInt32 count)
+		auto ProccessCell = [this, &data, &hashGridMap, &pair, &pairCount, &locks, windowsTest, diameter2](ndInt32 start, ndInt32 count)
 		{
 			const ndInt32 count0 = count - 1;
 			for (ndInt32 i = 0; i < count0; ++i)
@@ -1770,7 +1893,6 @@ void ndBodySphFluid::BuildBuckets(ndThreadPool* const threadPool)
 						const ndFloat32 dist2(p1p0.DotProduct(p1p0).GetScalar());
 						if (dist2 <= diameter2)
 						{
-							const ndFloat32 dist = ndSqrt(ndMax(dist2, ndFloat32(1.0e-8f)));
 							{
 								ndSpinLock lock(locks[particle0]);
 								ndInt8 neigborCount = pairCount[particle0];
@@ -1785,7 +1907,6 @@ void ndBodySphFluid::BuildBuckets(ndThreadPool* const threadPool)
 									//ndAssert(isUnique);
 
 									neighborg[neigborCount] = particle1;
-									distance[particle0].m_dist[neigborCount] = dist;
 									pairCount[particle0] = neigborCount + isUnique;
 								}
 							}
@@ -1804,7 +1925,6 @@ void ndBodySphFluid::BuildBuckets(ndThreadPool* const threadPool)
 									//ndAssert(isUnique);
 
 									neighborg[neigborCount] = particle0;
-									distance[particle1].m_dist[neigborCount] = dist;
 									pairCount[particle1] = neigborCount + isUnique;
 								}
 							}
@@ -1835,9 +1955,8 @@ void ndBodySphFluid::BuildBuckets(ndThreadPool* const threadPool)
 		ndArray<ndSpinLock>& locks = data.m_locks;
 		ndArray<ndInt8>& pairCount = data.m_pairCount;
 		ndArray<ndParticlePair>& pair = data.m_pairs;
-		ndArray<ndParticleKernelDistance>& distance = data.m_kernelDistance;
 
-		auto ProccessCell = [this, &data, &hashGridMap, &pair, &pairCount, &locks, &distance, windowsTest, diameter2](ndInt32 start, ndInt32 count)
+		auto ProccessCell = [this, &data, &hashGridMap, &pair, &pairCount, &locks, windowsTest, diameter2](ndInt32 start, ndInt32 count)
 		{
 			const ndInt32 count0 = count - 1;
 			for (ndInt32 i = 0; i < count0; ++i)
@@ -1866,11 +1985,9 @@ void ndBodySphFluid::BuildBuckets(ndThreadPool* const threadPool)
 						if (homeGridTest0 && homeGridTest1)
 						{
 							ndInt8 neigborCount0 = pairCount[particle0];
-							const ndFloat32 dist = ndSqrt(ndMax(dist2, ndFloat32(1.0e-8f)));
 							if (neigborCount0 < D_PARTICLE_BUCKET_SIZE)
 							{
 								pair[particle0].m_neighborg[neigborCount0] = particle1;
-								distance[particle0].m_dist[neigborCount0] = dist;
 								pairCount[particle0] = neigborCount0 + 1;
 							}
 
@@ -1878,7 +1995,6 @@ void ndBodySphFluid::BuildBuckets(ndThreadPool* const threadPool)
 							if (neigborCount1 < D_PARTICLE_BUCKET_SIZE)
 							{
 								pair[particle1].m_neighborg[neigborCount1] = particle0;
-								distance[particle1].m_dist[neigborCount1] = dist;
 								pairCount[particle1] = neigborCount1 + 1;
 							}
 
@@ -1887,11 +2003,9 @@ void ndBodySphFluid::BuildBuckets(ndThreadPool* const threadPool)
 						{
 							ndAssert(!homeGridTest1);
 							ndInt8 neigborCount0 = pairCount[particle0];
-							const ndFloat32 dist = ndSqrt(ndMax(dist2, ndFloat32(1.0e-8f)));
 							if (neigborCount0 < D_PARTICLE_BUCKET_SIZE)
 							{
 								pair[particle0].m_neighborg[neigborCount0] = particle1;
-								distance[particle0].m_dist[neigborCount0] = dist;
 								pairCount[particle0] = neigborCount0 + 1;
 							}
 						}
@@ -1899,11 +2013,9 @@ void ndBodySphFluid::BuildBuckets(ndThreadPool* const threadPool)
 						{
 							ndAssert(!homeGridTest0);
 							ndInt8 neigborCount1 = pairCount[particle1];
-							const ndFloat32 dist = ndSqrt(ndMax(dist2, ndFloat32(1.0e-8f)));
 							if (neigborCount1 < D_PARTICLE_BUCKET_SIZE)
 							{
 								pair[particle1].m_neighborg[neigborCount1] = particle0;
-								distance[particle1].m_dist[neigborCount1] = dist;
 								pairCount[particle1] = neigborCount1 + 1;
 							}
 						}
@@ -1937,6 +2049,305 @@ void ndBodySphFluid::BuildBuckets(ndThreadPool* const threadPool)
 	//threadPool->ParallelExecute(AddPairs_new);
 }
 
+void ndBodySphFluid::BuildCellList(ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+	ndWorkingBuffers& data = *m_workingBuffers;
+
+	// cells are one kernel radius wide, unless the fluid spreads so far 
+	// that the cell index does not fit in 32 bits or the column table gets too big.
+	const ndVector size(m_box1 - m_box0);
+	ndFloat32 cellSize = data.m_particleDiameter;
+	ndVector dim((size.Scale(ndFloat32(1.0f) / cellSize)).Floor() + ndVector::m_one);
+	while (((dim.m_x * dim.m_y * dim.m_z) >= ndFloat32(4.0e9f)) || ((dim.m_x * dim.m_z) > ndFloat32(1 << 22)))
+	{
+		cellSize *= ndFloat32(2.0f);
+		dim = (size.Scale(ndFloat32(1.0f) / cellSize)).Floor() + ndVector::m_one;
+	}
+	const ndInt32 dimX = ndInt32(dim.m_x);
+	const ndInt32 dimY = ndInt32(dim.m_y);
+	const ndInt32 dimZ = ndInt32(dim.m_z);
+	const ndUnsigned32 maxCell = ndUnsigned32(dimX) * ndUnsigned32(dimY) * ndUnsigned32(dimZ) - 1;
+
+	auto CalculateKeys = ndMakeObject::ndFunction([this, &data, &dim, cellSize, dimX, dimY](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateKeys);
+		const ndVector origin(m_box0);
+		const ndVector invCellSize(ndFloat32(1.0f) / cellSize);
+		const ndVector maxIndex(dim - ndVector::m_one);
+
+		const ndStartEnd startEnd(m_posit.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndVector cell(((m_posit[i] - origin) * invCellSize).Floor().GetMax(ndVector::m_zero).GetMin(maxIndex).GetInt());
+			const ndUnsigned32 index = (ndUnsigned32(cell.m_iz) * ndUnsigned32(dimX) + ndUnsigned32(cell.m_ix)) * ndUnsigned32(dimY) + ndUnsigned32(cell.m_iy);
+			data.m_cellKeys[i] = (ndUnsigned64(index) << 32) | ndUnsigned64(i);
+		}
+	});
+
+	// the y index goes last, so the three cells of a column are a contiguous run of the sorted keys
+	auto BuildRanges = ndMakeObject::ndFunction([&data, dimX, dimY, dimZ](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(BuildRanges);
+		const ndArray<ndUnsigned64>& keys = data.m_cellKeys;
+		const ndArray<ndInt32>& cellStart = data.m_cellStart;
+		const ndArray<ndInt32>& columnStart = data.m_columnStart;
+		const ndInt32 cellCount = cellStart.GetCount() - 1;
+
+		// first key in [i0, i1) with a cell index not smaller than cell
+		auto LowerBound = [&keys](ndInt32 i0, ndInt32 i1, ndUnsigned32 cell)
+		{
+			while (i0 < i1)
+			{
+				const ndInt32 mid = (i0 + i1) >> 1;
+				if (ndUnsigned32(keys[mid] >> 32) < cell)
+				{
+					i0 = mid + 1;
+				}
+				else
+				{
+					i1 = mid;
+				}
+			}
+			return i0;
+		};
+
+		const ndStartEnd startEnd(cellCount, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndUnsigned32 cell = ndUnsigned32(keys[cellStart[i]] >> 32);
+			const ndInt32 y = ndInt32(cell % ndUnsigned32(dimY));
+			const ndInt32 x = ndInt32((cell / ndUnsigned32(dimY)) % ndUnsigned32(dimX));
+			const ndInt32 z = ndInt32(cell / (ndUnsigned32(dimY) * ndUnsigned32(dimX)));
+			const ndUnsigned32 y0 = ndUnsigned32(ndMax(y - 1, 0));
+			const ndUnsigned32 y1 = ndUnsigned32(ndMin(y + 1, dimY - 1));
+
+			ndCellRange& range = data.m_cellRanges[i];
+			range.m_count = 0;
+			for (ndInt32 z1 = ndMax(z - 1, 0); z1 <= ndMin(z + 1, dimZ - 1); ++z1)
+			{
+				for (ndInt32 x1 = ndMax(x - 1, 0); x1 <= ndMin(x + 1, dimX - 1); ++x1)
+				{
+					const ndInt32 column = z1 * dimX + x1;
+					const ndInt32 columnEnd = columnStart[column + 1];
+					const ndUnsigned32 columnCell = ndUnsigned32(column) * ndUnsigned32(dimY);
+					const ndInt32 start = LowerBound(columnStart[column], columnEnd, columnCell + y0);
+					const ndInt32 end = LowerBound(start, columnEnd, columnCell + y1 + 1);
+					if (start < end)
+					{
+						range.m_start[range.m_count] = start;
+						range.m_end[range.m_count] = end;
+						range.m_count++;
+					}
+				}
+			}
+
+			for (ndInt32 j = cellStart[i]; j < cellStart[i + 1]; ++j)
+			{
+				data.m_particleCell[j] = i;
+			}
+		}
+	});
+
+	// the pair list buffers are not used
+	data.m_pairs.SetCount(0);
+	data.m_locks.SetCount(0);
+	data.m_pairCount.SetCount(0);
+	data.m_gridScans.SetCount(0);
+	data.m_hashGridMap.SetCount(0);
+	data.m_hashGridMapScratchBuffer.SetCount(0);
+	for (ndInt32 i = 0; i < D_MAX_THREADS_COUNT; ++i)
+	{
+		data.m_partialsGridScans[i].SetCount(0);
+	}
+
+	data.m_cellKeys.SetCount(m_posit.GetCount());
+	threadPool->ParallelExecute(CalculateKeys);
+
+	ndCountingSort<ndUnsigned64, ndSphCellKeyDigit<0>, 8>(*threadPool, data.m_cellKeys, data.m_cellKeysScratch, nullptr, nullptr);
+	if (maxCell >= (1 << 8))
+	{
+		ndCountingSort<ndUnsigned64, ndSphCellKeyDigit<8>, 8>(*threadPool, data.m_cellKeys, data.m_cellKeysScratch, nullptr, nullptr);
+	}
+	if (maxCell >= (1 << 16))
+	{
+		ndCountingSort<ndUnsigned64, ndSphCellKeyDigit<16>, 8>(*threadPool, data.m_cellKeys, data.m_cellKeysScratch, nullptr, nullptr);
+	}
+	if (maxCell >= (1 << 24))
+	{
+		ndCountingSort<ndUnsigned64, ndSphCellKeyDigit<24>, 8>(*threadPool, data.m_cellKeys, data.m_cellKeysScratch, nullptr, nullptr);
+	}
+
+	// start of each occupied cell, and of every column of the x z grid
+	const ndArray<ndUnsigned64>& keys = data.m_cellKeys;
+	const ndInt32 columnCount = dimX * dimZ;
+	data.m_cellStart.SetCount(0);
+	data.m_columnStart.SetCount(columnCount + 1);
+	ndInt32* const columnStart = &data.m_columnStart[0];
+
+	ndInt32 column0 = -1;
+	ndUnsigned32 cell0 = ndUnsigned32(-1);
+	for (ndInt32 i = 0; i < keys.GetCount(); ++i)
+	{
+		const ndUnsigned32 cell1 = ndUnsigned32(keys[i] >> 32);
+		if (cell1 != cell0)
+		{
+			data.m_cellStart.PushBack(i);
+			const ndInt32 column1 = ndInt32(cell1 / ndUnsigned32(dimY));
+			for (ndInt32 j = column0 + 1; j <= column1; ++j)
+			{
+				columnStart[j] = i;
+			}
+			column0 = column1;
+			cell0 = cell1;
+		}
+	}
+	data.m_cellStart.PushBack(keys.GetCount());
+	for (ndInt32 j = column0 + 1; j <= columnCount; ++j)
+	{
+		columnStart[j] = keys.GetCount();
+	}
+
+	// move the particle state to cell order, so the neighbor loops read contiguous memory.
+	auto GatherParticles = [this, &data, threadPool](ndArray<ndVector>& array)
+	{
+		auto Gather = ndMakeObject::ndFunction([this, &data, &array](ndInt32 threadIndex, ndInt32 threadCount)
+		{
+			D_TRACKTIME_NAMED(GatherParticles);
+			const ndStartEnd startEnd(array.GetCount(), threadIndex, threadCount);
+			for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+			{
+				m_reorderBuffer[i] = array[ndInt32(data.m_cellKeys[i] & 0xffffffff)];
+			}
+		});
+		m_reorderBuffer.SetCount(array.GetCount());
+		threadPool->ParallelExecute(Gather);
+		array.Swap(m_reorderBuffer);
+	};
+	GatherParticles(m_posit);
+	GatherParticles(m_veloc);
+	if (m_solverMode == m_positionBased)
+	{
+		// only the position based solver sets the base positions before the neighbor search
+		GatherParticles(data.m_positBase);
+	}
+
+	data.m_particleCell.SetCount(m_posit.GetCount());
+	data.m_cellRanges.SetCount(data.m_cellStart.GetCount() - 1);
+	threadPool->ParallelExecute(BuildRanges);
+}
+
+void ndBodySphFluid::BuildNeighborList(ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+	ndWorkingBuffers& data = *m_workingBuffers;
+
+	// the position based iterations visit the same neighbors several times, 
+	// so the cell list is scanned once and the neighbors go to a compact list.
+	auto CountNeighbors = ndMakeObject::ndFunction([this, &data](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CountNeighbors);
+		const ndStartEnd startEnd(m_posit.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i0 = startEnd.m_start; i0 < startEnd.m_end; ++i0)
+		{
+			ndInt32 count = 0;
+			auto AddCount = [&count](ndInt32)
+			{
+				count++;
+			};
+			data.ForEachCellNeighbor(i0, m_posit, AddCount);
+			data.m_neighborStart[i0 + 1] = count;
+		}
+	});
+
+	auto CollectNeighbors = ndMakeObject::ndFunction([this, &data](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CollectNeighbors);
+		const ndStartEnd startEnd(m_posit.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i0 = startEnd.m_start; i0 < startEnd.m_end; ++i0)
+		{
+			ndInt32* const neighbors = &data.m_neighbors[data.m_neighborStart[i0]];
+			ndInt32 count = 0;
+			auto AddNeighbor = [neighbors, &count](ndInt32 i1)
+			{
+				neighbors[count] = i1;
+				count++;
+			};
+			data.ForEachCellNeighbor(i0, m_posit, AddNeighbor);
+		}
+	});
+
+	data.m_neighborStart.SetCount(m_posit.GetCount() + 1);
+	data.m_neighborStart[0] = 0;
+	threadPool->ParallelExecute(CountNeighbors);
+
+	ndInt32 sum = 0;
+	for (ndInt32 i = 0; i < data.m_neighborStart.GetCount(); ++i)
+	{
+		sum += data.m_neighborStart[i];
+		data.m_neighborStart[i] = sum;
+	}
+	data.m_neighbors.SetCount(sum);
+	threadPool->ParallelExecute(CollectNeighbors);
+}
+
+void ndBodySphFluid::RestoreParticleOrder(ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+	ndWorkingBuffers& data = *m_workingBuffers;
+
+	// the cell list moved the particles to cell order, 
+	// move them back so the application sees the same particle indices.
+	auto ScatterParticles = [this, &data, threadPool](ndArray<ndVector>& array)
+	{
+		auto Scatter = ndMakeObject::ndFunction([this, &data, &array](ndInt32 threadIndex, ndInt32 threadCount)
+		{
+			D_TRACKTIME_NAMED(ScatterParticles);
+			const ndStartEnd startEnd(array.GetCount(), threadIndex, threadCount);
+			for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+			{
+				m_reorderBuffer[ndInt32(data.m_cellKeys[i] & 0xffffffff)] = array[i];
+			}
+		});
+		m_reorderBuffer.SetCount(array.GetCount());
+		threadPool->ParallelExecute(Scatter);
+		array.Swap(m_reorderBuffer);
+	};
+	ScatterParticles(m_posit);
+	ScatterParticles(m_veloc);
+}
+
+ndUnsigned64 ndBodySphFluid::GetWorkingMemory() const
+{
+	const ndWorkingBuffers& data = *m_workingBuffers;
+	ndUnsigned64 bytes = 0;
+	bytes += ndUnsigned64(data.m_accel.GetCount()) * sizeof(ndVector);
+	bytes += ndUnsigned64(data.m_locks.GetCount()) * sizeof(ndSpinLock);
+	bytes += ndUnsigned64(data.m_pairCount.GetCount()) * sizeof(ndInt8);
+	bytes += ndUnsigned64(data.m_gridScans.GetCount()) * sizeof(ndInt32);
+	bytes += ndUnsigned64(data.m_density.GetCount()) * sizeof(ndFloat32);
+	bytes += ndUnsigned64(data.m_invDensity.GetCount()) * sizeof(ndFloat32);
+	bytes += ndUnsigned64(data.m_pairs.GetCount()) * sizeof(ndParticlePair);
+	bytes += ndUnsigned64(data.m_hashGridMap.GetCount()) * sizeof(ndGridHash);
+	bytes += ndUnsigned64(data.m_hashGridMapScratchBuffer.GetCount()) * sizeof(ndGridHash);
+	bytes += ndUnsigned64(data.m_cellKeys.GetCount()) * sizeof(ndUnsigned64);
+	bytes += ndUnsigned64(data.m_cellKeysScratch.GetCount()) * sizeof(ndUnsigned64);
+	bytes += ndUnsigned64(data.m_cellStart.GetCount()) * sizeof(ndInt32);
+	bytes += ndUnsigned64(data.m_columnStart.GetCount()) * sizeof(ndInt32);
+	bytes += ndUnsigned64(data.m_particleCell.GetCount()) * sizeof(ndInt32);
+	bytes += ndUnsigned64(data.m_cellRanges.GetCount()) * sizeof(ndCellRange);
+	bytes += ndUnsigned64(data.m_neighborStart.GetCount()) * sizeof(ndInt32);
+	bytes += ndUnsigned64(data.m_neighbors.GetCount()) * sizeof(ndInt32);
+	bytes += ndUnsigned64(data.m_lambda.GetCount()) * sizeof(ndFloat32);
+	bytes += ndUnsigned64(data.m_positBase.GetCount()) * sizeof(ndVector);
+	bytes += ndUnsigned64(data.m_deltaPosit.GetCount()) * sizeof(ndVector);
+	for (ndInt32 i = 0; i < D_MAX_THREADS_COUNT; ++i)
+	{
+		bytes += ndUnsigned64(data.m_partialsGridScans[i].GetCount()) * sizeof(ndInt32);
+	}
+	return bytes;
+}
+
 void ndBodySphFluid::CalculateParticlesDensity(ndThreadPool* const threadPool)
 {
 	D_TRACKTIME();
@@ -1959,19 +2370,18 @@ void ndBodySphFluid::CalculateParticlesDensity(ndThreadPool* const threadPool)
 		const ndStartEnd startEnd(posit.GetCount(), threadIndex, threadCount);
 		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
 		{
-			const ndInt32 count = data.m_pairCount[i];
-			const ndParticleKernelDistance& distance = data.m_kernelDistance[i];
+			const ndVector p0(posit[i]);
 			//ndFloat32 density = selfDensity;
 			ndFloat32 volume = selfVolume;
-			for (ndInt32 j = 0; j < count; ++j)
+			auto AddDensity = [&posit, &p0, &volume, h2](ndInt32 i1)
 			{
-				const ndFloat32 dist = distance.m_dist[j];
-				const ndFloat32 dist2 = h2 - dist * dist;
-				ndAssert(dist2 >= ndFloat32(0.0f));
+				const ndVector p10(p0 - posit[i1]);
+				const ndFloat32 dist2 = ndMax(h2 - p10.DotProduct(p10).GetScalar(), ndFloat32(0.0f));
 				const ndFloat32 dist6 = dist2 * dist2 * dist2;
 				//density += kernelConst * dist6;
 				volume += dist6;
-			}
+			};
+			data.ForEachNeighbor(i, posit, AddDensity);
 			//density = kernelConst * density;
 			ndFloat32 density = kernelMassConst * volume;
 			data.m_density[i] = density;
@@ -2000,46 +2410,41 @@ void ndBodySphFluid::CalculateAccelerations(ndThreadPool* const threadPool)
 
 		//const ndFloat32 u = m_viscosity;
 		const ndFloat32 h = data.m_particleDiameter;
-		const ndVector kernelConst(ndFloat32(45.0f) / (ndPi * ndPow(h, ndFloat32 (6.0f))));
 
 		//const ndFloat32 viscosity = m_viscosity;
 		const ndFloat32 restDensity = m_restDensity;
 		const ndFloat32 gasConstant = m_gasConstant;
 
-		//const ndVector gravity(m_gravity);
-		const ndVector gravity(ndVector::m_zero);
+		// the legacy explicit solver has no gravity and no kernel or density scale
+		const bool weaklyCompressible = (m_solverMode == m_weaklyCompressible);
+		const ndVector gravity(weaklyCompressible ? m_gravity : ndVector::m_zero);
+		const ndVector kernelConst(weaklyCompressible ? ndFloat32(45.0f) / (ndPi * ndPow(h, ndFloat32(6.0f))) : ndFloat32(1.0f));
+
 		const ndStartEnd startEnd(posit.GetCount(), threadIndex, threadCount);
 		for (ndInt32 i0 = startEnd.m_start; i0 < startEnd.m_end; ++i0)
 		{
 			const ndVector p0(posit[i0]);
 			const ndVector v0(veloc[i0]);
 			ndVector forceAcc(ndVector::m_zero);
-			
-			const ndParticlePair& pairs = data.m_pairs[i0];
-			ndParticleKernelDistance& distance = data.m_kernelDistance[i0];
 			const ndFloat32 pressureI0 = gasConstant * (density[i0] - restDensity);
 
-			const ndInt32 count = data.m_pairCount[i0];
-			for (ndInt32 j = 0; j < count; ++j)
+			auto AddForce = [this, &posit, &p0, &forceAcc, &epsilon2, &kernelConst, density, invDensity, h, pressureI0, restDensity, gasConstant](ndInt32 i1)
 			{
-				const ndInt32 i1 = pairs.m_neighborg[j];
 				const ndVector p10(p0 - posit[i1]);
 				//const ndVector p10(posit[i1] - p0);
 				const ndVector dot(p10.DotProduct(p10) + epsilon2);
-				const ndVector unitDir(p10 * dot.InvSqrt());
-			
+				const ndVector invDist(dot.InvSqrt());
+				const ndVector unitDir(p10 * invDist);
 				ndAssert(p10.m_w == ndFloat32(0.0f));
-				ndAssert(ndAbs(ndSqrt (dot.GetScalar()) - distance.m_dist[j]) < ndFloat32(1.0e-4f));
 			
 				// kernel distance
-				const ndFloat32 dist = h - distance.m_dist[j];
-				ndAssert(dist >= ndFloat32(0.0f));
+				const ndFloat32 dist = ndMax(h - dot.GetScalar() * invDist.GetScalar(), ndFloat32(0.0f));
 				const ndFloat32 kernelValue = dist * dist;
 			
 				// calculate pressure
 				const ndFloat32 pressureI1 = gasConstant * (density[i1] - restDensity);
 				const ndFloat32 averagePressure = ndFloat32 (0.5f) * invDensity[i1] * (pressureI1 + pressureI0);
-				const ndVector forcePresure(m_mass * averagePressure * kernelValue);
+				const ndVector forcePresure(kernelConst * ndVector(m_mass * averagePressure * kernelValue));
 
 				//// calculate viscosity acceleration
 				//const ndVector v01(veloc[i1] - v0);
@@ -2047,10 +2452,11 @@ void ndBodySphFluid::CalculateAccelerations(ndThreadPool* const threadPool)
 
 				const ndVector force(forcePresure * unitDir);
 				forceAcc += force;
-			}
+			};
+			data.ForEachNeighbor(i0, posit, AddForce);
 
-			const ndVector accel(gravity + forceAcc);
-			//const ndVector accel(gravity + ndVector(invDensity[i0]) * forceAcc);
+			const ndVector densityScale(weaklyCompressible ? invDensity[i0] : ndFloat32(1.0f));
+			const ndVector accel(gravity + densityScale * forceAcc);
 			data.m_accel[i0] = accel;
 		}
 	});
@@ -2068,28 +2474,422 @@ void ndBodySphFluid::IntegrateParticles(ndThreadPool* const threadPool)
 		const ndArray<ndVector>& accel = data.m_accel;
 		ndArray<ndVector>& veloc = m_veloc;
 		ndArray<ndVector>& posit = m_posit;
+		ndArray<ndVector>& positBase = data.m_positBase;
 
-		//const ndVector timestep (ndFloat32 (0.003f));
-		//const ndVector timestep(m_timestep);
-		//const ndVector timestep(m_timestep * 0.5f);
-		const ndVector timestep(m_timestep * 0.25f);
+		// the legacy explicit solver integrates a quarter of each sub step
+		const ndFloat32 stepScale = (m_solverMode == m_weaklyCompressible) ? ndFloat32(1.0f) : ndFloat32(0.25f);
+		const ndVector timestep(stepScale * m_timestep / ndFloat32(m_subSteps));
 
 		const ndStartEnd startEnd(posit.GetCount(), threadIndex, threadCount);
 		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
 		{
+			positBase[i] = posit[i];
 			veloc[i] = veloc[i] + accel[i] * timestep;
 			posit[i] = posit[i] + veloc[i] * timestep;
-			if (posit[i].m_y <= 1.0f)
+			if (posit[i].m_y <= D_SPH_FLOOR_ELEVATION)
 			{
-				posit[i].m_y = 1.0f;
+				posit[i].m_y = D_SPH_FLOOR_ELEVATION;
 				veloc[i].m_y = 0.0f;
 			}
 		}
 	});
 
+	data.m_positBase.SetCount(m_posit.GetCount());
 	threadPool->ParallelExecute(IntegrateParticles);
 }
 
+void ndBodySphFluid::PredictPositions(ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+	ndWorkingBuffers& data = *m_workingBuffers;
+	data.m_positBase.SetCount(m_posit.GetCount());
+	auto PredictPositions = ndMakeObject::ndFunction([this, &data](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(PredictPositions);
+		ndArray<ndVector>& veloc = m_veloc;
+		ndArray<ndVector>& posit = m_posit;
+		ndArray<ndVector>& positBase = data.m_positBase;
+
+		const ndVector gravity(m_gravity);
+		const ndVector timestep(m_timestep / ndFloat32(m_subSteps));
+
+		const ndStartEnd startEnd(posit.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			positBase[i] = posit[i];
+			veloc[i] = veloc[i] + gravity * timestep;
+			posit[i] = posit[i] + veloc[i] * timestep;
+			posit[i].m_y = ndMax(posit[i].m_y, D_SPH_FLOOR_ELEVATION);
+		}
+	});
+
+	threadPool->ParallelExecute(PredictPositions);
+}
+
+// particles clamped to the floor or squeezed by a body can land on top of each other,
+// the kernel gradient vanishes there, so they get a fixed direction to split apart.
+static inline ndVector ndSphSeparation(const ndVector& p10, ndInt32 i0, ndInt32 i1, ndFloat32 minDist2)
+{
+	if (p10.DotProduct(p10).GetScalar() >= minDist2)
+	{
+		return p10;
+	}
+	// the direction flips with the pair order, so the pair gradient stays antisymmetric
+	static const ndVector directions[] = 
+	{
+		ndVector(ndFloat32(1.0f), ndFloat32(0.0f), ndFloat32(0.0f), ndFloat32(0.0f)),
+		ndVector(ndFloat32(0.0f), ndFloat32(0.0f), ndFloat32(1.0f), ndFloat32(0.0f)),
+		ndVector(ndFloat32(0.7071f), ndFloat32(0.0f), ndFloat32(0.7071f), ndFloat32(0.0f)),
+		ndVector(ndFloat32(0.7071f), ndFloat32(0.0f), ndFloat32(-0.7071f), ndFloat32(0.0f)),
+	};
+	const ndFloat32 dist = ndSqrt(minDist2);
+	return directions[(i0 ^ i1) & 3].Scale((i0 > i1) ? dist : -dist);
+}
+
+void ndBodySphFluid::CalculateLambdas(ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+	ndWorkingBuffers& data = *m_workingBuffers;
+	data.m_lambda.SetCount(m_posit.GetCount());
+	data.m_density.SetCount(m_posit.GetCount());
+
+	auto CalculateLambdas = ndMakeObject::ndFunction([this, &data](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateLambdas);
+		const ndVector epsilon2(ndFloat32(1.0e-12f));
+		const ndArray<ndVector>& posit = m_posit;
+
+		// neighbors were collected at the predicted positions, 
+		// the distances are recalculated since particles move every iteration.
+		const ndFloat32 h = data.m_particleDiameter;
+		const ndFloat32 h2 = h * h;
+		const ndFloat32 minDist2 = h2 * ndFloat32(1.0e-6f);
+		const ndFloat32 densityConst = m_mass * ndFloat32(315.0f) / (ndFloat32(64.0f) * ndPi * ndPow(h, ndFloat32(9.0f)));
+		const ndFloat32 gradientConst = m_mass * ndFloat32(45.0f) / (m_restDensity * ndPi * ndPow(h, ndFloat32(6.0f)));
+		const ndFloat32 invRestDensity = ndFloat32(1.0f) / m_restDensity;
+		const ndFloat32 relaxation = D_SPH_PBF_RELAXATION / h2;
+
+		const ndStartEnd startEnd(posit.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i0 = startEnd.m_start; i0 < startEnd.m_end; ++i0)
+		{
+			const ndVector p0(posit[i0]);
+
+			ndFloat32 volume = h2 * h2 * h2;
+			ndFloat32 gradientSum2 = ndFloat32(0.0f);
+			ndVector gradientAcc(ndVector::m_zero);
+			auto AddGradient = [&posit, &p0, &epsilon2, &volume, &gradientAcc, &gradientSum2, i0, h, h2, minDist2, gradientConst](ndInt32 i1)
+			{
+				const ndVector p10(ndSphSeparation(p0 - posit[i1], i0, i1, minDist2));
+				const ndVector dot(p10.DotProduct(p10) + epsilon2);
+				const ndFloat32 dist2 = dot.GetScalar();
+				const ndFloat32 dist = ndMin(ndSqrt(dist2), h);
+
+				const ndFloat32 kernelDist2 = ndMax(h2 - dist2, ndFloat32(0.0f));
+				volume += kernelDist2 * kernelDist2 * kernelDist2;
+
+				const ndFloat32 kernelDist = h - dist;
+				const ndVector gradient(p10 * dot.InvSqrt() * ndVector(gradientConst * kernelDist * kernelDist));
+				gradientAcc += gradient;
+				gradientSum2 += gradient.DotProduct(gradient).GetScalar();
+			};
+			data.ForEachNeighbor(i0, posit, AddGradient);
+			gradientSum2 += gradientAcc.DotProduct(gradientAcc).GetScalar();
+
+			// only resolve compression, this prevents particles from clumping at the free surface.
+			const ndFloat32 density = densityConst * volume;
+			const ndFloat32 constraint = ndMax(density * invRestDensity - ndFloat32(1.0f), ndFloat32(0.0f));
+			data.m_density[i0] = density;
+			data.m_lambda[i0] = -constraint / (gradientSum2 + relaxation);
+		}
+	});
+
+	threadPool->ParallelExecute(CalculateLambdas);
+}
+
+void ndBodySphFluid::ApplyPositionCorrections(ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+	ndWorkingBuffers& data = *m_workingBuffers;
+	data.m_deltaPosit.SetCount(m_posit.GetCount());
+
+	auto CalculateCorrections = ndMakeObject::ndFunction([this, &data](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateCorrections);
+		const ndVector epsilon2(ndFloat32(1.0e-12f));
+		const ndArray<ndVector>& posit = m_posit;
+		const ndFloat32* const lambda = &data.m_lambda[0];
+
+		const ndFloat32 h = data.m_particleDiameter;
+		const ndFloat32 minDist2 = h * h * ndFloat32(1.0e-6f);
+		const ndFloat32 gradientConst = m_mass * ndFloat32(45.0f) / (m_restDensity * ndPi * ndPow(h, ndFloat32(6.0f)));
+
+		const ndStartEnd startEnd(posit.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i0 = startEnd.m_start; i0 < startEnd.m_end; ++i0)
+		{
+			const ndVector p0(posit[i0]);
+			const ndFloat32 lambda0 = lambda[i0];
+
+			ndVector deltaAcc(ndVector::m_zero);
+			auto AddCorrection = [&posit, &p0, &epsilon2, &deltaAcc, lambda, lambda0, i0, h, minDist2, gradientConst](ndInt32 i1)
+			{
+				const ndVector p10(ndSphSeparation(p0 - posit[i1], i0, i1, minDist2));
+				const ndVector dot(p10.DotProduct(p10) + epsilon2);
+				const ndFloat32 kernelDist = ndMax(h - ndSqrt(dot.GetScalar()), ndFloat32(0.0f));
+				const ndFloat32 weight = (lambda0 + lambda[i1]) * gradientConst * kernelDist * kernelDist;
+				deltaAcc -= p10 * dot.InvSqrt() * ndVector(weight);
+			};
+			data.ForEachNeighbor(i0, posit, AddCorrection);
+			data.m_deltaPosit[i0] = deltaAcc;
+		}
+	});
+
+	auto ApplyCorrections = ndMakeObject::ndFunction([this, &data](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(ApplyCorrections);
+		ndArray<ndVector>& posit = m_posit;
+		const ndArray<ndVector>& deltaPosit = data.m_deltaPosit;
+
+		const ndStartEnd startEnd(posit.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			posit[i] = posit[i] + deltaPosit[i];
+			posit[i].m_y = ndMax(posit[i].m_y, D_SPH_FLOOR_ELEVATION);
+		}
+	});
+
+	threadPool->ParallelExecute(CalculateCorrections);
+	threadPool->ParallelExecute(ApplyCorrections);
+}
+
+void ndBodySphFluid::UpdateVelocities(ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+	ndWorkingBuffers& data = *m_workingBuffers;
+	auto UpdateVelocities = ndMakeObject::ndFunction([this, &data](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(UpdateVelocities);
+		ndArray<ndVector>& veloc = m_veloc;
+		const ndArray<ndVector>& posit = m_posit;
+		const ndArray<ndVector>& positBase = data.m_positBase;
+		const ndVector invTimestep(ndFloat32(m_subSteps) / m_timestep);
+
+		const ndStartEnd startEnd(posit.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			veloc[i] = (posit[i] - positBase[i]) * invTimestep;
+		}
+	});
+
+	threadPool->ParallelExecute(UpdateVelocities);
+}
+
+void ndBodySphFluid::CollectBoundaryBodies(const ndScene* const scene)
+{
+	D_TRACKTIME();
+	ndWorkingBuffers& data = *m_workingBuffers;
+	data.m_boundaryBodies.SetCount(0);
+	data.m_boundaryReferences.RemoveAll();
+	if (!m_bodyCoupling)
+	{
+		return;
+	}
+
+	// the fluid aabb is the one calculated by the last update
+	ndBodiesInAabbNotify notify;
+	scene->BodiesInAabb(notify, m_box0, m_box1);
+
+	const ndVector padding(ndFloat32(2.0f) * GetParticleRadius());
+	const ndVector timestep(m_timestep);
+	for (ndInt32 i = 0; i < notify.m_bodyArray.GetCount(); ++i)
+	{
+		ndBodyKinematic* const body = ((ndBody*)notify.m_bodyArray[i])->GetAsBodyKinematic();
+		if (body->GetAsBodyTriggerVolume())
+		{
+			continue;
+		}
+		const ndShapeInstance& shape = body->GetCollisionShape();
+
+		ndBoundaryBody boundary;
+		boundary.m_body = body;
+		boundary.m_shape = &shape;
+		boundary.m_matrix = body->GetMatrix();
+		boundary.m_shapeMatrix = shape.GetLocalMatrix() * boundary.m_matrix;
+		boundary.m_veloc = body->GetVelocity();
+		boundary.m_accel = body->GetForce().Scale(body->GetInvMass()) & ndVector::m_triplexMask;
+		boundary.m_stepVeloc = boundary.m_veloc;
+		boundary.m_omega = body->GetOmega();
+		boundary.m_com = body->GetGlobalGetCentreOfMass();
+		boundary.m_localCom = body->GetCentreOfMass();
+		boundary.m_impulse = ndVector::m_zero;
+		boundary.m_angularImpulse = ndVector::m_zero;
+
+		// particles moving relative to the body can reach it from the last step position
+		ndVector box0;
+		ndVector box1;
+		body->GetAABB(box0, box1);
+		const ndVector step(((boundary.m_veloc.Abs() + (boundary.m_accel * timestep).Abs()) * timestep) + padding);
+		boundary.m_box0 = (box0 - step) & ndVector::m_triplexMask;
+		boundary.m_box1 = (box1 + step) & ndVector::m_triplexMask;
+
+		data.m_boundaryBodies.PushBack(boundary);
+
+		// keep the body alive while the fluid update runs in the background
+		data.m_boundaryReferences.Append(scene->GetBody(body));
+	}
+}
+
+void ndBodySphFluid::CollideBoundaryBodies(ndThreadPool* const threadPool, ndInt32 subStep)
+{
+	D_TRACKTIME();
+	ndWorkingBuffers& data = *m_workingBuffers;
+	const ndInt32 bodyCount = data.m_boundaryBodies.GetCount();
+	if (!bodyCount)
+	{
+		return;
+	}
+
+	// the bodies were captured at the beginning of the frame, 
+	// move them ahead to where they are at the end of this sub step.
+	const ndFloat32 aheadStep = m_timestep * ndFloat32(subStep + 1) / ndFloat32(m_subSteps);
+	for (ndInt32 i = 0; i < bodyCount; ++i)
+	{
+		ndBoundaryBody& boundary = data.m_boundaryBodies[i];
+		const ndShapeInstance& shape = *boundary.m_shape;
+		ndMatrix matrix(boundary.m_matrix);
+		const ndFloat32 omegaMag2 = boundary.m_omega.DotProduct(boundary.m_omega).GetScalar();
+		if (omegaMag2 > ndFloat32(1.0e-12f))
+		{
+			const ndFloat32 omegaMag = ndSqrt(omegaMag2);
+			const ndMatrix rotation(ndQuaternion(boundary.m_omega.Scale(ndFloat32(1.0f) / omegaMag), omegaMag * aheadStep), ndVector::m_wOne);
+			const ndVector com(matrix.TransformVector(boundary.m_localCom));
+			matrix = matrix * rotation;
+			matrix.m_posit = com + rotation.RotateVector(boundary.m_matrix.m_posit - com);
+		}
+		// the body keeps the external force of the last frame
+		boundary.m_stepVeloc = boundary.m_veloc + boundary.m_accel.Scale(aheadStep);
+		matrix.m_posit += (boundary.m_veloc + boundary.m_stepVeloc).Scale(aheadStep * ndFloat32(0.5f));
+		matrix.m_posit.m_w = ndFloat32(1.0f);
+		boundary.m_shapeMatrix = shape.GetLocalMatrix() * matrix;
+		boundary.m_com = matrix.TransformVector(boundary.m_localCom);
+	}
+
+	const ndInt32 threadCount = threadPool->GetThreadCount();
+	data.m_boundaryImpulses.SetCount(threadCount * bodyCount * 2);
+	for (ndInt32 i = 0; i < data.m_boundaryImpulses.GetCount(); ++i)
+	{
+		data.m_boundaryImpulses[i] = ndVector::m_zero;
+	}
+
+	const ndFloat32 subStepTime = m_timestep / ndFloat32(m_subSteps);
+	data.m_boundaryGrid.Build(threadPool, m_posit, data.m_positBase, data.m_boundaryBodies, subStepTime, GetParticleRadius(), D_SPH_BOUNDARY_SKIN * GetParticleRadius());
+
+	auto CollideBodies = ndMakeObject::ndFunction([this, &data, bodyCount](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CollideBodies);
+		ndArray<ndVector>& veloc = m_veloc;
+		ndArray<ndVector>& posit = m_posit;
+		const ndArray<ndVector>& positBase = data.m_positBase;
+		const ndBoundaryBody* const bodies = &data.m_boundaryBodies[0];
+		ndVector* const impulses = &data.m_boundaryImpulses[threadIndex * bodyCount * 2];
+
+		const ndFloat32 timestep = m_timestep / ndFloat32(m_subSteps);
+		const ndVector invTimestep(ndFloat32(1.0f) / timestep);
+		const ndVector mass(m_mass);
+		const ndVector skin(D_SPH_BOUNDARY_SKIN * GetParticleRadius());
+		const bool positionBased = (m_solverMode == m_positionBased);
+
+		ndRayCastClosestHitCallback callback;
+		const ndStartEnd startEnd(posit.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			ndVector p1(posit[i]);
+			ndVector v(veloc[i]);
+			ndInt32 cellCount;
+			const ndInt32* const cellBodies = data.m_boundaryGrid.GetBodies(p1, cellCount);
+			for (ndInt32 k = 0; k < cellCount; ++k)
+			{
+				const ndInt32 j = cellBodies[k];
+				// trace the particle motion relative to the body, 
+				// in the frame the body has at the end of the step.
+				const ndBoundaryBody& boundary = bodies[j];
+				const ndVector bodyVeloc(boundary.m_stepVeloc + boundary.m_omega.CrossProduct(p1 - boundary.m_com));
+				const ndVector p0(positBase[i] + bodyVeloc.Scale(timestep));
+				if (!ndOverlapTest(p0.GetMin(p1), p0.GetMax(p1), boundary.m_box0, boundary.m_box1))
+				{
+					continue;
+				}
+
+				ndContactPoint contact;
+				callback.m_param = ndFloat32(1.0f);
+				const ndVector localP0(boundary.m_shapeMatrix.UntransformVector(p0) & ndVector::m_triplexMask);
+				const ndVector localP1(boundary.m_shapeMatrix.UntransformVector(p1) & ndVector::m_triplexMask);
+				const ndFloat32 t = boundary.m_shape->RayCast(callback, localP0, localP1, boundary.m_body, contact);
+				if (t < ndFloat32(1.0f))
+				{
+					const ndVector normal(boundary.m_shapeMatrix.RotateVector(contact.m_normal));
+					const ndVector point(p0 + (p1 - p0).Scale(t));
+					const ndVector target(point + normal * skin);
+
+					ndVector momentum;
+					if (positionBased)
+					{
+						// the velocity is recovered from the position change
+						momentum = mass * (target - p1) * invTimestep;
+					}
+					else
+					{
+						// remove the particle velocity going into the body
+						const ndFloat32 normalSpeed = (v - bodyVeloc).DotProduct(normal).GetScalar();
+						const ndVector deltaVeloc(normal.Scale(-ndMin(normalSpeed, ndFloat32(0.0f))));
+						v += deltaVeloc;
+						momentum = mass * deltaVeloc;
+					}
+					p1 = target;
+					impulses[j * 2 + 0] -= momentum;
+					impulses[j * 2 + 1] -= (point - boundary.m_com).CrossProduct(momentum);
+				}
+			}
+			posit[i] = p1;
+			veloc[i] = v;
+		}
+	});
+
+	threadPool->ParallelExecute(CollideBodies);
+
+	for (ndInt32 i = 0; i < threadCount; ++i)
+	{
+		const ndVector* const impulses = &data.m_boundaryImpulses[i * bodyCount * 2];
+		for (ndInt32 j = 0; j < bodyCount; ++j)
+		{
+			ndBoundaryBody& boundary = data.m_boundaryBodies[j];
+			boundary.m_impulse += impulses[j * 2 + 0];
+			boundary.m_angularImpulse += impulses[j * 2 + 1];
+		}
+	}
+}
+
+void ndBodySphFluid::ApplyBoundaryImpulses()
+{
+	D_TRACKTIME();
+	ndWorkingBuffers& data = *m_workingBuffers;
+	for (ndInt32 i = 0; i < data.m_boundaryBodies.GetCount(); ++i)
+	{
+		const ndBoundaryBody& boundary = data.m_boundaryBodies[i];
+		ndBodyKinematic* const body = boundary.m_body;
+		const ndFloat32 invMass = body->GetInvMass();
+		const ndFloat32 mag2 = boundary.m_impulse.DotProduct(boundary.m_impulse).GetScalar() + boundary.m_angularImpulse.DotProduct(boundary.m_angularImpulse).GetScalar();
+		if ((invMass > ndFloat32(0.0f)) && (mag2 > ndFloat32(1.0e-12f)))
+		{
+			// the world is not running, the impulses go directly to the body momentum.
+			const ndMatrix invInertia(body->CalculateInvInertiaMatrix());
+			body->SetVelocity(body->GetVelocity() + boundary.m_impulse.Scale(invMass));
+			body->SetOmega(body->GetOmega() + invInertia.RotateVector(boundary.m_angularImpulse));
+		}
+	}
+	data.m_boundaryBodies.SetCount(0);
+	data.m_boundaryReferences.RemoveAll();
+}
+
 void ndBodySphFluid::CaculateAabb(ndThreadPool* const threadPool)
 {
 	D_TRACKTIME();
@@ -2344,33 +3144,101 @@ bool ndBodySphFluid::TraceHashes() const
 
 void ndBodySphFluid::Update(const ndScene* const scene, ndFloat32 timestep)
 {
-	if (TaskState() == ndBackgroundTask::m_taskCompleted)
+	// the update of the last frame was completed by SyncUpdate
+	ndAssert(TaskState() == ndBackgroundTask::m_taskCompleted);
+	if (m_posit.GetCount())
 	{
-		if (m_posit.GetCount())
+		m_timestep = timestep;
+		CollectBoundaryBodies(scene);
+		((ndScene*)scene)->SendBackgroundTask(this);
+		if (!m_updateInBackground)
 		{
-			m_timestep = timestep;
-			((ndScene*)scene)->SendBackgroundTask(this);
-			if (!m_updateInBackground)
-			{
-				Sync();
-			}
+			Sync();
 		}
 	}
 }
 
+void ndBodySphFluid::SyncUpdate(const ndScene* const scene)
+{
+	ndBodyParticleSet::SyncUpdate(scene);
+	// the rigid bodies completed their step, the reactions go to the next one
+	ApplyBoundaryImpulses();
+}
+
 void ndBodySphFluid::Execute(ndThreadPool* const threadPool)
 {
 	D_TRACKTIME();
 	ndAssert(sizeof(ndGridHash) == sizeof(ndUnsigned64));
 
-	CaculateAabb(threadPool);
-	CreateGrids(threadPool);
-	SortGrids(threadPool);
-	CalculateScans(threadPool);
-	BuildBuckets(threadPool);
-	CalculateParticlesDensity(threadPool);
-	CalculateAccelerations(threadPool);
-	IntegrateParticles(threadPool);
+	ndWorkingBuffers& data = *m_workingBuffers;
+	data.m_cellSearch = (m_neighborSearch == m_cellList);
+	if (!data.m_cellSearch)
+	{
+		data.m_cellKeys.SetCount(0);
+		data.m_cellKeysScratch.SetCount(0);
+		data.m_cellStart.SetCount(0);
+		data.m_columnStart.SetCount(0);
+		data.m_particleCell.SetCount(0);
+		data.m_cellRanges.SetCount(0);
+	}
+	data.m_neighborStart.SetCount(0);
+	data.m_neighbors.SetCount(0);
+
+	// keep spatial neighbors close in memory, so the neighbor loops stay in cache.
+	if (m_reorderPeriod && ((m_reorderFrame++ % m_reorderPeriod) == 0))
+	{
+		ReorderParticles(threadPool);
+	}
+
+	for (ndInt32 step = 0; step < m_subSteps; ++step)
+	{
+		if (m_solverMode == m_positionBased)
+		{
+			// position based fluids: the neighbor lists are built once 
+			// at the predicted positions and reused by all iterations.
+			PredictPositions(threadPool);
+		}
+
+		CaculateAabb(threadPool);
+		if (data.m_cellSearch)
+		{
+			BuildCellList(threadPool);
+			if (m_solverMode == m_positionBased)
+			{
+				BuildNeighborList(threadPool);
+			}
+		}
+		else
+		{
+			CreateGrids(threadPool);
+			SortGrids(threadPool);
+			CalculateScans(threadPool);
+			BuildBuckets(threadPool);
+		}
+
+		if (m_solverMode == m_positionBased)
+		{
+			for (ndInt32 i = 0; i < m_solverIterations; ++i)
+			{
+				CalculateLambdas(threadPool);
+				ApplyPositionCorrections(threadPool);
+			}
+			CollideBoundaryBodies(threadPool, step);
+			UpdateVelocities(threadPool);
+		}
+		else
+		{
+			CalculateParticlesDensity(threadPool);
+			CalculateAccelerations(threadPool);
+			IntegrateParticles(threadPool);
+			CollideBoundaryBodies(threadPool, step);
+		}
+
+		if (data.m_cellSearch)
+		{
+			RestoreParticleOrder(threadPool);
+		}
+	}
 }
 
 #endif
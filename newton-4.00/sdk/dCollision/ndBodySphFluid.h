@@ -31,9 +31,48 @@ D_MSV_NEWTON_ALIGN_32
 class ndBodySphFluid: public ndBodyParticleSet
 {
 	public:
+	// m_explicitPressure is the original solver, it ignores gravity and runs a quarter step, 
+	// so it does not keep pace with coupled rigid bodies.
+	// m_weaklyCompressible is the same explicit solver with gravity, 
+	// the spiky kernel constant, the 1/density factor and the sub step setting.
+	enum ndSolverMode
+	{
+		m_explicitPressure,
+		m_positionBased,
+		m_weaklyCompressible,
+	};
+
+	enum ndNeighborSearch
+	{
+		m_pairList,
+		m_cellList,
+	};
+
 	D_COLLISION_API ndBodySphFluid();
 	D_COLLISION_API virtual ~ndBodySphFluid ();
 
+	ndSolverMode GetSolverMode() const;
+	void SetSolverMode(ndSolverMode mode);
+
+	ndInt32 GetSolverIterations() const;
+	void SetSolverIterations(ndInt32 iterations);
+
+	ndInt32 GetSubSteps() const;
+	void SetSubSteps(ndInt32 subSteps);
+
+	// two way coupling with the rigid bodies in the fluid aabb, off by default
+	bool GetBodyCoupling() const;
+	void SetBodyCoupling(bool state);
+
+	// the pair list caps neighbors at 32 per particle, 
+	// the cell list walks the sorted cells and has no limit.
+	// the particles keep their indices with both.
+	ndNeighborSearch GetNeighborSearch() const;
+	void SetNeighborSearch(ndNeighborSearch search);
+
+	// bytes of working memory used by the last update
+	D_COLLISION_API ndUnsigned64 GetWorkingMemory() const;
+
 	ndFloat32 GetViscosity() const;
 	void SetViscosity(ndFloat32 viscosity);
 	
@@ -53,16 +92,21 @@ class ndBodySphFluid: public ndBodyParticleSet
 
 	protected:
 	D_COLLISION_API virtual void Update(const ndScene* const scene, ndFloat32 timestep);
+	D_COLLISION_API virtual void SyncUpdate(const ndScene* const scene);
 	virtual bool RayCast(ndRayCastNotify& callback, const ndFastRay& ray, const ndFloat32 maxT) const;
 
 	private:
 	class ndGridHash;
 	class ndParticlePair;
+	class ndCellRange;
+	class ndBoundaryBody;
 	class ndWorkingBuffers;
-	class ndParticleKernelDistance;
 
 	void SortGrids(ndThreadPool* const threadPool);
 	void BuildBuckets(ndThreadPool* const threadPool);
+	void BuildCellList(ndThreadPool* const threadPool);
+	void BuildNeighborList(ndThreadPool* const threadPool);
+	void RestoreParticleOrder(ndThreadPool* const threadPool);
 	void CreateGrids(ndThreadPool* const threadPool);
 	void CaculateAabb(ndThreadPool* const threadPool);
 	void SortBuckets(ndThreadPool* const threadPool);
@@ -72,6 +116,17 @@ class ndBodySphFluid: public ndBodyParticleSet
 	void CalculateAccelerations(ndThreadPool* const threadPool);
 	void CalculateParticlesDensity(ndThreadPool* const threadPool);
 
+	// position based fluid solver
+	void PredictPositions(ndThreadPool* const threadPool);
+	void UpdateVelocities(ndThreadPool* const threadPool);
+	void CalculateLambdas(ndThreadPool* const threadPool);
+	void ApplyPositionCorrections(ndThreadPool* const threadPool);
+
+	// two way coupling with the rigid bodies overlapping the fluid
+	void ApplyBoundaryImpulses();
+	void CollectBoundaryBodies(const ndScene* const scene);
+	void CollideBoundaryBodies(ndThreadPool* const threadPool, ndInt32 subStep);
+
 	bool TraceHashes() const;
 
 	ndWorkingBuffers* m_workingBuffers;
@@ -79,9 +134,63 @@ class ndBodySphFluid: public ndBodyParticleSet
 	ndFloat32 m_viscosity;
 	ndFloat32 m_restDensity;
 	ndFloat32 m_gasConstant;
-	
+	ndSolverMode m_solverMode;
+	ndInt32 m_solverIterations;
+	ndInt32 m_subSteps;
+	ndNeighborSearch m_neighborSearch;
+	bool m_bodyCoupling;
 } D_GCC_NEWTON_ALIGN_32 ;
 
+inline ndBodySphFluid::ndSolverMode ndBodySphFluid::GetSolverMode() const
+{
+	return m_solverMode;
+}
+
+inline void ndBodySphFluid::SetSolverMode(ndSolverMode mode)
+{
+	m_solverMode = mode;
+}
+
+inline ndInt32 ndBodySphFluid::GetSolverIterations() const
+{
+	return m_solverIterations;
+}
+
+inline void ndBodySphFluid::SetSolverIterations(ndInt32 iterations)
+{
+	m_solverIterations = ndClamp(iterations, 1, 32);
+}
+
+inline ndInt32 ndBodySphFluid::GetSubSteps() const
+{
+	return m_subSteps;
+}
+
+inline void ndBodySphFluid::SetSubSteps(ndInt32 subSteps)
+{
+	m_subSteps = ndClamp(subSteps, 1, 16);
+}
+
+inline ndBodySphFluid::ndNeighborSearch ndBodySphFluid::GetNeighborSearch() const
+{
+	return m_neighborSearch;
+}
+
+inline void ndBodySphFluid::SetNeighborSearch(ndNeighborSearch search)
+{
+	m_neighborSearch = search;
+}
+
+inline bool ndBodySphFluid::GetBodyCoupling() const
+{
+	return m_bodyCoupling;
+}
+
+inline void ndBodySphFluid::SetBodyCoupling(bool state)
+{
+	m_bodyCoupling = state;
+}
+
 inline bool ndBodySphFluid::RayCast(ndRayCastNotify&, const ndFastRay&, const ndFloat32) const
 {
 	return false;
@@ -21,11 +21,16 @@
 
 #include "ndCoreStdafx.h"
 #include "ndCollisionStdafx.h"
+#include "ndScene.h"
 #include "ndContact.h"
 #include "ndBodyTriggerVolume.h"
 
 ndBodyTriggerVolume::ndBodyTriggerVolume()
 	:ndBodyKinematicBase()
+	,m_overlaps()
+	,m_enterBodies()
+	,m_exitBodies()
+	,m_mergeBuffer()
 {
 }
 
@@ -33,17 +38,97 @@ ndBodyTriggerVolume::~ndBodyTriggerVolume()
 {
 }
 
-void ndBodyTriggerVolume::SpecialUpdate(ndFloat32 timestep)
+void ndBodyTriggerVolume::SpecialUpdate(ndInt32 threadIndex, ndFloat32)
 {
-	const ndContactMap& contactMap = GetContactMap();
+	// the enter and exit events come from the contact calculation, so the trigger
+	// does not read its contacts. it only asks for the call back when it is not empty.
+	if (m_overlaps.GetCount())
+	{
+		GetScene()->AddTriggerEvent(threadIndex, this, nullptr, ndScene::ndTriggerEvent::m_inside);
+	}
+}
+
+void ndBodyTriggerVolume::OnTriggerEvents(ndFloat32 timestep)
+{
+	for (ndInt32 i = 0; i < m_enterBodies.GetCount(); ++i)
+	{
+		OnTriggerEnter(m_enterBodies[i], timestep);
+	}
+	for (ndInt32 i = 0; i < m_overlaps.GetCount(); ++i)
+	{
+		OnTrigger(m_overlaps[i], timestep);
+	}
+	for (ndInt32 i = 0; i < m_exitBodies.GetCount(); ++i)
+	{
+		OnTriggerExit(m_exitBodies[i], timestep);
+	}
+}
+
+void ndBodyTriggerVolume::UpdateOverlaps()
+{
+	// merge the enter bodies and remove the exit bodies, all sorted by id
+	if (m_enterBodies.GetCount() || m_exitBodies.GetCount())
+	{
+		ndInt32 i0 = 0;
+		ndInt32 i1 = 0;
+		ndInt32 i2 = 0;
+		m_mergeBuffer.SetCount(0);
+		while ((i0 < m_overlaps.GetCount()) || (i1 < m_enterBodies.GetCount()))
+		{
+			ndBodyKinematic* body = nullptr;
+			if ((i1 >= m_enterBodies.GetCount()) || ((i0 < m_overlaps.GetCount()) && (m_overlaps[i0]->GetId() < m_enterBodies[i1]->GetId())))
+			{
+				body = m_overlaps[i0];
+				i0++;
+			}
+			else
+			{
+				body = m_enterBodies[i1];
+				i1++;
+			}
+
+			while ((i2 < m_exitBodies.GetCount()) && (m_exitBodies[i2]->GetId() < body->GetId()))
+			{
+				i2++;
+			}
+			if ((i2 < m_exitBodies.GetCount()) && (m_exitBodies[i2] == body))
+			{
+				i2++;
+			}
+			else
+			{
+				m_mergeBuffer.PushBack(body);
+			}
+		}
+		m_overlaps.Swap(m_mergeBuffer);
+	}
+}
+
+void ndBodyTriggerVolume::RemoveOverlap(ndBodyKinematic* const body)
+{
+	// the overlaps are sorted by id, so binary search the body
+	ndInt32 i0 = 0;
+	ndInt32 i1 = m_overlaps.GetCount();
+	const ndUnsigned32 id = body->GetId();
+	while (i0 < i1)
+	{
+		const ndInt32 mid = (i0 + i1) >> 1;
+		if (m_overlaps[mid]->GetId() < id)
+		{
+			i0 = mid + 1;
+		}
+		else
+		{
+			i1 = mid;
+		}
+	}
 
-	ndBodyKinematic::ndContactMap::Iterator it(contactMap);
-	for (it.Begin(); it; it++)
+	if ((i0 < m_overlaps.GetCount()) && (m_overlaps[i0] == body))
 	{
-		const ndContact* const contact = *it;
-		if (contact->IsActive() && contact->IsInTrigger())
+		for (ndInt32 j = i0 + 1; j < m_overlaps.GetCount(); ++j)
 		{
-			OnTrigger(contact->GetBody0(), timestep);
+			m_overlaps[j - 1] = m_overlaps[j];
 		}
+		m_overlaps.SetCount(m_overlaps.GetCount() - 1);
 	}
 }
@@ -39,11 +39,30 @@ class ndBodyTriggerVolume : public ndBodyKinematicBase
 	virtual void OnTriggerEnter(ndBodyKinematic* const body, ndFloat32 timestep);
 	virtual void OnTriggerExit(ndBodyKinematic* const body, ndFloat32 timestep);
 
-	D_COLLISION_API virtual void SpecialUpdate(ndFloat32 timestep);
+	// called once per step with all the events of the trigger, the default
+	// calls OnTriggerEnter, OnTrigger and OnTriggerExit for each body.
+	D_COLLISION_API virtual void OnTriggerEvents(ndFloat32 timestep);
+
+	// the bodies inside the trigger, sorted by id
+	const ndArray<ndBodyKinematic*>& GetOverlaps() const;
+
+	// the bodies that entered or left the trigger, only valid inside OnTriggerEvents
+	const ndArray<ndBodyKinematic*>& GetEnterBodies() const;
+	const ndArray<ndBodyKinematic*>& GetExitBodies() const;
+
+	D_COLLISION_API virtual void SpecialUpdate(ndInt32 threadIndex, ndFloat32 timestep);
 
 	private:
 	virtual void IntegrateExternalForce(ndFloat32 timestep);
+	void UpdateOverlaps();
+	void RemoveOverlap(ndBodyKinematic* const body);
+
+	ndArray<ndBodyKinematic*> m_overlaps;
+	ndArray<ndBodyKinematic*> m_enterBodies;
+	ndArray<ndBodyKinematic*> m_exitBodies;
+	ndArray<ndBodyKinematic*> m_mergeBuffer;
 
+	friend class ndScene;
 } D_GCC_NEWTON_ALIGN_32;
 
 inline ndBodyTriggerVolume* ndBodyTriggerVolume::GetAsBodyTriggerVolume()
@@ -70,4 +89,19 @@ inline void ndBodyTriggerVolume::IntegrateExternalForce(ndFloat32)
 {
 }
 
+inline const ndArray<ndBodyKinematic*>& ndBodyTriggerVolume::GetOverlaps() const
+{
+	return m_overlaps;
+}
+
+inline const ndArray<ndBodyKinematic*>& ndBodyTriggerVolume::GetEnterBodies() const
+{
+	return m_enterBodies;
+}
+
+inline const ndArray<ndBodyKinematic*>& ndBodyTriggerVolume::GetExitBodies() const
+{
+	return m_exitBodies;
+}
+
 #endif
\ No newline at end of file
@@ -47,6 +47,7 @@
 #include <ndBodyListView.h>
 #include <ndContactArray.h>
 #include <ndBodySphFluid.h>
+#include <ndBodySoftBody.h>
 #include "ndBodySphFluid_New.h"
 #include <ndShapeCapsule.h>
 #include <ndShapeCylinder.h>
@@ -62,9 +63,12 @@
 #include <ndShapeStatic_bvh.h>
 #include <ndShapeConvexHull.h>
 #include <ndShapeStaticMesh.h>
+#include <ndShapeBinaryFormat.h>
 #include <ndShapeHeightfield.h>
+#include <ndShapeHeightfieldTiled.h>
 #include <ndConvexCastNotify.h>
 #include <ndBodyPlayerCapsule.h>
+#include <ndPlayerCapsuleCrowd.h>
 #include <ndBodyTriggerVolume.h>
 #include <ndBodiesInAabbNotify.h>
 #include <ndShapeConvexPolygon.h>
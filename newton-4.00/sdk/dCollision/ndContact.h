@@ -144,6 +144,7 @@ class ndContact: public ndConstraint
 	static ndVector m_initialSeparatingVector;
 
 	friend class ndScene;
+	friend class ndWorld;
 	friend class ndContactArray;
 	friend class ndBodyKinematic;
 	friend class ndContactSolver;
@@ -40,6 +40,7 @@ class ndConvexCastNotify : public ndClassAlloc
 		,m_contacts()
 		,m_param(ndFloat32 (1.2f))
 		,m_cachedScene(nullptr)
+		,m_threadIndex(0)
 	{
 	}
 
@@ -69,6 +70,8 @@ class ndConvexCastNotify : public ndClassAlloc
 	ndFixSizeArray<ndContactPoint, 8> m_contacts;
 	ndFloat32 m_param;
 	ndScene* m_cachedScene;
+	// casts running in parallel need their own contact solver scratch
+	ndInt32 m_threadIndex;
 } D_GCC_NEWTON_ALIGN_32;
 
 #endif
@@ -28,6 +28,8 @@
 #include "ndBodyKinematic.h"
 
 
+class ndJointHinge;
+
 #define ND_BILATERAL_CONTRAINT_DOF	12
 
 enum ndJointBilateralSolverModel
@@ -81,6 +83,7 @@ class ndJointBilateralConstraint : public ndConstraint
 
 	virtual ndUnsigned32 GetRowsCount() const;
 	virtual ndJointBilateralConstraint* GetAsBilateral() { return this; }
+	virtual ndJointHinge* GetAsHinge() { return nullptr; }
 	virtual void JacobianDerivative(ndConstraintDescritor& desc);
 	virtual ndJointBilateralSolverModel GetSolverModel() const;
 	virtual void SetSolverModel(ndJointBilateralSolverModel model);
@@ -0,0 +1,514 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "ndCoreStdafx.h"
+#include "ndCollisionStdafx.h"
+#include "ndScene.h"
+#include "ndContact.h"
+#include "ndBodyTriggerVolume.h"
+#include "ndBodyPlayerCapsule.h"
+#include "ndPlayerCapsuleCrowd.h"
+
+#define D_CROWD_LANES				4
+#define D_CROWD_MAX_PLANES			8
+#define D_CROWD_SOLVER_ITERATIONS	4
+#define D_CROWD_SLOP_JUMP_ANGLE		ndFloat32(0.8f)
+#define D_CROWD_MAX_PENETRATION		ndFloat32(5.0e-3f)
+
+// the constant parameters of four players
+class ndPlayerCapsuleCrowd::ndGroup
+{
+	public:
+	ndVector m_stepHeight;
+	ndVector m_contactPatch;
+};
+
+// the state of four players and their contact planes, one player per lane.
+// unused planes and inactive lanes are masked out.
+class ndPlayerCapsuleCrowd::ndLanes
+{
+	public:
+	class ndPlanes
+	{
+		public:
+		ndVector m_nx;
+		ndVector m_ny;
+		ndVector m_nz;
+		ndVector m_height;
+		ndVector m_depth;
+		ndVector m_friction;
+		ndVector m_mask;
+	};
+
+	ndVector m_posit[3];
+	ndVector m_veloc[3];
+	ndVector m_up[3];
+	ndVector m_side[3];
+	ndVector m_forwardSpeed;
+	ndVector m_lateralSpeed;
+	ndVector m_mask;
+	ndVector m_onFloor;
+	ndVector m_airborne;
+	ndPlanes m_planes[D_CROWD_MAX_PLANES];
+
+	void Clear()
+	{
+		// the inactive lanes are computed anyway, keep them at zero
+		ndVector* const data = &m_posit[0];
+		const ndInt32 count = ndInt32(sizeof(ndLanes) / sizeof(ndVector));
+		for (ndInt32 i = 0; i < count; ++i)
+		{
+			data[i] = ndVector::m_zero;
+		}
+	}
+};
+
+ndPlayerCapsuleCrowd::ndPlayerCapsuleCrowd()
+	:ndClassAlloc()
+	,m_players()
+	,m_groups()
+	,m_scene(nullptr)
+	,m_batchedCount(0)
+	,m_groupsDirty(true)
+{
+}
+
+ndPlayerCapsuleCrowd::~ndPlayerCapsuleCrowd()
+{
+	if (m_scene)
+	{
+		m_scene->RemovePlayerCrowd(this);
+	}
+	for (ndInt32 i = 0; i < m_players.GetCount(); ++i)
+	{
+		m_players[i]->m_crowd = nullptr;
+	}
+}
+
+void ndPlayerCapsuleCrowd::AddPlayer(ndBodyPlayerCapsule* const player)
+{
+	ndAssert(!player->m_crowd);
+	if (!player->m_crowd)
+	{
+		player->m_crowd = this;
+		player->m_crowdIndex = ndInt32(m_players.GetCount());
+		m_players.PushBack(player);
+		m_groupsDirty = true;
+	}
+}
+
+void ndPlayerCapsuleCrowd::RemovePlayer(ndBodyPlayerCapsule* const player)
+{
+	ndAssert(player->m_crowd == this);
+	if (player->m_crowd == this)
+	{
+		const ndInt32 index = player->m_crowdIndex;
+		ndBodyPlayerCapsule* const last = m_players[m_players.GetCount() - 1];
+		m_players[index] = last;
+		last->m_crowdIndex = index;
+		m_players.SetCount(m_players.GetCount() - 1);
+
+		player->m_crowd = nullptr;
+		player->m_crowdIndex = -1;
+		player->m_crowdUpdated = false;
+		m_groupsDirty = true;
+	}
+}
+
+void ndPlayerCapsuleCrowd::BuildGroups()
+{
+	const ndInt32 groupCount = (ndInt32(m_players.GetCount()) + D_CROWD_LANES - 1) / D_CROWD_LANES;
+	m_groups.SetCount(groupCount);
+	for (ndInt32 i = 0; i < groupCount; ++i)
+	{
+		ndGroup& group = m_groups[i];
+		group.m_stepHeight = ndVector::m_zero;
+		group.m_contactPatch = ndVector::m_zero;
+		for (ndInt32 j = 0; j < D_CROWD_LANES; ++j)
+		{
+			const ndInt32 index = i * D_CROWD_LANES + j;
+			if (index < m_players.GetCount())
+			{
+				const ndBodyPlayerCapsule* const player = m_players[index];
+				group.m_stepHeight[j] = player->m_stepHeight;
+				group.m_contactPatch[j] = player->m_contactPatch;
+			}
+		}
+	}
+	m_groupsDirty = false;
+}
+
+void ndPlayerCapsuleCrowd::Update(ndScene* const scene, ndFloat32 timestep)
+{
+	D_TRACKTIME();
+	if (m_groupsDirty)
+	{
+		BuildGroups();
+	}
+
+	ndInt32 batchedCount[D_MAX_THREADS_COUNT];
+	auto UpdateGroups = ndMakeObject::ndFunction([this, timestep, &batchedCount](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(UpdateGroups);
+		ndInt32 count = 0;
+		const ndStartEnd startEnd(ndInt32(m_groups.GetCount()), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			count += UpdateGroup(i, timestep);
+		}
+		batchedCount[threadIndex] = count;
+	});
+
+	for (ndInt32 i = 0; i < scene->GetThreadCount(); ++i)
+	{
+		batchedCount[i] = 0;
+	}
+	scene->ParallelExecute(UpdateGroups);
+
+	m_batchedCount = 0;
+	for (ndInt32 i = 0; i < scene->GetThreadCount(); ++i)
+	{
+		m_batchedCount += batchedCount[i];
+	}
+}
+
+ndInt32 ndPlayerCapsuleCrowd::UpdateGroup(ndInt32 groupIndex, ndFloat32 timestep)
+{
+	ndLanes lanes;
+	ndInt32 laneMask = 0;
+	ndBodyPlayerCapsule** const players = &m_players[groupIndex * D_CROWD_LANES];
+	const ndInt32 laneCount = ndMin(ndInt32(m_players.GetCount()) - groupIndex * D_CROWD_LANES, ndInt32(D_CROWD_LANES));
+
+	lanes.Clear();
+	for (ndInt32 i = 0; i < laneCount; ++i)
+	{
+		if (GatherLane(lanes, i, players[i], timestep))
+		{
+			laneMask |= 1 << i;
+		}
+	}
+
+	ndInt32 count = 0;
+	if (laneMask)
+	{
+		SolveLanes(lanes, m_groups[groupIndex], timestep);
+		for (ndInt32 i = 0; i < laneCount; ++i)
+		{
+			if (laneMask & (1 << i))
+			{
+				ScatterLane(lanes, i, players[i]);
+				count++;
+			}
+		}
+	}
+	return count;
+}
+
+bool ndPlayerCapsuleCrowd::GatherLane(ndLanes& lanes, ndInt32 lane, ndBodyPlayerCapsule* const player, ndFloat32 timestep) const
+{
+	player->m_crowdUpdated = false;
+	if (player->GetScene() != m_scene)
+	{
+		return false;
+	}
+
+	// players pushing dynamic bodies or other players need the full solver,
+	// since they apply reactions. so do players on moving kinematic bodies, 
+	// like platforms and elevators. the planes of static bodies come from the scene.
+	ndInt32 planeCount = 0;
+	ndContactPoint planes[D_CROWD_MAX_PLANES * 2];
+	ndBodyKinematic::ndContactMap::Iterator it(player->GetContactMap());
+	for (it.Begin(); it; it++)
+	{
+		const ndContact* const contact = *it;
+		if (contact->IsActive())
+		{
+			const bool swapped = (contact->GetBody1() == player);
+			ndBodyKinematic* const other = swapped ? contact->GetBody0() : contact->GetBody1();
+			if (!other->GetAsBodyTriggerVolume())
+			{
+				const ndContactPointList& points = contact->GetContactPoints();
+				const ndVector otherVeloc(other->GetVelocity());
+				const ndVector otherOmega(other->GetOmega());
+				const bool isStatic = (other->GetInvMass() == ndFloat32(0.0f)) &&
+					(otherVeloc.DotProduct(otherVeloc).GetScalar() == ndFloat32(0.0f)) &&
+					(otherOmega.DotProduct(otherOmega).GetScalar() == ndFloat32(0.0f));
+				if (points.GetCount() && !isStatic)
+				{
+					return false;
+				}
+				for (ndContactPointList::ndNode* node = points.GetFirst(); node; node = node->GetNext())
+				{
+					if (planeCount >= ndInt32(sizeof(planes) / sizeof(planes[0])))
+					{
+						return false;
+					}
+					planes[planeCount] = node->GetInfo();
+					if (swapped)
+					{
+						planes[planeCount].m_normal = planes[planeCount].m_normal.Scale(ndFloat32(-1.0f));
+						ndSwap(planes[planeCount].m_body0, planes[planeCount].m_body1);
+					}
+					planeCount++;
+				}
+			}
+		}
+	}
+
+	// keep the deepest planes
+	for (ndInt32 i = 0; i < ndMin(planeCount, ndInt32(D_CROWD_MAX_PLANES)); ++i)
+	{
+		ndInt32 index = i;
+		for (ndInt32 j = i + 1; j < planeCount; ++j)
+		{
+			if (planes[j].m_penetration > planes[index].m_penetration)
+			{
+				index = j;
+			}
+		}
+		ndSwap(planes[i], planes[index]);
+	}
+	planeCount = ndMin(planeCount, ndInt32(D_CROWD_MAX_PLANES));
+
+	// same as the start of ndBodyPlayerCapsule::SpecialUpdate
+	player->m_equilibriumOverride = 0;
+	player->m_impulse = ndVector::m_zero;
+	player->ApplyInputs(timestep);
+	player->m_equilibrium0 = 0;
+
+	ndMatrix matrix(ndYawMatrix(player->GetHeadingAngle()));
+	matrix.m_posit = player->GetMatrix().m_posit;
+	player->SetMatrix(matrix);
+
+	const ndVector veloc(player->GetVelocity() + player->m_impulse.Scale(player->m_invMass));
+	const ndMatrix frame(player->m_localFrame * matrix);
+	for (ndInt32 i = 0; i < 3; ++i)
+	{
+		lanes.m_posit[i][lane] = matrix.m_posit[i];
+		lanes.m_veloc[i][lane] = veloc[i];
+		lanes.m_up[i][lane] = frame.m_front[i];
+		lanes.m_side[i][lane] = frame.m_up[i];
+	}
+	lanes.m_forwardSpeed[lane] = -player->m_forwardSpeed;
+	lanes.m_lateralSpeed[lane] = -player->m_lateralSpeed;
+
+	for (ndInt32 i = 0; i < planeCount; ++i)
+	{
+		const ndContactPoint& contact = planes[i];
+		ndLanes::ndPlanes& plane = lanes.m_planes[i];
+		plane.m_nx[lane] = contact.m_normal.m_x;
+		plane.m_ny[lane] = contact.m_normal.m_y;
+		plane.m_nz[lane] = contact.m_normal.m_z;
+		plane.m_height[lane] = frame.m_front.DotProduct(contact.m_point - matrix.m_posit).GetScalar();
+		plane.m_depth[lane] = contact.m_penetration;
+		plane.m_friction[lane] = player->ContactFrictionCallback(contact.m_point, contact.m_normal, 0, contact.m_body1);
+		plane.m_mask.m_i[lane] = -1;
+	}
+	lanes.m_mask.m_i[lane] = -1;
+	player->m_crowdUpdated = true;
+	return true;
+}
+
+void ndPlayerCapsuleCrowd::SolveLanes(ndLanes& lanes, const ndGroup& group, ndFloat32 timestep) const
+{
+	const ndVector dt(timestep);
+	const ndVector minStep(timestep / ndFloat32(8.0f));
+	const ndVector slope(D_CROWD_SLOP_JUMP_ANGLE);
+	const ndVector maxPenetration(D_CROWD_MAX_PENETRATION);
+	const ndVector halfPenetration(D_CROWD_MAX_PENETRATION * ndFloat32(0.5f));
+	const ndVector speedTol(ndFloat32(1.0e-2f));
+	const ndVector epsilon(ndFloat32(1.0e-6f));
+
+	// classify the planes by their height over the feet of the player
+	ndVector groundNormal[3];
+	groundNormal[0] = ndVector::m_zero;
+	groundNormal[1] = ndVector::m_zero;
+	groundNormal[2] = ndVector::m_zero;
+	ndVector hasGround(ndVector::m_zero);
+	ndVector hasContacts(ndVector::m_zero);
+	ndVector groundMask[D_CROWD_MAX_PLANES];
+	for (ndInt32 i = 0; i < D_CROWD_MAX_PLANES; ++i)
+	{
+		const ndLanes::ndPlanes& plane = lanes.m_planes[i];
+		const ndVector upDot(plane.m_nx * lanes.m_up[0] + plane.m_ny * lanes.m_up[1] + plane.m_nz * lanes.m_up[2]);
+		groundMask[i] = plane.m_mask & (plane.m_height < group.m_contactPatch) & (upDot > slope);
+		groundNormal[0] += plane.m_nx & groundMask[i];
+		groundNormal[1] += plane.m_ny & groundMask[i];
+		groundNormal[2] += plane.m_nz & groundMask[i];
+		hasGround = hasGround | groundMask[i];
+		hasContacts = hasContacts | plane.m_mask;
+	}
+
+	// the desired walking velocity, along the ground or the horizontal plane
+	for (ndInt32 i = 0; i < 3; ++i)
+	{
+		groundNormal[i] = lanes.m_up[i].Select(groundNormal[i], hasGround);
+	}
+	const ndVector groundMag2(groundNormal[0] * groundNormal[0] + groundNormal[1] * groundNormal[1] + groundNormal[2] * groundNormal[2]);
+	const ndVector groundInvMag(groundMag2.GetMax(epsilon).InvSqrt());
+	for (ndInt32 i = 0; i < 3; ++i)
+	{
+		groundNormal[i] = groundNormal[i] * groundInvMag;
+	}
+
+	ndVector side[3];
+	side[0] = lanes.m_side[1] * groundNormal[2] - lanes.m_side[2] * groundNormal[1];
+	side[1] = lanes.m_side[2] * groundNormal[0] - lanes.m_side[0] * groundNormal[2];
+	side[2] = lanes.m_side[0] * groundNormal[1] - lanes.m_side[1] * groundNormal[0];
+	const ndVector sideInvMag((side[0] * side[0] + side[1] * side[1] + side[2] * side[2]).GetMax(epsilon).InvSqrt());
+	for (ndInt32 i = 0; i < 3; ++i)
+	{
+		side[i] = side[i] * sideInvMag;
+	}
+	ndVector front[3];
+	front[0] = groundNormal[1] * side[2] - groundNormal[2] * side[1];
+	front[1] = groundNormal[2] * side[0] - groundNormal[0] * side[2];
+	front[2] = groundNormal[0] * side[1] - groundNormal[1] * side[0];
+
+	ndVector target[3];
+	for (ndInt32 i = 0; i < 3; ++i)
+	{
+		target[i] = side[i] * lanes.m_lateralSpeed + front[i] * lanes.m_forwardSpeed;
+	}
+
+	// step over the obstacles lower than the step height the player walks into,
+	// unless the player also walks into a plane above the step height, like a wall.
+	ndVector blocked(ndVector::m_zero);
+	ndVector stepHeight(ndVector::m_zero);
+	for (ndInt32 i = 0; i < D_CROWD_MAX_PLANES; ++i)
+	{
+		const ndLanes::ndPlanes& plane = lanes.m_planes[i];
+		const ndVector relSpeed(plane.m_nx * target[0] + plane.m_ny * target[1] + plane.m_nz * target[2]);
+		const ndVector opposing(plane.m_mask & (relSpeed < speedTol * ndVector::m_negOne));
+		const ndVector stepMask(opposing & hasGround & (plane.m_height > group.m_contactPatch) & (plane.m_height < group.m_stepHeight));
+		stepHeight = stepHeight.GetMax(plane.m_height & stepMask);
+		blocked = blocked | (opposing & (plane.m_height >= group.m_stepHeight));
+	}
+	const ndVector stepped((stepHeight > ndVector::m_zero).AndNot(blocked));
+	stepHeight = stepHeight & stepped;
+	for (ndInt32 i = 0; i < D_CROWD_MAX_PLANES; ++i)
+	{
+		// after the step, only the planes above the step height are still touching
+		ndLanes::ndPlanes& plane = lanes.m_planes[i];
+		plane.m_mask = plane.m_mask & ((plane.m_height >= group.m_stepHeight) | ndVector::m_xyzwMask.AndNot(stepped));
+		groundMask[i] = groundMask[i] & plane.m_mask;
+	}
+	for (ndInt32 i = 0; i < 3; ++i)
+	{
+		// a player on a step walks at the desired speed and stops falling
+		lanes.m_veloc[i] = lanes.m_veloc[i].Select(target[i], stepped);
+		lanes.m_posit[i] = lanes.m_posit[i] + (lanes.m_up[i] * stepHeight);
+	}
+
+	// projected gauss seidel on the velocity for the contacts and the ground traction,
+	// and on the position to push the player out of the penetration.
+	ndVector normalImpulse[D_CROWD_MAX_PLANES];
+	ndVector correction[3];
+	correction[0] = ndVector::m_zero;
+	correction[1] = ndVector::m_zero;
+	correction[2] = ndVector::m_zero;
+	for (ndInt32 i = 0; i < D_CROWD_MAX_PLANES; ++i)
+	{
+		normalImpulse[i] = ndVector::m_zero;
+	}
+
+	for (ndInt32 iter = 0; iter < D_CROWD_SOLVER_ITERATIONS; ++iter)
+	{
+		ndVector groundImpulse(ndVector::m_zero);
+		ndVector friction(ndVector::m_zero);
+		for (ndInt32 i = 0; i < D_CROWD_MAX_PLANES; ++i)
+		{
+			const ndLanes::ndPlanes& plane = lanes.m_planes[i];
+			const ndVector vn(plane.m_nx * lanes.m_veloc[0] + plane.m_ny * lanes.m_veloc[1] + plane.m_nz * lanes.m_veloc[2]);
+			const ndVector impulse((normalImpulse[i] - vn).GetMax(ndVector::m_zero) & plane.m_mask);
+			const ndVector deltaImpulse(impulse - normalImpulse[i]);
+			normalImpulse[i] = impulse;
+			lanes.m_veloc[0] = lanes.m_veloc[0] + plane.m_nx * deltaImpulse;
+			lanes.m_veloc[1] = lanes.m_veloc[1] + plane.m_ny * deltaImpulse;
+			lanes.m_veloc[2] = lanes.m_veloc[2] + plane.m_nz * deltaImpulse;
+
+			const ndVector cn(plane.m_nx * correction[0] + plane.m_ny * correction[1] + plane.m_nz * correction[2]);
+			const ndVector push((plane.m_depth - halfPenetration - cn).GetMax(ndVector::m_zero) & plane.m_mask);
+			correction[0] = correction[0] + plane.m_nx * push;
+			correction[1] = correction[1] + plane.m_ny * push;
+			correction[2] = correction[2] + plane.m_nz * push;
+
+			groundImpulse += impulse & groundMask[i];
+			friction = friction.GetMax(plane.m_friction & groundMask[i]);
+		}
+
+		// drive the tangent velocity toward the walking velocity, bounded by the friction cone
+		const ndVector vn(groundNormal[0] * lanes.m_veloc[0] + groundNormal[1] * lanes.m_veloc[1] + groundNormal[2] * lanes.m_veloc[2]);
+		ndVector deltaVeloc[3];
+		for (ndInt32 i = 0; i < 3; ++i)
+		{
+			deltaVeloc[i] = target[i] - (lanes.m_veloc[i] - groundNormal[i] * vn);
+		}
+		const ndVector deltaMag2(deltaVeloc[0] * deltaVeloc[0] + deltaVeloc[1] * deltaVeloc[1] + deltaVeloc[2] * deltaVeloc[2]);
+		const ndVector deltaMag(deltaMag2.GetMax(epsilon).Sqrt());
+		const ndVector maxDelta(friction * groundImpulse);
+		const ndVector scale((maxDelta * deltaMag.Reciproc()).GetMin(ndVector::m_one) & hasGround);
+		for (ndInt32 i = 0; i < 3; ++i)
+		{
+			lanes.m_veloc[i] = lanes.m_veloc[i] + deltaVeloc[i] * scale;
+		}
+	}
+
+	// move until the first plane goes deeper than the allowed penetration
+	ndVector timeOfImpact(dt);
+	for (ndInt32 i = 0; i < D_CROWD_MAX_PLANES; ++i)
+	{
+		const ndLanes::ndPlanes& plane = lanes.m_planes[i];
+		const ndVector approach(ndVector::m_zero - (plane.m_nx * lanes.m_veloc[0] + plane.m_ny * lanes.m_veloc[1] + plane.m_nz * lanes.m_veloc[2]));
+		const ndVector cn(plane.m_nx * correction[0] + plane.m_ny * correction[1] + plane.m_nz * correction[2]);
+		const ndVector approachMask(plane.m_mask & (approach > epsilon));
+		const ndVector time((maxPenetration - plane.m_depth + cn) * approach.GetMax(epsilon).Reciproc());
+		timeOfImpact = timeOfImpact.Select(timeOfImpact.GetMin(time), approachMask);
+	}
+	timeOfImpact = timeOfImpact.GetMax(minStep);
+
+	for (ndInt32 i = 0; i < 3; ++i)
+	{
+		lanes.m_posit[i] = lanes.m_posit[i] + correction[i] + lanes.m_veloc[i] * timeOfImpact;
+	}
+	lanes.m_onFloor = hasGround | stepped;
+	lanes.m_airborne = ndVector::m_xyzwMask.AndNot(hasContacts | stepped);
+}
+
+void ndPlayerCapsuleCrowd::ScatterLane(const ndLanes& lanes, ndInt32 lane, ndBodyPlayerCapsule* const player) const
+{
+	ndMatrix matrix(player->GetMatrix());
+	ndVector veloc(ndVector::m_zero);
+	for (ndInt32 i = 0; i < 3; ++i)
+	{
+		matrix.m_posit[i] = lanes.m_posit[i][lane];
+		veloc[i] = lanes.m_veloc[i][lane];
+	}
+	player->SetMatrix(matrix);
+	player->SetVelocity(veloc);
+
+	player->m_isOnFloor = (lanes.m_onFloor.GetSignMask() >> lane) & 1;
+	player->m_isAirbone = (lanes.m_airborne.GetSignMask() >> lane) & 1;
+	if (player->m_isAirbone || !player->m_isOnFloor)
+	{
+		player->m_equilibriumOverride = 1;
+	}
+}
@@ -0,0 +1,82 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef __ND_PLAYER_CAPSULE_CROWD_H__
+#define __ND_PLAYER_CAPSULE_CROWD_H__
+
+#include "ndCollisionStdafx.h"
+
+class ndScene;
+class ndBodyPlayerCapsule;
+
+// updates many player capsules together, four at a time, one per simd lane.
+// players that only touch static bodies are solved against the contact planes
+// the scene calculated for them, with the step up, the ground traction and the
+// penetration recovery done for the four lanes at once.
+// players touching a dynamic body, or another player, take the full path
+// of ndBodyPlayerCapsule on that step.
+// the crowd is added to the scene, and it is updated before the special bodies.
+D_MSV_NEWTON_ALIGN_32
+class ndPlayerCapsuleCrowd: public ndClassAlloc
+{
+	public:
+	D_COLLISION_API ndPlayerCapsuleCrowd();
+	D_COLLISION_API virtual ~ndPlayerCapsuleCrowd();
+
+	D_COLLISION_API void AddPlayer(ndBodyPlayerCapsule* const player);
+	D_COLLISION_API void RemovePlayer(ndBodyPlayerCapsule* const player);
+
+	ndInt32 GetPlayerCount() const;
+
+	// players solved by the crowd on the last step
+	ndInt32 GetBatchedCount() const;
+
+	private:
+	class ndGroup;
+	class ndLanes;
+
+	void BuildGroups();
+	void Update(ndScene* const scene, ndFloat32 timestep);
+	bool GatherLane(ndLanes& lanes, ndInt32 lane, ndBodyPlayerCapsule* const player, ndFloat32 timestep) const;
+	void SolveLanes(ndLanes& lanes, const ndGroup& group, ndFloat32 timestep) const;
+	void ScatterLane(const ndLanes& lanes, ndInt32 lane, ndBodyPlayerCapsule* const player) const;
+	ndInt32 UpdateGroup(ndInt32 groupIndex, ndFloat32 timestep);
+
+	ndArray<ndBodyPlayerCapsule*> m_players;
+	ndArray<ndGroup> m_groups;
+	ndScene* m_scene;
+	ndInt32 m_batchedCount;
+	bool m_groupsDirty;
+
+	friend class ndScene;
+} D_GCC_NEWTON_ALIGN_32;
+
+inline ndInt32 ndPlayerCapsuleCrowd::GetPlayerCount() const
+{
+	return ndInt32(m_players.GetCount());
+}
+
+inline ndInt32 ndPlayerCapsuleCrowd::GetBatchedCount() const
+{
+	return m_batchedCount;
+}
+
+#endif
@@ -32,11 +32,13 @@
 #include "ndBodyParticleSet.h"
 #include "ndConvexCastNotify.h"
 #include "ndBodyTriggerVolume.h"
+#include "ndPlayerCapsuleCrowd.h"
 #include "ndBodiesInAabbNotify.h"
 #include "ndJointBilateralConstraint.h"
 #include "ndShapeStaticProceduralMesh.h"
 
 #define D_CONTACT_DELAY_FRAMES		4
+#define D_SCENE_MAX_SPECIAL_BATCHES	64
 #define D_NARROW_PHASE_DIST			ndFloat32 (0.2f)
 #define D_CONTACT_TRANSLATION_ERROR	ndFloat32 (1.0e-3f)
 #define D_CONTACT_ANGULAR_ERROR		(ndFloat32 (0.25f * ndDegreeToRad))
@@ -101,7 +103,7 @@ ndScene::ndScene(const ndScene& src)
 	ndScene* const stealData = (ndScene*)&src;
 
 	SetThreadCount(src.GetThreadCount());
-	m_backgroundThread.SetThreadCount(m_backgroundThread.GetThreadCount());
+	m_backgroundThread.SetThreadCount(src.m_backgroundThread.GetThreadCount());
 
 	m_scratchBuffer.Swap(stealData->m_scratchBuffer);
 	m_sceneBodyArray.Swap(stealData->m_sceneBodyArray);
@@ -129,6 +131,12 @@ ndScene::ndScene(const ndScene& src)
 		particle->m_listNode = m_particleSetList.Append(node);
 	}
 
+	m_playerCrowds.Swap(stealData->m_playerCrowds);
+	for (ndInt32 i = 0; i < m_playerCrowds.GetCount(); ++i)
+	{
+		m_playerCrowds[i]->m_scene = this;
+	}
+
 	for (ndBodyListView::ndNode* node = m_bodyList.GetFirst(); node; node = node->GetNext())
 	{
 		ndBodyKinematic* const body = node->GetInfo()->GetAsBodyKinematic();
@@ -187,6 +195,8 @@ bool ndScene::RemoveParticle(ndSharedPtr<ndBody>& particle)
 {
 	ndBodyParticleSet* const particleSet = particle->GetAsBodyParticleSet();
 	ndAssert(particleSet->m_listNode);
+	// the set may still be updating in the background
+	particleSet->Sync();
 	m_particleSetList.Remove(particleSet->m_listNode);
 	return true;
 }
@@ -281,6 +291,13 @@ bool ndScene::RemoveBody(ndSharedPtr<ndBody>& body)
 		while (contactMap.GetRoot())
 		{
 			ndContact* const contact = contactMap.GetRoot()->GetInfo();
+			if (contact->m_inTrigger)
+			{
+				// there is no exit call back, but the trigger must forget the body
+				ndBodyTriggerVolume* const trigger = contact->GetBody1()->GetAsBodyTriggerVolume();
+				ndAssert(trigger);
+				trigger->RemoveOverlap(contact->GetBody0());
+			}
 			m_contactArray.DetachContact(contact);
 		}
 
@@ -346,7 +363,8 @@ bool ndScene::ValidateContactCache(ndContact* const contact, const ndVector& tim
 {
 	ndAssert(contact && (contact->GetAsContact()));
 
-	if (contact->m_maxDOF)
+	// a body inside a trigger stays inside until it moves more than the cache tolerance
+	if (contact->m_maxDOF || contact->m_inTrigger)
 	{
 		ndBodyKinematic* const body0 = contact->GetBody0();
 		ndBodyKinematic* const body1 = contact->GetBody1();
@@ -397,20 +415,32 @@ void ndScene::CalculateJointContacts(ndInt32 threadIndex, ndContact* const conta
 		ndContactSolver contactSolver(contact, m_contactNotifyCallback, m_timestep, threadIndex);
 		contactSolver.m_separatingVector = contact->m_separatingVector;
 		contactSolver.m_contactBuffer = contactBuffer;
-		contactSolver.m_intersectionTestOnly = body0->m_contactTestOnly | body1->m_contactTestOnly;
+		const ndUnsigned32 testOnly = body0->m_contactTestOnly | body1->m_contactTestOnly;
+		contactSolver.m_intersectionTestOnly = testOnly;
+
+		// player capsules solve their own contacts, but they read the manifold from here
+		const bool keepManifold = testOnly && (body0->GetAsBodyPlayerCapsule() || body1->GetAsBodyPlayerCapsule()) && !body1->GetAsBodyTriggerVolume();
+		if (keepManifold)
+		{
+			contactSolver.m_intersectionTestOnly = 0;
+		}
 
 		ndInt32 count = contactSolver.CalculateContactsDiscrete ();
 		if (count)
 		{
 			contact->SetActive(true);
-			if (contactSolver.m_intersectionTestOnly)
+			if (testOnly)
 			{
 				ndBodyTriggerVolume* const trigger = body1->GetAsBodyTriggerVolume();
 				if (trigger && !contact->m_inTrigger)
 				{
 					contact->m_inTrigger = 1;
 					//ndAssert(contact->m_isIntersetionTestOnly);
-					trigger->OnTriggerEnter(body0, m_timestep);
+					AddTriggerEvent(threadIndex, trigger, body0, ndTriggerEvent::m_enter);
+				}
+				if (keepManifold)
+				{
+					StoreManifold(count, &contactSolver);
 				}
 				contact->m_isIntersetionTestOnly = 1;
 			}
@@ -424,15 +454,10 @@ void ndScene::CalculateJointContacts(ndInt32 threadIndex, ndContact* const conta
 		}
 		else
 		{
-			if (contactSolver.m_intersectionTestOnly)
+			if (testOnly)
 			{
-				ndBodyTriggerVolume* const trigger = body1->GetAsBodyTriggerVolume();
-				if (trigger && contact->m_inTrigger)
-				{
-					contact->m_inTrigger = 0;
-					ndAssert(contact->m_isIntersetionTestOnly);
-					trigger->GetAsBodyTriggerVolume()->OnTriggerExit(body0, m_timestep);
-				}
+				ndAssert(!contact->m_inTrigger || contact->m_isIntersetionTestOnly);
+				ExitTrigger(threadIndex, contact);
 				contact->m_isIntersetionTestOnly = 1;
 			}
 			contact->m_maxDOF = 0;
@@ -440,6 +465,30 @@ void ndScene::CalculateJointContacts(ndInt32 threadIndex, ndContact* const conta
 	}
 }
 
+void ndScene::ExitTrigger(ndInt32 threadIndex, ndContact* const contact)
+{
+	if (contact->m_inTrigger)
+	{
+		ndBodyTriggerVolume* const trigger = contact->GetBody1()->GetAsBodyTriggerVolume();
+		ndAssert(trigger);
+		contact->m_inTrigger = 0;
+		AddTriggerEvent(threadIndex, trigger, contact->GetBody0(), ndTriggerEvent::m_exit);
+	}
+}
+
+void ndScene::StoreManifold(ndInt32 contactCount, ndContactSolver* const contactSolver)
+{
+	// the points of a test only contact are never solved, so there
+	// is nothing to keep from the previous frame.
+	ndContactPointList& contactPointList = contactSolver->m_contact->m_contacPointsList;
+	contactPointList.RemoveAll();
+	for (ndInt32 i = 0; i < contactCount; ++i)
+	{
+		ndContactPoint& contactPoint = contactPointList.Append()->GetInfo();
+		contactPoint = contactSolver->m_contactBuffer[i];
+	}
+}
+
 void ndScene::ProcessContacts(ndInt32, ndInt32 contactCount, ndContactSolver* const contactSolver)
 {
 	ndContact* const contact = contactSolver->m_contact;
@@ -864,6 +913,7 @@ void ndScene::CalculateContacts(ndInt32 threadIndex, ndContact* const contact)
 				else if (contact->m_sceneLru < lru) 
 				{
 					contact->m_isDead = 1;
+					ExitTrigger(threadIndex, contact);
 				}
 			}
 		}
@@ -892,19 +942,224 @@ void ndScene::CalculateContacts(ndInt32 threadIndex, ndContact* const contact)
 		if (!ndOverlapTest(bodyNode0->m_minBox, bodyNode0->m_maxBox, bodyNode1->m_minBox, bodyNode1->m_maxBox))
 		{
 			contact->m_isDead = 1;
+			ExitTrigger(threadIndex, contact);
 		}
 	}
 }
 
-void ndScene::UpdateSpecial()
+void ndScene::BuildSpecialUpdateBatches()
 {
+	D_TRACKTIME();
+	// special bodies read the state of the special bodies they touch, so two
+	// bodies in contact go to different batches. trigger volumes only read
+	// their contacts, so they never conflict with anything.
+	const ndInt32 maxColors = D_SCENE_MAX_SPECIAL_BATCHES;
+	const ndArray<ndBodyKinematic*>& view = GetActiveBodyArray();
+	m_specialUpdateColors.SetCount(view.GetCount());
+	for (ndSpecialList<ndBodyKinematic>::ndNode* node = m_specialUpdateList.GetFirst(); node; node = node->GetNext())
+	{
+		m_specialUpdateColors[node->GetInfo()->m_index] = 0xff;
+	}
+
+	ndInt32 histogram[D_SCENE_MAX_SPECIAL_BATCHES + 1];
+	for (ndInt32 i = 0; i <= maxColors; ++i)
+	{
+		histogram[i] = 0;
+	}
+
+	for (ndSpecialList<ndBodyKinematic>::ndNode* node = m_specialUpdateList.GetFirst(); node; node = node->GetNext())
+	{
+		ndBodyKinematic* const body = node->GetInfo();
+		ndInt32 color = 0;
+		if (!body->GetAsBodyTriggerVolume())
+		{
+			ndUnsigned64 used = 0;
+			ndBodyKinematic::ndContactMap::Iterator it(body->GetContactMap());
+			for (it.Begin(); it; it++)
+			{
+				const ndContact* const contact = *it;
+				if (contact->IsActive())
+				{
+					const ndBodyKinematic* const other = (contact->GetBody0() == body) ? contact->GetBody1() : contact->GetBody0();
+					if (other->m_spetialUpdateNode && !((ndBodyKinematic*)other)->GetAsBodyTriggerVolume())
+					{
+						const ndInt32 otherColor = m_specialUpdateColors[other->m_index];
+						if (otherColor < maxColors)
+						{
+							used |= ndUnsigned64(1) << otherColor;
+						}
+					}
+				}
+			}
+			while ((color < maxColors) && (used & (ndUnsigned64(1) << color)))
+			{
+				color++;
+			}
+		}
+		m_specialUpdateColors[body->m_index] = ndUnsigned8(color);
+		histogram[color]++;
+	}
+
+	// the bodies that ran out of colors go to the last batch, it is updated in one thread
+	ndInt32 sum = 0;
+	m_specialUpdateBatches.SetCount(0);
+	for (ndInt32 i = 0; i <= maxColors; ++i)
+	{
+		const ndInt32 start = sum;
+		sum += histogram[i];
+		histogram[i] = start;
+		if ((sum > start) || (i == maxColors))
+		{
+			m_specialUpdateBatches.PushBack(start);
+		}
+	}
+	m_specialUpdateBatches.PushBack(sum);
+
+	// stable sort by color, so that the update order only depends on the list order
+	m_specialUpdateArray.SetCount(sum);
 	for (ndSpecialList<ndBodyKinematic>::ndNode* node = m_specialUpdateList.GetFirst(); node; node = node->GetNext())
 	{
 		ndBodyKinematic* const body = node->GetInfo();
-		body->SpecialUpdate(m_timestep);
+		const ndInt32 color = m_specialUpdateColors[body->m_index];
+		m_specialUpdateArray[histogram[color]] = body;
+		histogram[color]++;
 	}
 }
 
+void ndScene::ApplySpecialReactions()
+{
+	// each thread updates a contiguous run of the batch, so going
+	// over the queues in thread order is the same as the batch order.
+	for (ndInt32 i = 0; i < GetThreadCount(); ++i)
+	{
+		ndArray<ndSpecialReaction>& reactions = m_specialReactions[i];
+		for (ndInt32 j = 0; j < reactions.GetCount(); ++j)
+		{
+			const ndSpecialReaction& reaction = reactions[j];
+			ndBodyKinematic* const body = reaction.m_body;
+			body->SetForce(body->GetForce() + reaction.m_force);
+			body->SetTorque(body->GetTorque() + reaction.m_torque);
+		}
+		reactions.SetCount(0);
+	}
+}
+
+void ndScene::FlushTriggerEvents()
+{
+	class ndCompareEvents
+	{
+		public:
+		ndInt32 Compare(const ndTriggerEvent& event0, const ndTriggerEvent& event1, void* const) const
+		{
+			const ndUnsigned32 trigger0 = event0.m_trigger->GetId();
+			const ndUnsigned32 trigger1 = event1.m_trigger->GetId();
+			if (trigger0 != trigger1)
+			{
+				return (trigger0 < trigger1) ? -1 : 1;
+			}
+			if (event0.m_type != event1.m_type)
+			{
+				return (event0.m_type < event1.m_type) ? -1 : 1;
+			}
+			const ndUnsigned32 body0 = event0.m_body ? event0.m_body->GetId() : 0;
+			const ndUnsigned32 body1 = event1.m_body ? event1.m_body->GetId() : 0;
+			if (body0 != body1)
+			{
+				return (body0 < body1) ? -1 : 1;
+			}
+			return 0;
+		}
+	};
+
+	// the enter and exit events come from the contact calculation, which
+	// does not run in a fixed order, so sort the events before calling back.
+	// the inside events are one per trigger, the trigger keeps the bodies inside.
+	ndArray<ndTriggerEvent>& events = m_triggerEvents[0];
+	for (ndInt32 i = 1; i < GetThreadCount(); ++i)
+	{
+		ndArray<ndTriggerEvent>& threadEvents = m_triggerEvents[i];
+		for (ndInt32 j = 0; j < threadEvents.GetCount(); ++j)
+		{
+			events.PushBack(threadEvents[j]);
+		}
+		threadEvents.SetCount(0);
+	}
+
+	if (events.GetCount())
+	{
+		D_TRACKTIME();
+		ndSort<ndTriggerEvent, ndCompareEvents>(&events[0], ndInt32(events.GetCount()), nullptr);
+		for (ndInt32 i = 0; i < events.GetCount(); )
+		{
+			ndBodyTriggerVolume* const trigger = events[i].m_trigger;
+			for (; (i < events.GetCount()) && (events[i].m_trigger == trigger); ++i)
+			{
+				const ndTriggerEvent& event = events[i];
+				switch (event.m_type)
+				{
+					case ndTriggerEvent::m_enter:
+						trigger->m_enterBodies.PushBack(event.m_body);
+						break;
+					case ndTriggerEvent::m_exit:
+						trigger->m_exitBodies.PushBack(event.m_body);
+						break;
+					case ndTriggerEvent::m_inside:
+						break;
+				}
+			}
+
+			trigger->UpdateOverlaps();
+			trigger->OnTriggerEvents(m_timestep);
+			trigger->m_enterBodies.SetCount(0);
+			trigger->m_exitBodies.SetCount(0);
+		}
+		events.SetCount(0);
+	}
+}
+
+void ndScene::UpdateSpecial()
+{
+	D_TRACKTIME();
+	// the crowds move the players that only touch static bodies,
+	// the special update skips them.
+	for (ndInt32 i = 0; i < m_playerCrowds.GetCount(); ++i)
+	{
+		m_playerCrowds[i]->Update(this, m_timestep);
+	}
+
+	BuildSpecialUpdateBatches();
+	for (ndInt32 batch = 0; batch < m_specialUpdateBatches.GetCount() - 1; ++batch)
+	{
+		const ndInt32 start = m_specialUpdateBatches[batch];
+		const ndInt32 count = m_specialUpdateBatches[batch + 1] - start;
+		auto UpdateSpecial = ndMakeObject::ndFunction([this, start, count](ndInt32 threadIndex, ndInt32 threadCount)
+		{
+			D_TRACKTIME_NAMED(UpdateSpecial);
+			const ndFloat32 timestep = m_timestep;
+			ndBodyKinematic** const bodies = &m_specialUpdateArray[start];
+			const ndStartEnd startEnd(count, threadIndex, threadCount);
+			for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+			{
+				bodies[i]->SpecialUpdate(threadIndex, timestep);
+			}
+		});
+
+		if (count)
+		{
+			if (batch < m_specialUpdateBatches.GetCount() - 2)
+			{
+				ParallelExecute(UpdateSpecial);
+			}
+			else
+			{
+				UpdateSpecial(0, 1);
+			}
+			ApplySpecialReactions();
+		}
+	}
+	FlushTriggerEvents();
+}
+
 bool ndScene::ConvexCast(ndConvexCastNotify& callback, const ndBvhNode** stackPool, ndFloat32* const stackDistance, ndInt32 stack, const ndFastRay& ray, const ndShapeInstance& convexShape, const ndMatrix& globalOrigin, const ndVector& globalDest) const
 {
 	ndVector boxP0;
@@ -1170,6 +1425,12 @@ void ndScene::Cleanup()
 	m_frameNumber = 0;
 	m_subStepNumber = 0;
 
+	for (ndInt32 i = 0; i < m_playerCrowds.GetCount(); ++i)
+	{
+		m_playerCrowds[i]->m_scene = nullptr;
+	}
+	m_playerCrowds.SetCount(0);
+
 	if (m_sentinelBody)
 	{
 		delete m_sentinelBody;
@@ -1244,6 +1505,35 @@ bool ndScene::ConvexCast(ndConvexCastNotify& callback, const ndShapeInstance& co
 	return state;
 }
 
+void ndScene::AddPlayerCrowd(ndPlayerCapsuleCrowd* const crowd)
+{
+	ndAssert(!crowd->m_scene);
+	if (!crowd->m_scene)
+	{
+		crowd->m_scene = this;
+		m_playerCrowds.PushBack(crowd);
+	}
+}
+
+void ndScene::RemovePlayerCrowd(ndPlayerCapsuleCrowd* const crowd)
+{
+	ndAssert(crowd->m_scene == this);
+	for (ndInt32 i = 0; i < m_playerCrowds.GetCount(); ++i)
+	{
+		if (m_playerCrowds[i] == crowd)
+		{
+			// keep the update order of the other crowds
+			for (ndInt32 j = i + 1; j < m_playerCrowds.GetCount(); ++j)
+			{
+				m_playerCrowds[j - 1] = m_playerCrowds[j];
+			}
+			m_playerCrowds.SetCount(m_playerCrowds.GetCount() - 1);
+			crowd->m_scene = nullptr;
+			break;
+		}
+	}
+}
+
 void ndScene::SendBackgroundTask(ndBackgroundTask* const job)
 {
 	m_backgroundThread.SendTask(job);
@@ -1780,3 +2070,13 @@ void ndScene::ParticleUpdate(ndFloat32 timestep)
 		body->Update(this, timestep);
 	}
 }
+
+void ndScene::ParticleSync()
+{
+	D_TRACKTIME();
+	for (ndBodyList::ndNode* node = m_particleSetList.GetFirst(); node; node = node->GetNext())
+	{
+		ndBodyParticleSet* const body = node->GetInfo()->GetAsBodyParticleSet();
+		body->SyncUpdate(this);
+	}
+}
@@ -36,6 +36,8 @@ class ndContact;
 class ndRayCastNotify;
 class ndContactNotify;
 class ndConvexCastNotify;
+class ndBodyTriggerVolume;
+class ndPlayerCapsuleCrowd;
 class ndBodiesInAabbNotify;
 class ndJointBilateralConstraint;
 
@@ -72,6 +74,29 @@ class ndScene : public ndThreadPool
 	};
 
 	public:
+	class ndSpecialReaction
+	{
+		public:
+		ndBodyKinematic* m_body;
+		ndVector m_force;
+		ndVector m_torque;
+	};
+
+	class ndTriggerEvent
+	{
+		public:
+		enum ndType
+		{
+			m_enter,
+			m_inside, // one per trigger, with no body
+			m_exit,
+		};
+
+		ndBodyTriggerVolume* m_trigger;
+		ndBodyKinematic* m_body;
+		ndType m_type;
+	};
+
 	D_COLLISION_API virtual ~ndScene();
 	D_COLLISION_API virtual bool AddBody(ndSharedPtr<ndBody>& body);
 	D_COLLISION_API virtual bool RemoveBody(ndSharedPtr<ndBody>& body);
@@ -98,6 +123,16 @@ class ndScene : public ndThreadPool
 
 	D_COLLISION_API void SendBackgroundTask(ndBackgroundTask* const job);
 
+	// the crowds are not owned by the scene
+	D_COLLISION_API void AddPlayerCrowd(ndPlayerCapsuleCrowd* const crowd);
+	D_COLLISION_API void RemovePlayerCrowd(ndPlayerCapsuleCrowd* const crowd);
+
+	// special bodies are updated in parallel, so they can not write to other bodies.
+	// the forces they apply to other bodies and the trigger events are queued per thread,
+	// and applied in a fixed order after the update.
+	void AddSpecialReaction(ndInt32 threadIndex, ndBodyKinematic* const body, const ndVector& force, const ndVector& torque);
+	void AddTriggerEvent(ndInt32 threadIndex, ndBodyTriggerVolume* const trigger, ndBodyKinematic* const body, ndTriggerEvent::ndType type);
+
 	ndInt32 GetThreadCount() const;
 
 	virtual ndWorld* GetWorld() const;
@@ -129,7 +164,12 @@ class ndScene : public ndThreadPool
 	void SubmitPairs(ndBvhLeafNode* const bodyNode, ndBvhNode* const node, bool forward, ndInt32 threadId);
 
 	void CalculateJointContacts(ndInt32 threadIndex, ndContact* const contact);
+	void BuildSpecialUpdateBatches();
+	void ApplySpecialReactions();
+	void FlushTriggerEvents();
+	void ExitTrigger(ndInt32 threadIndex, ndContact* const contact);
 	void ProcessContacts(ndInt32 threadIndex, ndInt32 contactCount, ndContactSolver* const contactSolver);
+	void StoreManifold(ndInt32 contactCount, ndContactSolver* const contactSolver);
 
 	ndJointBilateralConstraint* FindBilateralJoint(ndBodyKinematic* const body0, ndBodyKinematic* const body1) const;
 	bool RayCast(ndRayCastNotify& callback, const ndBvhNode** stackPool, ndFloat32* const distance, ndInt32 stack, const ndFastRay& ray) const;
@@ -150,6 +190,7 @@ class ndScene : public ndThreadPool
 	D_COLLISION_API virtual void CalculateContacts(ndInt32 threadIndex, ndContact* const contact);
 	D_COLLISION_API virtual void UpdateTransformNotify(ndInt32 threadIndex, ndBodyKinematic* const body);
 
+	D_COLLISION_API virtual void ParticleSync();
 	D_COLLISION_API virtual void ParticleUpdate(ndFloat32 timestep);
 	D_COLLISION_API virtual bool AddParticle(ndSharedPtr<ndBody>& particle);
 	D_COLLISION_API virtual bool RemoveParticle(ndSharedPtr<ndBody>& particle);
@@ -165,6 +206,12 @@ class ndScene : public ndThreadPool
 	ndThreadBackgroundWorker m_backgroundThread;
 	ndArray<ndContactPairs> m_newPairs;
 	ndArray<ndContactPairs> m_partialNewPairs[D_MAX_THREADS_COUNT];
+	ndArray<ndBodyKinematic*> m_specialUpdateArray;
+	ndArray<ndInt32> m_specialUpdateBatches;
+	ndArray<ndUnsigned8> m_specialUpdateColors;
+	ndArray<ndSpecialReaction> m_specialReactions[D_MAX_THREADS_COUNT];
+	ndArray<ndTriggerEvent> m_triggerEvents[D_MAX_THREADS_COUNT];
+	ndArray<ndPlayerCapsuleCrowd*> m_playerCrowds;
 	ndPolygonMeshDesc::ndStaticMeshFaceQuery m_staticMeshQuery[D_MAX_THREADS_COUNT];
 	ndPolygonMeshDesc::ndProceduralStaticMeshFaceQuery m_proceduralStaticMeshQuery[D_MAX_THREADS_COUNT];
 
@@ -271,4 +318,22 @@ inline ndBodyKinematic* ndScene::GetSentinelBody() const
 	return m_sentinelBody;
 }
 
+inline void ndScene::AddSpecialReaction(ndInt32 threadIndex, ndBodyKinematic* const body, const ndVector& force, const ndVector& torque)
+{
+	ndSpecialReaction reaction;
+	reaction.m_body = body;
+	reaction.m_force = force;
+	reaction.m_torque = torque;
+	m_specialReactions[threadIndex].PushBack(reaction);
+}
+
+inline void ndScene::AddTriggerEvent(ndInt32 threadIndex, ndBodyTriggerVolume* const trigger, ndBodyKinematic* const body, ndTriggerEvent::ndType type)
+{
+	ndTriggerEvent event;
+	event.m_trigger = trigger;
+	event.m_body = body;
+	event.m_type = type;
+	m_triggerEvents[threadIndex].PushBack(event);
+}
+
 #endif
@@ -0,0 +1,669 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "ndCoreStdafx.h"
+#include "ndCollisionStdafx.h"
+#include "ndShapeBox.h"
+#include "ndShapeCone.h"
+#include "ndShapeSphere.h"
+#include "ndShapeCapsule.h"
+#include "ndShapeCylinder.h"
+#include "ndShapeCompound.h"
+#include "ndShapeInstance.h"
+#include "ndShapeConvexHull.h"
+#include "ndShapeStatic_bvh.h"
+#include "ndShapeHeightfield.h"
+#include "ndShapeBinaryFormat.h"
+#include "ndShapeChamferCylinder.h"
+
+#if !(defined (WIN32) || defined(_WIN32) || defined (_M_ARM) || defined (_M_ARM64))
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+class ndConvexParams
+{
+	public:
+	ndFloat32 m_param[4];
+};
+
+class ndStaticBvhParams
+{
+	public:
+	ndVector m_boxSize;
+	ndVector m_boxOrigin;
+	ndVector m_wideOrigin;
+	ndVector m_wideScale;
+	ndVector m_wideInvScale;
+	ndInt32 m_vertexCount;
+	ndInt32 m_indexCount;
+	ndInt32 m_nodesCount;
+	ndInt32 m_wideNodesCount;
+	ndInt32 m_trianglesCount;
+};
+
+class ndHeightfieldParams
+{
+	public:
+	ndFloat32 m_horizontalScale_x;
+	ndFloat32 m_horizontalScale_z;
+	ndInt32 m_width;
+	ndInt32 m_height;
+	ndInt32 m_diagonalMode;
+};
+
+class ndInstanceParams
+{
+	public:
+	ndMatrix m_localMatrix;
+	ndMatrix m_alignmentMatrix;
+	ndVector m_scale;
+	ndShapeMaterial m_material;
+	ndFloat32 m_skinMargin;
+	ndInt32 m_scaleType;
+	ndInt32 m_collisionMode;
+};
+
+static ndUnsigned64 ndAlignChunk(ndUnsigned64 offset)
+{
+	return (offset + D_SHAPE_BINARY_ALIGNMENT - 1) & ~ndUnsigned64(D_SHAPE_BINARY_ALIGNMENT - 1);
+}
+
+class ndShapeBinaryFormat::ndWriter
+{
+	public:
+	ndWriter(ndInt32 shapeId)
+		:m_chunks()
+		,m_payload()
+		,m_shapeId(shapeId)
+	{
+	}
+
+	void AddChunk(ndInt32 id, ndInt32 count, const void* const data, ndUnsigned64 size)
+	{
+		ndChunk chunk;
+		chunk.m_id = id;
+		chunk.m_count = count;
+		chunk.m_offset = ndAlignChunk(ndUnsigned64(m_payload.GetCount()));
+		chunk.m_size = size;
+		chunk.m_reserved = 0;
+
+		const ndInt32 start = m_payload.GetCount();
+		m_payload.SetCount(ndInt32(chunk.m_offset + size));
+		memset(&m_payload[start], 0, size_t(chunk.m_offset) - size_t(start));
+		if (size)
+		{
+			memcpy(&m_payload[ndInt32(chunk.m_offset)], data, size_t(size));
+		}
+		m_chunks.PushBack(chunk);
+	}
+
+	template <class T>
+	void AddParams(const T& params)
+	{
+		AddChunk(m_params, 1, &params, sizeof(T));
+	}
+
+	void Finalize(ndArray<ndUnsigned8>& buffer) const
+	{
+		const ndUnsigned64 dataStart = ndAlignChunk(sizeof(ndHeader) + sizeof(ndChunk) * ndUnsigned64(m_chunks.GetCount()));
+		const ndUnsigned64 size = dataStart + ndUnsigned64(m_payload.GetCount());
+		buffer.SetCount(ndInt32(size));
+		memset(&buffer[0], 0, size_t(size));
+
+		ndHeader header;
+		header.m_magic = D_SHAPE_BINARY_MAGIC;
+		header.m_version = D_SHAPE_BINARY_VERSION;
+		header.m_shapeId = m_shapeId;
+		header.m_chunkCount = m_chunks.GetCount();
+		header.m_floatSize = sizeof(ndFloat32);
+		header.m_reserved = 0;
+		header.m_size = size;
+		memcpy(&buffer[0], &header, sizeof(header));
+
+		for (ndInt32 i = 0; i < m_chunks.GetCount(); ++i)
+		{
+			ndChunk chunk(m_chunks[i]);
+			chunk.m_offset += dataStart;
+			memcpy(&buffer[ndInt32(sizeof(ndHeader) + i * sizeof(ndChunk))], &chunk, sizeof(chunk));
+		}
+		if (m_payload.GetCount())
+		{
+			memcpy(&buffer[ndInt32(dataStart)], &m_payload[0], size_t(m_payload.GetCount()));
+		}
+	}
+
+	ndArray<ndChunk> m_chunks;
+	ndArray<ndUnsigned8> m_payload;
+	ndInt32 m_shapeId;
+};
+
+class ndShapeBinaryFormat::ndReader
+{
+	public:
+	ndReader(const void* const buffer, ndInt64 size)
+		:m_buffer((const ndUnsigned8*)buffer)
+		,m_header(nullptr)
+		,m_chunks(nullptr)
+	{
+		if (!buffer || (size < ndInt64(sizeof(ndHeader))))
+		{
+			return;
+		}
+		ndAssert(!(ndUnsigned64(buffer) & (sizeof(ndUnsigned64) - 1)));
+
+		const ndHeader* const header = (const ndHeader*)m_buffer;
+		if ((header->m_magic != D_SHAPE_BINARY_MAGIC) || (header->m_version != D_SHAPE_BINARY_VERSION))
+		{
+			return;
+		}
+		if ((header->m_floatSize != sizeof(ndFloat32)) || (header->m_size > ndUnsigned64(size)) || (header->m_chunkCount < 0))
+		{
+			return;
+		}
+		if ((sizeof(ndHeader) + sizeof(ndChunk) * ndUnsigned64(header->m_chunkCount)) > header->m_size)
+		{
+			return;
+		}
+
+		const ndChunk* const chunks = (const ndChunk*)(m_buffer + sizeof(ndHeader));
+		for (ndInt32 i = 0; i < header->m_chunkCount; ++i)
+		{
+			if ((chunks[i].m_offset > header->m_size) || (chunks[i].m_size > (header->m_size - chunks[i].m_offset)))
+			{
+				return;
+			}
+		}
+
+		m_header = header;
+		m_chunks = chunks;
+	}
+
+	bool IsValid() const
+	{
+		return m_header ? true : false;
+	}
+
+	const ndChunk* Find(ndInt32 id) const
+	{
+		for (ndInt32 i = 0; i < m_header->m_chunkCount; ++i)
+		{
+			if (m_chunks[i].m_id == id)
+			{
+				return &m_chunks[i];
+			}
+		}
+		return nullptr;
+	}
+
+	const void* GetData(const ndChunk* const chunk) const
+	{
+		return m_buffer + chunk->m_offset;
+	}
+
+	template <class T>
+	bool GetParams(T& params) const
+	{
+		const ndChunk* const chunk = Find(m_params);
+		if (!chunk || (chunk->m_size != sizeof(T)))
+		{
+			return false;
+		}
+		memcpy(&params, GetData(chunk), sizeof(T));
+		return true;
+	}
+
+	const ndUnsigned8* m_buffer;
+	const ndHeader* m_header;
+	const ndChunk* m_chunks;
+};
+
+#if (defined (WIN32) || defined(_WIN32) || defined (_M_ARM) || defined (_M_ARM64))
+ndShapeBinaryFormat::ndMappedFile::ndMappedFile(const char* const path)
+	:ndClassAlloc()
+	,m_data(nullptr)
+	,m_size(0)
+	,m_file(INVALID_HANDLE_VALUE)
+	,m_mapping(nullptr)
+{
+	m_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		LARGE_INTEGER size;
+		GetFileSizeEx(m_file, &size);
+		m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+		if (m_mapping)
+		{
+			m_data = MapViewOfFile(m_mapping, FILE_MAP_COPY, 0, 0, 0);
+			m_size = m_data ? ndInt64(size.QuadPart) : 0;
+		}
+	}
+}
+
+ndShapeBinaryFormat::ndMappedFile::~ndMappedFile()
+{
+	if (m_data)
+	{
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mapping)
+	{
+		CloseHandle(m_mapping);
+	}
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+	}
+}
+#else
+ndShapeBinaryFormat::ndMappedFile::ndMappedFile(const char* const path)
+	:ndClassAlloc()
+	,m_data(nullptr)
+	,m_size(0)
+{
+	const ndInt32 file = open(path, O_RDONLY);
+	if (file >= 0)
+	{
+		struct stat info;
+		if (!fstat(file, &info) && (info.st_size > 0))
+		{
+			void* const data = mmap(nullptr, size_t(info.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+			if (data != MAP_FAILED)
+			{
+				m_data = data;
+				m_size = ndInt64(info.st_size);
+			}
+		}
+		// the mapping stays valid after the file is closed
+		close(file);
+	}
+}
+
+ndShapeBinaryFormat::ndMappedFile::~ndMappedFile()
+{
+	if (m_data)
+	{
+		munmap(m_data, size_t(m_size));
+	}
+}
+#endif
+
+bool ndShapeBinaryFormat::Save(const ndShape* const shape, ndArray<ndUnsigned8>& buffer)
+{
+	const ndShapeInfo info(shape->GetShapeInfo());
+	ndWriter writer(info.m_collisionType);
+	if (!SaveShape(shape, writer))
+	{
+		buffer.SetCount(0);
+		return false;
+	}
+	writer.Finalize(buffer);
+	return true;
+}
+
+bool ndShapeBinaryFormat::Save(const ndShape* const shape, const char* const path)
+{
+	ndArray<ndUnsigned8> buffer;
+	if (!Save(shape, buffer))
+	{
+		return false;
+	}
+
+	FILE* const file = fopen(path, "wb");
+	if (!file)
+	{
+		return false;
+	}
+	const size_t written = fwrite(&buffer[0], size_t(buffer.GetCount()), 1, file);
+	fclose(file);
+	return written == 1;
+}
+
+bool ndShapeBinaryFormat::SaveShape(const ndShape* const shape, ndWriter& writer)
+{
+	const ndShapeInfo info(shape->GetShapeInfo());
+
+	ndConvexParams convex;
+	memset(&convex, 0, sizeof(convex));
+	switch (info.m_collisionType)
+	{
+		case m_box:
+		{
+			convex.m_param[0] = info.m_box.m_x;
+			convex.m_param[1] = info.m_box.m_y;
+			convex.m_param[2] = info.m_box.m_z;
+			writer.AddParams(convex);
+			break;
+		}
+
+		case m_sphere:
+		{
+			convex.m_param[0] = info.m_sphere.m_radius;
+			writer.AddParams(convex);
+			break;
+		}
+
+		case m_capsule:
+		{
+			convex.m_param[0] = info.m_capsule.m_radio0;
+			convex.m_param[1] = info.m_capsule.m_radio1;
+			convex.m_param[2] = info.m_capsule.m_height;
+			writer.AddParams(convex);
+			break;
+		}
+
+		case m_cylinder:
+		{
+			convex.m_param[0] = info.m_cylinder.m_radio0;
+			convex.m_param[1] = info.m_cylinder.m_radio1;
+			convex.m_param[2] = info.m_cylinder.m_height;
+			writer.AddParams(convex);
+			break;
+		}
+
+		case m_cone:
+		{
+			convex.m_param[0] = info.m_cone.m_radius;
+			convex.m_param[1] = info.m_cone.m_height;
+			writer.AddParams(convex);
+			break;
+		}
+
+		case m_chamferCylinder:
+		{
+			convex.m_param[0] = info.m_chamferCylinder.m_r;
+			convex.m_param[1] = info.m_chamferCylinder.m_height;
+			writer.AddParams(convex);
+			break;
+		}
+
+		case m_convexHull:
+		{
+			const ndInt32 count = info.m_convexhull.m_vertexCount;
+			writer.AddChunk(m_vertex, count, info.m_convexhull.m_vertex, sizeof(ndVector) * ndUnsigned64(count));
+			break;
+		}
+
+		case m_boundingBoxHierachy:
+		{
+			const ndShapeStatic_bvh* const bvh = ((ndShape*)shape)->GetAsShapeStaticBVH();
+			ndStaticBvhParams params;
+			params.m_boxSize = bvh->m_boxSize;
+			params.m_boxOrigin = bvh->m_boxOrigin;
+			params.m_wideOrigin = bvh->m_wideOrigin;
+			params.m_wideScale = bvh->m_wideScale;
+			params.m_wideInvScale = bvh->m_wideInvScale;
+			params.m_vertexCount = bvh->m_vertexCount;
+			params.m_indexCount = bvh->m_indexCount;
+			params.m_nodesCount = bvh->m_nodesCount;
+			params.m_wideNodesCount = bvh->m_wideNodesCount;
+			params.m_trianglesCount = bvh->m_trianglesCount;
+			writer.AddParams(params);
+
+			writer.AddChunk(m_vertex, params.m_vertexCount, bvh->m_localVertex, sizeof(ndTriplex) * ndUnsigned64(params.m_vertexCount));
+			writer.AddChunk(m_indices, params.m_indexCount, bvh->m_indices, sizeof(ndInt32) * ndUnsigned64(params.m_indexCount));
+			writer.AddChunk(m_nodes, params.m_nodesCount, bvh->m_aabb, sizeof(ndAabbPolygonSoup::ndNode) * ndUnsigned64(params.m_nodesCount));
+			writer.AddChunk(m_wideNodes, params.m_wideNodesCount, bvh->m_wideNodes, sizeof(ndAabbPolygonSoup::ndWideNode) * ndUnsigned64(params.m_wideNodesCount));
+			break;
+		}
+
+		case m_heightField:
+		{
+			ndHeightfieldParams params;
+			params.m_horizontalScale_x = info.m_heightfield.m_horizonalScale_x;
+			params.m_horizontalScale_z = info.m_heightfield.m_horizonalScale_z;
+			params.m_width = info.m_heightfield.m_width;
+			params.m_height = info.m_heightfield.m_height;
+			params.m_diagonalMode = info.m_heightfield.m_gridsDiagonals;
+			writer.AddParams(params);
+
+			const ndInt32 count = params.m_width * params.m_height;
+			writer.AddChunk(m_elevation, count, info.m_heightfield.m_elevation, sizeof(ndReal) * ndUnsigned64(count));
+			writer.AddChunk(m_attributes, count, info.m_heightfield.m_atributes, sizeof(ndInt8) * ndUnsigned64(count));
+			break;
+		}
+
+		case m_compound:
+		{
+			ndShapeCompound* const compound = ((ndShape*)shape)->GetAsShapeCompound();
+			ndShapeCompound::ndTreeArray::Iterator it(compound->GetTree());
+			for (it.Begin(); it; it++)
+			{
+				const ndShapeInstance* const instance = compound->GetShapeInstance(it.GetNode());
+
+				ndInstanceParams params;
+				params.m_localMatrix = instance->m_localMatrix;
+				params.m_alignmentMatrix = instance->m_alignmentMatrix;
+				params.m_scale = instance->m_scale;
+				params.m_material = instance->m_shapeMaterial;
+				params.m_skinMargin = instance->m_skinMargin;
+				params.m_scaleType = ndInt32(instance->m_scaleType);
+				params.m_collisionMode = instance->m_collisionMode ? 1 : 0;
+				writer.AddChunk(m_childInstance, 1, &params, sizeof(params));
+
+				ndArray<ndUnsigned8> child;
+				if (!Save(instance->GetShape(), child))
+				{
+					return false;
+				}
+				writer.AddChunk(m_childShape, 1, &child[0], ndUnsigned64(child.GetCount()));
+			}
+			break;
+		}
+
+		default:
+			return false;
+	}
+	return true;
+}
+
+ndShape* ndShapeBinaryFormat::Load(const void* const buffer, ndInt64 size, bool zeroCopy)
+{
+	ndReader reader(buffer, size);
+	return reader.IsValid() ? LoadShape(reader, zeroCopy) : nullptr;
+}
+
+ndShape* ndShapeBinaryFormat::Load(const char* const path)
+{
+	ndMappedFile file(path);
+	return file.GetData() ? Load(file.GetData(), file.GetSize(), false) : nullptr;
+}
+
+ndShape* ndShapeBinaryFormat::LoadShape(const ndReader& reader, bool zeroCopy)
+{
+	ndConvexParams convex;
+	switch (reader.m_header->m_shapeId)
+	{
+		case m_box:
+			return reader.GetParams(convex) ? new ndShapeBox(convex.m_param[0], convex.m_param[1], convex.m_param[2]) : nullptr;
+
+		case m_sphere:
+			return reader.GetParams(convex) ? new ndShapeSphere(convex.m_param[0]) : nullptr;
+
+		case m_capsule:
+			return reader.GetParams(convex) ? new ndShapeCapsule(convex.m_param[0], convex.m_param[1], convex.m_param[2]) : nullptr;
+
+		case m_cylinder:
+			return reader.GetParams(convex) ? new ndShapeCylinder(convex.m_param[0], convex.m_param[1], convex.m_param[2]) : nullptr;
+
+		case m_cone:
+			return reader.GetParams(convex) ? new ndShapeCone(convex.m_param[0], convex.m_param[1]) : nullptr;
+
+		case m_chamferCylinder:
+			return reader.GetParams(convex) ? new ndShapeChamferCylinder(convex.m_param[0], convex.m_param[1]) : nullptr;
+
+		case m_convexHull:
+		{
+			const ndChunk* const chunk = reader.Find(m_vertex);
+			if (!chunk || (chunk->m_size != sizeof(ndVector) * ndUnsigned64(chunk->m_count)))
+			{
+				return nullptr;
+			}
+			return new ndShapeConvexHull(chunk->m_count, sizeof(ndVector), ndFloat32(0.0f), (const ndFloat32*)reader.GetData(chunk));
+		}
+
+		case m_boundingBoxHierachy:
+			return LoadStaticBvh(reader, zeroCopy);
+
+		case m_heightField:
+			return LoadHeightfield(reader);
+
+		case m_compound:
+			return LoadCompound(reader, zeroCopy);
+
+		default:
+			return nullptr;
+	}
+}
+
+ndShape* ndShapeBinaryFormat::LoadStaticBvh(const ndReader& reader, bool zeroCopy)
+{
+	ndStaticBvhParams params;
+	if (!reader.GetParams(params))
+	{
+		return nullptr;
+	}
+
+	const ndChunk* const vertex = reader.Find(m_vertex);
+	const ndChunk* const indices = reader.Find(m_indices);
+	const ndChunk* const nodes = reader.Find(m_nodes);
+	const ndChunk* const wideNodes = reader.Find(m_wideNodes);
+	if (!vertex || !indices || !nodes || !wideNodes)
+	{
+		return nullptr;
+	}
+	if ((vertex->m_size != sizeof(ndTriplex) * ndUnsigned64(params.m_vertexCount)) ||
+		(indices->m_size != sizeof(ndInt32) * ndUnsigned64(params.m_indexCount)) ||
+		(nodes->m_size != sizeof(ndAabbPolygonSoup::ndNode) * ndUnsigned64(params.m_nodesCount)) ||
+		(wideNodes->m_size != sizeof(ndAabbPolygonSoup::ndWideNode) * ndUnsigned64(params.m_wideNodesCount)))
+	{
+		return nullptr;
+	}
+
+	ndShapeStatic_bvh* const shape = new ndShapeStatic_bvh();
+	shape->m_boxSize = params.m_boxSize;
+	shape->m_boxOrigin = params.m_boxOrigin;
+	shape->m_wideOrigin = params.m_wideOrigin;
+	shape->m_wideScale = params.m_wideScale;
+	shape->m_wideInvScale = params.m_wideInvScale;
+	shape->m_strideInBytes = sizeof(ndTriplex);
+	shape->m_vertexCount = params.m_vertexCount;
+	shape->m_indexCount = params.m_indexCount;
+	shape->m_nodesCount = params.m_nodesCount;
+	shape->m_wideNodesCount = params.m_wideNodesCount;
+	shape->m_trianglesCount = params.m_trianglesCount;
+
+	if (!params.m_vertexCount)
+	{
+		return shape;
+	}
+
+	if (zeroCopy)
+	{
+		shape->m_externalData = true;
+		shape->m_localVertex = (ndFloat32*)reader.GetData(vertex);
+		shape->m_indices = (ndInt32*)reader.GetData(indices);
+		shape->m_aabb = (ndAabbPolygonSoup::ndNode*)reader.GetData(nodes);
+		shape->m_wideNodes = params.m_wideNodesCount ? (ndAabbPolygonSoup::ndWideNode*)reader.GetData(wideNodes) : nullptr;
+	}
+	else
+	{
+		shape->m_localVertex = (ndFloat32*)ndMemory::Malloc(size_t(vertex->m_size));
+		shape->m_indices = (ndInt32*)ndMemory::Malloc(size_t(indices->m_size));
+		shape->m_aabb = (ndAabbPolygonSoup::ndNode*)ndMemory::Malloc(size_t(nodes->m_size));
+		memcpy(shape->m_localVertex, reader.GetData(vertex), size_t(vertex->m_size));
+		memcpy(shape->m_indices, reader.GetData(indices), size_t(indices->m_size));
+		memcpy(shape->m_aabb, reader.GetData(nodes), size_t(nodes->m_size));
+		if (params.m_wideNodesCount)
+		{
+			shape->m_wideNodes = ndAabbPolygonSoup::AllocateWideNodes(params.m_wideNodesCount);
+			memcpy(shape->m_wideNodes, reader.GetData(wideNodes), size_t(wideNodes->m_size));
+		}
+	}
+	return shape;
+}
+
+ndShape* ndShapeBinaryFormat::LoadHeightfield(const ndReader& reader)
+{
+	ndHeightfieldParams params;
+	if (!reader.GetParams(params) || (params.m_width < 2) || (params.m_height < 2))
+	{
+		return nullptr;
+	}
+
+	const ndInt32 count = params.m_width * params.m_height;
+	const ndChunk* const elevation = reader.Find(m_elevation);
+	const ndChunk* const attributes = reader.Find(m_attributes);
+	if (!elevation || !attributes ||
+		(elevation->m_size != sizeof(ndReal) * ndUnsigned64(count)) ||
+		(attributes->m_size != sizeof(ndInt8) * ndUnsigned64(count)))
+	{
+		return nullptr;
+	}
+
+	ndShapeHeightfield* const shape = new ndShapeHeightfield(
+		params.m_width, params.m_height, ndShapeHeightfield::ndGridConstruction(params.m_diagonalMode),
+		params.m_horizontalScale_x, params.m_horizontalScale_z);
+	memcpy(&shape->m_elevationMap[0], reader.GetData(elevation), size_t(elevation->m_size));
+	memcpy(&shape->m_atributeMap[0], reader.GetData(attributes), size_t(attributes->m_size));
+	shape->UpdateElevationMapAabb();
+	return shape;
+}
+
+ndShape* ndShapeBinaryFormat::LoadCompound(const ndReader& reader, bool zeroCopy)
+{
+	ndShapeInstance rootInstance(new ndShapeCompound());
+	ndShapeCompound* const compoundShape = (ndShapeCompound*)rootInstance.GetShape();
+
+	compoundShape->BeginAddRemove();
+	const ndChunk* instanceChunk = nullptr;
+	for (ndInt32 i = 0; i < reader.m_header->m_chunkCount; ++i)
+	{
+		const ndChunk* const chunk = &reader.m_chunks[i];
+		if (chunk->m_id == m_childInstance)
+		{
+			instanceChunk = (chunk->m_size == sizeof(ndInstanceParams)) ? chunk : nullptr;
+		}
+		else if ((chunk->m_id == m_childShape) && instanceChunk)
+		{
+			ndShape* const childShape = Load(reader.GetData(chunk), ndInt64(chunk->m_size), zeroCopy);
+			if (childShape)
+			{
+				ndInstanceParams params;
+				memcpy(&params, reader.GetData(instanceChunk), sizeof(params));
+
+				ndShapeInstance instance(childShape);
+				instance.SetScale(params.m_scale);
+				instance.SetLocalMatrix(params.m_localMatrix);
+				instance.SetCollisionMode(params.m_collisionMode ? true : false);
+				instance.m_scaleType = ndShapeInstance::ndScaleType(params.m_scaleType);
+				instance.m_skinMargin = params.m_skinMargin;
+				instance.m_alignmentMatrix = params.m_alignmentMatrix;
+				instance.SetMaterial(params.m_material);
+				compoundShape->AddCollision(&instance);
+			}
+			instanceChunk = nullptr;
+		}
+	}
+	compoundShape->EndAddRemove();
+	return new ndShapeCompound(*compoundShape, nullptr);
+}
@@ -0,0 +1,133 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef __ND_SHAPE_BINARY_FORMAT_H__
+#define __ND_SHAPE_BINARY_FORMAT_H__
+
+#include "ndCollisionStdafx.h"
+
+class ndShape;
+
+#define D_SHAPE_BINARY_MAGIC		0x4253646e
+#define D_SHAPE_BINARY_VERSION		1
+#define D_SHAPE_BINARY_ALIGNMENT	64
+
+// versioned binary container for collision shapes.
+// the container is a fixed header, followed by a chunk table, followed by
+// the chunks data, each chunk aligned to D_SHAPE_BINARY_ALIGNMENT bytes,
+// a cache line, so the wide nodes of a mapped file keep their alignment.
+// the arrays of static bvh meshes are stored in the exact runtime layout,
+// so a memory mapped file can be used in place without parsing or copying.
+// compound children are saved as nested containers.
+class ndShapeBinaryFormat: public ndClassAlloc
+{
+	public:
+	enum ndChunkId
+	{
+		m_params = 0,
+		m_vertex,
+		m_nodes,
+		m_indices,
+		m_wideNodes,
+		m_elevation,
+		m_attributes,
+		m_childInstance,
+		m_childShape,
+	};
+
+	class ndHeader
+	{
+		public:
+		ndUnsigned32 m_magic;
+		ndUnsigned32 m_version;
+		ndInt32 m_shapeId;
+		ndInt32 m_chunkCount;
+		ndInt32 m_floatSize;
+		ndInt32 m_reserved;
+		ndUnsigned64 m_size;
+	};
+
+	class ndChunk
+	{
+		public:
+		ndInt32 m_id;
+		ndInt32 m_count;
+		ndUnsigned64 m_offset;
+		ndUnsigned64 m_size;
+		ndUnsigned64 m_reserved;
+	};
+
+	// read only view of a file mapped in memory.
+	// pages are mapped copy on write, so shapes can still patch their data.
+	class ndMappedFile: public ndClassAlloc
+	{
+		public:
+		D_COLLISION_API ndMappedFile(const char* const path);
+		D_COLLISION_API ~ndMappedFile();
+
+		const void* GetData() const;
+		ndInt64 GetSize() const;
+
+		private:
+		void* m_data;
+		ndInt64 m_size;
+		#if (defined (WIN32) || defined(_WIN32) || defined (_M_ARM) || defined (_M_ARM64))
+		void* m_file;
+		void* m_mapping;
+		#endif
+	};
+
+	// writes shape to buffer, returns false if the shape type is not supported.
+	D_COLLISION_API static bool Save(const ndShape* const shape, ndArray<ndUnsigned8>& buffer);
+	D_COLLISION_API static bool Save(const ndShape* const shape, const char* const path);
+
+	// returns nullptr if the buffer is not a valid container.
+	// when zeroCopy is true the static bvh arrays point directly into buffer,
+	// and the buffer must outlive the shape.
+	D_COLLISION_API static ndShape* Load(const void* const buffer, ndInt64 size, bool zeroCopy);
+
+	// the file is only mapped while loading, so the shape always copies its data.
+	// for a zero copy load, keep an ndMappedFile alive for the life of the shape
+	// and call Load(file.GetData(), file.GetSize(), true).
+	D_COLLISION_API static ndShape* Load(const char* const path);
+
+	private:
+	class ndWriter;
+	class ndReader;
+
+	static bool SaveShape(const ndShape* const shape, ndWriter& writer);
+	static ndShape* LoadShape(const ndReader& reader, bool zeroCopy);
+	static ndShape* LoadStaticBvh(const ndReader& reader, bool zeroCopy);
+	static ndShape* LoadHeightfield(const ndReader& reader);
+	static ndShape* LoadCompound(const ndReader& reader, bool zeroCopy);
+};
+
+inline const void* ndShapeBinaryFormat::ndMappedFile::GetData() const
+{
+	return m_data;
+}
+
+inline ndInt64 ndShapeBinaryFormat::ndMappedFile::GetSize() const
+{
+	return m_size;
+}
+
+#endif
@@ -107,6 +107,7 @@ class ndShapeCompound: public ndShape
 	friend class ndShapeInstance;
 	friend class ndContactSolver;
 	friend class ndFileFormatShapeCompound;
+	friend class ndShapeBinaryFormat;
 };
 
 inline ndShapeCompound* ndShapeCompound::GetAsShapeCompound()
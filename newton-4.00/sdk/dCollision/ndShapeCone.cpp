@@ -123,7 +123,7 @@ ndShapeInfo ndShapeCone::GetShapeInfo() const
 	ndShapeInfo info(ndShapeConvex::GetShapeInfo());
 
 	info.m_cone.m_radius = m_radius;
-	info.m_cylinder.m_height = ndFloat32(2.0f) * m_height;
+	info.m_cone.m_height = ndFloat32(2.0f) * m_height;
 	return info;
 }
 
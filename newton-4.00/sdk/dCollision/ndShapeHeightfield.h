@@ -101,6 +101,7 @@ class ndShapeHeightfield: public ndShapeStaticMesh
 
 	friend class ndContactSolver;
 	friend class ndFileFormatShapeStaticHeightfield;
+	friend class ndShapeBinaryFormat;
 };
 
 inline ndArray<ndReal>& ndShapeHeightfield::GetElevationMap()
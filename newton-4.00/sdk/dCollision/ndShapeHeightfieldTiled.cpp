@@ -0,0 +1,605 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "ndCoreStdafx.h"
+#include "ndCollisionStdafx.h"
+#include "ndScene.h"
+#include "ndContact.h"
+#include "ndBodyKinematic.h"
+#include "ndShapeInstance.h"
+#include "ndShapeHeightfieldTiled.h"
+
+ndShapeHeightfieldTiled::ndTile::ndTile(ndInt32 cellsPerTile)
+	:ndClassAlloc()
+	,m_elevation((cellsPerTile + 1) * (cellsPerTile + 1))
+	,m_atributes(cellsPerTile * cellsPerTile)
+	,m_offset(ndFloat32(0.0f))
+	,m_scale(ndFloat32(0.0f))
+	,m_cellsPerTile(cellsPerTile)
+{
+	m_elevation.SetCount((cellsPerTile + 1) * (cellsPerTile + 1));
+	m_atributes.SetCount(cellsPerTile * cellsPerTile);
+	memset(&m_elevation[0], 0, sizeof(ndUnsigned16) * m_elevation.GetCount());
+	memset(&m_atributes[0], 0, sizeof(ndInt8) * m_atributes.GetCount());
+}
+
+void ndShapeHeightfieldTiled::ndTile::Quantize(const ndReal* const elevation, const ndInt8* const attributes)
+{
+	ndReal y0 = ndReal(1.0e10f);
+	ndReal y1 = -ndReal(1.0e10f);
+	for (ndInt32 i = m_elevation.GetCount() - 1; i >= 0; --i)
+	{
+		y0 = ndMin(y0, elevation[i]);
+		y1 = ndMax(y1, elevation[i]);
+	}
+
+	m_offset = ndFloat32(y0);
+	m_scale = ndFloat32(y1 - y0) / ndFloat32(0xffff);
+	const ndFloat32 invScale = (m_scale > ndFloat32(0.0f)) ? ndFloat32(1.0f) / m_scale : ndFloat32(0.0f);
+	for (ndInt32 i = m_elevation.GetCount() - 1; i >= 0; --i)
+	{
+		const ndFloat32 value = (ndFloat32(elevation[i]) - m_offset) * invScale + ndFloat32(0.5f);
+		m_elevation[i] = ndUnsigned16(ndClamp(ndInt32(value), 0, 0xffff));
+	}
+
+	if (attributes)
+	{
+		ndMemCpy(&m_atributes[0], attributes, m_atributes.GetCount());
+	}
+}
+
+ndShapeHeightfieldTiled::ndTileLoadRequest::ndTileLoadRequest(ndShapeHeightfieldTiled* const owner, ndInt32 tileIndex)
+	:ndBackgroundTask()
+	,ndClassAlloc()
+	,m_owner(owner)
+	,m_tile(nullptr)
+	,m_tileIndex(tileIndex)
+{
+}
+
+ndShapeHeightfieldTiled::ndTileLoadRequest::~ndTileLoadRequest()
+{
+	if (m_tile)
+	{
+		delete m_tile;
+	}
+}
+
+void ndShapeHeightfieldTiled::ndTileLoadRequest::Execute(ndThreadPool* const)
+{
+	const ndInt32 tileX = m_tileIndex % m_owner->m_tilesCount_x;
+	const ndInt32 tileZ = m_tileIndex / m_owner->m_tilesCount_x;
+	m_tile = new ndTile(m_owner->m_cellsPerTile);
+	if (!m_owner->m_loader->LoadTile(tileX, tileZ, *m_tile))
+	{
+		delete m_tile;
+		m_tile = nullptr;
+	}
+}
+
+ndShapeHeightfieldTiled::ndShapeHeightfieldTiled(
+	ndInt32 tilesCount_x, ndInt32 tilesCount_z, ndInt32 cellsPerTile,
+	ndFloat32 horizontalScale_x, ndFloat32 horizontalScale_z,
+	ndFloat32 minElevation, ndFloat32 maxElevation, ndTileLoader* const loader)
+	:ndShapeStaticProceduralMesh(ndFloat32(0.0f), ndFloat32(0.0f), ndFloat32(0.0f))
+	,m_tiles(tilesCount_x * tilesCount_z)
+	,m_residentTiles()
+	,m_pendingRequests()
+	,m_loader(loader)
+	,m_horizontalScale_x(horizontalScale_x)
+	,m_horizontalScale_z(horizontalScale_z)
+	,m_horizontalScaleInv_x(ndFloat32(1.0f) / horizontalScale_x)
+	,m_horizontalScaleInv_z(ndFloat32(1.0f) / horizontalScale_z)
+	,m_tilesCount_x(tilesCount_x)
+	,m_tilesCount_z(tilesCount_z)
+	,m_cellsPerTile(cellsPerTile)
+	,m_width(tilesCount_x * cellsPerTile + 1)
+	,m_height(tilesCount_z * cellsPerTile + 1)
+{
+	ndAssert(loader);
+	ndAssert(cellsPerTile >= 1);
+	ndAssert(tilesCount_x >= 1);
+	ndAssert(tilesCount_z >= 1);
+	ndAssert(minElevation <= maxElevation);
+
+	m_tiles.SetCount(tilesCount_x * tilesCount_z);
+	for (ndInt32 i = m_tiles.GetCount() - 1; i >= 0; --i)
+	{
+		ndTileHeader& header = m_tiles[i];
+		header.m_tile = nullptr;
+		header.m_minElevation = minElevation;
+		header.m_maxElevation = maxElevation;
+		header.m_state = m_tileUnloaded;
+		header.m_residentIndex = -1;
+	}
+
+	const ndVector minBox(ndFloat32(0.0f), minElevation, ndFloat32(0.0f), ndFloat32(0.0f));
+	const ndVector maxBox(ndFloat32(m_width - 1) * m_horizontalScale_x, maxElevation, ndFloat32(m_height - 1) * m_horizontalScale_z, ndFloat32(0.0f));
+	m_boxSize = (maxBox - minBox) * ndVector::m_half;
+	m_boxOrigin = (maxBox + minBox) * ndVector::m_half;
+}
+
+ndShapeHeightfieldTiled::~ndShapeHeightfieldTiled()
+{
+	CompletePendingRequests(true);
+	EvictAllTiles();
+	delete m_loader;
+}
+
+ndUnsigned64 ndShapeHeightfieldTiled::GetHash(ndUnsigned64 hash) const
+{
+	hash = dCRC64(&m_tilesCount_x, ndInt32(sizeof(ndInt32)), hash);
+	hash = dCRC64(&m_tilesCount_z, ndInt32(sizeof(ndInt32)), hash);
+	hash = dCRC64(&m_cellsPerTile, ndInt32(sizeof(ndInt32)), hash);
+	hash = dCRC64(&m_horizontalScale_x, ndInt32(sizeof(ndFloat32)), hash);
+	hash = dCRC64(&m_horizontalScale_z, ndInt32(sizeof(ndFloat32)), hash);
+	return hash;
+}
+
+void ndShapeHeightfieldTiled::SetTileBounds(ndInt32 tileX, ndInt32 tileZ, ndFloat32 minElevation, ndFloat32 maxElevation)
+{
+	// tile bounds must be inside the elevation range of the shape
+	ndAssert(minElevation <= maxElevation);
+	ndAssert(minElevation >= (m_boxOrigin.m_y - m_boxSize.m_y - ndFloat32(1.0e-3f)));
+	ndAssert(maxElevation <= (m_boxOrigin.m_y + m_boxSize.m_y + ndFloat32(1.0e-3f)));
+	ndTileHeader& header = m_tiles[tileZ * m_tilesCount_x + tileX];
+	header.m_minElevation = minElevation;
+	header.m_maxElevation = maxElevation;
+}
+
+bool ndShapeHeightfieldTiled::IsTileResident(ndInt32 tileX, ndInt32 tileZ) const
+{
+	return m_tiles[tileZ * m_tilesCount_x + tileX].m_state == m_tileResident;
+}
+
+ndInt32 ndShapeHeightfieldTiled::GetResidentTilesCount() const
+{
+	return m_residentTiles.GetCount();
+}
+
+ndFloat32 ndShapeHeightfieldTiled::GetElevation(ndInt32 x, ndInt32 z) const
+{
+	const ndInt32 tileX = ndMin(x / m_cellsPerTile, m_tilesCount_x - 1);
+	const ndInt32 tileZ = ndMin(z / m_cellsPerTile, m_tilesCount_z - 1);
+
+	// samples on a tile edge are stored by the tiles on both sides, 
+	// read them from any resident one, so a missing neighbor does not slope the edge cells.
+	const ndInt32 edgeX = ((x == tileX * m_cellsPerTile) && (tileX > 0)) ? 1 : 0;
+	const ndInt32 edgeZ = ((z == tileZ * m_cellsPerTile) && (tileZ > 0)) ? 1 : 0;
+	for (ndInt32 dz = 0; dz <= edgeZ; ++dz)
+	{
+		for (ndInt32 dx = 0; dx <= edgeX; ++dx)
+		{
+			const ndInt32 sampleTileX = tileX - dx;
+			const ndInt32 sampleTileZ = tileZ - dz;
+			const ndTileHeader& header = m_tiles[sampleTileZ * m_tilesCount_x + sampleTileX];
+			if (header.m_tile)
+			{
+				return header.m_tile->GetElevation(x - sampleTileX * m_cellsPerTile, z - sampleTileZ * m_cellsPerTile);
+			}
+		}
+	}
+	// the tile is not in memory, use the most conservative elevation
+	return m_tiles[tileZ * m_tilesCount_x + tileX].m_maxElevation;
+}
+
+ndInt32 ndShapeHeightfieldTiled::GetCellAttribute(ndInt32 x, ndInt32 z) const
+{
+	const ndInt32 tileX = x / m_cellsPerTile;
+	const ndInt32 tileZ = z / m_cellsPerTile;
+	const ndTileHeader& header = m_tiles[tileZ * m_tilesCount_x + tileX];
+	return header.m_tile ? header.m_tile->GetAttribute(x - tileX * m_cellsPerTile, z - tileZ * m_cellsPerTile) : 0;
+}
+
+void ndShapeHeightfieldTiled::MakeTileResident(ndInt32 tileIndex, ndTile* const tile)
+{
+	ndTileHeader& header = m_tiles[tileIndex];
+	ndAssert(!header.m_tile);
+	ndAssert(tile->m_cellsPerTile == m_cellsPerTile);
+
+	// tighten the tile bounds, so that the fallback patch is closer
+	// to the real terrain the next time this tile is evicted.
+	ndFloat32 y0 = ndFloat32(1.0e10f);
+	ndFloat32 y1 = -ndFloat32(1.0e10f);
+	const ndInt32 samples = tile->GetSampleWidth();
+	for (ndInt32 z = 0; z < samples; ++z)
+	{
+		for (ndInt32 x = 0; x < samples; ++x)
+		{
+			const ndFloat32 y = tile->GetElevation(x, z);
+			y0 = ndMin(y0, y);
+			y1 = ndMax(y1, y);
+		}
+	}
+	header.m_minElevation = ndMax(y0, m_boxOrigin.m_y - m_boxSize.m_y);
+	header.m_maxElevation = ndMin(y1, m_boxOrigin.m_y + m_boxSize.m_y);
+
+	header.m_tile = tile;
+	header.m_state = m_tileResident;
+	header.m_residentIndex = m_residentTiles.GetCount();
+	m_residentTiles.PushBack(tileIndex);
+}
+
+void ndShapeHeightfieldTiled::EvictTile(ndInt32 tileIndex)
+{
+	ndTileHeader& header = m_tiles[tileIndex];
+	ndAssert(header.m_state == m_tileResident);
+
+	const ndInt32 index = header.m_residentIndex;
+	const ndInt32 lastTile = m_residentTiles[m_residentTiles.GetCount() - 1];
+	m_residentTiles[index] = lastTile;
+	m_tiles[lastTile].m_residentIndex = index;
+	m_residentTiles.SetCount(m_residentTiles.GetCount() - 1);
+
+	delete header.m_tile;
+	header.m_tile = nullptr;
+	header.m_state = m_tileUnloaded;
+	header.m_residentIndex = -1;
+}
+
+void ndShapeHeightfieldTiled::EvictAllTiles()
+{
+	for (ndInt32 i = m_residentTiles.GetCount() - 1; i >= 0; --i)
+	{
+		EvictTile(m_residentTiles[i]);
+	}
+}
+
+void ndShapeHeightfieldTiled::CompletePendingRequests(bool wait)
+{
+	ndList<ndTileLoadRequest*>::ndNode* nextNode;
+	for (ndList<ndTileLoadRequest*>::ndNode* node = m_pendingRequests.GetFirst(); node; node = nextNode)
+	{
+		nextNode = node->GetNext();
+		ndTileLoadRequest* const request = node->GetInfo();
+		if (wait)
+		{
+			request->Sync();
+		}
+		if (request->TaskState() == ndBackgroundTask::m_taskCompleted)
+		{
+			if (request->m_tile)
+			{
+				MakeTileResident(request->m_tileIndex, request->m_tile);
+				request->m_tile = nullptr;
+			}
+			else
+			{
+				m_tiles[request->m_tileIndex].m_state = m_tileUnloaded;
+			}
+			m_pendingRequests.Remove(node);
+			delete request;
+		}
+	}
+}
+
+void ndShapeHeightfieldTiled::StreamTiles(ndScene* const scene, const ndVector* const localPoints, ndInt32 count, ndFloat32 loadRadius, ndFloat32 evictRadius)
+{
+	D_TRACKTIME();
+	ndAssert(evictRadius >= loadRadius);
+	CompletePendingRequests(false);
+
+	const ndFloat32 tileSize_x = m_horizontalScale_x * ndFloat32(m_cellsPerTile);
+	const ndFloat32 tileSize_z = m_horizontalScale_z * ndFloat32(m_cellsPerTile);
+
+	// calculate the squared horizontal distance from a point to a tile
+	auto TileDist2 = [tileSize_x, tileSize_z](const ndVector& point, ndInt32 tileX, ndInt32 tileZ)
+	{
+		const ndFloat32 x0 = ndFloat32(tileX) * tileSize_x;
+		const ndFloat32 z0 = ndFloat32(tileZ) * tileSize_z;
+		const ndFloat32 dx = point.m_x - ndClamp(point.m_x, x0, x0 + tileSize_x);
+		const ndFloat32 dz = point.m_z - ndClamp(point.m_z, z0, z0 + tileSize_z);
+		return dx * dx + dz * dz;
+	};
+
+	// evict all the resident tiles that are far from all points
+	const ndFloat32 evictDist2 = evictRadius * evictRadius;
+	for (ndInt32 i = m_residentTiles.GetCount() - 1; i >= 0; --i)
+	{
+		const ndInt32 tileIndex = m_residentTiles[i];
+		const ndInt32 tileX = tileIndex % m_tilesCount_x;
+		const ndInt32 tileZ = tileIndex / m_tilesCount_x;
+		bool inRange = false;
+		for (ndInt32 j = 0; (j < count) && !inRange; ++j)
+		{
+			inRange = TileDist2(localPoints[j], tileX, tileZ) <= evictDist2;
+		}
+		if (!inRange)
+		{
+			EvictTile(tileIndex);
+		}
+	}
+
+	// request all missing tiles near each point
+	const ndFloat32 loadDist2 = loadRadius * loadRadius;
+	for (ndInt32 i = 0; i < count; ++i)
+	{
+		const ndVector& point = localPoints[i];
+		const ndInt32 tileX0 = ndClamp(FastInt((point.m_x - loadRadius) / tileSize_x), 0, m_tilesCount_x - 1);
+		const ndInt32 tileX1 = ndClamp(FastInt((point.m_x + loadRadius) / tileSize_x), 0, m_tilesCount_x - 1);
+		const ndInt32 tileZ0 = ndClamp(FastInt((point.m_z - loadRadius) / tileSize_z), 0, m_tilesCount_z - 1);
+		const ndInt32 tileZ1 = ndClamp(FastInt((point.m_z + loadRadius) / tileSize_z), 0, m_tilesCount_z - 1);
+		for (ndInt32 tileZ = tileZ0; tileZ <= tileZ1; ++tileZ)
+		{
+			for (ndInt32 tileX = tileX0; tileX <= tileX1; ++tileX)
+			{
+				const ndInt32 tileIndex = tileZ * m_tilesCount_x + tileX;
+				ndTileHeader& header = m_tiles[tileIndex];
+				if ((header.m_state == m_tileUnloaded) && (TileDist2(point, tileX, tileZ) <= loadDist2))
+				{
+					header.m_state = m_tileLoading;
+					ndTileLoadRequest* const request = new ndTileLoadRequest(this, tileIndex);
+					m_pendingRequests.Append(request);
+					if (scene)
+					{
+						scene->SendBackgroundTask(request);
+					}
+					else
+					{
+						request->Execute(nullptr);
+					}
+				}
+			}
+		}
+	}
+
+	if (!scene)
+	{
+		CompletePendingRequests(true);
+	}
+}
+
+void ndShapeHeightfieldTiled::GetCellRange(const ndVector& minBox, const ndVector& maxBox, ndInt32& x0, ndInt32& x1, ndInt32& z0, ndInt32& z1) const
+{
+	x0 = ndClamp(FastInt(minBox.m_x * m_horizontalScaleInv_x), 0, m_width - 1);
+	z0 = ndClamp(FastInt(minBox.m_z * m_horizontalScaleInv_z), 0, m_height - 1);
+	x1 = ndClamp(FastInt(maxBox.m_x * m_horizontalScaleInv_x) + 1, 0, m_width - 1);
+	z1 = ndClamp(FastInt(maxBox.m_z * m_horizontalScaleInv_z) + 1, 0, m_height - 1);
+}
+
+void ndShapeHeightfieldTiled::GetCollidingFaces(const ndVector& minBox, const ndVector& maxBox, ndArray<ndVector>& vertex, ndArray<ndInt32>& faceList, ndArray<ndInt32>& faceMaterial, ndArray<ndInt32>& indexListList) const
+{
+	ndInt32 x0;
+	ndInt32 x1;
+	ndInt32 z0;
+	ndInt32 z1;
+	GetCellRange(minBox, maxBox, x0, x1, z0, z1);
+	if ((x1 <= x0) || (z1 <= z0))
+	{
+		return;
+	}
+
+	const ndInt32 vertexBase = vertex.GetCount();
+	for (ndInt32 z = z0; z <= z1; ++z)
+	{
+		const ndFloat32 zVal = m_horizontalScale_z * ndFloat32(z);
+		for (ndInt32 x = x0; x <= x1; ++x)
+		{
+			vertex.PushBack(ndVector(m_horizontalScale_x * ndFloat32(x), GetElevation(x, z), zVal, ndFloat32(0.0f)));
+		}
+	}
+
+	const ndInt32 step = x1 - x0 + 1;
+	for (ndInt32 z = z0; z < z1; ++z)
+	{
+		for (ndInt32 x = x0; x < x1; ++x)
+		{
+			const ndInt32 i0 = vertexBase + (z - z0) * step + x - x0;
+			const ndInt32 i1 = i0 + 1;
+			const ndInt32 i2 = i0 + step;
+			const ndInt32 i3 = i2 + 1;
+
+			const ndFloat32 y0 = ndMin(ndMin(vertex[i0].m_y, vertex[i1].m_y), ndMin(vertex[i2].m_y, vertex[i3].m_y));
+			const ndFloat32 y1 = ndMax(ndMax(vertex[i0].m_y, vertex[i1].m_y), ndMax(vertex[i2].m_y, vertex[i3].m_y));
+			if ((y1 < minBox.m_y) || (y0 > maxBox.m_y))
+			{
+				continue;
+			}
+
+			const ndInt32 material = GetCellAttribute(x, z);
+			faceList.PushBack(3);
+			faceMaterial.PushBack(material);
+			indexListList.PushBack(i2);
+			indexListList.PushBack(i1);
+			indexListList.PushBack(i0);
+
+			faceList.PushBack(3);
+			faceMaterial.PushBack(material);
+			indexListList.PushBack(i1);
+			indexListList.PushBack(i2);
+			indexListList.PushBack(i3);
+		}
+	}
+}
+
+void ndShapeHeightfieldTiled::DebugShape(const ndMatrix& matrix, ndShapeDebugNotify& debugCallback) const
+{
+	// only resident tiles are drawn
+	ndVector triangle[3];
+	ndShapeDebugNotify::ndEdgeType edgeType[3];
+	memset(edgeType, ndShapeDebugNotify::m_shared, sizeof(edgeType));
+
+	for (ndInt32 i = 0; i < m_residentTiles.GetCount(); ++i)
+	{
+		const ndInt32 tileIndex = m_residentTiles[i];
+		const ndInt32 x0 = (tileIndex % m_tilesCount_x) * m_cellsPerTile;
+		const ndInt32 z0 = (tileIndex / m_tilesCount_x) * m_cellsPerTile;
+		for (ndInt32 z = z0; z < z0 + m_cellsPerTile; ++z)
+		{
+			for (ndInt32 x = x0; x < x0 + m_cellsPerTile; ++x)
+			{
+				const ndVector p0(m_horizontalScale_x * ndFloat32(x + 0), GetElevation(x + 0, z + 0), m_horizontalScale_z * ndFloat32(z + 0), ndFloat32(0.0f));
+				const ndVector p1(m_horizontalScale_x * ndFloat32(x + 1), GetElevation(x + 1, z + 0), m_horizontalScale_z * ndFloat32(z + 0), ndFloat32(0.0f));
+				const ndVector p2(m_horizontalScale_x * ndFloat32(x + 0), GetElevation(x + 0, z + 1), m_horizontalScale_z * ndFloat32(z + 1), ndFloat32(0.0f));
+				const ndVector p3(m_horizontalScale_x * ndFloat32(x + 1), GetElevation(x + 1, z + 1), m_horizontalScale_z * ndFloat32(z + 1), ndFloat32(0.0f));
+
+				triangle[0] = matrix.TransformVector(p2);
+				triangle[1] = matrix.TransformVector(p1);
+				triangle[2] = matrix.TransformVector(p0);
+				debugCallback.DrawPolygon(3, triangle, edgeType);
+
+				triangle[0] = matrix.TransformVector(p1);
+				triangle[1] = matrix.TransformVector(p2);
+				triangle[2] = matrix.TransformVector(p3);
+				debugCallback.DrawPolygon(3, triangle, edgeType);
+			}
+		}
+	}
+}
+
+ndFloat32 ndShapeHeightfieldTiled::RayCastCell(const ndFastRay& ray, ndInt32 xIndex0, ndInt32 zIndex0, ndVector& normalOut, ndFloat32 maxT) const
+{
+	if ((xIndex0 < 0) || (zIndex0 < 0) || (xIndex0 >= (m_width - 1)) || (zIndex0 >= (m_height - 1)))
+	{
+		return ndFloat32(1.2f);
+	}
+
+	ndVector points[4];
+	points[0] = ndVector(ndFloat32(xIndex0 + 0) * m_horizontalScale_x, GetElevation(xIndex0 + 0, zIndex0 + 0), ndFloat32(zIndex0 + 0) * m_horizontalScale_z, ndFloat32(0.0f));
+	points[1] = ndVector(ndFloat32(xIndex0 + 1) * m_horizontalScale_x, GetElevation(xIndex0 + 1, zIndex0 + 0), ndFloat32(zIndex0 + 0) * m_horizontalScale_z, ndFloat32(0.0f));
+	points[2] = ndVector(ndFloat32(xIndex0 + 0) * m_horizontalScale_x, GetElevation(xIndex0 + 0, zIndex0 + 1), ndFloat32(zIndex0 + 1) * m_horizontalScale_z, ndFloat32(0.0f));
+	points[3] = ndVector(ndFloat32(xIndex0 + 1) * m_horizontalScale_x, GetElevation(xIndex0 + 1, zIndex0 + 1), ndFloat32(zIndex0 + 1) * m_horizontalScale_z, ndFloat32(0.0f));
+
+	const ndInt32 triangle0[] = { 2, 1, 0 };
+	const ndInt32 triangle1[] = { 1, 2, 3 };
+
+	const ndVector e10(points[1] - points[2]);
+	const ndVector e20(points[0] - points[2]);
+	ndVector normal(e10.CrossProduct(e20).Normalize());
+	ndFloat32 t = ray.PolygonIntersect(normal, maxT, &points[0].m_x, sizeof(ndVector), triangle0, 3);
+	if (t < maxT)
+	{
+		normalOut = normal;
+		return t;
+	}
+
+	const ndVector e30(points[2] - points[1]);
+	const ndVector e40(points[3] - points[1]);
+	normal = e30.CrossProduct(e40).Normalize();
+	t = ray.PolygonIntersect(normal, maxT, &points[0].m_x, sizeof(ndVector), triangle1, 3);
+	if (t < maxT)
+	{
+		normalOut = normal;
+	}
+	return t;
+}
+
+ndFloat32 ndShapeHeightfieldTiled::RayCast(ndRayCastNotify&, const ndVector& localP0, const ndVector& localP1, ndFloat32 maxT, const ndBody* const, ndContactPoint& contactOut) const
+{
+	ndVector p0(localP0);
+	ndVector p1(localP1);
+	const ndVector boxP0(m_boxOrigin - m_boxSize);
+	const ndVector boxP1(m_boxOrigin + m_boxSize);
+
+	// clip the line against the bounding box
+	if (ndRayBoxClip(p0, p1, boxP0, boxP1))
+	{
+		const ndVector dp(p1 - p0);
+		ndVector normalOut(ndVector::m_zero);
+
+		const ndInt32 ix0 = FastInt(p0.m_x * m_horizontalScaleInv_x);
+		const ndInt32 iz0 = FastInt(p0.m_z * m_horizontalScaleInv_z);
+
+		// implement a 2d dda line algorithm
+		ndInt32 xInc;
+		ndFloat32 tx;
+		ndFloat32 stepX;
+		if (dp.m_x > ndFloat32(0.0f))
+		{
+			xInc = 1;
+			const ndFloat32 val = ndFloat32(1.0f) / dp.m_x;
+			stepX = m_horizontalScale_x * val;
+			tx = (m_horizontalScale_x * (ndFloat32(ix0) + ndFloat32(1.0f)) - p0.m_x) * val;
+		}
+		else if (dp.m_x < ndFloat32(0.0f))
+		{
+			xInc = -1;
+			const ndFloat32 val = -ndFloat32(1.0f) / dp.m_x;
+			stepX = m_horizontalScale_x * val;
+			tx = -(m_horizontalScale_x * ndFloat32(ix0) - p0.m_x) * val;
+		}
+		else
+		{
+			xInc = 0;
+			stepX = ndFloat32(0.0f);
+			tx = ndFloat32(1.0e10f);
+		}
+
+		ndInt32 zInc;
+		ndFloat32 tz;
+		ndFloat32 stepZ;
+		if (dp.m_z > ndFloat32(0.0f))
+		{
+			zInc = 1;
+			const ndFloat32 val = ndFloat32(1.0f) / dp.m_z;
+			stepZ = m_horizontalScale_z * val;
+			tz = (m_horizontalScale_z * (ndFloat32(iz0) + ndFloat32(1.0f)) - p0.m_z) * val;
+		}
+		else if (dp.m_z < ndFloat32(0.0f))
+		{
+			zInc = -1;
+			const ndFloat32 val = -ndFloat32(1.0f) / dp.m_z;
+			stepZ = m_horizontalScale_z * val;
+			tz = -(m_horizontalScale_z * ndFloat32(iz0) - p0.m_z) * val;
+		}
+		else
+		{
+			zInc = 0;
+			stepZ = ndFloat32(0.0f);
+			tz = ndFloat32(1.0e10f);
+		}
+
+		ndFloat32 txAcc = tx;
+		ndFloat32 tzAcc = tz;
+		ndInt32 xIndex0 = ix0;
+		ndInt32 zIndex0 = iz0;
+		const ndFastRay ray(localP0, localP1);
+
+		// for each cell touched by the line
+		do
+		{
+			const ndFloat32 t = RayCastCell(ray, xIndex0, zIndex0, normalOut, maxT);
+			if (t < maxT)
+			{
+				ndAssert(normalOut.m_w == ndFloat32(0.0f));
+				contactOut.m_normal = normalOut.Normalize();
+				contactOut.m_shapeId0 = GetCellAttribute(xIndex0, zIndex0);
+				contactOut.m_shapeId1 = contactOut.m_shapeId0;
+				return t;
+			}
+
+			if (txAcc < tzAcc)
+			{
+				xIndex0 += xInc;
+				tx = txAcc;
+				txAcc += stepX;
+			}
+			else
+			{
+				zIndex0 += zInc;
+				tz = tzAcc;
+				tzAcc += stepZ;
+			}
+		} while ((tx <= ndFloat32(1.0f)) || (tz <= ndFloat32(1.0f)));
+	}
+
+	return ndFloat32(1.2f);
+}
@@ -0,0 +1,185 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef __ND_SHAPE_HEIGHT_FIELD_TILED__
+#define __ND_SHAPE_HEIGHT_FIELD_TILED__
+
+#include "ndCollisionStdafx.h"
+#include "ndShapeStaticProceduralMesh.h"
+
+class ndScene;
+
+// a height field that is split in square tiles of cellsPerTile x cellsPerTile cells.
+// only the tiles near the bodies of interest are kept resident,
+// the elevation of each tile is quantized to 16 bits with a per tile offset and scale.
+// tiles are paged in and out by the application calling StreamTiles,
+// which loads the missing tiles through a user ndTileLoader on the scene background thread.
+// tiles that are not resident collide with a flat patch at the tile max elevation,
+// so bodies never fall through the terrain while the tile is loading.
+// the samples on the edge between two tiles are stored by both tiles, 
+// they come from whichever tile is resident.
+class ndShapeHeightfieldTiled: public ndShapeStaticProceduralMesh
+{
+	public:
+	class ndTile: public ndClassAlloc
+	{
+		public:
+		D_COLLISION_API ndTile(ndInt32 cellsPerTile);
+
+		// quantize (cellsPerTile + 1) x (cellsPerTile + 1) elevation samples,
+		// and cellsPerTile x cellsPerTile cell attributes (attributes can be null)
+		D_COLLISION_API void Quantize(const ndReal* const elevation, const ndInt8* const attributes);
+
+		ndFloat32 GetElevation(ndInt32 x, ndInt32 z) const;
+		ndInt32 GetAttribute(ndInt32 x, ndInt32 z) const;
+		ndInt32 GetSampleWidth() const;
+
+		ndArray<ndUnsigned16> m_elevation;
+		ndArray<ndInt8> m_atributes;
+		ndFloat32 m_offset;
+		ndFloat32 m_scale;
+		ndInt32 m_cellsPerTile;
+	};
+
+	class ndTileLoader: public ndClassAlloc
+	{
+		public:
+		ndTileLoader()
+			:ndClassAlloc()
+		{
+		}
+
+		virtual ~ndTileLoader()
+		{
+		}
+
+		// called from the background thread,
+		// the loader must fill the tile and return true on success.
+		virtual bool LoadTile(ndInt32 tileX, ndInt32 tileZ, ndTile& tile) = 0;
+	};
+
+	D_CLASS_REFLECTION(ndShapeHeightfieldTiled, ndShapeStaticProceduralMesh)
+	// the shape takes ownership of the loader.
+	D_COLLISION_API ndShapeHeightfieldTiled(
+		ndInt32 tilesCount_x, ndInt32 tilesCount_z, ndInt32 cellsPerTile,
+		ndFloat32 horizontalScale_x, ndFloat32 horizontalScale_z,
+		ndFloat32 minElevation, ndFloat32 maxElevation, ndTileLoader* const loader);
+	D_COLLISION_API virtual ~ndShapeHeightfieldTiled();
+
+	D_COLLISION_API void SetTileBounds(ndInt32 tileX, ndInt32 tileZ, ndFloat32 minElevation, ndFloat32 maxElevation);
+
+	// must be called outside the world update.
+	// loads all tiles within loadRadius of the local points and evict
+	// all tiles outside evictRadius. if scene is null tiles are load immediately.
+	D_COLLISION_API void StreamTiles(ndScene* const scene, const ndVector* const localPoints, ndInt32 count, ndFloat32 loadRadius, ndFloat32 evictRadius);
+	D_COLLISION_API void EvictAllTiles();
+
+	D_COLLISION_API bool IsTileResident(ndInt32 tileX, ndInt32 tileZ) const;
+	D_COLLISION_API ndInt32 GetResidentTilesCount() const;
+	D_COLLISION_API ndFloat32 GetElevation(ndInt32 x, ndInt32 z) const;
+
+	D_COLLISION_API virtual void GetCollidingFaces(const ndVector& minBox, const ndVector& maxBox, ndArray<ndVector>& vertex, ndArray<ndInt32>& faceList, ndArray<ndInt32>& faceMaterial, ndArray<ndInt32>& indexListList) const;
+
+	protected:
+	D_COLLISION_API virtual ndUnsigned64 GetHash(ndUnsigned64 hash) const;
+	D_COLLISION_API virtual void DebugShape(const ndMatrix& matrix, ndShapeDebugNotify& debugCallback) const;
+	D_COLLISION_API virtual ndFloat32 RayCast(ndRayCastNotify& callback, const ndVector& localP0, const ndVector& localP1, ndFloat32 maxT, const ndBody* const body, ndContactPoint& contactOut) const;
+
+	private:
+	enum ndTileState
+	{
+		m_tileUnloaded,
+		m_tileLoading,
+		m_tileResident,
+	};
+
+	class ndTileHeader
+	{
+		public:
+		ndTile* m_tile;
+		ndFloat32 m_minElevation;
+		ndFloat32 m_maxElevation;
+		ndInt32 m_state;
+		ndInt32 m_residentIndex;
+	};
+
+	class ndTileLoadRequest: public ndBackgroundTask, public ndClassAlloc
+	{
+		public:
+		ndTileLoadRequest(ndShapeHeightfieldTiled* const owner, ndInt32 tileIndex);
+		virtual ~ndTileLoadRequest();
+		virtual void Execute(ndThreadPool* const threadPool);
+
+		ndShapeHeightfieldTiled* m_owner;
+		ndTile* m_tile;
+		ndInt32 m_tileIndex;
+	};
+
+	void CalculateLocalObb();
+	void CompletePendingRequests(bool wait);
+	void MakeTileResident(ndInt32 tileIndex, ndTile* const tile);
+	void EvictTile(ndInt32 tileIndex);
+	ndInt32 GetCellAttribute(ndInt32 x, ndInt32 z) const;
+	void GetCellRange(const ndVector& minBox, const ndVector& maxBox, ndInt32& x0, ndInt32& x1, ndInt32& z0, ndInt32& z1) const;
+	ndFloat32 RayCastCell(const ndFastRay& ray, ndInt32 xIndex0, ndInt32 zIndex0, ndVector& normalOut, ndFloat32 maxT) const;
+	ndInt32 FastInt(ndFloat32 x) const;
+
+	ndArray<ndTileHeader> m_tiles;
+	ndArray<ndInt32> m_residentTiles;
+	ndList<ndTileLoadRequest*> m_pendingRequests;
+	ndTileLoader* m_loader;
+	ndFloat32 m_horizontalScale_x;
+	ndFloat32 m_horizontalScale_z;
+	ndFloat32 m_horizontalScaleInv_x;
+	ndFloat32 m_horizontalScaleInv_z;
+	ndInt32 m_tilesCount_x;
+	ndInt32 m_tilesCount_z;
+	ndInt32 m_cellsPerTile;
+	ndInt32 m_width;
+	ndInt32 m_height;
+};
+
+inline ndInt32 ndShapeHeightfieldTiled::ndTile::GetSampleWidth() const
+{
+	return m_cellsPerTile + 1;
+}
+
+inline ndFloat32 ndShapeHeightfieldTiled::ndTile::GetElevation(ndInt32 x, ndInt32 z) const
+{
+	return m_offset + m_scale * ndFloat32(m_elevation[z * GetSampleWidth() + x]);
+}
+
+inline ndInt32 ndShapeHeightfieldTiled::ndTile::GetAttribute(ndInt32 x, ndInt32 z) const
+{
+	return m_atributes[z * m_cellsPerTile + x];
+}
+
+inline ndInt32 ndShapeHeightfieldTiled::FastInt(ndFloat32 x) const
+{
+	ndInt32 i = ndInt32(x);
+	if (ndFloat32(i) > x)
+	{
+		i--;
+	}
+	return i;
+}
+
+#endif
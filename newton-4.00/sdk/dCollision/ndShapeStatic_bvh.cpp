@@ -61,12 +61,12 @@ ndShapeStatic_bvh::ndShapeStatic_bvh()
 {
 }
 
-ndShapeStatic_bvh::ndShapeStatic_bvh(const ndPolygonSoupBuilder& builder)
+ndShapeStatic_bvh::ndShapeStatic_bvh(const ndPolygonSoupBuilder& builder, ndThreadPool* const threadPool)
 	:ndShapeStaticMesh(m_boundingBoxHierachy)
 	,ndAabbPolygonSoup()
 	,m_trianglesCount(0)
 {
-	Create(builder);
+	Create(builder, threadPool);
 	CalculateAdjacent();
 
 	ndVector p0;
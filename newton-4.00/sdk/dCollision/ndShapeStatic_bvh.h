@@ -31,7 +31,9 @@ class ndShapeStatic_bvh: public ndShapeStaticMesh, public ndAabbPolygonSoup
 	D_CLASS_REFLECTION(ndShapeStatic_bvh,ndShapeStaticMesh)
 
 	D_COLLISION_API ndShapeStatic_bvh();
-	D_COLLISION_API ndShapeStatic_bvh(const ndPolygonSoupBuilder& builder);
+	// if a thread pool is passed, the hierarchy is built in parallel.
+	// the pool is started and stopped here, so it must not be inside its own Begin/End.
+	D_COLLISION_API ndShapeStatic_bvh(const ndPolygonSoupBuilder& builder, ndThreadPool* const threadPool = nullptr);
 	D_COLLISION_API virtual ~ndShapeStatic_bvh();
 
 	void *operator new (size_t size);
@@ -61,6 +63,7 @@ class ndShapeStatic_bvh: public ndShapeStaticMesh, public ndAabbPolygonSoup
 
 	friend class ndContactSolver;
 	friend class ndFileFormatShapeStaticMesh_bvh;
+	friend class ndShapeBinaryFormat;
 };
 
 inline void* ndShapeStatic_bvh::operator new (size_t size)
@@ -26,10 +26,13 @@
 #include "ndList.h"
 #include "ndMatrix.h"
 #include "ndPolyhedra.h"
+#include "ndProfiler.h"
+#include "ndThreadPool.h"
 #include "ndAabbPolygonSoup.h"
 #include "ndPolygonSoupBuilder.h"
 
 #define DG_STACK_DEPTH 512
+#define D_AABB_SAH_BINS 16
 
 D_MSV_NEWTON_ALIGN_32
 class ndAabbPolygonSoup::ndNodeBuilder: public ndAabbPolygonSoup::ndNode
@@ -119,108 +122,149 @@ class ndAabbPolygonSoup::ndNodeBuilder: public ndAabbPolygonSoup::ndNode
 
 class ndAabbPolygonSoup::ndSplitInfo
 {
+	class ndBin
+	{
+		public:
+		ndBin()
+			:m_p0(ndFloat32(1.0e15f))
+			,m_p1(ndFloat32(-1.0e15f))
+			,m_count(0)
+		{
+		}
+
+		ndVector m_p0;
+		ndVector m_p1;
+		ndInt32 m_count;
+	};
+
 	public:
 	ndSplitInfo (ndNodeBuilder* const boxArray, ndInt32 boxCount)
 	{
 		ndVector minP ( ndFloat32 (1.0e15f)); 
 		ndVector maxP (-ndFloat32 (1.0e15f)); 
+		ndVector minCenter ( ndFloat32 (1.0e15f)); 
+		ndVector maxCenter (-ndFloat32 (1.0e15f)); 
+		for (ndInt32 i = 0; i < boxCount; ++i) 
+		{
+			const ndNodeBuilder& box = boxArray[i];
+			const ndVector center (ndVector::m_half * (box.m_p0 + box.m_p1));
+			minP = minP.GetMin (box.m_p0); 
+			maxP = maxP.GetMax (box.m_p1); 
+			minCenter = minCenter.GetMin (center); 
+			maxCenter = maxCenter.GetMax (center); 
+		}
+
+		ndAssert (maxP.m_x - minP.m_x >= ndFloat32 (0.0f));
+		ndAssert (maxP.m_y - minP.m_y >= ndFloat32 (0.0f));
+		ndAssert (maxP.m_z - minP.m_z >= ndFloat32 (0.0f));
+		m_p0 = minP;
+		m_p1 = maxP;
+		m_axis = boxCount / 2;
 
-		if (boxCount == 2) 
+		if (boxCount > 2) 
 		{
-			m_axis = 1;
-			for (ndInt32 i = 0; i < boxCount; ++i) 
+			// binned surface area heuristic
+			ndBin bins[3][D_AABB_SAH_BINS];
+			ndFloat32 binScale[3];
+			for (ndInt32 i = 0; i < 3; ++i) 
 			{
-				const ndNodeBuilder& box = boxArray[i];
-				const ndVector& p0 = box.m_p0;
-				const ndVector& p1 = box.m_p1;
-				minP = minP.GetMin (p0); 
-				maxP = maxP.GetMax (p1); 
+				const ndFloat32 extend = maxCenter[i] - minCenter[i];
+				binScale[i] = (extend > ndFloat32 (1.0e-6f)) ? ndFloat32 (D_AABB_SAH_BINS) * ndFloat32 (0.999f) / extend : ndFloat32 (0.0f);
 			}
 
-		} 
-		else 
-		{
-			ndVector median (ndVector::m_zero);
-			ndVector varian (ndVector::m_zero);
 			for (ndInt32 i = 0; i < boxCount; ++i) 
 			{
 				const ndNodeBuilder& box = boxArray[i];
-
-				const ndVector& p0 = box.m_p0;
-				const ndVector& p1 = box.m_p1;
-
-				minP = minP.GetMin (p0); 
-				maxP = maxP.GetMax (p1); 
-				ndVector p (ndVector::m_half * (p0 + p1));
-
-				median += p;
-				varian += p * p;
+				const ndVector center (ndVector::m_half * (box.m_p0 + box.m_p1));
+				for (ndInt32 j = 0; j < 3; ++j) 
+				{
+					ndBin& bin = bins[j][BinIndex(center, minCenter, binScale, j)];
+					bin.m_p0 = bin.m_p0.GetMin(box.m_p0);
+					bin.m_p1 = bin.m_p1.GetMax(box.m_p1);
+					bin.m_count++;
+				}
 			}
 
-			varian = varian.Scale (ndFloat32 (boxCount)) - median * median;
-
-			ndInt32 index = 0;
-			ndFloat32 maxVarian = ndFloat32 (-1.0e10f);
-			for (ndInt32 i = 0; i < 3; ++i) 
+			ndInt32 bestAxis = -1;
+			ndInt32 bestSplit = 0;
+			ndFloat32 bestCost = ndFloat32 (1.0e20f);
+			for (ndInt32 j = 0; j < 3; ++j) 
 			{
-				if (varian[i] > maxVarian) 
+				if (binScale[j] == ndFloat32 (0.0f))
 				{
-					index = i;
-					maxVarian = varian[i];
+					continue;
 				}
-			}
 
-			ndVector center = median.Scale (ndFloat32 (1.0f) / ndFloat32 (boxCount));
-			ndFloat32 test = center[index];
-			ndInt32 i0 = 0;
-			ndInt32 i1 = boxCount - 1;
-			do 
-			{    
-				for (; i0 <= i1; ++i0) 
+				ndFloat32 rightCost[D_AABB_SAH_BINS];
+				ndVector p0 (ndFloat32 (1.0e15f));
+				ndVector p1 (ndFloat32 (-1.0e15f));
+				ndInt32 count = 0;
+				for (ndInt32 i = D_AABB_SAH_BINS - 1; i > 0; --i) 
 				{
-					const ndNodeBuilder& box = boxArray[i0];
-					ndFloat32 val = (box.m_p0[index] + box.m_p1[index]) * ndFloat32 (0.5f);
-					if (val > test) 
-					{
-						break;
-					}
+					const ndBin& bin = bins[j][i];
+					p0 = p0.GetMin(bin.m_p0);
+					p1 = p1.GetMax(bin.m_p1);
+					count += bin.m_count;
+					rightCost[i] = count ? Area(p0, p1) * ndFloat32 (count) : ndFloat32 (-1.0f);
 				}
 
-				for (; i1 >= i0; --i1) 
+				p0 = ndVector (ndFloat32 (1.0e15f));
+				p1 = ndVector (ndFloat32 (-1.0e15f));
+				count = 0;
+				for (ndInt32 i = 0; i < D_AABB_SAH_BINS - 1; ++i) 
 				{
-					const ndNodeBuilder& box = boxArray[i1];
-					ndFloat32 val = (box.m_p0[index] + box.m_p1[index]) * ndFloat32 (0.5f);
-					if (val < test) 
+					const ndBin& bin = bins[j][i];
+					p0 = p0.GetMin(bin.m_p0);
+					p1 = p1.GetMax(bin.m_p1);
+					count += bin.m_count;
+					if (count && (rightCost[i + 1] >= ndFloat32 (0.0f)))
 					{
-						break;
+						const ndFloat32 cost = Area(p0, p1) * ndFloat32 (count) + rightCost[i + 1];
+						if (cost < bestCost)
+						{
+							bestCost = cost;
+							bestAxis = j;
+							bestSplit = i + 1;
+						}
 					}
 				}
+			}
 
-				if (i0 < i1)
+			if (bestAxis >= 0)
+			{
+				ndInt32 i0 = 0;
+				ndInt32 i1 = boxCount - 1;
+				while (i0 <= i1)
 				{
-					ndSwap(boxArray[i0], boxArray[i1]);
-					i0++; 
-					i1--;
+					const ndNodeBuilder& box = boxArray[i0];
+					const ndVector center (ndVector::m_half * (box.m_p0 + box.m_p1));
+					if (BinIndex(center, minCenter, binScale, bestAxis) < bestSplit)
+					{
+						i0++;
+					}
+					else
+					{
+						ndSwap(boxArray[i0], boxArray[i1]);
+						i1--;
+					}
 				}
-			} while (i0 <= i1);
-
-			if (i0 > 0)
-			{
-				i0 --;
+				ndAssert (i0 > 0);
+				ndAssert (i0 < boxCount);
+				m_axis = i0;
 			}
-			if ((i0 + 1) >= boxCount) 
-			{
-				i0 = boxCount - 2;
-			}
-
-			m_axis = i0 + 1;
 		}
+	}
 
-		ndAssert (maxP.m_x - minP.m_x >= ndFloat32 (0.0f));
-		ndAssert (maxP.m_y - minP.m_y >= ndFloat32 (0.0f));
-		ndAssert (maxP.m_z - minP.m_z >= ndFloat32 (0.0f));
-		m_p0 = minP;
-		m_p1 = maxP;
+	static ndFloat32 Area(const ndVector& p0, const ndVector& p1)
+	{
+		const ndVector size (p1 - p0);
+		return size.m_x * size.m_y + size.m_y * size.m_z + size.m_z * size.m_x;
+	}
+
+	static ndInt32 BinIndex(const ndVector& center, const ndVector& minCenter, const ndFloat32* const binScale, ndInt32 axis)
+	{
+		const ndInt32 index = ndInt32 ((center[axis] - minCenter[axis]) * binScale[axis]);
+		return ndClamp(index, 0, D_AABB_SAH_BINS - 1);
 	}
 
 	ndInt32 m_axis;
@@ -230,20 +274,54 @@ class ndAabbPolygonSoup::ndSplitInfo
 
 ndAabbPolygonSoup::ndAabbPolygonSoup ()
 	:ndPolygonSoupDatabase()
+	,m_wideOrigin(ndVector::m_zero)
+	,m_wideScale(ndVector::m_zero)
+	,m_wideInvScale(ndVector::m_zero)
 	,m_aabb(nullptr)
+	,m_wideNodes(nullptr)
 	,m_indices(nullptr)
 	,m_nodesCount(0)
+	,m_wideNodesCount(0)
 	,m_indexCount(0)
+	,m_externalData(false)
 {
 }
 
 ndAabbPolygonSoup::~ndAabbPolygonSoup ()
 {
+	if (m_externalData)
+	{
+		// the arrays point into a buffer owned by the application
+		m_aabb = nullptr;
+		m_indices = nullptr;
+		m_wideNodes = nullptr;
+		m_localVertex = nullptr;
+	}
 	if (m_aabb) 
 	{
 		ndMemory::Free(m_aabb);
 		ndMemory::Free(m_indices);
 	}
+	if (m_wideNodes)
+	{
+		FreeWideNodes(m_wideNodes);
+	}
+}
+
+ndAabbPolygonSoup::ndWideNode* ndAabbPolygonSoup::AllocateWideNodes(ndInt32 count)
+{
+	// ndMemory::Malloc only aligns to D_MEMORY_ALIGMNET, over allocate 
+	// and save the base pointer right before the cache line aligned nodes
+	ndAssert(D_WIDE_NODE_ALIGNMENT >= 2 * sizeof(void*));
+	ndUnsigned8* const base = (ndUnsigned8*)ndMemory::Malloc(sizeof(ndWideNode) * size_t(count) + D_WIDE_NODE_ALIGNMENT);
+	ndUnsigned8* const nodes = (ndUnsigned8*)((ndUnsigned64(base) + D_WIDE_NODE_ALIGNMENT) & ~ndUnsigned64(D_WIDE_NODE_ALIGNMENT - 1));
+	((void**)nodes)[-1] = base;
+	return (ndWideNode*)nodes;
+}
+
+void ndAabbPolygonSoup::FreeWideNodes(ndWideNode* const nodes)
+{
+	ndMemory::Free(((void**)nodes)[-1]);
 }
 
 ndFloat32 ndAabbPolygonSoup::CalculateFaceMaxDiagonal (const ndVector* const vertex, ndInt32 indexCount, const ndInt32* const indexArray) const
@@ -549,7 +627,7 @@ ndIntersectStatus ndAabbPolygonSoup::CalculateAllFaceEdgeNormals(void* const con
 	return m_continueSearh;
 }
 
-ndAabbPolygonSoup::ndNodeBuilder* ndAabbPolygonSoup::BuildTopDown (ndNodeBuilder* const leafArray, ndInt32 firstBox, ndInt32 lastBox, ndNodeBuilder** const allocator) const
+ndAabbPolygonSoup::ndNodeBuilder* ndAabbPolygonSoup::BuildTopDown (ndNodeBuilder* const leafArray, ndInt32 firstBox, ndInt32 lastBox, ndNodeBuilder* const nodeArray) const
 {
 	ndAssert (firstBox >= 0);
 	ndAssert (lastBox >= 0);
@@ -562,20 +640,100 @@ ndAabbPolygonSoup::ndNodeBuilder* ndAabbPolygonSoup::BuildTopDown (ndNodeBuilder
 	{
 		ndSplitInfo info (&leafArray[firstBox], lastBox - firstBox + 1);
 
-		ndNodeBuilder* const parent = new (*allocator) ndNodeBuilder (info.m_p0, info.m_p1);
-		*allocator = *allocator + 1;
+		// each split point is unique, so it can be used as the node slot.
+		// this way sub trees can be built independently of each other.
+		ndNodeBuilder* const parent = new (&nodeArray[firstBox + info.m_axis - 1]) ndNodeBuilder (info.m_p0, info.m_p1);
 
-		ndAssert (parent);
-		parent->m_right = BuildTopDown (leafArray, firstBox + info.m_axis, lastBox, allocator);
+		parent->m_right = BuildTopDown (leafArray, firstBox + info.m_axis, lastBox, nodeArray);
 		parent->m_right->m_parent = parent;
 
-		parent->m_left = BuildTopDown (leafArray, firstBox, firstBox + info.m_axis - 1, allocator);
+		parent->m_left = BuildTopDown (leafArray, firstBox, firstBox + info.m_axis - 1, nodeArray);
 		parent->m_left->m_parent = parent;
 		return parent;
 	}
 }
 
-void ndAabbPolygonSoup::Create (const ndPolygonSoupBuilder& builder)
+ndAabbPolygonSoup::ndNodeBuilder* ndAabbPolygonSoup::BuildTopLevels (ndNodeBuilder* const leafArray, ndInt32 firstBox, ndInt32 lastBox, ndNodeBuilder* const nodeArray, ndInt32 jobSize, ndArray<ndSubTreeJob>& jobs) const
+{
+	ndAssert ((lastBox - firstBox + 1) > jobSize);
+	ndSplitInfo info (&leafArray[firstBox], lastBox - firstBox + 1);
+	ndNodeBuilder* const parent = new (&nodeArray[firstBox + info.m_axis - 1]) ndNodeBuilder (info.m_p0, info.m_p1);
+
+	const ndInt32 split = firstBox + info.m_axis;
+	if ((lastBox - split + 1) > jobSize)
+	{
+		parent->m_right = BuildTopLevels (leafArray, split, lastBox, nodeArray, jobSize, jobs);
+		parent->m_right->m_parent = parent;
+	}
+	else
+	{
+		ndSubTreeJob job;
+		job.m_parent = parent;
+		job.m_firstBox = split;
+		job.m_lastBox = lastBox;
+		job.m_isLeft = false;
+		jobs.PushBack(job);
+	}
+
+	if ((split - firstBox) > jobSize)
+	{
+		parent->m_left = BuildTopLevels (leafArray, firstBox, split - 1, nodeArray, jobSize, jobs);
+		parent->m_left->m_parent = parent;
+	}
+	else
+	{
+		ndSubTreeJob job;
+		job.m_parent = parent;
+		job.m_firstBox = firstBox;
+		job.m_lastBox = split - 1;
+		job.m_isLeft = true;
+		jobs.PushBack(job);
+	}
+	return parent;
+}
+
+ndAabbPolygonSoup::ndNodeBuilder* ndAabbPolygonSoup::BuildTopDownParallel (ndThreadPool* const threadPool, ndNodeBuilder* const leafArray, ndInt32 boxCount, ndNodeBuilder* const nodeArray) const
+{
+	D_TRACKTIME();
+	const ndInt32 threadCount = threadPool->GetThreadCount();
+	const ndInt32 jobSize = ndMax (boxCount / (threadCount * 8), ndInt32 (256));
+	if ((threadCount <= 1) || (boxCount <= jobSize))
+	{
+		return BuildTopDown (leafArray, 0, boxCount - 1, nodeArray);
+	}
+
+	// split the top levels serially, until there are enough
+	// independent sub trees to keep all threads busy.
+	ndArray<ndSubTreeJob> jobs;
+	ndNodeBuilder* const root = BuildTopLevels (leafArray, 0, boxCount - 1, nodeArray, jobSize, jobs);
+
+	ndAtomic<ndInt32> iterator(0);
+	auto BuildSubTrees = ndMakeObject::ndFunction([this, &jobs, &iterator, leafArray, nodeArray](ndInt32, ndInt32)
+	{
+		D_TRACKTIME_NAMED(BuildSubTrees);
+		for (ndInt32 i = iterator++; i < jobs.GetCount(); i = iterator++)
+		{
+			const ndSubTreeJob& job = jobs[i];
+			ndNodeBuilder* const node = BuildTopDown (leafArray, job.m_firstBox, job.m_lastBox, nodeArray);
+			node->m_parent = job.m_parent;
+			if (job.m_isLeft)
+			{
+				job.m_parent->m_left = node;
+			}
+			else
+			{
+				job.m_parent->m_right = node;
+			}
+		}
+	});
+	// the build runs outside the world update, so start the workers here
+	threadPool->Begin();
+	threadPool->ParallelExecute(BuildSubTrees);
+	threadPool->End();
+	return root;
+}
+
+void ndAabbPolygonSoup::Create (const ndPolygonSoupBuilder& builder, ndThreadPool* const threadPool)
 {
 	if (builder.m_faceVertexCount.GetCount() == 0) 
 	{
@@ -625,8 +783,9 @@ void ndAabbPolygonSoup::Create (const ndPolygonSoupBuilder& builder)
 		polygonIndex += (indexCount + 1);
 	}
 
-	ndNodeBuilder* constructorAllocator = &constructor[allocatorIndex];
-	ndNodeBuilder* const root = BuildTopDown (&constructor[0], 0, allocatorIndex - 1, &constructorAllocator);
+	ndNodeBuilder* const root = threadPool ?
+		BuildTopDownParallel (threadPool, &constructor[0], allocatorIndex, &constructor[allocatorIndex]) :
+		BuildTopDown (&constructor[0], 0, allocatorIndex - 1, &constructor[allocatorIndex]);
 
 	ndAssert (root);
 	ndList<ndNodeBuilder*> list;
@@ -764,6 +923,8 @@ void ndAabbPolygonSoup::Create (const ndPolygonSoupBuilder& builder)
 	{
 		m_aabb[0].m_right = ndNode::ndLeafNodePtr (0, 0);
 	}
+
+	BuildWideTree();
 }
 
 void ndAabbPolygonSoup::Serialize (const char* const path) const
@@ -814,6 +975,7 @@ void ndAabbPolygonSoup::Deserialize (const char* const path)
 		}
 
 		fclose(file);
+		BuildWideTree();
 	}
 }
 
@@ -970,6 +1132,11 @@ void ndAabbPolygonSoup::ForAllSectorsRayHit (const ndFastRay& raySrc, ndFloat32
 	const ndNode *stackPool[DG_STACK_DEPTH];
 	ndFloat32 distance[DG_STACK_DEPTH];
 	ndFastRay ray (raySrc);
+	if (m_wideNodes)
+	{
+		ForAllSectorsRayHitWide(ray, maxParam, callback, context);
+		return;
+	}
 
 	ndInt32 stack = 1;
 	const ndTriplex* const vertexArray = (ndTriplex*) m_localVertex;
@@ -1075,7 +1242,11 @@ void ndAabbPolygonSoup::ForAllSectors (const ndFastAabb& obbAabbInfo, const ndVe
 	ndAssert (ndAbs(ndAbs(obbAabbInfo[0][2]) - obbAabbInfo.m_absDir[2][0]) < ndFloat32 (1.0e-4f));
 	ndAssert (ndAbs(ndAbs(obbAabbInfo[1][2]) - obbAabbInfo.m_absDir[2][1]) < ndFloat32 (1.0e-4f));
 
-	if (m_aabb) 
+	if (m_wideNodes)
+	{
+		ForAllSectorsWide(obbAabbInfo, boxDistanceTravel, callback, context);
+	}
+	else if (m_aabb) 
 	{
 		ndFloat32 distance[DG_STACK_DEPTH];
 		const ndNode* stackPool[DG_STACK_DEPTH];
@@ -1464,3 +1635,472 @@ void ndAabbPolygonSoup::ForThisSector(const ndAabbPolygonSoup::ndNode* const nod
 		}
 	}
 }
+
+void ndAabbPolygonSoup::GetWideNodeChildAabb(const ndWideNode* const node, ndInt32 child, ndVector& p0, ndVector& p1) const
+{
+	const ndVector q0(ndFloat32(node->m_min[0][child]), ndFloat32(node->m_min[1][child]), ndFloat32(node->m_min[2][child]), ndFloat32(0.0f));
+	const ndVector q1(ndFloat32(node->m_max[0][child]), ndFloat32(node->m_max[1][child]), ndFloat32(node->m_max[2][child]), ndFloat32(0.0f));
+	p0 = m_wideOrigin + q0 * m_wideScale;
+	p1 = m_wideOrigin + q1 * m_wideScale;
+}
+
+ndInt32 ndAabbPolygonSoup::BuildWideNode(const ndNode* const node, ndInt32& nodeCount)
+{
+	// collapse the binary sub tree by opening the largest interior child 
+	// until there are four children or all children are leaves.
+	ndUnsigned32 children[4];
+	children[0] = node->m_left.m_node;
+	children[1] = node->m_right.m_node;
+	ndInt32 childCount = 2;
+	while (childCount < 4)
+	{
+		ndInt32 bestChild = -1;
+		ndFloat32 bestArea = ndFloat32(-1.0f);
+		for (ndInt32 i = 0; i < childCount; ++i)
+		{
+			if (!(children[i] & 0x80000000))
+			{
+				ndVector p0;
+				ndVector p1;
+				GetNodeAabb(&m_aabb[children[i]], p0, p1);
+				const ndVector size(p1 - p0);
+				const ndFloat32 area = size.m_x * size.m_y + size.m_y * size.m_z + size.m_z * size.m_x;
+				if (area > bestArea)
+				{
+					bestArea = area;
+					bestChild = i;
+				}
+			}
+		}
+		if (bestChild < 0)
+		{
+			break;
+		}
+		const ndNode* const child = &m_aabb[children[bestChild]];
+		children[bestChild] = child->m_left.m_node;
+		children[childCount] = child->m_right.m_node;
+		childCount++;
+	}
+
+	// nodes are enumerated in depth first order, so that the first
+	// child of a node is always next to its parent in memory.
+	const ndInt32 nodeIndex = nodeCount;
+	nodeCount++;
+	ndAssert(nodeCount <= m_nodesCount);
+
+	const ndTriplex* const vertexArray = (ndTriplex*)m_localVertex;
+	ndWideNode* const wideNode = &m_wideNodes[nodeIndex];
+	for (ndInt32 i = 0; i < 4; ++i)
+	{
+		ndVector p0(ndFloat32(1.0e15f));
+		ndVector p1(ndFloat32(-1.0e15f));
+		if (i >= childCount)
+		{
+			wideNode->m_child[i] = ndNode::ndLeafNodePtr(0, 0);
+		}
+		else if (children[i] & 0x80000000)
+		{
+			ndNode::ndLeafNodePtr leaf(ndNode::ndLeafNodePtr(0, 0));
+			leaf.m_node = children[i];
+			wideNode->m_child[i] = leaf;
+
+			const ndInt32 vCount = ndInt32(leaf.GetCount());
+			const ndInt32* const indices = &m_indices[leaf.GetIndex()];
+			for (ndInt32 j = 0; j < vCount; ++j)
+			{
+				ndVector p(&vertexArray[indices[j]].m_x);
+				p = p & ndVector::m_triplexMask;
+				p0 = p0.GetMin(p);
+				p1 = p1.GetMax(p);
+			}
+		}
+		else
+		{
+			const ndNode* const child = &m_aabb[children[i]];
+			GetNodeAabb(child, p0, p1);
+			wideNode->m_child[i] = ndNode::ndLeafNodePtr(ndUnsigned32(BuildWideNode(child, nodeCount)));
+		}
+
+		if (p0.m_x > p1.m_x)
+		{
+			// empty slot, make a box that always fails
+			for (ndInt32 j = 0; j < 3; ++j)
+			{
+				wideNode->m_min[j][i] = 0xffff;
+				wideNode->m_max[j][i] = 0;
+			}
+		}
+		else
+		{
+			// quantize conservatively, min down and max up.
+			const ndVector q0(((p0 - m_wideOrigin) * m_wideInvScale).Floor());
+			const ndVector q1(((p1 - m_wideOrigin) * m_wideInvScale).Floor() + ndVector::m_one);
+			for (ndInt32 j = 0; j < 3; ++j)
+			{
+				wideNode->m_min[j][i] = ndUnsigned16(ndClamp(ndInt32(q0[j]), 0, 0xffff));
+				wideNode->m_max[j][i] = ndUnsigned16(ndClamp(ndInt32(q1[j]), 0, 0xffff));
+			}
+		}
+	}
+	return nodeIndex;
+}
+
+void ndAabbPolygonSoup::BuildWideTree()
+{
+	// removed faces refer to the old hierarchy
+	m_removedFaces.SetCount(0);
+	if (m_wideNodes)
+	{
+		FreeWideNodes(m_wideNodes);
+		m_wideNodes = nullptr;
+		m_wideNodesCount = 0;
+	}
+
+	if (!m_aabb)
+	{
+		return;
+	}
+
+	ndVector p0;
+	ndVector p1;
+	GetNodeAabb(m_aabb, p0, p1);
+	const ndVector size(((p1 - p0) & ndVector::m_triplexMask).GetMax(ndVector(ndFloat32(1.0e-3f))));
+
+	// leave one quantization step at each side, so that the rounded boxes never clip
+	m_wideScale = size.Scale(ndFloat32(1.0f) / ndFloat32(0xffff - 2)) & ndVector::m_triplexMask;
+	m_wideOrigin = (p0 - m_wideScale) & ndVector::m_triplexMask;
+	m_wideInvScale = ndVector(ndFloat32(1.0f) / m_wideScale.m_x, ndFloat32(1.0f) / m_wideScale.m_y, ndFloat32(1.0f) / m_wideScale.m_z, ndFloat32(0.0f));
+
+	// a four wide tree never has more nodes than the binary tree
+	m_wideNodes = AllocateWideNodes(m_nodesCount);
+	m_wideNodesCount = 0;
+	BuildWideNode(m_aabb, m_wideNodesCount);
+}
+
+bool ndAabbPolygonSoup::IsFaceInsideBox(const ndNode::ndLeafNodePtr& leaf, const ndVector& p0, const ndVector& p1) const
+{
+	const ndTriplex* const vertexArray = (ndTriplex*)m_localVertex;
+	const ndInt32 vCount = ndInt32(leaf.GetCount());
+	const ndInt32* const indices = &m_indices[leaf.GetIndex()];
+	for (ndInt32 i = 0; i < vCount; ++i)
+	{
+		ndVector p(&vertexArray[indices[i]].m_x);
+		p = p & ndVector::m_triplexMask;
+		if (!ndBoxInclusionTest(p, p, p0, p1))
+		{
+			return false;
+		}
+	}
+	return vCount > 0;
+}
+
+ndInt32 ndAabbPolygonSoup::RemoveFaces(const ndVector& boxP0, const ndVector& boxP1)
+{
+	if (!m_aabb)
+	{
+		return 0;
+	}
+
+	// faces are removed by setting the leaf count to zero, so that 
+	// all the queries skip them. the hierarchy boxes are left as they are.
+	const ndVector p0(boxP0 & ndVector::m_triplexMask);
+	const ndVector p1(boxP1 & ndVector::m_triplexMask);
+
+	ndInt32 removeCount = 0;
+	ndInt32 stack = 1;
+	ndNode* stackPool[DG_STACK_DEPTH];
+	stackPool[0] = m_aabb;
+	while (stack)
+	{
+		stack--;
+		ndNode* const me = stackPool[stack];
+
+		ndVector q0;
+		ndVector q1;
+		GetNodeAabb(me, q0, q1);
+		if (ndOverlapTest(p0, p1, q0, q1))
+		{
+			ndNode::ndLeafNodePtr* const children[] = { &me->m_left, &me->m_right };
+			for (ndInt32 i = 0; i < 2; ++i)
+			{
+				ndNode::ndLeafNodePtr& child = *children[i];
+				if (!child.IsLeaf())
+				{
+					ndAssert(stack < DG_STACK_DEPTH);
+					stackPool[stack] = child.GetNode(m_aabb);
+					stack++;
+				}
+				else if (IsFaceInsideBox(child, p0, p1))
+				{
+					ndRemovedFace removed;
+					removed.m_slot = &child.m_node;
+					removed.m_leaf = child.m_node;
+					m_removedFaces.PushBack(removed);
+					child = ndNode::ndLeafNodePtr(0, child.GetIndex());
+					removeCount++;
+				}
+			}
+		}
+	}
+
+	if (m_wideNodes)
+	{
+		ndInt32 wideStack = 1;
+		ndInt32 wideStackPool[DG_STACK_DEPTH];
+		wideStackPool[0] = 0;
+		while (wideStack)
+		{
+			wideStack--;
+			ndWideNode* const me = &m_wideNodes[wideStackPool[wideStack]];
+			for (ndInt32 i = 0; i < 4; ++i)
+			{
+				ndNode::ndLeafNodePtr& child = me->m_child[i];
+				if (child.IsLeaf() && !child.GetCount())
+				{
+					continue;
+				}
+
+				ndVector q0;
+				ndVector q1;
+				GetWideNodeChildAabb(me, i, q0, q1);
+				if (ndOverlapTest(p0, p1, q0, q1))
+				{
+					if (!child.IsLeaf())
+					{
+						ndAssert(wideStack < DG_STACK_DEPTH);
+						wideStackPool[wideStack] = ndInt32(child.m_node);
+						wideStack++;
+					}
+					else if (IsFaceInsideBox(child, p0, p1))
+					{
+						ndRemovedFace removed;
+						removed.m_slot = &child.m_node;
+						removed.m_leaf = child.m_node;
+						m_removedFaces.PushBack(removed);
+						child = ndNode::ndLeafNodePtr(0, child.GetIndex());
+					}
+				}
+			}
+		}
+	}
+	return removeCount;
+}
+
+void ndAabbPolygonSoup::RestoreFaces()
+{
+	for (ndInt32 i = m_removedFaces.GetCount() - 1; i >= 0; --i)
+	{
+		const ndRemovedFace& removed = m_removedFaces[i];
+		*removed.m_slot = removed.m_leaf;
+	}
+	m_removedFaces.SetCount(0);
+}
+
+void ndAabbPolygonSoup::ForAllSectorsRayHitWide(const ndFastRay& ray, ndFloat32 maxParam, ndRayIntersectCallback callback, void* const context) const
+{
+	ndFloat32 distance[DG_STACK_DEPTH];
+	ndInt32 stackPool[DG_STACK_DEPTH];
+	const ndTriplex* const vertexArray = (ndTriplex*)m_localVertex;
+
+	ndInt32 stack = 1;
+	stackPool[0] = 0;
+	distance[0] = m_aabb->RayDistance(ray, vertexArray);
+	while (stack)
+	{
+		stack--;
+		const ndFloat32 dist = distance[stack];
+		if (dist > maxParam)
+		{
+			break;
+		}
+
+		const ndWideNode* const me = &m_wideNodes[stackPool[stack]];
+		for (ndInt32 i = 0; i < 4; ++i)
+		{
+			const ndNode::ndLeafNodePtr& child = me->m_child[i];
+			if (child.IsLeaf() && !child.GetCount())
+			{
+				continue;
+			}
+
+			ndVector p0;
+			ndVector p1;
+			GetWideNodeChildAabb(me, i, p0, p1);
+			const ndFloat32 dist1 = ray.BoxIntersect(p0, p1);
+			if (dist1 < maxParam)
+			{
+				if (child.IsLeaf())
+				{
+					const ndInt32 index = ndInt32(child.GetIndex());
+					const ndInt32 vCount = ndInt32(child.GetCount());
+					const ndFloat32 param = callback(context, &vertexArray[0].m_x, sizeof(ndTriplex), &m_indices[index], vCount);
+					ndAssert(param >= ndFloat32(0.0f));
+					if (param < maxParam)
+					{
+						maxParam = param;
+						if (maxParam == ndFloat32(0.0f))
+						{
+							return;
+						}
+					}
+				}
+				else
+				{
+					ndInt32 j = stack;
+					for (; j && (dist1 > distance[j - 1]); j--)
+					{
+						stackPool[j] = stackPool[j - 1];
+						distance[j] = distance[j - 1];
+					}
+					ndAssert(stack < DG_STACK_DEPTH);
+					stackPool[j] = ndInt32(child.m_node);
+					distance[j] = dist1;
+					stack++;
+				}
+			}
+		}
+	}
+}
+
+void ndAabbPolygonSoup::ForAllSectorsWide(const ndFastAabb& obbAabbInfo, const ndVector& boxDistanceTravel, ndAaabbIntersectCallback callback, void* const context) const
+{
+	ndFloat32 distance[DG_STACK_DEPTH];
+	ndInt32 stackPool[DG_STACK_DEPTH];
+
+	const ndInt32 stride = sizeof(ndTriplex) / sizeof(ndFloat32);
+	const ndTriplex* const vertexArray = (ndTriplex*)m_localVertex;
+
+	ndAssert(boxDistanceTravel.m_w == ndFloat32(0.0f));
+	if (boxDistanceTravel.DotProduct(boxDistanceTravel).GetScalar() < ndFloat32(1.0e-8f))
+	{
+		ndInt32 stack = 1;
+		stackPool[0] = 0;
+		distance[0] = m_aabb->BoxPenetration(obbAabbInfo, vertexArray);
+		if (distance[0] <= ndFloat32(0.0f))
+		{
+			obbAabbInfo.m_separationDistance = ndMin(obbAabbInfo.m_separationDistance[0], -distance[0]);
+		}
+		while (stack)
+		{
+			stack--;
+			if (distance[stack] > ndFloat32(0.0f))
+			{
+				const ndWideNode* const me = &m_wideNodes[stackPool[stack]];
+				for (ndInt32 i = 0; i < 4; ++i)
+				{
+					const ndNode::ndLeafNodePtr& child = me->m_child[i];
+					if (child.IsLeaf() && !child.GetCount())
+					{
+						continue;
+					}
+
+					ndVector p0;
+					ndVector p1;
+					GetWideNodeChildAabb(me, i, p0, p1);
+					const ndFloat32 dist1 = ndNode::BoxPenetration(obbAabbInfo, p0, p1);
+					if (dist1 <= ndFloat32(0.0f))
+					{
+						obbAabbInfo.m_separationDistance = ndMin(obbAabbInfo.m_separationDistance[0], -dist1);
+					}
+					else if (child.IsLeaf())
+					{
+						const ndInt32 vCount = ndInt32(child.GetCount());
+						const ndInt32* const indices = &m_indices[child.GetIndex()];
+						const ndInt32 normalIndex = indices[vCount + 1];
+						ndVector faceNormal(&vertexArray[normalIndex].m_x);
+						faceNormal = faceNormal & ndVector::m_triplexMask;
+						const ndFloat32 dist2 = obbAabbInfo.PolygonBoxDistance(faceNormal, vCount, indices, stride, &vertexArray[0].m_x);
+						if (dist2 > ndFloat32(0.0f))
+						{
+							ndAssert(vCount >= 3);
+							obbAabbInfo.m_separationDistance = ndFloat32(0.0f);
+							if (callback(context, &vertexArray[0].m_x, sizeof(ndTriplex), indices, vCount, dist2) == m_stopSearch)
+							{
+								return;
+							}
+						}
+						else
+						{
+							obbAabbInfo.m_separationDistance = ndMin(obbAabbInfo.m_separationDistance[0], -dist2);
+						}
+					}
+					else
+					{
+						ndInt32 j = stack;
+						for (; j && (dist1 > distance[j - 1]); j--)
+						{
+							stackPool[j] = stackPool[j - 1];
+							distance[j] = distance[j - 1];
+						}
+						ndAssert(stack < DG_STACK_DEPTH);
+						stackPool[j] = ndInt32(child.m_node);
+						distance[j] = dist1;
+						stack++;
+					}
+				}
+			}
+		}
+	}
+	else
+	{
+		const ndFastRay ray(ndVector::m_zero, boxDistanceTravel);
+		const ndFastRay obbRay(ndVector::m_zero, obbAabbInfo.UnrotateVector(boxDistanceTravel));
+		ndInt32 stack = 1;
+		stackPool[0] = 0;
+		distance[0] = m_aabb->BoxIntersect(ray, obbRay, obbAabbInfo, vertexArray);
+		while (stack)
+		{
+			stack--;
+			if (distance[stack] < ndFloat32(1.0f))
+			{
+				const ndWideNode* const me = &m_wideNodes[stackPool[stack]];
+				for (ndInt32 i = 0; i < 4; ++i)
+				{
+					const ndNode::ndLeafNodePtr& child = me->m_child[i];
+					if (child.IsLeaf() && !child.GetCount())
+					{
+						continue;
+					}
+
+					ndVector p0;
+					ndVector p1;
+					GetWideNodeChildAabb(me, i, p0, p1);
+					const ndFloat32 dist1 = ndNode::BoxIntersect(ray, obbRay, obbAabbInfo, p0, p1);
+					if (dist1 < ndFloat32(1.0f))
+					{
+						if (child.IsLeaf())
+						{
+							const ndInt32 vCount = ndInt32(child.GetCount());
+							const ndInt32* const indices = &m_indices[child.GetIndex()];
+							const ndInt32 normalIndex = indices[vCount + 1];
+							ndVector faceNormal(&vertexArray[normalIndex].m_x);
+							faceNormal = faceNormal & ndVector::m_triplexMask;
+							const ndFloat32 hitDistance = obbAabbInfo.PolygonBoxRayDistance(faceNormal, vCount, indices, stride, &vertexArray[0].m_x, ray);
+							if (hitDistance < ndFloat32(1.0f))
+							{
+								ndAssert(vCount >= 3);
+								if (callback(context, &vertexArray[0].m_x, sizeof(ndTriplex), indices, vCount, hitDistance) == m_stopSearch)
+								{
+									return;
+								}
+							}
+						}
+						else
+						{
+							ndInt32 j = stack;
+							for (; j && (dist1 > distance[j - 1]); j--)
+							{
+								stackPool[j] = stackPool[j - 1];
+								distance[j] = distance[j - 1];
+							}
+							ndAssert(stack < DG_STACK_DEPTH);
+							stackPool[j] = ndInt32(child.m_node);
+							distance[j] = dist1;
+							stack++;
+						}
+					}
+				}
+			}
+		}
+	}
+}
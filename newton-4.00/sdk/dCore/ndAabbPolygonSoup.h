@@ -25,16 +25,19 @@
 #include "ndCoreStdafx.h"
 #include "ndTypes.h"
 #include "ndUtils.h"
+#include "ndArray.h"
 #include "ndFastRay.h"
 #include "ndFastAabb.h"
 #include "ndIntersections.h"
 #include "ndPolygonSoupDatabase.h"
 
+class ndThreadPool;
 class ndPolygonSoupBuilder;
 
 // index format: i0, i1, i2, ... , id, normal, e0Normal, e1Normal, e2Normal, ..., faceSize
 #define D_CONCAVE_EDGE_MASK			(1<<31)
 #define D_FACE_CLIP_DIAGONAL_SCALE	ndFloat32 (0.25f)
+#define D_WIDE_NODE_ALIGNMENT		64
 
 enum ndIntersectStatus
 {
@@ -133,6 +136,20 @@ class ndAabbPolygonSoup: public ndPolygonSoupDatabase
 			ndVector p1 (&vertexArray[m_indexBox1].m_x);
 			p0 = p0 & ndVector::m_triplexMask;
 			p1 = p1 & ndVector::m_triplexMask;
+			return BoxPenetration(obb, p0, p1);
+		}
+
+		inline ndFloat32 BoxIntersect (const ndFastRay& ray, const ndFastRay& obbRay, const ndFastAabb& obb, const ndTriplex* const vertexArray) const
+		{
+			ndVector p0 (&vertexArray[m_indexBox0].m_x);
+			ndVector p1 (&vertexArray[m_indexBox1].m_x);
+			p0 = p0 & ndVector::m_triplexMask;
+			p1 = p1 & ndVector::m_triplexMask;
+			return BoxIntersect(ray, obbRay, obb, p0, p1);
+		}
+
+		static inline ndFloat32 BoxPenetration (const ndFastAabb& obb, const ndVector& p0, const ndVector& p1)
+		{
 			ndVector minBox (p0 - obb.m_p1);
 			ndVector maxBox (p1 - obb.m_p0);
 			ndAssert(maxBox.m_x >= minBox.m_x);
@@ -173,13 +190,8 @@ class ndAabbPolygonSoup: public ndPolygonSoupDatabase
 			return	dist.GetScalar();
 		}
 
-		inline ndFloat32 BoxIntersect (const ndFastRay& ray, const ndFastRay& obbRay, const ndFastAabb& obb, const ndTriplex* const vertexArray) const
+		static inline ndFloat32 BoxIntersect (const ndFastRay& ray, const ndFastRay& obbRay, const ndFastAabb& obb, const ndVector& p0, const ndVector& p1)
 		{
-			ndVector p0 (&vertexArray[m_indexBox0].m_x);
-			ndVector p1 (&vertexArray[m_indexBox1].m_x);
-			p0 = p0 & ndVector::m_triplexMask;
-			p1 = p1 & ndVector::m_triplexMask;
-
 			ndVector minBox (p0 - obb.m_p1);
 			ndVector maxBox (p1 - obb.m_p0);
 			ndFloat32 dist = ray.BoxIntersect(minBox, maxBox);
@@ -207,6 +219,18 @@ class ndAabbPolygonSoup: public ndPolygonSoupDatabase
 		ndLeafNodePtr m_right;
 	};
 
+	/// Four wide node of the quantized tree used for queries.
+	/// children bounding boxes are stored inline quantized to 16 bits,
+	/// relative to the root box, so that a node fits in a single cache line.
+	/// the node arrays are allocated at D_WIDE_NODE_ALIGNMENT boundaries.
+	class ndWideNode
+	{
+		public:
+		ndUnsigned16 m_min[3][4];
+		ndUnsigned16 m_max[3][4];
+		ndNode::ndLeafNodePtr m_child[4];
+	};
+
 	class ndSplitInfo;
 	class ndNodeBuilder;
 
@@ -219,11 +243,19 @@ class ndAabbPolygonSoup: public ndPolygonSoupDatabase
 	/// Reads a previously saved database binary file named path.
 	D_CORE_API virtual void Deserialize (const char* const path);
 
+	/// Removes all faces that are fully inside the box p0, p1 without rebuilding the hierarchy.
+	/// returns the number of faces removed. must be called outside the world update.
+	D_CORE_API ndInt32 RemoveFaces (const ndVector& p0, const ndVector& p1);
+
+	/// Brings back all the faces removed by calls to RemoveFaces.
+	D_CORE_API void RestoreFaces ();
+
 	protected:
 	D_CORE_API ndAabbPolygonSoup ();
 	D_CORE_API virtual ~ndAabbPolygonSoup ();
 
-	D_CORE_API void Create (const ndPolygonSoupBuilder& builder);
+	// the thread pool, if any, is started and stopped by the build
+	D_CORE_API void Create (const ndPolygonSoupBuilder& builder, ndThreadPool* const threadPool = nullptr);
 	D_CORE_API void CalculateAdjacent ();
 	D_CORE_API virtual ndVector ForAllSectorsSupportVertex(const ndVector& dir) const;
 	D_CORE_API virtual void ForAllSectorsRayHit (const ndFastRay& ray, ndFloat32 maxT, ndRayIntersectCallback callback, void* const context) const;
@@ -261,15 +293,50 @@ class ndAabbPolygonSoup: public ndPolygonSoupDatabase
 	}
 
 	private:
-	ndNodeBuilder* BuildTopDown (ndNodeBuilder* const leafArray, ndInt32 firstBox, ndInt32 lastBox, ndNodeBuilder** const allocator) const;
+	class ndRemovedFace
+	{
+		public:
+		ndUnsigned32* m_slot;
+		ndUnsigned32 m_leaf;
+	};
+
+	class ndSubTreeJob
+	{
+		public:
+		ndNodeBuilder* m_parent;
+		ndInt32 m_firstBox;
+		ndInt32 m_lastBox;
+		bool m_isLeft;
+	};
+
+	ndNodeBuilder* BuildTopDown (ndNodeBuilder* const leafArray, ndInt32 firstBox, ndInt32 lastBox, ndNodeBuilder* const nodeArray) const;
+	ndNodeBuilder* BuildTopDownParallel (ndThreadPool* const threadPool, ndNodeBuilder* const leafArray, ndInt32 boxCount, ndNodeBuilder* const nodeArray) const;
+	ndNodeBuilder* BuildTopLevels (ndNodeBuilder* const leafArray, ndInt32 firstBox, ndInt32 lastBox, ndNodeBuilder* const nodeArray, ndInt32 jobSize, ndArray<ndSubTreeJob>& jobs) const;
 	ndFloat32 CalculateFaceMaxDiagonal (const ndVector* const vertex, ndInt32 indexCount, const ndInt32* const indexArray) const;
 	static ndIntersectStatus CalculateAllFaceEdgeNormals(void* const context, const ndFloat32* const polygon, ndInt32 strideInBytes, const ndInt32* const indexArray, ndInt32 indexCount, ndFloat32 hitDistance);
+
+	bool IsFaceInsideBox(const ndNode::ndLeafNodePtr& leaf, const ndVector& p0, const ndVector& p1) const;
+	void BuildWideTree();
+	static ndWideNode* AllocateWideNodes(ndInt32 count);
+	static void FreeWideNodes(ndWideNode* const nodes);
+	ndInt32 BuildWideNode(const ndNode* const node, ndInt32& nodeCount);
+	void GetWideNodeChildAabb(const ndWideNode* const node, ndInt32 child, ndVector& p0, ndVector& p1) const;
+	void ForAllSectorsWide(const ndFastAabb& obbAabb, const ndVector& boxDistanceTravel, ndAaabbIntersectCallback callback, void* const context) const;
+	void ForAllSectorsRayHitWide(const ndFastRay& ray, ndFloat32 maxT, ndRayIntersectCallback callback, void* const context) const;
 	
+	ndArray<ndRemovedFace> m_removedFaces;
+	ndVector m_wideOrigin;
+	ndVector m_wideScale;
+	ndVector m_wideInvScale;
 	ndNode* m_aabb;
+	ndWideNode* m_wideNodes;
 	ndInt32* m_indices;
 	ndInt32 m_nodesCount;
+	ndInt32 m_wideNodesCount;
 	ndInt32 m_indexCount;
+	bool m_externalData;
 	friend class ndContactSolver;
+	friend class ndShapeBinaryFormat;
 };
 
 #endif
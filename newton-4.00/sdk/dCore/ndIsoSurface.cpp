@@ -30,6 +30,11 @@
 // adapted from code by written by Paul Bourke may 1994
 //http://paulbourke.net/geometry/polygonise/
 
+// cells are kept this many grids away from the volume origin, 
+// so that small motions of the fluid do not force a rebuild.
+#define D_ISO_SURFACE_PADDING		16
+#define D_ISO_SURFACE_MAX_CELL		(0xffff - 2 * D_ISO_SURFACE_PADDING)
+
 class ndIsoSurface::ndImplementation : public ndClassAlloc
 {
 	public:
@@ -47,17 +52,25 @@ class ndIsoSurface::ndImplementation : public ndClassAlloc
 		ndVector m_isoValues[8];
 	};
 
+	// one vertex per face of an occupied cell that borders an empty cell
+	class ndCellVertex
+	{
+		public:
+		ndInt32 m_start;
+		ndInt32 m_faceMask;
+	};
+
 	ndImplementation();
 	~ndImplementation();
 
 	void Clear();
 	ndVector GetOrigin() const;
-	void BuildLowResolutionMesh(ndIsoSurface* const me, const ndArray<ndVector>& pointCloud, ndFloat32 gridSize);
+	void BuildLowResolutionMesh(ndIsoSurface* const me, const ndArray<ndVector>& pointCloud, ndFloat32 gridSize, ndThreadPool* const threadPool);
 	void BuildHighResolutionMesh(ndIsoSurface* const me, const ndArray<ndVector>& pointCloud, ndFloat32 gridSize, ndCalculateIsoValue* const computeIsoValue);
 
-	ndInt32 GenerateLowResIndexList(const ndIsoSurface* const me, 
+	ndInt32 GenerateLowResIndexList(
 		ndInt32* const indexList, ndInt32 strideInFloats, 
-		ndReal* const posit, ndReal* const normals);
+		ndReal* const posit, ndReal* const normals, ndThreadPool* const threadPool);
 
 	private:
 	class ndGridHash
@@ -162,17 +175,41 @@ class ndIsoSurface::ndImplementation : public ndClassAlloc
 		ndInt32 m_z;
 	};
 
-	void CreateGrids();
-	void ClearBuffers();
-	void SortCellBuckects();
-	void GenerateLowResIsoSurface();
-	void ProcessLowResCell(ndIsoCell& cell);
-	void MakeTriangleList(ndIsoSurface* const me);
+	template <ndInt32 byte>
+	class ndGridHashDigit
+	{
+		public:
+		ndGridHashDigit(void* const)
+		{
+		}
+
+		ndInt32 GetKey(const ndGridHash& cell) const
+		{
+			return ndInt32((cell.m_gridFullHash >> (byte * 8)) & 0xff);
+		}
+	};
+
+	template <typename Function>
+	void ParallelExecute(ndThreadPool* const threadPool, const Function& function) const;
+	template <ndInt32 byte>
+	void SortDigit(ndThreadPool* const threadPool, ndArray<ndGridHash>& array, ndArray<ndGridHash>& scratchBuffer) const;
+
+	ndInt32 GetThreadCount(ndThreadPool* const threadPool) const;
+	ndInt32 FindCell(ndInt32& cursor, ndUnsigned64 hash) const;
+	ndInt32 LowerBound(const ndArray<ndGridHash>& array, ndUnsigned64 hash, ndInt32 start = 0) const;
+	void SplitKeys(const ndArray<ndGridHash>& array0, const ndArray<ndGridHash>& array1, ndInt32 threadIndex, ndInt32 threadCount, ndInt32* const range0, ndInt32* const range1) const;
+	void SortGridHash(ndThreadPool* const threadPool, ndArray<ndGridHash>& array);
+	void CompactBlocks(ndThreadPool* const threadPool, ndArray<ndGridHash>& array);
+
+	void UpdateCubes(ndThreadPool* const threadPool);
+	void CalculateChangedCells(ndThreadPool* const threadPool);
+	void ProcessLowResCell(const ndGridHash& cube, ndVector* const triangle) const;
+	void GenerateLowResIsoSurface(ndIsoSurface* const me, ndThreadPool* const threadPool);
+	void CalculateAabb(const ndArray<ndVector>& points, ndFloat32 gridSize, ndThreadPool* const threadPool);
+	void CalculateOccupiedCells(const ndArray<ndVector>& points, ndThreadPool* const threadPool);
+
 	void CalculateNormals(ndIsoSurface* const me);
-	
 	void GenerateHighResIndexList(ndIsoSurface* const me);
-	void RemoveDuplicates(const ndArray<ndVector>& points);
-	void CalculateAabb(const ndArray<ndVector>& points, ndFloat32 gridSize);
 	void GenerateHighResIsoSurface(ndCalculateIsoValue* const computeIsoValue);
 	void ProcessHighResCell(ndIsoCell& cell, ndCalculateIsoValue* const computeIsoValue);
 	ndVector InterpolateLowResVertex(const ndVector& p1, const ndVector& p2) const;
@@ -180,30 +217,43 @@ class ndIsoSurface::ndImplementation : public ndClassAlloc
 
 	ndVector m_boxP0;
 	ndVector m_boxP1;
+	ndVector m_anchor;
 	ndVector m_gridSize;
 	ndVector m_invGridSize;
+
+	// occupied cells and marching cubes of the last update, 
+	// the next update only revisits the cubes around cells that changed.
+	ndArray<ndGridHash> m_cells;
+	ndArray<ndGridHash> m_cubes;
+	ndArray<ndGridHash> m_newCells;
 	ndArray<ndGridHash> m_hashGridMap;
 	ndArray<ndGridHash> m_hashGridMapScratchBuffer;
+	ndArray<ndCellVertex> m_cellVertex;
 	ndArray<ndVector> m_triangles;
-	ndArray<ndVector> m_trianglesScratchBuffer;
 
 	ndFloat32 m_isoValue;
 	ndInt32 m_volumeSizeX;
 	ndInt32 m_volumeSizeY;
 	ndInt32 m_volumeSizeZ;
+	ndInt32 m_changedCellCount;
 	ndUpperDigit m_upperDigitsIsValid;
+
+	// where each thread wrote its items, and how many
+	ndInt32 m_blockStart[D_MAX_THREADS_COUNT];
+	ndInt32 m_blockCount[D_MAX_THREADS_COUNT];
 	
 	static ndEdge m_edges[];
 	static ndInt32 m_faces[][3];
 	static ndInt32 m_edgeScan[];
 	static ndInt32 m_facesScan[];
 	static ndVector m_gridCorners[];
+	static ndInt32 m_cornerOffsets[][3];
 
 	friend class ndIsoSurface;
 };
 
-ndInt32 ndIsoSurface::ndImplementation::m_facesScan[] = { 0,0,1,2,4,5,7,9,12,13,15,17,20,22,25,28,30,31,33,35,38,40,43,46,50,52,55,58,62,65,69,73,76,77,79,81,84,86,89,92,96,98,101,104,108,111,115,119,122,124,127,130,132,135,139,143,146,149,153,157,160,164,169,174,176,177,179,181,184,186,189,192,196,198,201,204,208,211,215,219,222,224,227,230,234,237,241,245,250,253,257,261,266,270,275,280,284,286,289,292,296,299,303,305,308,311,315,319,324,328,333,336,338,341,345,349,352,356,361,364,366,370,375,380,384,389,391,395,396,397,399,401,404,406,409,412,416,418,421,424,428,431,435,439,442,444,447,450,454,457,461,465,470,473,475,479,482,486,489,494,496,498,501,504,508,511,515,519,524,527,531,535,540,544,549,554,558,561,565,569,572,576,581,586,590,594,597,602,604,609,613,615,616,618,621,624,628,631,635,639,644,647,651,655,660,662,665,668,670,673,677,681,686,690,695,700,702,706,709,714,718,721,723,727,728,731,735,739,744,748,753,756,760,764,769,774,776,779,783,785,786,788,791,794,796,799,803,805,806,809,811,815,816,818,819,820};
-ndInt32 ndIsoSurface::ndImplementation::m_edgeScan[] = { 0,0,3,6,10,13,19,23,28,31,35,41,46,50,55,60,64,67,71,77,82,88,95,102,108,114,119,128,134,141,147,155,160,163,169,173,178,184,193,198,204,210,217,224,230,237,245,251,256,260,265,270,274,281,289,295,300,307,313,321,326,334,341,348,352,355,361,367,374,378,385,390,396,402,409,418,426,431,437,443,448,454,461,470,478,485,493,501,508,517,525,537,546,554,561,570,576,580,587,592,598,603,611,615,620,627,635,643,650,656,663,668,672,677,683,689,694,700,707,712,716,724,731,740,746,753,759,765,768,771,777,783,790,796,805,812,820,824,829,836,842,847,853,859,864,868,873,880,886,893,901,909,916,921,925,933,938,944,949,956,960,966,975,982,990,999,1011,1019,1028,1035,1043,1051,1058,1066,1075,1082,1088,1093,1099,1105,1110,1118,1127,1134,1140,1146,1151,1158,1162,1169,1175,1181,1184,1188,1195,1202,1210,1215,1223,1229,1236,1241,1247,1255,1262,1266,1271,1276,1280,1285,1291,1299,1306,1312,1319,1326,1332,1338,1343,1352,1358,1363,1367,1373,1376,1381,1389,1395,1402,1408,1417,1422,1428,1434,1441,1448,1454,1459,1465,1469,1472,1476,1481,1486,1490,1495,1501,1505,1508,1513,1517,1523,1526,1530,1533,1536 };
+ndInt32 ndIsoSurface::ndImplementation::m_facesScan[] = { 0,0,1,2,4,5,7,9,12,13,15,17,20,22,25,28,30,31,33,35,38,40,43,46,50,52,55,58,62,65,69,73,76,77,79,81,84,86,89,92,96,98,101,104,108,111,115,119,122,124,127,130,132,135,139,143,146,149,153,157,160,164,169,174,176,177,179,181,184,186,189,192,196,198,201,204,208,211,215,219,222,224,227,230,234,237,241,245,250,253,257,261,266,270,275,280,284,286,289,292,296,299,303,305,308,311,315,319,324,328,333,336,338,341,345,349,352,356,361,364,366,370,375,380,384,389,391,395,396,397,399,401,404,406,409,412,416,418,421,424,428,431,435,439,442,444,447,450,454,457,461,465,470,473,475,479,482,486,489,494,496,498,501,504,508,511,515,519,524,527,531,535,540,544,549,554,558,561,565,569,572,576,581,586,590,594,597,602,604,609,613,615,616,618,621,624,628,631,635,639,644,647,651,655,660,662,665,668,670,673,677,681,686,690,695,700,702,706,709,714,718,721,723,727,728,731,735,739,744,748,753,756,760,764,769,774,776,779,783,785,786,788,791,794,796,799,803,805,806,809,811,815,816,818,819,820,820};
+ndInt32 ndIsoSurface::ndImplementation::m_edgeScan[] = { 0,0,3,6,10,13,19,23,28,31,35,41,46,50,55,60,64,67,71,77,82,88,95,102,108,114,119,128,134,141,147,155,160,163,169,173,178,184,193,198,204,210,217,224,230,237,245,251,256,260,265,270,274,281,289,295,300,307,313,321,326,334,341,348,352,355,361,367,374,378,385,390,396,402,409,418,426,431,437,443,448,454,461,470,478,485,493,501,508,517,525,537,546,554,561,570,576,580,587,592,598,603,611,615,620,627,635,643,650,656,663,668,672,677,683,689,694,700,707,712,716,724,731,740,746,753,759,765,768,771,777,783,790,796,805,812,820,824,829,836,842,847,853,859,864,868,873,880,886,893,901,909,916,921,925,933,938,944,949,956,960,966,975,982,990,999,1011,1019,1028,1035,1043,1051,1058,1066,1075,1082,1088,1093,1099,1105,1110,1118,1127,1134,1140,1146,1151,1158,1162,1169,1175,1181,1184,1188,1195,1202,1210,1215,1223,1229,1236,1241,1247,1255,1262,1266,1271,1276,1280,1285,1291,1299,1306,1312,1319,1326,1332,1338,1343,1352,1358,1363,1367,1373,1376,1381,1389,1395,1402,1408,1417,1422,1428,1434,1441,1448,1454,1459,1465,1469,1472,1476,1481,1486,1490,1495,1501,1505,1508,1513,1517,1523,1526,1530,1533,1536,1536 };
 
 ndIsoSurface::ndImplementation::ndEdge ndIsoSurface::ndImplementation::m_edges[] =
 {
@@ -2581,22 +2631,48 @@ ndVector ndIsoSurface::ndImplementation::m_gridCorners[] =
 	ndVector(ndFloat32(-1.0f), ndFloat32(0.0f), ndFloat32(-1.0f), ndFloat32(0.0f))
 };
 
+// integer offset of each cube corner from the cube cell
+ndInt32 ndIsoSurface::ndImplementation::m_cornerOffsets[][3] =
+{
+	{ 1, 0, 0 },
+	{ 1, 0, 1 },
+	{ 0, 0, 1 },
+	{ 0, 0, 0 },
+	{ 1, 1, 0 },
+	{ 1, 1, 1 },
+	{ 0, 1, 1 },
+	{ 0, 1, 0 }
+};
+
+static inline ndInt32 ndIsoSurfaceBitCount(ndInt32 mask)
+{
+	ndInt32 count = 0;
+	for (; mask; mask &= mask - 1)
+	{
+		count++;
+	}
+	return count;
+}
+
 inline ndIsoSurface::ndImplementation::ndImplementation()
 	:ndClassAlloc()
 	,m_boxP0(ndVector::m_zero)
 	,m_boxP1(ndVector::m_zero)
+	,m_anchor(ndVector::m_zero)
 	,m_gridSize(ndVector::m_zero)
 	,m_invGridSize(ndVector::m_zero)
+	,m_cells(256)
+	,m_cubes(256)
+	,m_newCells(256)
 	,m_hashGridMap(256)
 	,m_hashGridMapScratchBuffer(256)
+	,m_cellVertex(256)
 	,m_triangles(256)
-	,m_trianglesScratchBuffer(256)
 	,m_isoValue(ndFloat32 (0.5f))
-	//,m_worlToGridOrigin(ndFloat32(1.0f))
-	//,m_worlToGridScale(ndFloat32(1.0f))
 	,m_volumeSizeX(1)
 	,m_volumeSizeY(1)
 	,m_volumeSizeZ(1)
+	,m_changedCellCount(0)
 	,m_upperDigitsIsValid()
 {
 }
@@ -2612,45 +2688,395 @@ ndVector ndIsoSurface::ndImplementation::GetOrigin() const
 
 void ndIsoSurface::ndImplementation::Clear()
 {
+	m_cells.Resize(256);
+	m_cubes.Resize(256);
+	m_newCells.Resize(256);
 	m_triangles.Resize(256);
+	m_cellVertex.Resize(256);
 	m_hashGridMap.Resize(256);
-	m_trianglesScratchBuffer.Resize(256);
 	m_hashGridMapScratchBuffer.Resize(256);
+	m_cells.SetCount(0);
+	m_cubes.SetCount(0);
+}
+
+template <typename Function>
+void ndIsoSurface::ndImplementation::ParallelExecute(ndThreadPool* const threadPool, const Function& function) const
+{
+	if (threadPool)
+	{
+		threadPool->ParallelExecute(function);
+	}
+	else
+	{
+		function(0, 1);
+	}
+}
+
+ndInt32 ndIsoSurface::ndImplementation::GetThreadCount(ndThreadPool* const threadPool) const
+{
+	return threadPool ? threadPool->GetThreadCount() : 1;
+}
+
+template <ndInt32 byte>
+void ndIsoSurface::ndImplementation::SortDigit(ndThreadPool* const threadPool, ndArray<ndGridHash>& array, ndArray<ndGridHash>& scratchBuffer) const
+{
+	if (threadPool)
+	{
+		ndCountingSort<ndGridHash, ndGridHashDigit<byte>, 8>(*threadPool, array, scratchBuffer, nullptr, nullptr);
+	}
+	else
+	{
+		ndCountingSort<ndGridHash, ndGridHashDigit<byte>, 8>(array, scratchBuffer, nullptr, nullptr);
+	}
+}
+
+void ndIsoSurface::ndImplementation::SortGridHash(ndThreadPool* const threadPool, ndArray<ndGridHash>& array)
+{
+	D_TRACKTIME();
+	if (array.GetCount() > 1)
+	{
+		ndArray<ndGridHash>& scratchBuffer = m_hashGridMapScratchBuffer;
+		SortDigit<0>(threadPool, array, scratchBuffer);
+		if (m_upperDigitsIsValid.m_x)
+		{
+			SortDigit<1>(threadPool, array, scratchBuffer);
+		}
+		SortDigit<2>(threadPool, array, scratchBuffer);
+		if (m_upperDigitsIsValid.m_y)
+		{
+			SortDigit<3>(threadPool, array, scratchBuffer);
+		}
+		SortDigit<4>(threadPool, array, scratchBuffer);
+		if (m_upperDigitsIsValid.m_z)
+		{
+			SortDigit<5>(threadPool, array, scratchBuffer);
+		}
+	}
+}
+
+ndInt32 ndIsoSurface::ndImplementation::LowerBound(const ndArray<ndGridHash>& array, ndUnsigned64 hash, ndInt32 start) const
+{
+	ndInt32 i0 = start;
+	ndInt32 i1 = ndInt32(array.GetCount());
+	while (i0 < i1)
+	{
+		const ndInt32 middle = (i0 + i1) >> 1;
+		if (array[middle].m_gridCellHash < hash)
+		{
+			i0 = middle + 1;
+		}
+		else
+		{
+			i1 = middle;
+		}
+	}
+	return i0;
+}
+
+ndInt32 ndIsoSurface::ndImplementation::FindCell(ndInt32& cursor, ndUnsigned64 hash) const
+{
+	// the callers look up cells with increasing keys, 
+	// so most searches are a few steps forward from the last one.
+	const ndInt32 count = ndInt32(m_cells.GetCount());
+	ndInt32 index = cursor;
+	for (ndInt32 i = 0; (i < 8) && (index < count) && (m_cells[index].m_gridCellHash < hash); ++i)
+	{
+		index++;
+	}
+	if ((index < count) && (m_cells[index].m_gridCellHash < hash))
+	{
+		index = LowerBound(m_cells, hash, index);
+	}
+	cursor = index;
+	return ((index < count) && (m_cells[index].m_gridCellHash == hash)) ? index : -1;
+}
+
+void ndIsoSurface::ndImplementation::SplitKeys(const ndArray<ndGridHash>& array0, const ndArray<ndGridHash>& array1, ndInt32 threadIndex, ndInt32 threadCount, ndInt32* const range0, ndInt32* const range1) const
+{
+	// the longer of the two sorted arrays splits the keys among the threads, 
+	// equal keys always go to the same thread.
+	const ndUnsigned64 maxKey = ndUnsigned64(-1);
+	const ndInt32 count0 = ndInt32(array0.GetCount());
+	const ndInt32 count1 = ndInt32(array1.GetCount());
+	const ndArray<ndGridHash>& splitArray = (count0 >= count1) ? array0 : array1;
+	const ndInt32 splitCount = ndMax(count0, count1);
+	const ndStartEnd startEnd(splitCount, threadIndex, threadCount);
+	const ndUnsigned64 key0 = threadIndex ? ((startEnd.m_start < splitCount) ? ndUnsigned64(splitArray[startEnd.m_start].m_gridCellHash) : maxKey) : 0;
+	const ndUnsigned64 key1 = (startEnd.m_end < splitCount) ? ndUnsigned64(splitArray[startEnd.m_end].m_gridCellHash) : maxKey;
+	range0[0] = LowerBound(array0, key0);
+	range0[1] = LowerBound(array0, key1);
+	range1[0] = LowerBound(array1, key0);
+	range1[1] = LowerBound(array1, key1);
 }
 
-void ndIsoSurface::ndImplementation::CalculateAabb(const ndArray<ndVector>& points, ndFloat32 gridSize)
+void ndIsoSurface::ndImplementation::CompactBlocks(ndThreadPool* const threadPool, ndArray<ndGridHash>& array)
 {
 	D_TRACKTIME();
+	ndInt32 offsets[D_MAX_THREADS_COUNT];
+	ndInt32 count = 0;
+	const ndInt32 threadCount = GetThreadCount(threadPool);
+	for (ndInt32 i = 0; i < threadCount; ++i)
+	{
+		offsets[i] = count;
+		count += m_blockCount[i];
+	}
+	array.SetCount(count);
+
+	auto CopyBlocks = ndMakeObject::ndFunction([this, &array, &offsets](ndInt32 threadIndex, ndInt32)
+	{
+		D_TRACKTIME_NAMED(CopyBlocks);
+		const ndInt32 start = m_blockStart[threadIndex];
+		const ndInt32 offset = offsets[threadIndex];
+		for (ndInt32 i = m_blockCount[threadIndex] - 1; i >= 0; --i)
+		{
+			array[offset + i] = m_hashGridMapScratchBuffer[start + i];
+		}
+	});
+	ParallelExecute(threadPool, CopyBlocks);
+}
 
+void ndIsoSurface::ndImplementation::CalculateAabb(const ndArray<ndVector>& points, ndFloat32 gridSize, ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+
+	const bool sameGrid = (m_gridSize.m_x == gridSize);
 	m_isoValue = ndFloat32(0.5f);
 	m_gridSize = ndVector::m_triplexMask & ndVector(gridSize);
 	m_invGridSize = ndVector::m_triplexMask & ndVector(ndFloat32(1.0f) / gridSize);
 
-	ndVector boxP0(ndFloat32(1.0e10f));
-	ndVector boxP1(ndFloat32(-1.0e10f));
-	for (ndInt32 i = 0; i < points.GetCount(); ++i)
+	ndVector boxP0[D_MAX_THREADS_COUNT];
+	ndVector boxP1[D_MAX_THREADS_COUNT];
+	auto CalculateBounds = ndMakeObject::ndFunction([&points, &boxP0, &boxP1](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateBounds);
+		ndVector p0(ndFloat32(1.0e10f));
+		ndVector p1(ndFloat32(-1.0e10f));
+		const ndStartEnd startEnd(ndInt32(points.GetCount()), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			p0 = p0.GetMin(points[i]);
+			p1 = p1.GetMax(points[i]);
+		}
+		boxP0[threadIndex] = p0;
+		boxP1[threadIndex] = p1;
+	});
+	ParallelExecute(threadPool, CalculateBounds);
+
+	ndVector p0(boxP0[0]);
+	ndVector p1(boxP1[0]);
+	for (ndInt32 i = GetThreadCount(threadPool) - 1; i > 0; --i)
 	{
-		boxP0 = boxP0.GetMin(points[i]);
-		boxP1 = boxP1.GetMax(points[i]);
+		p0 = p0.GetMin(boxP0[i]);
+		p1 = p1.GetMax(boxP1[i]);
 	}
-	boxP0 -= m_gridSize;
-	boxP1 += (m_gridSize + m_gridSize);
 
-	// quantize the aabb to integers of the gird size
-	boxP0 = m_gridSize * (boxP0 * m_invGridSize).Floor();
-	boxP1 = m_gridSize * (boxP1 * m_invGridSize).Floor();
-
-	// make sure the w component is zero.
-	m_boxP0 = boxP0 & ndVector::m_triplexMask;
-	m_boxP1 = boxP1 & ndVector::m_triplexMask;
+	// quantize the aabb to world aligned cells
+	const ndVector cell0(ndVector::m_triplexMask & (p0 * m_invGridSize).Floor());
+	const ndVector cell1(ndVector::m_triplexMask & (p1 * m_invGridSize).Floor());
+
+	// the cells of the last update can be reused if the new cells
+	// still fit in the volume and leave room for the cube corners.
+	const ndVector low(cell0 - m_anchor);
+	const ndVector high(cell1 - m_anchor);
+	const bool fitVolume =
+		(low.m_x >= ndFloat32(1.0f)) && (low.m_y >= ndFloat32(1.0f)) && (low.m_z >= ndFloat32(1.0f)) &&
+		(high.m_x < ndFloat32(D_ISO_SURFACE_MAX_CELL)) && (high.m_y < ndFloat32(D_ISO_SURFACE_MAX_CELL)) && (high.m_z < ndFloat32(D_ISO_SURFACE_MAX_CELL));
+	if (!(sameGrid && fitVolume && m_cells.GetCount()))
+	{
+		m_cells.SetCount(0);
+		m_cubes.SetCount(0);
+		m_upperDigitsIsValid = ndUpperDigit();
+		m_anchor = ndVector::m_triplexMask & (cell0 - ndVector(ndFloat32(D_ISO_SURFACE_PADDING)));
+	}
 
-	const ndVector sizeInGrids(((boxP1 - boxP0) * m_invGridSize + ndVector::m_one).Floor().GetInt());
+	const ndVector sizeInGrids((cell1 - m_anchor + ndVector::m_one + ndVector::m_one).GetInt());
 	m_volumeSizeX = ndInt32(sizeInGrids.m_ix);
 	m_volumeSizeY = ndInt32(sizeInGrids.m_iy);
 	m_volumeSizeZ = ndInt32(sizeInGrids.m_iz);
+	ndAssert(m_volumeSizeX < 0xffff);
+	ndAssert(m_volumeSizeY < 0xffff);
+	ndAssert(m_volumeSizeZ < 0xffff);
+
+	// cells removed in this update may still use the upper digits 
+	m_upperDigitsIsValid.m_x |= (m_volumeSizeX >= 256) ? 1 : 0;
+	m_upperDigitsIsValid.m_y |= (m_volumeSizeY >= 256) ? 1 : 0;
+	m_upperDigitsIsValid.m_z |= (m_volumeSizeZ >= 256) ? 1 : 0;
 
-	//m_worlToGridOrigin = m_boxP0.m_x;
-	//m_worlToGridScale = ndFloat32(1 << D_GRID_X_RESOLUTION) * m_volumeSizeX / (m_boxP1.m_x - m_boxP0.m_x);
+	m_boxP0 = m_anchor * m_gridSize;
+	m_boxP1 = (cell1 + ndVector::m_one) * m_gridSize;
+}
+
+void ndIsoSurface::ndImplementation::CalculateOccupiedCells(const ndArray<ndVector>& points, ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+	m_hashGridMap.SetCount(points.GetCount());
+	auto HashPoints = ndMakeObject::ndFunction([this, &points](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(HashPoints);
+		const ndVector anchor(m_anchor);
+		const ndVector invGridSize(m_invGridSize);
+		const ndStartEnd startEnd(ndInt32(points.GetCount()), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndVector cell((points[i] * invGridSize).Floor() - anchor);
+			m_hashGridMap[i] = ndGridHash(cell);
+		}
+	});
+	ParallelExecute(threadPool, HashPoints);
+	SortGridHash(threadPool, m_hashGridMap);
+
+	// each thread packs the unique cells of its block in place, then the blocks are joined
+	m_hashGridMapScratchBuffer.SetCount(m_hashGridMap.GetCount());
+	auto RemoveDuplicates = ndMakeObject::ndFunction([this](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(RemoveDuplicates);
+		ndInt32 count = 0;
+		const ndStartEnd startEnd(ndInt32(m_hashGridMap.GetCount()), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndGridHash cell(m_hashGridMap[i]);
+			if ((i == 0) || (cell.m_gridCellHash != m_hashGridMap[i - 1].m_gridCellHash))
+			{
+				m_hashGridMapScratchBuffer[startEnd.m_start + count] = cell;
+				count++;
+			}
+		}
+		m_blockStart[threadIndex] = startEnd.m_start;
+		m_blockCount[threadIndex] = count;
+	});
+	ParallelExecute(threadPool, RemoveDuplicates);
+	CompactBlocks(threadPool, m_newCells);
+}
+
+void ndIsoSurface::ndImplementation::CalculateChangedCells(ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+	// merge the old and the new sorted cells, keeping the ones that are only in one set
+	m_hashGridMapScratchBuffer.SetCount(m_cells.GetCount() + m_newCells.GetCount());
+	auto FindChangedCells = ndMakeObject::ndFunction([this](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(FindChangedCells);
+		ndInt32 range0[2];
+		ndInt32 range1[2];
+		SplitKeys(m_cells, m_newCells, threadIndex, threadCount, range0, range1);
+
+		ndInt32 i = range0[0];
+		ndInt32 j = range1[0];
+		const ndInt32 start = i + j;
+		const ndUnsigned64 maxKey = ndUnsigned64(-1);
+
+		ndInt32 count = 0;
+		while ((i < range0[1]) || (j < range1[1]))
+		{
+			const ndUnsigned64 oldKey = (i < range0[1]) ? ndUnsigned64(m_cells[i].m_gridCellHash) : maxKey;
+			const ndUnsigned64 newKey = (j < range1[1]) ? ndUnsigned64(m_newCells[j].m_gridCellHash) : maxKey;
+			if (oldKey == newKey)
+			{
+				i++;
+				j++;
+			}
+			else if (oldKey < newKey)
+			{
+				m_hashGridMapScratchBuffer[start + count] = m_cells[i];
+				count++;
+				i++;
+			}
+			else
+			{
+				m_hashGridMapScratchBuffer[start + count] = m_newCells[j];
+				count++;
+				j++;
+			}
+		}
+		m_blockStart[threadIndex] = start;
+		m_blockCount[threadIndex] = count;
+	});
+	ParallelExecute(threadPool, FindChangedCells);
+
+	ndInt32 offsets[D_MAX_THREADS_COUNT];
+	ndInt32 changedCount = 0;
+	const ndInt32 threadCount = GetThreadCount(threadPool);
+	for (ndInt32 i = 0; i < threadCount; ++i)
+	{
+		offsets[i] = changedCount;
+		changedCount += m_blockCount[i];
+	}
+	m_changedCellCount = changedCount;
+
+	// a changed cell flips its corner bit in the eight cubes that share it
+	m_hashGridMap.SetCount(changedCount * 8);
+	auto AddCornerToggles = ndMakeObject::ndFunction([this, &offsets](ndInt32 threadIndex, ndInt32)
+	{
+		D_TRACKTIME_NAMED(AddCornerToggles);
+		const ndGridHashSteps steps;
+		const ndInt32 start = m_blockStart[threadIndex];
+		const ndInt32 offset = offsets[threadIndex];
+		for (ndInt32 i = m_blockCount[threadIndex] - 1; i >= 0; --i)
+		{
+			const ndGridHash cell(m_hashGridMapScratchBuffer[start + i]);
+			for (ndInt32 j = 0; j < 8; ++j)
+			{
+				ndGridHash cube(cell);
+				cube.m_x += steps.m_steps[j].m_x;
+				cube.m_y += steps.m_steps[j].m_y;
+				cube.m_z += steps.m_steps[j].m_z;
+				cube.m_cellType = ndUnsigned8(1 << steps.m_cellType[j]);
+				m_hashGridMap[(offset + i) * 8 + j] = cube;
+			}
+		}
+	});
+	ParallelExecute(threadPool, AddCornerToggles);
+	SortGridHash(threadPool, m_hashGridMap);
+}
+
+void ndIsoSurface::ndImplementation::UpdateCubes(ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+	// merge the cubes of the last update with the sorted corner toggles
+	m_hashGridMapScratchBuffer.SetCount(m_cubes.GetCount() + m_hashGridMap.GetCount());
+	auto MergeCubes = ndMakeObject::ndFunction([this](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(MergeCubes);
+		ndInt32 range0[2];
+		ndInt32 range1[2];
+		SplitKeys(m_cubes, m_hashGridMap, threadIndex, threadCount, range0, range1);
+
+		ndInt32 i = range0[0];
+		ndInt32 j = range1[0];
+		const ndInt32 i1 = range0[1];
+		const ndInt32 j1 = range1[1];
+		const ndInt32 start = i + j;
+		const ndUnsigned64 maxKey = ndUnsigned64(-1);
+
+		ndInt32 count = 0;
+		while ((i < i1) || (j < j1))
+		{
+			const ndUnsigned64 cubeKey = (i < i1) ? ndUnsigned64(m_cubes[i].m_gridCellHash) : maxKey;
+			const ndUnsigned64 toggleKey = (j < j1) ? ndUnsigned64(m_hashGridMap[j].m_gridCellHash) : maxKey;
+			const ndUnsigned64 key = ndMin(cubeKey, toggleKey);
+			const ndGridHash cube((cubeKey == key) ? m_cubes[i] : m_hashGridMap[j]);
+
+			ndInt32 mask = 0;
+			if (cubeKey == key)
+			{
+				mask = m_cubes[i].m_cellType;
+				i++;
+			}
+			for (; (j < j1) && (m_hashGridMap[j].m_gridCellHash == key); ++j)
+			{
+				mask ^= m_hashGridMap[j].m_cellType;
+			}
+			if (mask)
+			{
+				m_hashGridMapScratchBuffer[start + count] = ndGridHash(cube, ndInt8(mask));
+				count++;
+			}
+		}
+		m_blockStart[threadIndex] = start;
+		m_blockCount[threadIndex] = count;
+	});
+	ParallelExecute(threadPool, MergeCubes);
+	CompactBlocks(threadPool, m_cubes);
 }
 
 ndVector ndIsoSurface::ndImplementation::InterpolateLowResVertex(const ndVector& p0, const ndVector& p1) const
@@ -2676,13 +3102,10 @@ ndVector ndIsoSurface::ndImplementation::InterpolateHighResVertex(ndFloat32, con
 	return ndVector(p0 + p1p0 * ndVector::m_half);
 }
 
-void ndIsoSurface::ndImplementation::ProcessLowResCell(ndIsoCell& cell)
+void ndIsoSurface::ndImplementation::ProcessLowResCell(const ndGridHash& cube, ndVector* const triangle) const
 {
-	ndInt32 tableIndex = 0;
-	for (ndInt32 i = 0; i < 8; ++i)
-	{
-		tableIndex |= (cell.m_isoValues[i].m_w > m_isoValue) << i;
-	}
+	const ndInt32 tableIndex = cube.m_cellType;
+	const ndVector origin(ndFloat32(cube.m_x + 1), ndFloat32(cube.m_y + 1), ndFloat32(cube.m_z + 1), ndFloat32(0.0f));
 
 	ndVector vertlist[12];
 	const ndInt32 start = m_edgeScan[tableIndex];
@@ -2690,31 +3113,21 @@ void ndIsoSurface::ndImplementation::ProcessLowResCell(ndIsoCell& cell)
 	for (ndInt32 i = 0; i < edgeCount; ++i)
 	{
 		const ndEdge& edge = m_edges[start + i];
-		const ndInt32 midPoint = edge.m_midPoint;
-		const ndInt32 p0 = edge.m_p0;
-		const ndInt32 p1 = edge.m_p1;
-		vertlist[midPoint] = InterpolateLowResVertex(cell.m_isoValues[p0], cell.m_isoValues[p1]);
+		ndVector p0(origin + m_gridCorners[edge.m_p0]);
+		ndVector p1(origin + m_gridCorners[edge.m_p1]);
+		p0.m_w = ndFloat32((tableIndex >> edge.m_p0) & 1);
+		p1.m_w = ndFloat32((tableIndex >> edge.m_p1) & 1);
+		vertlist[edge.m_midPoint] = InterpolateLowResVertex(p0, p1) * m_gridSize;
 	}
 	
-	const ndInt32 index = m_triangles.GetCount();
 	const ndInt32 faceStart = m_facesScan[tableIndex];
 	const ndInt32 faceVertexCount = m_facesScan[tableIndex + 1] - faceStart;
-	
-	m_triangles.SetCount(index + faceVertexCount * 3);
-	ndVector* const triangle = &m_triangles[index];
 	for (ndInt32 i = 0; i < faceVertexCount; ++i)
 	{
 		const ndInt32 j = i * 3;
-		const ndInt32 j0 = m_faces[faceStart + i][0];
-		const ndInt32 j1 = m_faces[faceStart + i][1];
-		const ndInt32 j2 = m_faces[faceStart + i][2];
-		
-		triangle[j + 0] = vertlist[j0];
-		triangle[j + 1] = vertlist[j1];
-		triangle[j + 2] = vertlist[j2];
-		triangle[j + 0].m_w = ndFloat32(index + j + 0);
-		triangle[j + 1].m_w = ndFloat32(index + j + 1);
-		triangle[j + 2].m_w = ndFloat32(index + j + 2);
+		triangle[j + 0] = vertlist[m_faces[faceStart + i][0]];
+		triangle[j + 1] = vertlist[m_faces[faceStart + i][1]];
+		triangle[j + 2] = vertlist[m_faces[faceStart + i][2]];
 	}
 }
 
@@ -2798,235 +3211,50 @@ void ndIsoSurface::ndImplementation::CalculateNormals(ndIsoSurface* const)
 	//}
 }
 
-void ndIsoSurface::ndImplementation::SortCellBuckects()
-{
-	D_TRACKTIME();
-	class ndKey_xlow
-	{
-		public:
-		ndKey_xlow(void* const){}
-		ndInt32 GetKey(const ndGridHash& cell) const
-		{
-			return cell.m_xLow;
-		}
-	};
-
-	class ndKey_ylow
-	{
-		public:
-		ndKey_ylow(void* const) {}
-		ndInt32 GetKey(const ndGridHash& cell) const
-		{
-			return cell.m_yLow;
-		}
-	};
-
-	class ndKey_zlow
-	{
-		public:
-		ndKey_zlow(void* const) {}
-		ndInt32 GetKey(const ndGridHash& cell) const
-		{
-			return cell.m_zLow;
-		}
-	};
-
-	class ndKey_xhigh
-	{
-		public:
-		ndKey_xhigh(void* const) {}
-		ndInt32 GetKey(const ndGridHash& cell) const
-		{
-			return cell.m_xHigh;
-		}
-	};
-
-	class ndKey_yhigh
-	{
-		public:
-		ndKey_yhigh(void* const) {}
-		ndInt32 GetKey(const ndGridHash& cell) const
-		{
-			return cell.m_yHigh;
-		}
-	};
-
-	class ndKey_zhigh
-	{
-		public:
-		ndKey_zhigh(void* const) {}
-		ndInt32 GetKey(const ndGridHash& cell) const
-		{
-			return cell.m_zHigh;
-		}
-	};
-
-	ndCountingSort<ndGridHash, ndKey_xlow, 8>(m_hashGridMap, m_hashGridMapScratchBuffer, nullptr, nullptr);
-	if (m_upperDigitsIsValid.m_x)
-	{
-		ndCountingSort<ndGridHash, ndKey_xhigh, 8>(m_hashGridMap, m_hashGridMapScratchBuffer, nullptr, nullptr);
-	}
-
-	ndCountingSort<ndGridHash, ndKey_ylow, 8>(m_hashGridMap, m_hashGridMapScratchBuffer, nullptr, nullptr);
-	if (m_upperDigitsIsValid.m_y)
-	{
-		ndCountingSort<ndGridHash, ndKey_yhigh, 8>(m_hashGridMap, m_hashGridMapScratchBuffer, nullptr, nullptr);
-	}
-
-	ndCountingSort<ndGridHash, ndKey_zlow, 8>(m_hashGridMap, m_hashGridMapScratchBuffer, nullptr, nullptr);
-	if (m_upperDigitsIsValid.m_z)
-	{
-		ndCountingSort<ndGridHash, ndKey_zhigh, 8>(m_hashGridMap, m_hashGridMapScratchBuffer, nullptr, nullptr);
-	}
-}
-
-void ndIsoSurface::ndImplementation::RemoveDuplicates(const ndArray<ndVector>& points)
+void ndIsoSurface::ndImplementation::GenerateLowResIsoSurface(ndIsoSurface* const me, ndThreadPool* const threadPool)
 {
 	D_TRACKTIME();
-	class ndKey_xlow
-	{
-		public:
-		ndKey_xlow(void* const) {}
-		ndInt32 GetKey(const ndGridHash& cell) const
-		{
-			return cell.m_xLow;
-		}
-	};
-
-	class ndKey_ylow
-	{
-		public:
-		ndKey_ylow(void* const) {}
-		ndInt32 GetKey(const ndGridHash& cell) const
-		{
-			return cell.m_yLow;
-		}
-	};
-
-	class ndKey_zlow
+	auto CountFaces = ndMakeObject::ndFunction([this](ndInt32 threadIndex, ndInt32 threadCount)
 	{
-		public:
-		ndKey_zlow(void* const) {}
-		ndInt32 GetKey(const ndGridHash& cell) const
-		{
-			return cell.m_zLow;
-		}
-	};
-
-	class ndKey_xhigh
-	{
-		public:
-		ndKey_xhigh(void* const) {}
-		ndInt32 GetKey(const ndGridHash& cell) const
-		{
-			return cell.m_xHigh;
-		}
-	};
-
-	class ndKey_yhigh
-	{
-		public:
-		ndKey_yhigh(void* const) {}
-		ndInt32 GetKey(const ndGridHash& cell) const
+		D_TRACKTIME_NAMED(CountFaces);
+		ndInt32 faceCount = 0;
+		const ndStartEnd startEnd(ndInt32(m_cubes.GetCount()), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
 		{
-			return cell.m_yHigh;
+			const ndInt32 tableIndex = m_cubes[i].m_cellType;
+			faceCount += m_facesScan[tableIndex + 1] - m_facesScan[tableIndex];
 		}
-	};
-
-	class ndKey_zhigh
-	{
-		public:
-		ndKey_zhigh(void* const) {}
-		ndInt32 GetKey(const ndGridHash& cell) const
-		{
-			return cell.m_zHigh;
-		}
-	};
-
-	const ndVector origin(m_boxP0);
-	const ndVector invGridSize(m_invGridSize);
-
-	const ndVector rounding(ndVector::m_zero);
-	ndUpperDigit upperDigits;
-	const ndGridHashSteps steps;
-	m_hashGridMapScratchBuffer.SetCount(points.GetCount());
-	for (ndInt32 i = 0; i < points.GetCount(); ++i)
-	{
-		const ndVector r(points[i] - origin);
-		const ndVector p(r * invGridSize + rounding);
-		const ndGridHash hashKey(p);
-		m_hashGridMapScratchBuffer[i] = hashKey;
-
-		upperDigits.m_x = ndMax(upperDigits.m_x, ndInt32(hashKey.m_xHigh));
-		upperDigits.m_y = ndMax(upperDigits.m_y, ndInt32(hashKey.m_yHigh));
-		upperDigits.m_z = ndMax(upperDigits.m_z, ndInt32(hashKey.m_zHigh));
-	}
-	m_upperDigitsIsValid = upperDigits;
+		m_blockCount[threadIndex] = faceCount;
+	});
+	ParallelExecute(threadPool, CountFaces);
 
-	ndCountingSort<ndGridHash, ndKey_xlow, 8>(m_hashGridMapScratchBuffer, m_hashGridMap, nullptr, nullptr);
-	if (m_upperDigitsIsValid.m_x)
+	ndInt32 faceCount = 0;
+	const ndInt32 threadCount = GetThreadCount(threadPool);
+	for (ndInt32 i = 0; i < threadCount; ++i)
 	{
-		ndCountingSort<ndGridHash, ndKey_xhigh, 8>(m_hashGridMapScratchBuffer, m_hashGridMap, nullptr, nullptr);
+		m_blockStart[i] = faceCount;
+		faceCount += m_blockCount[i];
 	}
 
-	ndCountingSort<ndGridHash, ndKey_ylow, 8>(m_hashGridMapScratchBuffer, m_hashGridMap, nullptr, nullptr);
-	if (m_upperDigitsIsValid.m_y)
-	{
-		ndCountingSort<ndGridHash, ndKey_yhigh, 8>(m_hashGridMapScratchBuffer, m_hashGridMap, nullptr, nullptr);
-	}
-
-	ndCountingSort<ndGridHash, ndKey_zlow, 8>(m_hashGridMapScratchBuffer, m_hashGridMap, nullptr, nullptr);
-	if (m_upperDigitsIsValid.m_z)
-	{
-		ndCountingSort<ndGridHash, ndKey_zhigh, 8>(m_hashGridMapScratchBuffer, m_hashGridMap, nullptr, nullptr);
-	}
-
-	ndInt32 gridCount = 0;
-	for (ndInt32 i = 1; i < m_hashGridMapScratchBuffer.GetCount(); ++i)
-	{
-		const ndGridHash cell(m_hashGridMapScratchBuffer[i]);
-		gridCount += (cell.m_gridFullHash != m_hashGridMapScratchBuffer[i - 1].m_gridFullHash);
-		m_hashGridMapScratchBuffer[gridCount] = cell;
-	}
-	gridCount++;
-	m_hashGridMapScratchBuffer.SetCount(gridCount);
-}
-	
-void ndIsoSurface::ndImplementation::GenerateLowResIsoSurface()
-{
-	D_TRACKTIME();
-	ndInt32 end = 0;
-	const ndInt32 gridCount = m_hashGridMap.GetCount();
-	m_hashGridMap.PushBack(ndGridHash(0xffff, 0xffff, 0xffff));
-
-	m_triangles.SetCount(0);
-	for (ndInt32 i = 0; i < gridCount; i = end)
+	ndArray<ndVector>& points = me->m_points;
+	points.SetCount(faceCount * 3);
+	auto EmitTriangles = ndMakeObject::ndFunction([this, &points](ndInt32 threadIndex, ndInt32 threadCount)
 	{
-		end = i + 1;
-		ndInt32 start = i;
-		const ndGridHash startGrid(m_hashGridMap[start], 0);
-		while (startGrid.m_gridCellHash == ndGridHash(m_hashGridMap[end], 0).m_gridCellHash)
-		{
-			end++;
-		}
-		ndInt32 count = end - start;
-		if (count < 8)
+		D_TRACKTIME_NAMED(EmitTriangles);
+		ndInt32 faceIndex = m_blockStart[threadIndex];
+		const ndStartEnd startEnd(ndInt32(m_cubes.GetCount()), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
 		{
-			ndIsoCell cell;
-			ndVector* const isoValue = &cell.m_isoValues[0];
-			ndVector origin(ndFloat32(startGrid.m_x + 1), ndFloat32(startGrid.m_y + 1), ndFloat32(startGrid.m_z + 1), ndFloat32(0.0f));
-			for (ndInt32 j = 0; j < 8; ++j)
-			{
-				isoValue[j] = origin + m_gridCorners[j];
-			}
-			for (ndInt32 j = 0; j < count; ++j)
+			const ndGridHash cube(m_cubes[i]);
+			const ndInt32 faceCount = m_facesScan[cube.m_cellType + 1] - m_facesScan[cube.m_cellType];
+			if (faceCount)
 			{
-				ndInt32 index = m_hashGridMap[start + j].m_cellType;
-				isoValue[index].m_w = ndFloat32(1.0f);
+				ProcessLowResCell(cube, &points[faceIndex * 3]);
+				faceIndex += faceCount;
 			}
-			ProcessLowResCell(cell);
 		}
-	}
+	});
+	ParallelExecute(threadPool, EmitTriangles);
 }
 
 void ndIsoSurface::ndImplementation::GenerateHighResIsoSurface(ndCalculateIsoValue* const computeIsoValue)
@@ -3067,255 +3295,219 @@ void ndIsoSurface::ndImplementation::GenerateHighResIsoSurface(ndCalculateIsoVal
 }
 
 ndInt32 ndIsoSurface::ndImplementation::GenerateLowResIndexList(
-	const ndIsoSurface* const me, 
 	ndInt32* const indexList, ndInt32 strideInFloats, 
-	ndReal* const posit, ndReal* const normals)
+	ndReal* const posit, ndReal* const normals, ndThreadPool* const threadPool)
 {
 	D_TRACKTIME();
-	#define D_LOW_RES_BITS	   1
-	#define D_LOW_RES_FRACTION (1 << D_LOW_RES_BITS)
-
-	class ndKey_lowX
+	// a vertex is the face of an occupied cell that borders an empty cell,
+	// so the sorted cells number the vertices with no need to weld positions.
+	const ndInt32 cellCount = ndInt32(m_cells.GetCount());
+	m_cellVertex.SetCount(cellCount);
+	auto CountVertices = ndMakeObject::ndFunction([this, cellCount](ndInt32 threadIndex, ndInt32 threadCount)
 	{
-		public:
-		ndKey_lowX(void* const) {}
-		ndInt32 GetKey(const ndVector& point) const
+		D_TRACKTIME_NAMED(CountVertices);
+		const ndUnsigned64 ySteps = ndUnsigned64(1) << 16;
+		const ndUnsigned64 zSteps = ndUnsigned64(1) << 32;
+		ndInt32 cursor[] = { 0, 0, 0, 0 };
+		ndInt32 vertexCount = 0;
+		const ndStartEnd startEnd(cellCount, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
 		{
-			ndFloat32 val = (point.m_x * D_LOW_RES_FRACTION);
-			ndInt32 key = ndInt32(val);
-			return key & 0xff;
+			const ndUnsigned64 hash = m_cells[i].m_gridCellHash;
+
+			// x neighbors are next to each other in the sorted list
+			ndInt32 faceMask = 0;
+			faceMask |= ((i == 0) || (m_cells[i - 1].m_gridCellHash != hash - 1)) ? 1 << 0 : 0;
+			faceMask |= ((i == cellCount - 1) || (m_cells[i + 1].m_gridCellHash != hash + 1)) ? 1 << 1 : 0;
+			faceMask |= (FindCell(cursor[0], hash - ySteps) < 0) ? 1 << 2 : 0;
+			faceMask |= (FindCell(cursor[1], hash + ySteps) < 0) ? 1 << 3 : 0;
+			faceMask |= (FindCell(cursor[2], hash - zSteps) < 0) ? 1 << 4 : 0;
+			faceMask |= (FindCell(cursor[3], hash + zSteps) < 0) ? 1 << 5 : 0;
+			m_cellVertex[i].m_faceMask = faceMask;
+			vertexCount += ndIsoSurfaceBitCount(faceMask);
 		}
-	};
+		m_blockCount[threadIndex] = vertexCount;
+	});
+	ParallelExecute(threadPool, CountVertices);
 
-	class ndKey_midleX
-	{
-		public:
-		ndKey_midleX(void* const) {}
-		ndInt32 GetKey(const ndVector& point) const
-		{
-			ndFloat32 val = point.m_x * ndFloat32(D_LOW_RES_FRACTION);
-			ndInt32 key = ndInt32(val) >> 8;
-			return key & 0xff;
-		}
-	};
-
-	class ndKey_highX
-	{
-		public:
-		ndKey_highX(void* const) {}
-		ndInt32 GetKey(const ndVector& point) const
-		{
-			ndFloat32 val = point.m_x * ndFloat32(D_LOW_RES_FRACTION);
-			ndInt32 key = ndInt32(val) >> 16;
-			return key & 0xff;
-		}
-	};
-
-	class ndKey_lowY
-	{
-		public:
-		ndKey_lowY(void* const) {}
-		ndInt32 GetKey(const ndVector& point) const
-		{
-			ndFloat32 val = (point.m_y * D_LOW_RES_FRACTION);
-			ndInt32 key = ndInt32(val);
-			return key & 0xff;
-		}
-	};
-
-	class ndKey_midleY
+	ndInt32 vertexCount = 0;
+	const ndInt32 threadCount = GetThreadCount(threadPool);
+	for (ndInt32 i = 0; i < threadCount; ++i)
 	{
-		public:
-		ndKey_midleY(void* const) {}
-		ndInt32 GetKey(const ndVector& point) const
-		{
-			ndFloat32 val = point.m_y * ndFloat32(D_LOW_RES_FRACTION);
-			ndInt32 key = ndInt32(val) >> 8;
-			return key & 0xff;
-		}
-	};
+		m_blockStart[i] = vertexCount;
+		vertexCount += m_blockCount[i];
+	}
 
-	class ndKey_highY
+	auto SetVertices = ndMakeObject::ndFunction([this, cellCount, strideInFloats, posit, normals](ndInt32 threadIndex, ndInt32 threadCount)
 	{
-		public:
-		ndKey_highY(void* const) {}
-		ndInt32 GetKey(const ndVector& point) const
+		D_TRACKTIME_NAMED(SetVertices);
+		const ndVector faceOffsets[] =
 		{
-			ndFloat32 val = point.m_y * ndFloat32(D_LOW_RES_FRACTION);
-			ndInt32 key = ndInt32(val) >> 16;
-			return key & 0xff;
-		}
-	};
+			ndVector(ndFloat32(-0.5f), ndFloat32(0.0f), ndFloat32(0.0f), ndFloat32(0.0f)),
+			ndVector(ndFloat32(0.5f), ndFloat32(0.0f), ndFloat32(0.0f), ndFloat32(0.0f)),
+			ndVector(ndFloat32(0.0f), ndFloat32(-0.5f), ndFloat32(0.0f), ndFloat32(0.0f)),
+			ndVector(ndFloat32(0.0f), ndFloat32(0.5f), ndFloat32(0.0f), ndFloat32(0.0f)),
+			ndVector(ndFloat32(0.0f), ndFloat32(0.0f), ndFloat32(-0.5f), ndFloat32(0.0f)),
+			ndVector(ndFloat32(0.0f), ndFloat32(0.0f), ndFloat32(0.5f), ndFloat32(0.0f))
+		};
 
-	class ndKey_lowZ
-	{
-		public:
-		ndKey_lowZ(void* const) {}
-		ndInt32 GetKey(const ndVector& point) const
+		ndInt32 vertex = m_blockStart[threadIndex];
+		const ndStartEnd startEnd(cellCount, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
 		{
-			ndFloat32 val = (point.m_z * D_LOW_RES_FRACTION);
-			ndInt32 key = ndInt32(val);
-			return key & 0xff;
+			const ndGridHash cell(m_cells[i]);
+			const ndVector origin(ndFloat32(cell.m_x), ndFloat32(cell.m_y), ndFloat32(cell.m_z), ndFloat32(0.0f));
+			const ndInt32 faceMask = m_cellVertex[i].m_faceMask;
+			m_cellVertex[i].m_start = vertex;
+			for (ndInt32 j = 0; j < 6; ++j)
+			{
+				if (faceMask & (1 << j))
+				{
+					const ndVector p((origin + faceOffsets[j]) * m_gridSize);
+					const ndInt32 k = vertex * strideInFloats;
+					posit[k + 0] = ndReal(p.m_x);
+					posit[k + 1] = ndReal(p.m_y);
+					posit[k + 2] = ndReal(p.m_z);
+					normals[k + 0] = ndReal(0.0f);
+					normals[k + 1] = ndReal(0.0f);
+					normals[k + 2] = ndReal(0.0f);
+					vertex++;
+				}
+			}
 		}
-	};
+	});
+	ParallelExecute(threadPool, SetVertices);
 
-	class ndKey_midleZ
+	// same face layout as the triangle list
+	auto CountFaces = ndMakeObject::ndFunction([this](ndInt32 threadIndex, ndInt32 threadCount)
 	{
-		public:
-		ndKey_midleZ(void* const) {}
-		ndInt32 GetKey(const ndVector& point) const
+		D_TRACKTIME_NAMED(CountFaces);
+		ndInt32 faceCount = 0;
+		const ndStartEnd startEnd(ndInt32(m_cubes.GetCount()), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
 		{
-			ndFloat32 val = point.m_z * ndFloat32(D_LOW_RES_FRACTION);
-			ndInt32 key = ndInt32(val) >> 8;
-			return key & 0xff;
+			const ndInt32 tableIndex = m_cubes[i].m_cellType;
+			faceCount += m_facesScan[tableIndex + 1] - m_facesScan[tableIndex];
 		}
-	};
+		m_blockCount[threadIndex] = faceCount;
+	});
+	ParallelExecute(threadPool, CountFaces);
 
-	class ndKey_highZ
+	ndInt32 faceCount = 0;
+	for (ndInt32 i = 0; i < threadCount; ++i)
 	{
-		public:
-		ndKey_highZ(void* const) {}
-		ndInt32 GetKey(const ndVector& point) const
-		{
-			ndFloat32 val = point.m_z * ndFloat32(D_LOW_RES_FRACTION);
-			ndInt32 key = ndInt32(val) >> 16;
-			return key & 0xff;
-		}
-	};
+		m_blockStart[i] = faceCount;
+		faceCount += m_blockCount[i];
+	}
 
-	class ndCompareKey
+	auto SetIndices = ndMakeObject::ndFunction([this, indexList](ndInt32 threadIndex, ndInt32 threadCount)
 	{
-		public:
-		ndCompareKey(const ndVector& base)
-			:m_base(base)
+		D_TRACKTIME_NAMED(SetIndices);
+		ndInt32 index = m_blockStart[threadIndex] * 3;
+		ndInt32 cursor[] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+		const ndStartEnd startEnd(ndInt32(m_cubes.GetCount()), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
 		{
-		}
-
-		ndInt32 Test(const ndVector& point) const
-		{
-			const ndVector test(point == m_base);
-			return ndInt32 (test.m_ix & test.m_iy & test.m_iz);
-		}
+			const ndGridHash cube(m_cubes[i]);
+			const ndInt32 tableIndex = cube.m_cellType;
+			const ndInt32 faceStart = m_facesScan[tableIndex];
+			const ndInt32 faceCount = m_facesScan[tableIndex + 1] - faceStart;
+			if (!faceCount)
+			{
+				continue;
+			}
 
-		ndVector m_base;
-	};
+			ndInt32 cornerCell[8];
+			for (ndInt32 j = 0; j < 8; ++j)
+			{
+				cornerCell[j] = -1;
+			}
 
-	const ndVector invGrid(ndFloat32(1.0f) / me->m_gridSize);
-	const ndArray<ndVector>& points = me->m_points;
-	m_triangles.SetCount(points.GetCount());
-	for (ndInt32 i = 0; i < points.GetCount(); ++i)
-	{
-		m_triangles[i] = points[i] * invGrid;
-		m_triangles[i].m_w = ndFloat32(i);
-	}
+			ndInt32 vertlist[12];
+			const ndInt32 start = m_edgeScan[tableIndex];
+			const ndInt32 edgeCount = m_edgeScan[tableIndex + 1] - start;
+			for (ndInt32 j = 0; j < edgeCount; ++j)
+			{
+				const ndEdge& edge = m_edges[start + j];
+				const bool p0IsInside = ((tableIndex >> edge.m_p0) & 1) ? true : false;
+				const ndInt32 inside = p0IsInside ? edge.m_p0 : edge.m_p1;
+				const ndInt32 outside = p0IsInside ? edge.m_p1 : edge.m_p0;
+				const ndInt32* const insideOffset = m_cornerOffsets[inside];
+				const ndInt32* const outsideOffset = m_cornerOffsets[outside];
+				if (cornerCell[inside] < 0)
+				{
+					const ndUnsigned64 hash = cube.m_gridCellHash + 
+						ndUnsigned64(insideOffset[0]) + (ndUnsigned64(insideOffset[1]) << 16) + (ndUnsigned64(insideOffset[2]) << 32);
+					cornerCell[inside] = FindCell(cursor[inside], hash);
+					ndAssert(cornerCell[inside] >= 0);
+				}
+
+				// the face of the inside cell that looks at the outside corner
+				ndInt32 face = 0;
+				for (ndInt32 k = 0; k < 3; ++k)
+				{
+					const ndInt32 step = outsideOffset[k] - insideOffset[k];
+					face = step ? k * 2 + ((step > 0) ? 1 : 0) : face;
+				}
+				const ndCellVertex& cellVertex = m_cellVertex[cornerCell[inside]];
+				ndAssert(cellVertex.m_faceMask & (1 << face));
+				vertlist[edge.m_midPoint] = cellVertex.m_start + ndIsoSurfaceBitCount(cellVertex.m_faceMask & ((1 << face) - 1));
+			}
 
-	const ndInt32 xDimSize = me->m_volumeSizeX * D_LOW_RES_FRACTION;
-	ndCountingSort<ndVector, ndKey_lowX, 8>(m_triangles, m_trianglesScratchBuffer, nullptr, nullptr);
-	if (xDimSize >= 256)
-	{
-		ndCountingSort<ndVector, ndKey_midleX, 8>(m_triangles, m_trianglesScratchBuffer, nullptr, nullptr);
-	}
-	if (xDimSize >= 256 * 256)
-	{
-		ndCountingSort<ndVector, ndKey_highX, 8>(m_triangles, m_trianglesScratchBuffer, nullptr, nullptr);
-	} 
-	
-	const ndInt32 yDimSize = me->m_volumeSizeY * D_LOW_RES_FRACTION;
-	ndCountingSort<ndVector, ndKey_lowY, 8>(m_triangles, m_trianglesScratchBuffer, nullptr, nullptr);
-	if (yDimSize >= 256)
-	{
-		ndCountingSort<ndVector, ndKey_midleY, 8>(m_triangles, m_trianglesScratchBuffer, nullptr, nullptr);
-	}
-	if (yDimSize >= 256 * 256)
-	{
-		ndCountingSort<ndVector, ndKey_highY, 8>(m_triangles, m_trianglesScratchBuffer, nullptr, nullptr);
-	}
-	
-	const ndInt32 zDimSize = me->m_volumeSizeZ * D_LOW_RES_FRACTION;
-	ndCountingSort<ndVector, ndKey_lowZ, 8>(m_triangles, m_trianglesScratchBuffer, nullptr, nullptr);
-	if (zDimSize >= 256)
-	{
-		ndCountingSort<ndVector, ndKey_midleZ, 8>(m_triangles, m_trianglesScratchBuffer, nullptr, nullptr);
-	}
-	if (zDimSize >= 256 * 256)
-	{
-		ndCountingSort<ndVector, ndKey_highZ, 8>(m_triangles, m_trianglesScratchBuffer, nullptr, nullptr);
-	}
-	
-	const ndInt32 count = m_triangles.GetCount();
-	const ndArray<ndVector>& triangleList = m_triangles;
-	
-	ndInt32 vertexCount = 0;
-	m_triangles.PushBack(ndVector::m_one + (m_triangles[count - 1]));
-	for (ndInt32 i = 0; i < count; ++i)
-	{
-		m_trianglesScratchBuffer[vertexCount] = triangleList[i] * m_gridSize;
-		
-		const ndCompareKey comparator(m_triangles[i]);
-		const ndInt32 index = ndInt32(m_triangles[i].m_w);
-		indexList[index] = vertexCount;
-		for (i = i + 1; comparator.Test(m_triangles[i]); ++i)
-		{
-			const ndInt32 duplicateIndex = ndInt32(m_triangles[i].m_w);
-			indexList[duplicateIndex] = vertexCount;
+			for (ndInt32 j = 0; j < faceCount; ++j)
+			{
+				indexList[index + 0] = vertlist[m_faces[faceStart + j][0]];
+				indexList[index + 1] = vertlist[m_faces[faceStart + j][1]];
+				indexList[index + 2] = vertlist[m_faces[faceStart + j][2]];
+				index += 3;
+			}
 		}
-		--i;
-		vertexCount++;
-	}
+	});
+	ParallelExecute(threadPool, SetIndices);
 
-	for (ndInt32 i = 0; i < vertexCount; ++i)
+	// vertices are shared by faces of different threads, so accumulate in one pass
+	for (ndInt32 i = 0; i < faceCount * 3; i += 3)
 	{
-		ndInt32 j = strideInFloats * i;
-		m_triangles[i] = ndVector::m_zero;
-		posit[j + 0] = ndReal(m_trianglesScratchBuffer[i].m_x);
-		posit[j + 1] = ndReal(m_trianglesScratchBuffer[i].m_y);
-		posit[j + 2] = ndReal(m_trianglesScratchBuffer[i].m_z);
-	}
-
-	// calculate normals
-	for (ndInt32 i = 0; i < count; i += 3)
-	{
-		ndInt32 id0 = indexList[i + 0] * strideInFloats;
-		ndInt32 id1 = indexList[i + 1] * strideInFloats;
-		ndInt32 id2 = indexList[i + 2] * strideInFloats;
+		const ndInt32 id0 = indexList[i + 0] * strideInFloats;
+		const ndInt32 id1 = indexList[i + 1] * strideInFloats;
+		const ndInt32 id2 = indexList[i + 2] * strideInFloats;
 
 		const ndVector p0(posit[id0 + 0], posit[id0 + 1], posit[id0 + 2], ndFloat32(0.0f));
 		const ndVector p1(posit[id1 + 0], posit[id1 + 1], posit[id1 + 2], ndFloat32(0.0f));
 		const ndVector p2(posit[id2 + 0], posit[id2 + 1], posit[id2 + 2], ndFloat32(0.0f));
-		const ndVector vec1(p1 - p0);
-		const ndVector vec2(p2 - p0);
-
-		const ndVector normal = vec1.CrossProduct(vec2);
-		m_triangles[indexList[i + 0]] += normal;
-		m_triangles[indexList[i + 1]] += normal;
-		m_triangles[indexList[i + 2]] += normal;
+		const ndVector normal((p1 - p0).CrossProduct(p2 - p0));
+		for (ndInt32 j = 0; j < 3; ++j)
+		{
+			const ndInt32 k = indexList[i + j] * strideInFloats;
+			normals[k + 0] += ndReal(normal.m_x);
+			normals[k + 1] += ndReal(normal.m_y);
+			normals[k + 2] += ndReal(normal.m_z);
+		}
 	}
 
-	// Normalize normals.
-	for (ndInt32 i = 0; i < vertexCount; ++i)
+	auto NormalizeNormals = ndMakeObject::ndFunction([vertexCount, strideInFloats, normals](ndInt32 threadIndex, ndInt32 threadCount)
 	{
-		ndVector normal(m_triangles[i] * m_triangles[i].InvMagSqrt());
-		ndInt32 j = strideInFloats * i;
-		normals[j + 0] = ndReal (normal.m_x);
-		normals[j + 1] = ndReal (normal.m_y);
-		normals[j + 2] = ndReal (normal.m_z);
-	}
+		D_TRACKTIME_NAMED(NormalizeNormals);
+		const ndStartEnd startEnd(vertexCount, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndInt32 j = strideInFloats * i;
+			const ndVector normal(normals[j + 0], normals[j + 1], normals[j + 2], ndFloat32(0.0f));
+			const ndFloat32 mag2 = normal.DotProduct(normal).GetScalar();
+			if (mag2 > ndFloat32(1.0e-20f))
+			{
+				const ndVector unitNormal(normal.Scale(ndRsqrt(mag2)));
+				normals[j + 0] = ndReal(unitNormal.m_x);
+				normals[j + 1] = ndReal(unitNormal.m_y);
+				normals[j + 2] = ndReal(unitNormal.m_z);
+			}
+		}
+	});
+	ParallelExecute(threadPool, NormalizeNormals);
 
 	return vertexCount;
 }
 
-void ndIsoSurface::ndImplementation::MakeTriangleList(ndIsoSurface* const me)
-{
-	D_TRACKTIME();
-	ndArray<ndVector>& points = me->m_points;
-	points.SetCount(m_triangles.GetCount());
-
-	for (ndInt32 i = 0; i < m_triangles.GetCount(); ++i)
-	{
-		points[i] = m_triangles[i] * m_gridSize;
-	}
-}
-
 //void ndIsoSurface::ndImplementation::GenerateHighResIndexList(ndIsoSurface* const me)
 void ndIsoSurface::ndImplementation::GenerateHighResIndexList(ndIsoSurface* const)
 {
@@ -3323,35 +3515,6 @@ void ndIsoSurface::ndImplementation::GenerateHighResIndexList(ndIsoSurface* cons
 	ndAssert(0);
 }
 
-void ndIsoSurface::ndImplementation::CreateGrids()
-{
-	D_TRACKTIME();
-	const ndGridHashSteps steps;
-	m_hashGridMap.SetCount(m_hashGridMapScratchBuffer.GetCount() * 8);
-	for (ndInt32 i = 0; i < m_hashGridMapScratchBuffer.GetCount(); ++i)
-	{
-		const ndGridHash hashKey(m_hashGridMapScratchBuffer[i]);
-		for (ndInt32 j = 0; j < 8; ++j)
-		{
-			ndGridHash cell(hashKey);
-			cell.m_x += steps.m_steps[j].m_x;
-			cell.m_y += steps.m_steps[j].m_y;
-			cell.m_z += steps.m_steps[j].m_z;
-			cell.m_cellType = steps.m_cellType[j];
-			m_hashGridMap[i * 8 + j] = cell;
-		}
-	}
-}
-
-void ndIsoSurface::ndImplementation::ClearBuffers()
-{
-	D_TRACKTIME();
-	m_triangles.SetCount(0);
-	m_hashGridMap.SetCount(0);
-	m_trianglesScratchBuffer.SetCount(0);
-	m_hashGridMapScratchBuffer.SetCount(0);
-}
-
 //void ndIsoSurface::ndImplementation::BuildHighResolutionMesh(ndIsoSurface* const me, const ndArray<ndVector>& points, ndFloat32 gridSize, ndCalculateIsoValue* const computeIsoValue)
 void ndIsoSurface::ndImplementation::BuildHighResolutionMesh(ndIsoSurface* const, const ndArray<ndVector>&, ndFloat32, ndCalculateIsoValue* const)
 {
@@ -3367,18 +3530,15 @@ void ndIsoSurface::ndImplementation::BuildHighResolutionMesh(ndIsoSurface* const
 	//ClearBuffers();
 }
 
-void ndIsoSurface::ndImplementation::BuildLowResolutionMesh(ndIsoSurface* const me, const ndArray<ndVector>& points, ndFloat32 gridSize)
+void ndIsoSurface::ndImplementation::BuildLowResolutionMesh(ndIsoSurface* const me, const ndArray<ndVector>& points, ndFloat32 gridSize, ndThreadPool* const threadPool)
 {
 	D_TRACKTIME();
-	CalculateAabb(points, gridSize);
-	RemoveDuplicates(points);
-	CreateGrids();
-	SortCellBuckects();
-	GenerateLowResIsoSurface();
-	MakeTriangleList(me);
-	//GenerateLowResIndexList(me);
-	//CalculateNormals(me);
-	ClearBuffers();
+	CalculateAabb(points, gridSize, threadPool);
+	CalculateOccupiedCells(points, threadPool);
+	CalculateChangedCells(threadPool);
+	UpdateCubes(threadPool);
+	m_cells.Swap(m_newCells);
+	GenerateLowResIsoSurface(me, threadPool);
 }
 
 ndIsoSurface::ndIsoSurface()
@@ -3389,6 +3549,7 @@ ndIsoSurface::ndIsoSurface()
 	,m_volumeSizeX(1)
 	,m_volumeSizeY(1)
 	,m_volumeSizeZ(1)
+	,m_changedCellCount(0)
 	,m_isLowRes(true)
 {
 }
@@ -3402,14 +3563,14 @@ ndIsoSurface::~ndIsoSurface()
 	}
 }
 
-void ndIsoSurface::GenerateMesh(const ndArray<ndVector>& pointCloud, ndFloat32 gridSize, ndCalculateIsoValue* const computeIsoValue)
+void ndIsoSurface::GenerateMesh(const ndArray<ndVector>& pointCloud, ndFloat32 gridSize, ndCalculateIsoValue* const computeIsoValue, ndThreadPool* const threadPool)
 {
 	if (pointCloud.GetCount())
 	{
 		if (!computeIsoValue)
 		{
 			m_isLowRes = true;
-			m_implementation->BuildLowResolutionMesh(this, pointCloud, gridSize);
+			m_implementation->BuildLowResolutionMesh(this, pointCloud, gridSize, threadPool);
 		}
 		else
 		{
@@ -3422,19 +3583,20 @@ void ndIsoSurface::GenerateMesh(const ndArray<ndVector>& pointCloud, ndFloat32 g
 		m_volumeSizeX = m_implementation->m_volumeSizeX;
 		m_volumeSizeY = m_implementation->m_volumeSizeY;
 		m_volumeSizeZ = m_implementation->m_volumeSizeZ;
+		m_changedCellCount = m_implementation->m_changedCellCount;
 	}
 }
 
-ndInt32 ndIsoSurface::GenerateListIndexList(ndInt32* const indexList, ndInt32 strideInFloats, ndReal* const posit, ndReal* const normals) const
+ndInt32 ndIsoSurface::GenerateListIndexList(ndInt32* const indexList, ndInt32 strideInFloats, ndReal* const posit, ndReal* const normals, ndThreadPool* const threadPool) const
 {
 	ndInt32 vertexCount = 0;
 	if (m_isLowRes)
 	{
-		vertexCount = m_implementation->GenerateLowResIndexList(this, indexList, strideInFloats, posit, normals);
+		vertexCount = m_implementation->GenerateLowResIndexList(indexList, strideInFloats, posit, normals, threadPool);
 	}
 	else
 	{
 		ndAssert(0);
 	}
 	return vertexCount;
-}
\ No newline at end of file
+}
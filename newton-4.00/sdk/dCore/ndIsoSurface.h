@@ -27,6 +27,8 @@
 #include "ndArray.h"
 #include "ndTree.h"
 
+class ndThreadPool;
+
 class ndIsoSurface: public ndClassAlloc
 {
 	public:
@@ -52,8 +54,12 @@ class ndIsoSurface: public ndClassAlloc
 	ndVector GetOrigin() const;
 	const ndArray<ndVector>& GetPoints() const;
 
-	D_CORE_API void GenerateMesh(const ndArray<ndVector>& pointCloud, ndFloat32 gridSize, ndCalculateIsoValue* const computeIsoValue = nullptr);
-	D_CORE_API ndInt32 GenerateListIndexList(ndInt32 * const indexList, ndInt32 strideInFloat32, ndReal* const posit, ndReal* const normals) const;
+	// cells that gained or lost particles since the previous mesh, 
+	// only the cubes around them are processed again.
+	ndInt32 GetChangedCellCount() const;
+
+	D_CORE_API void GenerateMesh(const ndArray<ndVector>& pointCloud, ndFloat32 gridSize, ndCalculateIsoValue* const computeIsoValue = nullptr, ndThreadPool* const threadPool = nullptr);
+	D_CORE_API ndInt32 GenerateListIndexList(ndInt32 * const indexList, ndInt32 strideInFloat32, ndReal* const posit, ndReal* const normals, ndThreadPool* const threadPool = nullptr) const;
 
 	private:
 	ndVector m_origin;
@@ -63,6 +69,7 @@ class ndIsoSurface: public ndClassAlloc
 	ndInt32 m_volumeSizeX;
 	ndInt32 m_volumeSizeY;
 	ndInt32 m_volumeSizeZ;
+	ndInt32 m_changedCellCount;
 	bool m_isLowRes;
 };
 
@@ -76,5 +83,10 @@ inline ndVector ndIsoSurface::GetOrigin() const
 	return m_origin;
 }
 
+inline ndInt32 ndIsoSurface::GetChangedCellCount() const
+{
+	return m_changedCellCount;
+}
+
 #endif
 
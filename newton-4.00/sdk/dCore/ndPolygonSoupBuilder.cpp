@@ -29,7 +29,9 @@
 #include "ndList.h"
 #include "ndTree.h"
 #include "ndStack.h"
+#include "ndProfiler.h"
 #include "ndPolyhedra.h"
+#include "ndThreadPool.h"
 #include "ndPolygonSoupBuilder.h"
 
 #define ND_POINTS_RUN (512 * 1024)
@@ -41,6 +43,15 @@ class ndPolygonSoupBuilder::dgFaceInfo
 	ndInt32 indexStart;
 };
 
+class ndPolygonSoupBuilder::dgOptimizeJob
+{
+	public:
+	ndInt32 m_faceId;
+	ndInt32 m_faceStart;
+	ndInt32 m_faceCount;
+	ndPolygonSoupBuilder* m_result;
+};
+
 class ndPolygonSoupBuilder::dgFaceBucket: public ndList<dgFaceInfo>
 {
 	public: 
@@ -577,54 +588,136 @@ void ndPolygonSoupBuilder::OptimizeByIndividualFaces()
 	m_faceVertexCount.SetCount(newFaceCount);
 }
 
-void ndPolygonSoupBuilder::End(bool optimize)
+void ndPolygonSoupBuilder::End(bool optimize, ndThreadPool* const threadPool)
 {
+	D_TRACKTIME();
 	if (optimize) 
 	{
 		ndPolygonSoupBuilder copy (*this);
 		dgFaceMap faceMap (copy);
 
-		Begin();
+		// split the faces in independent partitions 
+		ndArray<dgFaceInfo> faceList;
+		ndArray<dgOptimizeJob> jobs;
 		dgFaceMap::Iterator iter (faceMap);
 		for (iter.Begin(); iter; iter ++) 
 		{
 			const dgFaceBucket& bucket = iter.GetNode()->GetInfo();
-			Optimize(iter.GetNode()->GetKey(), bucket, copy);
+			Optimize(iter.GetNode()->GetKey(), bucket, copy, faceList, jobs);
+		}
+
+		ndAtomic<ndInt32> iterator(0);
+		auto OptimizePartitions = ndMakeObject::ndFunction([&jobs, &faceList, &copy, &iterator](ndInt32, ndInt32)
+		{
+			D_TRACKTIME_NAMED(OptimizePartitions);
+			ndVector face[256];
+			ndInt32 faceIndex[256];
+			const ndInt32* const indexArray = &copy.m_vertexIndex[0];
+			const ndBigVector* const points = &copy.m_vertexPoints[0];
+			for (ndInt32 i = iterator++; i < jobs.GetCount(); i = iterator++)
+			{
+				dgOptimizeJob& job = jobs[i];
+				ndPolygonSoupBuilder* const tmpBuilder = new ndPolygonSoupBuilder;
+				for (ndInt32 j = 0; j < job.m_faceCount; ++j)
+				{
+					const dgFaceInfo& faceInfo = faceList[job.m_faceStart + j];
+					ndInt32 count = faceInfo.indexCount - 1;
+					ndInt32 start = faceInfo.indexStart;
+					ndAssert (job.m_faceId == indexArray[start + count]);
+					for (ndInt32 k = 0; k < count; ++k) 
+					{
+						ndInt32 index = indexArray[start + k];
+						face[k] = points[index];
+						faceIndex[k] = k;
+					}
+					tmpBuilder->AddFaceIndirect(&face[0].m_x, sizeof(ndVector), job.m_faceId, faceIndex, count);
+				}
+				tmpBuilder->FinalizeAndOptimize (job.m_faceId);
+				job.m_result = tmpBuilder;
+			}
+		});
+
+		if (threadPool)
+		{
+			threadPool->Begin();
+			threadPool->ParallelExecute(OptimizePartitions);
+			threadPool->End();
+		}
+		else
+		{
+			OptimizePartitions(0, 1);
+		}
+
+		// merge the partitions in order, so that the result does not depend on the thread count
+		Begin();
+		for (ndInt32 i = 0; i < jobs.GetCount(); ++i)
+		{
+			AddOptimizedFaces(*jobs[i].m_result, jobs[i].m_faceId);
+			delete jobs[i].m_result;
 		}
 	}
 	Finalize();
 
 	// build the normal array and adjacency array
-	ndInt32 indexCount = 0;
+	CalculateNormals(threadPool);
+}
+
+void ndPolygonSoupBuilder::CalculateNormals(ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
 	const ndInt32 faceCount = m_faceVertexCount.GetCount();
 	if (faceCount)
 	{
+		ndArray<ndInt32> faceStart;
+		faceStart.SetCount(faceCount);
+		ndInt32 indexCount = 0;
+		for (ndInt32 i = 0; i < faceCount; ++i)
+		{
+			faceStart[i] = indexCount;
+			indexCount += m_faceVertexCount[i];
+		}
+
 		// calculate all face the normals
 		m_normalPoints.Resize(faceCount);
 		m_normalPoints.SetCount(faceCount);
-		for (ndInt32 i = 0; i < faceCount; ++i)
+		auto CalculateFaceNormals = ndMakeObject::ndFunction([this, &faceStart](ndInt32 threadIndex, ndInt32 threadCount)
 		{
-			ndInt32 faceIndexCount = m_faceVertexCount[i];
-
-			const ndInt32* const ptr = &m_vertexIndex[indexCount];
-			ndBigVector v0(&m_vertexPoints[ptr[0]].m_x);
-			ndBigVector v1(&m_vertexPoints[ptr[1]].m_x);
-			ndBigVector e0(v1 - v0);
-			ndBigVector normal0(ndBigVector::m_zero);
-			for (ndInt32 j = 2; j < faceIndexCount - 1; ++j)
+			D_TRACKTIME_NAMED(CalculateFaceNormals);
+			const ndStartEnd startEnd(m_faceVertexCount.GetCount(), threadIndex, threadCount);
+			for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
 			{
-				ndBigVector v2(&m_vertexPoints[ptr[j]].m_x);
-				ndBigVector e1(v2 - v0);
-				normal0 += e0.CrossProduct(e1);
-				e0 = e1;
+				ndInt32 faceIndexCount = m_faceVertexCount[i];
+
+				const ndInt32* const ptr = &m_vertexIndex[faceStart[i]];
+				ndBigVector v0(&m_vertexPoints[ptr[0]].m_x);
+				ndBigVector v1(&m_vertexPoints[ptr[1]].m_x);
+				ndBigVector e0(v1 - v0);
+				ndBigVector normal0(ndBigVector::m_zero);
+				for (ndInt32 j = 2; j < faceIndexCount - 1; ++j)
+				{
+					ndBigVector v2(&m_vertexPoints[ptr[j]].m_x);
+					ndBigVector e1(v2 - v0);
+					normal0 += e0.CrossProduct(e1);
+					e0 = e1;
+				}
+				ndBigVector normal(normal0.Normalize());
+
+				m_normalPoints[i].m_x = normal.m_x;
+				m_normalPoints[i].m_y = normal.m_y;
+				m_normalPoints[i].m_z = normal.m_z;
+				m_normalPoints[i].m_w = ndFloat32(0.0f);
 			}
-			ndBigVector normal(normal0.Normalize());
+		});
 
-			m_normalPoints[i].m_x = normal.m_x;
-			m_normalPoints[i].m_y = normal.m_y;
-			m_normalPoints[i].m_z = normal.m_z;
-			m_normalPoints[i].m_w = ndFloat32(0.0f);
-			indexCount += faceIndexCount;
+		if (threadPool)
+		{
+			threadPool->Begin();
+			threadPool->ParallelExecute(CalculateFaceNormals);
+			threadPool->End();
+		}
+		else
+		{
+			CalculateFaceNormals(0, 1);
 		}
 
 		m_normalIndex.Resize(faceCount);;
@@ -635,188 +728,141 @@ void ndPolygonSoupBuilder::End(bool optimize)
 	}
 }
 
-void ndPolygonSoupBuilder::Optimize(ndInt32 faceId, const dgFaceBucket& faceBucket, const ndPolygonSoupBuilder& source)
+void ndPolygonSoupBuilder::AddOptimizedFaces(const ndPolygonSoupBuilder& source, ndInt32 faceId)
+{
+	ndVector face[256];
+	ndInt32 faceIndex[256];
+	ndInt32 faceIndexNumber = 0;
+	for (ndInt32 i = 0; i < source.m_faceVertexCount.GetCount(); ++i)
+	{
+		ndInt32 indexCount = source.m_faceVertexCount[i] - 1;
+		for (ndInt32 j = 0; j < indexCount; ++j) 
+		{
+			ndInt32 index = source.m_vertexIndex[faceIndexNumber + j];
+			face[j] = source.m_vertexPoints[index];
+			faceIndex[j] = j;
+		}
+		AddFaceIndirect(&face[0].m_x, sizeof(ndVector), faceId, faceIndex, indexCount);
+		faceIndexNumber += (indexCount + 1); 
+	}
+}
+
+void ndPolygonSoupBuilder::Optimize(ndInt32 faceId, const dgFaceBucket& faceBucket, const ndPolygonSoupBuilder& source, ndArray<dgFaceInfo>& faceList, ndArray<dgOptimizeJob>& jobs) const
 {
 	#define DG_MESH_PARTITION_SIZE (1024 * 4)
 
 	const ndInt32* const indexArray = &source.m_vertexIndex[0];
 	const ndBigVector* const points = &source.m_vertexPoints[0];
 
-	ndVector face[256];
-	ndInt32 faceIndex[256];
-	if (faceBucket.GetCount() >= DG_MESH_PARTITION_SIZE) 
+	const ndInt32 faceBase = faceList.GetCount();
+	for (dgFaceBucket::ndNode* node = faceBucket.GetFirst(); node; node = node->GetNext()) 
 	{
-		ndStack<dgFaceBucket::ndNode*> array(faceBucket.GetCount());
-		ndInt32 count = 0;
-		for (dgFaceBucket::ndNode* node = faceBucket.GetFirst(); node; node = node->GetNext()) 
-		{
-			array[count] = node;
-			count ++;
-		}
+		faceList.PushBack(node->GetInfo());
+	}
+	dgFaceInfo* const array = &faceList[faceBase];
 
-		ndInt32 stack = 1;
-		ndInt32 segments[32][2];
+	ndInt32 stack = 1;
+	ndInt32 segments[32][2];
 			
-		segments[0][0] = 0;
-		segments[0][1] = count;
+	segments[0][0] = 0;
+	segments[0][1] = faceBucket.GetCount();
 	
-		while (stack) 
-		{
-			stack --;
-			ndInt32 faceStart = segments[stack][0];
-			ndInt32 faceCount = segments[stack][1];
+	while (stack) 
+	{
+		stack --;
+		ndInt32 faceStart = segments[stack][0];
+		ndInt32 faceCount = segments[stack][1];
 
-			if (faceCount <= DG_MESH_PARTITION_SIZE) 
+		if (faceCount <= DG_MESH_PARTITION_SIZE) 
+		{
+			dgOptimizeJob job;
+			job.m_faceId = faceId;
+			job.m_faceStart = faceBase + faceStart;
+			job.m_faceCount = faceCount;
+			job.m_result = nullptr;
+			jobs.PushBack(job);
+		} 
+		else 
+		{
+			ndBigVector median (ndBigVector::m_zero);
+			ndBigVector varian (ndBigVector::m_zero);
+			for (ndInt32 i = 0; i < faceCount; ++i) 
 			{
-				ndPolygonSoupBuilder tmpBuilder;
-				for (ndInt32 i = 0; i < faceCount; ++i) 
+				const dgFaceInfo& faceInfo = array[faceStart + i];
+				ndInt32 count1 = faceInfo.indexCount - 1;
+				ndInt32 start1 = faceInfo.indexStart;
+				ndBigVector p0 (ndFloat32 ( 1.0e10f), ndFloat32 ( 1.0e10f), ndFloat32 ( 1.0e10f), ndFloat32 (0.0f));
+				ndBigVector p1 (ndFloat32 (-1.0e10f), ndFloat32 (-1.0e10f), ndFloat32 (-1.0e10f), ndFloat32 (0.0f));
+				for (ndInt32 j = 0; j < count1; ++j) 
 				{
-					const dgFaceInfo& faceInfo = array[faceStart + i]->GetInfo();
-
-					ndInt32 count1 = faceInfo.indexCount - 1;
-					ndInt32 start1 = faceInfo.indexStart;
-					ndAssert (faceId == indexArray[start1 + count1]);
-					for (ndInt32 j = 0; j < count1; ++j) 
-					{
-						ndInt32 index = indexArray[start1 + j];
-						face[j] = points[index];
-						faceIndex[j] = j;
-					}
-					tmpBuilder.AddFaceIndirect(&face[0].m_x, sizeof(ndVector), faceId, faceIndex, count1);
+					ndInt32 index = indexArray[start1 + j];
+					const ndBigVector& p = points[index];
+					ndAssert(p.m_w == ndFloat32(0.0f));
+					p0 = p0.GetMin(p);
+					p1 = p1.GetMax(p);
 				}
-				tmpBuilder.FinalizeAndOptimize (faceId);
+				ndBigVector p ((p0 + p1).Scale (0.5f));
+				median += p;
+				varian += p * p;
+			}
 
-				ndInt32 faceIndexNumber = 0;
-				for (ndInt32 i = 0; i < tmpBuilder.m_faceVertexCount.GetCount(); ++i)
-				{
-					ndInt32 indexCount = tmpBuilder.m_faceVertexCount[i] - 1;
-					for (ndInt32 j = 0; j < indexCount; ++j) 
-					{
-						ndInt32 index = tmpBuilder.m_vertexIndex[faceIndexNumber + j];
-						face[j] = tmpBuilder.m_vertexPoints[index];
-						faceIndex[j] = j;
-					}
-					AddFaceIndirect(&face[0].m_x, sizeof(ndVector), faceId, faceIndex, indexCount);
-					faceIndexNumber += (indexCount + 1); 
-				}
-			} 
-			else 
+			varian = varian.Scale (ndFloat32 (faceCount)) - median * median;
+
+			ndInt32 axis = 0;
+			ndFloat32 maxVarian = ndFloat32 (-1.0e10f);
+			for (ndInt32 i = 0; i < 3; ++i) 
 			{
-				ndBigVector median (ndBigVector::m_zero);
-				ndBigVector varian (ndBigVector::m_zero);
-				for (ndInt32 i = 0; i < faceCount; ++i) 
+				if (varian[i] > maxVarian) 
 				{
-					const dgFaceInfo& faceInfo = array[faceStart + i]->GetInfo();
-					ndInt32 count1 = faceInfo.indexCount - 1;
-					ndInt32 start1 = faceInfo.indexStart;
-					ndBigVector p0 (ndFloat32 ( 1.0e10f), ndFloat32 ( 1.0e10f), ndFloat32 ( 1.0e10f), ndFloat32 (0.0f));
-					ndBigVector p1 (ndFloat32 (-1.0e10f), ndFloat32 (-1.0e10f), ndFloat32 (-1.0e10f), ndFloat32 (0.0f));
-					for (ndInt32 j = 0; j < count1; ++j) 
-					{
-						ndInt32 index = indexArray[start1 + j];
-						const ndBigVector& p = points[index];
-						ndAssert(p.m_w == ndFloat32(0.0f));
-						p0 = p0.GetMin(p);
-						p1 = p1.GetMax(p);
-					}
-					ndBigVector p ((p0 + p1).Scale (0.5f));
-					median += p;
-					varian += p * p;
+					axis = i;
+					maxVarian = ndFloat32 (varian[i]);
 				}
+			}
+			ndBigVector center = median.Scale (ndFloat32 (1.0f) / ndFloat32 (faceCount));
+			ndFloat64 axisVal = center[axis];
 
-				varian = varian.Scale (ndFloat32 (faceCount)) - median * median;
+			ndInt32 leftCount = 0;
+			ndInt32 lastFace = faceCount;
 
-				ndInt32 axis = 0;
-				ndFloat32 maxVarian = ndFloat32 (-1.0e10f);
-				for (ndInt32 i = 0; i < 3; ++i) 
+			for (ndInt32 i = 0; i < lastFace; ++i) 
+			{
+				ndInt32 side = 0;
+				const dgFaceInfo& faceInfo = array[faceStart + i];
+
+				ndInt32 start1 = faceInfo.indexStart;
+				ndInt32 count1 = faceInfo.indexCount - 1;
+				for (ndInt32 j = 0; j < count1; ++j) 
 				{
-					if (varian[i] > maxVarian) 
+					ndInt32 index = indexArray[start1 + j];
+					const ndBigVector& p = points[index];
+					if (p[axis] > axisVal) 
 					{
-						axis = i;
-						maxVarian = ndFloat32 (varian[i]);
+						side = 1;
+						break;
 					}
 				}
-				ndBigVector center = median.Scale (ndFloat32 (1.0f) / ndFloat32 (faceCount));
-				ndFloat64 axisVal = center[axis];
 
-				ndInt32 leftCount = 0;
-				ndInt32 lastFace = faceCount;
-
-				for (ndInt32 i = 0; i < lastFace; ++i) 
+				if (side) 
 				{
-					ndInt32 side = 0;
-					const dgFaceInfo& faceInfo = array[faceStart + i]->GetInfo();
-
-					ndInt32 start1 = faceInfo.indexStart;
-					ndInt32 count1 = faceInfo.indexCount - 1;
-					for (ndInt32 j = 0; j < count1; ++j) 
-					{
-						ndInt32 index = indexArray[start1 + j];
-						const ndBigVector& p = points[index];
-						if (p[axis] > axisVal) 
-						{
-							side = 1;
-							break;
-						}
-					}
-
-					if (side) 
-					{
-						ndSwap (array[faceStart + i], array[faceStart + lastFace - 1]);
-						lastFace --;
-						i --;
-					} 
-					else 
-					{
-						leftCount ++;
-					}
+					ndSwap (array[faceStart + i], array[faceStart + lastFace - 1]);
+					lastFace --;
+					i --;
+				} 
+				else 
+				{
+					leftCount ++;
 				}
-				ndAssert (leftCount);
-				ndAssert (leftCount < faceCount);
-
-				segments[stack][0] = faceStart;
-				segments[stack][1] = leftCount;
-				stack ++;
-
-				segments[stack][0] = faceStart + leftCount;
-				segments[stack][1] = faceCount - leftCount;
-				stack ++;
 			}
-		}
-	} 
-	else 
-	{
-		ndPolygonSoupBuilder tmpBuilder;
-		for (dgFaceBucket::ndNode* node = faceBucket.GetFirst(); node; node = node->GetNext()) 
-		{
-			const dgFaceInfo& faceInfo = node->GetInfo();
+			ndAssert (leftCount);
+			ndAssert (leftCount < faceCount);
 
-			ndInt32 count = faceInfo.indexCount - 1;
-			ndInt32 start = faceInfo.indexStart;
-			ndAssert (faceId == indexArray[start + count]);
-			for (ndInt32 j = 0; j < count; ++j) 
-			{
-				ndInt32 index = indexArray[start + j];
-				face[j] = points[index];
-				faceIndex[j] = j;
-			}
-			tmpBuilder.AddFaceIndirect(&face[0].m_x, sizeof(ndVector), faceId, faceIndex, count);
-		}
-		tmpBuilder.FinalizeAndOptimize (faceId);
+			segments[stack][0] = faceStart;
+			segments[stack][1] = leftCount;
+			stack ++;
 
-		ndInt32 faceIndexNumber = 0;
-		for (ndInt32 i = 0; i < tmpBuilder.m_faceVertexCount.GetCount(); ++i)
-		{
-			ndInt32 indexCount = tmpBuilder.m_faceVertexCount[i] - 1;
-			for (ndInt32 j = 0; j < indexCount; ++j) 
-			{
-				ndInt32 index = tmpBuilder.m_vertexIndex[faceIndexNumber + j];
-				face[j] = tmpBuilder.m_vertexPoints[index];
-				faceIndex[j] = j;
-			}
-			AddFaceIndirect(&face[0].m_x, sizeof(ndVector), faceId, faceIndex, indexCount);
-		
-			faceIndexNumber += (indexCount + 1); 
+			segments[stack][0] = faceStart + leftCount;
+			segments[stack][1] = faceCount - leftCount;
+			stack ++;
 		}
 	}
 }
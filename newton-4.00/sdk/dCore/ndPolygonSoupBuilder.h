@@ -34,6 +34,8 @@
 #include "ndVector.h"
 #include "ndMatrix.h"
 
+class ndThreadPool;
+
 /// Helper intermediate class for encoding a face adjacent face to an edge of a face.
 class ndAdjacentFace
 {
@@ -49,6 +51,7 @@ class ndPolygonSoupBuilder: public ndClassAlloc
 	class dgFaceMap;
 	class dgFaceInfo;
 	class dgFaceBucket;
+	class dgOptimizeJob;
 	class dgPolySoupFilterAllocator;
 
 	public:
@@ -57,7 +60,9 @@ class ndPolygonSoupBuilder: public ndClassAlloc
 	D_CORE_API virtual ~ndPolygonSoupBuilder ();
 
 	D_CORE_API virtual void Begin();
-	D_CORE_API virtual void End(bool optimize);
+	// if a thread pool is passed, the face optimization and normal calculation run in parallel.
+	// the pool is started and stopped here, so it must not be inside its own Begin/End.
+	D_CORE_API virtual void End(bool optimize, ndThreadPool* const threadPool = nullptr);
 	D_CORE_API virtual void AddFace(const ndFloat32* const vertex, ndInt32 strideInBytes, ndInt32 vertexCount, const ndInt32 faceId);
 	D_CORE_API virtual void AddFaceIndirect(const ndFloat32* const vertex, ndInt32 strideInBytes, ndInt32 faceId, const ndInt32* const indexArray, ndInt32 indexCount);
 
@@ -65,7 +70,9 @@ class ndPolygonSoupBuilder: public ndClassAlloc
 	D_CORE_API void SavePLY(const char* const fileName) const;
 
 	private:
-	void Optimize(ndInt32 faceId, const dgFaceBucket& faceBucket, const ndPolygonSoupBuilder& source);
+	void Optimize(ndInt32 faceId, const dgFaceBucket& faceBucket, const ndPolygonSoupBuilder& source, ndArray<dgFaceInfo>& faceList, ndArray<dgOptimizeJob>& jobs) const;
+	void AddOptimizedFaces(const ndPolygonSoupBuilder& source, ndInt32 faceId);
+	void CalculateNormals(ndThreadPool* const threadPool);
 
 	void Finalize();
 	void OptimizeByIndividualFaces();
@@ -0,0 +1,333 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "ndCoreStdafx.h"
+#include "ndNewtonStdafx.h"
+#include "ndWorld.h"
+#include "ndBodyDynamic.h"
+#include "ndJointHinge.h"
+#include "ndModelArticulation.h"
+#include "ndModelArticulationBatch.h"
+
+ndModelArticulationBatch::ndModelArticulationBatch()
+	:ndModel()
+	,m_bodies()
+	,m_joints()
+	,m_hinges()
+	,m_jointTorque()
+	,m_jointBody0()
+	,m_jointBody1()
+	,m_bodyTorque()
+	,m_bodyMap()
+	,m_bodyStart()
+	,m_jointStart()
+{
+	m_bodyStart.PushBack(0);
+	m_jointStart.PushBack(0);
+}
+
+ndModelArticulationBatch::~ndModelArticulationBatch()
+{
+}
+
+void ndModelArticulationBatch::OnAddToWorld()
+{
+}
+
+void ndModelArticulationBatch::OnRemoveFromToWorld()
+{
+}
+
+void ndModelArticulationBatch::AddModel(ndModelArticulation* const model)
+{
+	ndAssert(model->GetRoot());
+	const ndInt32 firstJoint = m_joints.GetCount();
+	ndFixSizeArray<ndModelArticulation::ndNode*, 256> stack;
+	stack.PushBack(model->GetRoot());
+	while (stack.GetCount())
+	{
+		ndInt32 index = stack.GetCount() - 1;
+		ndModelArticulation::ndNode* const node = stack[index];
+		stack.SetCount(index);
+
+		ndBodyKinematic* const body = node->m_body->GetAsBodyKinematic();
+		bool wasFound;
+		m_bodyMap.Insert(m_bodies.GetCount(), body, wasFound);
+		// a body can only belong to one model of the batch
+		ndAssert(!wasFound);
+		m_bodies.PushBack(body);
+		m_bodyTorque.PushBack(ndVector::m_zero);
+		if (*node->m_joint)
+		{
+			ndJointBilateralConstraint* const joint = *node->m_joint;
+			m_joints.PushBack(joint);
+			m_hinges.PushBack(joint->GetAsHinge());
+			m_jointTorque.PushBack(ndFloat32(0.0f));
+		}
+
+		// push the children in reverse, so that they come out in order
+		ndFixSizeArray<ndModelArticulation::ndNode*, 256> children;
+		for (ndModelArticulation::ndNode* child = node->GetFirstChild(); child; child = child->GetNext())
+		{
+			children.PushBack(child);
+		}
+		for (ndInt32 i = children.GetCount() - 1; i >= 0; --i)
+		{
+			stack.PushBack(children[i]);
+		}
+	}
+	m_bodyStart.PushBack(m_bodies.GetCount());
+	m_jointStart.PushBack(m_joints.GetCount());
+
+	// the joint bodies are resolved once all the model bodies are known
+	for (ndInt32 i = firstJoint; i < m_joints.GetCount(); ++i)
+	{
+		const ndJointBilateralConstraint* const joint = m_joints[i];
+		ndTree<ndInt32, const ndBodyKinematic*>::ndNode* const node0 = m_bodyMap.Find(joint->GetBody0());
+		ndTree<ndInt32, const ndBodyKinematic*>::ndNode* const node1 = m_bodyMap.Find(joint->GetBody1());
+		m_jointBody0.PushBack(node0 ? node0->GetInfo() : -1);
+		m_jointBody1.PushBack(node1 ? node1->GetInfo() : -1);
+	}
+}
+
+ndInt32 ndModelArticulationBatch::GetModelCount() const
+{
+	return m_bodyStart.GetCount() - 1;
+}
+
+ndInt32 ndModelArticulationBatch::GetBodyCount() const
+{
+	return m_bodies.GetCount();
+}
+
+ndInt32 ndModelArticulationBatch::GetJointCount() const
+{
+	return m_joints.GetCount();
+}
+
+ndInt32 ndModelArticulationBatch::GetBodyStart(ndInt32 modelIndex) const
+{
+	return m_bodyStart[modelIndex];
+}
+
+ndInt32 ndModelArticulationBatch::GetJointStart(ndInt32 modelIndex) const
+{
+	return m_jointStart[modelIndex];
+}
+
+void ndModelArticulationBatch::ResizeObservation(ndObservation& observation) const
+{
+	const ndInt32 bodyCount = m_bodies.GetCount();
+	for (ndInt32 i = 0; i < 3; ++i)
+	{
+		observation.m_posit[i].SetCount(bodyCount);
+		observation.m_veloc[i].SetCount(bodyCount);
+		observation.m_omega[i].SetCount(bodyCount);
+		observation.m_contactForce[i].SetCount(bodyCount);
+	}
+	for (ndInt32 i = 0; i < 4; ++i)
+	{
+		observation.m_rotation[i].SetCount(bodyCount);
+	}
+	observation.m_jointAngle.SetCount(m_joints.GetCount());
+	observation.m_jointOmega.SetCount(m_joints.GetCount());
+}
+
+void ndModelArticulationBatch::GetObservation(ndObservation& observation, ndInt32 modelIndex) const
+{
+	for (ndInt32 i = m_bodyStart[modelIndex]; i < m_bodyStart[modelIndex + 1]; ++i)
+	{
+		const ndBodyKinematic* const body = m_bodies[i];
+		const ndMatrix matrix(body->GetMatrix());
+		const ndQuaternion rotation(body->GetRotation());
+		const ndVector veloc(body->GetVelocity());
+		const ndVector omega(body->GetOmega());
+
+		// sum of the contact forces acting on the body
+		ndVector force(ndVector::m_zero);
+		const ndBodyKinematic::ndContactMap& contactMap = body->GetContactMap();
+		ndBodyKinematic::ndContactMap::Iterator it(contactMap);
+		for (it.Begin(); it; it++)
+		{
+			const ndContact* const contact = *it;
+			if (contact->IsActive())
+			{
+				ndVector contactForce(ndVector::m_zero);
+				const ndContactPointList& contactPoints = contact->GetContactPoints();
+				for (ndContactPointList::ndNode* contactNode = contactPoints.GetFirst(); contactNode; contactNode = contactNode->GetNext())
+				{
+					const ndContactMaterial& contactPoint = contactNode->GetInfo();
+					contactForce += contactPoint.m_normal.Scale(contactPoint.m_normal_Force.m_force);
+					contactForce += contactPoint.m_dir0.Scale(contactPoint.m_dir0_Force.m_force);
+					contactForce += contactPoint.m_dir1.Scale(contactPoint.m_dir1_Force.m_force);
+				}
+				force += (contact->GetBody0() == body) ? contactForce : contactForce.Scale(ndFloat32(-1.0f));
+			}
+		}
+
+		for (ndInt32 j = 0; j < 3; ++j)
+		{
+			observation.m_posit[j][i] = matrix.m_posit[j];
+			observation.m_veloc[j][i] = veloc[j];
+			observation.m_omega[j][i] = omega[j];
+			observation.m_contactForce[j][i] = force[j];
+		}
+		for (ndInt32 j = 0; j < 4; ++j)
+		{
+			observation.m_rotation[j][i] = rotation[j];
+		}
+	}
+
+	for (ndInt32 i = m_jointStart[modelIndex]; i < m_jointStart[modelIndex + 1]; ++i)
+	{
+		const ndJointHinge* const hinge = m_hinges[i];
+		if (hinge)
+		{
+			observation.m_jointAngle[i] = hinge->GetAngle();
+			observation.m_jointOmega[i] = hinge->GetOmega();
+		}
+		else
+		{
+			// angle and speed around the joint pin, same as the hinge
+			ndMatrix matrix0;
+			ndMatrix matrix1;
+			const ndJointBilateralConstraint* const joint = m_joints[i];
+			joint->CalculateGlobalMatrix(matrix0, matrix1);
+			const ndVector omega0(joint->GetBody0()->GetOmega());
+			const ndVector omega1(joint->GetBody1()->GetOmega());
+			observation.m_jointAngle[i] = -joint->CalculateAngle(matrix0.m_up, matrix1.m_up, matrix1.m_front);
+			observation.m_jointOmega[i] = matrix1.m_front.DotProduct(omega0 - omega1).GetScalar();
+		}
+	}
+}
+
+void ndModelArticulationBatch::GetObservation(ndObservation& observation) const
+{
+	D_TRACKTIME();
+	ResizeObservation(observation);
+	for (ndInt32 i = 0; i < GetModelCount(); ++i)
+	{
+		GetObservation(observation, i);
+	}
+}
+
+void ndModelArticulationBatch::GetObservation(ndThreadPool& threadPool, ndObservation& observation) const
+{
+	D_TRACKTIME();
+	ResizeObservation(observation);
+
+	ndAtomic<ndInt32> iterator(0);
+	auto GetObservation = ndMakeObject::ndFunction([this, &iterator, &observation](ndInt32, ndInt32)
+	{
+		D_TRACKTIME_NAMED(GetObservation);
+		const ndInt32 modelCount = GetModelCount();
+		for (ndInt32 i = iterator.fetch_add(1); i < modelCount; i = iterator.fetch_add(1))
+		{
+			this->GetObservation(observation, i);
+		}
+	});
+	threadPool.ParallelExecute(GetObservation);
+}
+
+void ndModelArticulationBatch::ApplyActions(const ndAction& action, ndInt32 modelIndex)
+{
+	for (ndInt32 i = m_jointStart[modelIndex]; i < m_jointStart[modelIndex + 1]; ++i)
+	{
+		ndJointHinge* const hinge = m_hinges[i];
+		if (hinge && action.m_jointTarget.GetCount())
+		{
+			hinge->SetOffsetAngle(action.m_jointTarget[i]);
+		}
+		m_jointTorque[i] = action.m_jointTorque.GetCount() ? action.m_jointTorque[i] : ndFloat32(0.0f);
+	}
+}
+
+void ndModelArticulationBatch::ApplyActions(const ndAction& action)
+{
+	D_TRACKTIME();
+	ndAssert(!action.m_jointTarget.GetCount() || (action.m_jointTarget.GetCount() == m_joints.GetCount()));
+	ndAssert(!action.m_jointTorque.GetCount() || (action.m_jointTorque.GetCount() == m_joints.GetCount()));
+	for (ndInt32 i = 0; i < GetModelCount(); ++i)
+	{
+		ApplyActions(action, i);
+	}
+}
+
+void ndModelArticulationBatch::ApplyActions(ndThreadPool& threadPool, const ndAction& action)
+{
+	D_TRACKTIME();
+	ndAssert(!action.m_jointTarget.GetCount() || (action.m_jointTarget.GetCount() == m_joints.GetCount()));
+	ndAssert(!action.m_jointTorque.GetCount() || (action.m_jointTorque.GetCount() == m_joints.GetCount()));
+
+	ndAtomic<ndInt32> iterator(0);
+	auto ApplyActions = ndMakeObject::ndFunction([this, &iterator, &action](ndInt32, ndInt32)
+	{
+		D_TRACKTIME_NAMED(ApplyActions);
+		const ndInt32 modelCount = GetModelCount();
+		for (ndInt32 i = iterator.fetch_add(1); i < modelCount; i = iterator.fetch_add(1))
+		{
+			this->ApplyActions(action, i);
+		}
+	});
+	threadPool.ParallelExecute(ApplyActions);
+}
+
+// the external forces are reset at the beginning of each sub step, 
+// so the joint torques are added to the bodies here, before the solver runs.
+// the torques are summed per body first, so each body is written once.
+void ndModelArticulationBatch::Update(ndWorld* const, ndFloat32)
+{
+	for (ndInt32 i = m_bodyTorque.GetCount() - 1; i >= 0; --i)
+	{
+		m_bodyTorque[i] = ndVector::m_zero;
+	}
+
+	for (ndInt32 i = m_joints.GetCount() - 1; i >= 0; --i)
+	{
+		const ndFloat32 torque = m_jointTorque[i];
+		if (torque != ndFloat32(0.0f))
+		{
+			ndMatrix matrix0;
+			ndMatrix matrix1;
+			const ndJointBilateralConstraint* const joint = m_joints[i];
+			joint->CalculateGlobalMatrix(matrix0, matrix1);
+			const ndVector pinTorque(matrix1.m_front.Scale(torque));
+			if (m_jointBody0[i] >= 0)
+			{
+				m_bodyTorque[m_jointBody0[i]] += pinTorque;
+			}
+			if (m_jointBody1[i] >= 0)
+			{
+				m_bodyTorque[m_jointBody1[i]] -= pinTorque;
+			}
+		}
+	}
+
+	for (ndInt32 i = m_bodies.GetCount() - 1; i >= 0; --i)
+	{
+		ndBodyDynamic* const body = m_bodies[i]->GetAsBodyDynamic();
+		const ndVector& torque = m_bodyTorque[i];
+		if (body && (torque.DotProduct(torque).GetScalar() > ndFloat32(0.0f)))
+		{
+			body->SetTorque(body->GetTorque() + torque);
+		}
+	}
+}
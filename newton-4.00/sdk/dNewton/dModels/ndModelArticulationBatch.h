@@ -0,0 +1,112 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef _ND_MODEL_ARTICULATION_BATCH_H__
+#define _ND_MODEL_ARTICULATION_BATCH_H__
+
+#include "ndCoreStdafx.h"
+#include "ndNewtonStdafx.h"
+#include "ndModel.h"
+
+class ndModelArticulation;
+
+// gathers the state of many articulations into flat arrays in one pass, 
+// and writes the actions of the agents back to the joints.
+// the body and joint pointers of each model are cached when the model is added, 
+// so the gather does not walk the node hierarchies or make virtual calls.
+// bodies are stored in the depth first order of the model nodes, 
+// and joints in the same order skipping the root node.
+// the batch is itself a model, so that once added to the world 
+// it applies the joint torques on every sub step.
+// the batch owns the bodies of its models, a body can only be in one 
+// model, and must not be driven by other models in the world, because 
+// models update in parallel. torques of joints to bodies outside the 
+// batch are only applied to the body that belongs to the batch.
+class ndModelArticulationBatch: public ndModel
+{
+	public: 
+	D_CLASS_REFLECTION(ndModelArticulationBatch, ndModel)
+
+	// structure of arrays, one entry per body or per joint slot
+	class ndObservation
+	{
+		public:
+		ndArray<ndFloat32> m_posit[3];
+		ndArray<ndFloat32> m_rotation[4];
+		ndArray<ndFloat32> m_veloc[3];
+		ndArray<ndFloat32> m_omega[3];
+		ndArray<ndFloat32> m_contactForce[3];
+		ndArray<ndFloat32> m_jointAngle;
+		ndArray<ndFloat32> m_jointOmega;
+	};
+
+	// one entry per joint slot. targets are the offset angles 
+	// of hinge joints, and are ignored by other joints
+	class ndAction
+	{
+		public:
+		ndArray<ndFloat32> m_jointTarget;
+		ndArray<ndFloat32> m_jointTorque;
+	};
+
+	D_NEWTON_API ndModelArticulationBatch();
+	D_NEWTON_API virtual ~ndModelArticulationBatch();
+
+	D_NEWTON_API void AddModel(ndModelArticulation* const model);
+
+	D_NEWTON_API ndInt32 GetModelCount() const;
+	D_NEWTON_API ndInt32 GetBodyCount() const;
+	D_NEWTON_API ndInt32 GetJointCount() const;
+	D_NEWTON_API ndInt32 GetBodyStart(ndInt32 modelIndex) const;
+	D_NEWTON_API ndInt32 GetJointStart(ndInt32 modelIndex) const;
+
+	// must be called outside the world update
+	D_NEWTON_API void GetObservation(ndObservation& observation) const;
+	D_NEWTON_API void GetObservation(ndThreadPool& threadPool, ndObservation& observation) const;
+
+	// targets are written to the joints, the torques are saved, 
+	// and applied to the bodies on each sub step of the next update
+	D_NEWTON_API void ApplyActions(const ndAction& action);
+	D_NEWTON_API void ApplyActions(ndThreadPool& threadPool, const ndAction& action);
+
+	protected:
+	D_NEWTON_API virtual void OnAddToWorld();
+	D_NEWTON_API virtual void OnRemoveFromToWorld();
+	D_NEWTON_API virtual void Update(ndWorld* const world, ndFloat32 timestep);
+
+	void ResizeObservation(ndObservation& observation) const;
+	void GetObservation(ndObservation& observation, ndInt32 modelIndex) const;
+	void ApplyActions(const ndAction& action, ndInt32 modelIndex);
+
+	ndArray<ndBodyKinematic*> m_bodies;
+	ndArray<ndJointBilateralConstraint*> m_joints;
+	ndArray<ndJointHinge*> m_hinges;
+	ndArray<ndFloat32> m_jointTorque;
+	ndArray<ndInt32> m_jointBody0;
+	ndArray<ndInt32> m_jointBody1;
+	ndArray<ndVector> m_bodyTorque;
+	ndTree<ndInt32, const ndBodyKinematic*> m_bodyMap;
+	ndArray<ndInt32> m_bodyStart;
+	ndArray<ndInt32> m_jointStart;
+};
+
+#endif 
+
@@ -89,6 +89,7 @@ class ndBodyDynamic: public ndBodyKinematic
 	friend class ndDynamicsUpdateAvx2;
 	friend class ndDynamicsUpdateSycl;
 	friend class ndDynamicsUpdateCuda;
+	friend class ndWorld;
 	friend class ndFileFormatBodyDynamic;
 } D_GCC_NEWTON_ALIGN_32 ;
 
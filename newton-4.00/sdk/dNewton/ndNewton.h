@@ -48,6 +48,7 @@
 #include <ndContactArray.h>
 #include <ndJointFix6dof.h>
 #include <ndBodySphFluid.h>
+#include <ndBodySoftBody.h>
 #include <ndSkeletonList.h>
 #include <ndBodyKinematic.h>
 #include <ndContactSolver.h>
@@ -62,6 +63,7 @@
 #include <ndJointFixDistance.h>
 #include <ndMultiBodyVehicle.h>
 #include <ndModelArticulation.h>
+#include <ndModelArticulationBatch.h>
 #include <ndSkeletonContainer.h>
 #include <ndDynamicsUpdateSoa.h>
 #include <ndIkJointDoubleHinge.h>
@@ -118,6 +118,7 @@ ndWorld::ndWorld()
 	,m_averageFramesCount(ndFloat32(0.0f))
 	,m_lastExecutionTime(ndFloat32(0.0f))
 	,m_subSteps(1)
+	,m_particleThreadCount(0)
 	,m_solverMode(ndStandardSolver)
 	,m_solverIterations(4)
 	,m_inUpdate(false)
@@ -234,7 +235,24 @@ ndInt32 ndWorld::GetThreadCount() const
 void ndWorld::SetThreadCount(ndInt32 count)
 {
 	m_scene->SetThreadCount(count);
-	m_scene->m_backgroundThread.SetThreadCount(count);
+	m_scene->m_backgroundThread.SetThreadCount(m_particleThreadCount ? m_particleThreadCount : count);
+}
+
+ndInt32 ndWorld::GetParticleThreadCount() const
+{
+	return m_scene->m_backgroundThread.GetThreadCount();
+}
+
+void ndWorld::SetParticleThreadCount(ndInt32 count)
+{
+	Sync();
+	// the pool can not be resized while a particle set is updating in it
+	for (ndBodyList::ndNode* node = m_scene->m_particleSetList.GetFirst(); node; node = node->GetNext())
+	{
+		node->GetInfo()->GetAsBodyParticleSet()->Sync();
+	}
+	m_particleThreadCount = ndMax(count, 0);
+	m_scene->m_backgroundThread.SetThreadCount(m_particleThreadCount ? m_particleThreadCount : m_scene->GetThreadCount());
 }
 
 ndInt32 ndWorld::GetSubSteps() const
@@ -484,6 +502,10 @@ void ndWorld::ThreadFunction()
 
 	PreUpdate(m_timestep);
 
+	// particle sets step against the rigid bodies of the last frame, 
+	// so they run in their own pool while the rigid bodies step.
+	ParticleUpdate(m_timestep);
+
 	ndInt32 const steps = m_subSteps;
 	ndFloat32 timestep = m_timestep / (ndFloat32)steps;
 	for (ndInt32 i = 0; i < steps; ++i)
@@ -492,8 +514,7 @@ void ndWorld::ThreadFunction()
 	}
 
 	m_scene->SetTimestep(m_timestep);
-		
-	ParticleUpdate(m_timestep);
+	ParticleSync();
 		
 	UpdateTransforms();
 	PostModelTransform();
@@ -568,6 +589,12 @@ void ndWorld::ParticleUpdate(ndFloat32 timestep)
 	m_scene->ParticleUpdate(timestep);
 }
 
+void ndWorld::ParticleSync()
+{
+	D_TRACKTIME();
+	m_scene->ParticleSync();
+}
+
 void ndWorld::ModelUpdate()
 {
 	D_TRACKTIME();
@@ -1182,4 +1209,498 @@ void ndWorld::CalculateJointContacts(ndContact* const contact)
 	body1->UpdateCollisionMatrix();
 
 	m_scene->CalculateJointContacts(0, contact);
-}
\ No newline at end of file
+}
+
+#define D_WORLD_SNAPSHOT_MAGIC		0x5753646e
+#define D_WORLD_SNAPSHOT_VERSION	1
+#define D_WORLD_SNAPSHOT_ALIGNMENT	32
+
+class ndWorldSnapshotHeader
+{
+	public:
+	ndUnsigned32 m_magic;
+	ndUnsigned32 m_version;
+	ndInt32 m_floatSize;
+	ndInt32 m_bodyCount;
+	ndInt32 m_jointCount;
+	ndInt32 m_contactCount;
+	ndInt32 m_pointCount;
+	ndUnsigned32 m_lru;
+	ndInt64 m_size;
+};
+
+class ndBodySnapshot
+{
+	public:
+	ndMatrix m_matrix;
+	ndQuaternion m_rotation;
+	ndQuaternion m_gyroRotation;
+	ndVector m_veloc;
+	ndVector m_omega;
+	ndVector m_accel;
+	ndVector m_alpha;
+	ndVector m_gyroAlpha;
+	ndVector m_gyroTorque;
+	ndVector m_impulseForce;
+	ndVector m_impulseTorque;
+	ndVector m_savedExternalForce;
+	ndVector m_savedExternalTorque;
+	ndUnsigned32 m_id;
+	ndUnsigned8 m_equilibrium;
+	ndUnsigned8 m_equilibrium0;
+	ndUnsigned8 m_autoSleep;
+};
+
+class ndJointSnapshot
+{
+	public:
+	ndVector m_forceBody0;
+	ndVector m_torqueBody0;
+	ndVector m_forceBody1;
+	ndVector m_torqueBody1;
+	ndForceImpactPair m_jointForce[ND_BILATERAL_CONTRAINT_DOF];
+	ndUnsigned32 m_body0Id;
+	ndUnsigned32 m_body1Id;
+};
+
+class ndContactSnapshot
+{
+	public:
+	ndVector m_positAcc;
+	ndVector m_separatingVector;
+	ndQuaternion m_rotationAcc;
+	ndFloat32 m_timeOfImpact;
+	ndFloat32 m_separationDistance;
+	ndUnsigned32 m_body0Id;
+	ndUnsigned32 m_body1Id;
+	ndUnsigned32 m_maxDOF;
+	ndUnsigned32 m_sceneLru;
+	ndInt32 m_pointStart;
+	ndInt32 m_pointCount;
+	ndUnsigned8 m_active;
+	ndUnsigned8 m_isDead;
+};
+
+// offsets of each section of the snapshot, all records are copied with memcpy
+// so that the caller buffer does not need any particular alignment.
+class ndWorldSnapshotLayout
+{
+	public:
+	ndWorldSnapshotLayout(ndInt32 bodyCount, ndInt32 jointCount, ndInt32 contactCount, ndInt32 pointCount)
+	{
+		m_bodies = Align(sizeof(ndWorldSnapshotHeader));
+		m_joints = Align(m_bodies + ndInt64(sizeof(ndBodySnapshot)) * bodyCount);
+		m_contacts = Align(m_joints + ndInt64(sizeof(ndJointSnapshot)) * jointCount);
+		m_points = Align(m_contacts + ndInt64(sizeof(ndContactSnapshot)) * contactCount);
+		m_size = Align(m_points + ndInt64(sizeof(ndContactMaterial)) * pointCount);
+	}
+
+	static ndInt64 Align(ndInt64 offset)
+	{
+		return (offset + D_WORLD_SNAPSHOT_ALIGNMENT - 1) & ~ndInt64(D_WORLD_SNAPSHOT_ALIGNMENT - 1);
+	}
+
+	ndInt64 m_bodies;
+	ndInt64 m_joints;
+	ndInt64 m_contacts;
+	ndInt64 m_points;
+	ndInt64 m_size;
+};
+
+class ndBodyIdPair
+{
+	public:
+	ndUnsigned32 m_id;
+	ndBodyKinematic* m_body;
+};
+
+class ndCompareBodyIdPair
+{
+	public:
+	ndInt32 Compare(const ndBodyIdPair& pairA, const ndBodyIdPair& pairB, void* const) const
+	{
+		if (pairA.m_id < pairB.m_id)
+		{
+			return -1;
+		}
+		if (pairA.m_id > pairB.m_id)
+		{
+			return 1;
+		}
+		return 0;
+	}
+};
+
+static ndBodyKinematic* ndFindBodyById(const ndBodyIdPair* const pairs, ndInt32 count, ndUnsigned32 id)
+{
+	ndInt32 i0 = 0;
+	ndInt32 i1 = count - 1;
+	while (i0 <= i1)
+	{
+		const ndInt32 mid = (i0 + i1) >> 1;
+		if (pairs[mid].m_id == id)
+		{
+			return pairs[mid].m_body;
+		}
+		if (pairs[mid].m_id < id)
+		{
+			i0 = mid + 1;
+		}
+		else
+		{
+			i1 = mid - 1;
+		}
+	}
+	return nullptr;
+}
+
+ndInt64 ndWorld::GetSnapshotSize() const
+{
+	ndInt32 pointCount = 0;
+	const ndContactArray& contactArray = m_scene->GetContactArray();
+	for (ndInt32 i = 0; i < contactArray.GetCount(); ++i)
+	{
+		// same filter as SaveSnapshot, dead contacts save no points
+		const ndContact* const contact = contactArray[i];
+		pointCount += contact->m_isDead ? 0 : contact->m_contacPointsList.GetCount();
+	}
+	const ndWorldSnapshotLayout layout(m_scene->GetBodyList().GetView().GetCount(), m_jointList.GetCount(), contactArray.GetCount(), pointCount);
+	return layout.m_size;
+}
+
+ndInt64 ndWorld::SaveSnapshot(void* const buffer, ndInt64 bufferSize) const
+{
+	D_TRACKTIME();
+	ndAssert(!m_inUpdate);
+	if (m_scene->GetBodyList().IsListDirty())
+	{
+		// bodies were added or removed since the last update
+		return 0;
+	}
+
+	const ndArray<ndBodyKinematic*>& bodyArray = m_scene->GetBodyList().GetView();
+	const ndContactArray& contactArray = m_scene->GetContactArray();
+
+	// the contact points are variable size, so make a prefix scan of the counts first
+	ndArray<ndUnsigned8>& scratchBuffer = m_scene->m_scratchBuffer;
+	scratchBuffer.SetCount(ndInt32(sizeof(ndInt32)) * (contactArray.GetCount() + 1));
+	ndInt32* const pointStart = (ndInt32*)&scratchBuffer[0];
+	ndInt32 pointCount = 0;
+	for (ndInt32 i = 0; i < contactArray.GetCount(); ++i)
+	{
+		pointStart[i] = pointCount;
+		const ndContact* const contact = contactArray[i];
+		pointCount += contact->m_isDead ? 0 : contact->m_contacPointsList.GetCount();
+	}
+	pointStart[contactArray.GetCount()] = pointCount;
+
+	const ndWorldSnapshotLayout layout(bodyArray.GetCount(), m_jointList.GetCount(), contactArray.GetCount(), pointCount);
+	if (!buffer || (bufferSize < layout.m_size))
+	{
+		return 0;
+	}
+
+	ndUnsigned8* const data = (ndUnsigned8*)buffer;
+	ndWorldSnapshotHeader header;
+	header.m_magic = D_WORLD_SNAPSHOT_MAGIC;
+	header.m_version = D_WORLD_SNAPSHOT_VERSION;
+	header.m_floatSize = sizeof(ndFloat32);
+	header.m_bodyCount = bodyArray.GetCount();
+	header.m_jointCount = m_jointList.GetCount();
+	header.m_contactCount = contactArray.GetCount();
+	header.m_pointCount = pointCount;
+	header.m_lru = m_scene->m_lru;
+	header.m_size = layout.m_size;
+	memcpy(data, &header, sizeof(header));
+
+	auto SaveBodies = ndMakeObject::ndFunction([&bodyArray, &layout, data](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(SaveBodies);
+		ndBodySnapshot record;
+		const ndStartEnd startEnd(bodyArray.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndBodyKinematic* const body = bodyArray[i];
+			record.m_matrix = body->m_matrix;
+			record.m_rotation = body->m_rotation;
+			record.m_gyroRotation = body->m_gyroRotation;
+			record.m_veloc = body->m_veloc;
+			record.m_omega = body->m_omega;
+			record.m_accel = body->m_accel;
+			record.m_alpha = body->m_alpha;
+			record.m_gyroAlpha = body->m_gyroAlpha;
+			record.m_gyroTorque = body->m_gyroTorque;
+			record.m_impulseForce = ndVector::m_zero;
+			record.m_impulseTorque = ndVector::m_zero;
+			record.m_savedExternalForce = ndVector::m_zero;
+			record.m_savedExternalTorque = ndVector::m_zero;
+			const ndBodyDynamic* const dynBody = ((ndBodyKinematic*)body)->GetAsBodyDynamic();
+			if (dynBody)
+			{
+				record.m_impulseForce = dynBody->m_impulseForce;
+				record.m_impulseTorque = dynBody->m_impulseTorque;
+				record.m_savedExternalForce = dynBody->m_savedExternalForce;
+				record.m_savedExternalTorque = dynBody->m_savedExternalTorque;
+			}
+			record.m_id = body->m_uniqueId;
+			record.m_equilibrium = body->m_equilibrium;
+			record.m_equilibrium0 = body->m_equilibrium0;
+			record.m_autoSleep = body->m_autoSleep;
+			memcpy(data + layout.m_bodies + ndInt64(sizeof(ndBodySnapshot)) * i, &record, sizeof(record));
+		}
+	});
+
+	auto SaveContacts = ndMakeObject::ndFunction([&contactArray, &layout, data, pointStart](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(SaveContacts);
+		ndContactSnapshot record;
+		const ndStartEnd startEnd(contactArray.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndContact* const contact = contactArray[i];
+			record.m_positAcc = contact->m_positAcc;
+			record.m_separatingVector = contact->m_separatingVector;
+			record.m_rotationAcc = contact->m_rotationAcc;
+			record.m_timeOfImpact = contact->m_timeOfImpact;
+			record.m_separationDistance = contact->m_separationDistance;
+			record.m_body0Id = contact->m_body0->m_uniqueId;
+			record.m_body1Id = contact->m_body1->m_uniqueId;
+			record.m_maxDOF = contact->m_maxDOF;
+			record.m_sceneLru = contact->m_sceneLru;
+			record.m_pointStart = pointStart[i];
+			record.m_pointCount = pointStart[i + 1] - pointStart[i];
+			record.m_active = contact->IsActive() ? 1 : 0;
+			record.m_isDead = ndUnsigned8(contact->m_isDead);
+			memcpy(data + layout.m_contacts + ndInt64(sizeof(ndContactSnapshot)) * i, &record, sizeof(record));
+
+			ndInt64 offset = layout.m_points + ndInt64(sizeof(ndContactMaterial)) * record.m_pointStart;
+			for (ndContactPointList::ndNode* node = record.m_pointCount ? contact->m_contacPointsList.GetFirst() : nullptr; node; node = node->GetNext())
+			{
+				memcpy(data + offset, &node->GetInfo(), sizeof(ndContactMaterial));
+				offset += ndInt64(sizeof(ndContactMaterial));
+			}
+		}
+	});
+
+	// the snapshot is taken outside the update, so start the workers here
+	m_scene->Begin();
+	m_scene->ParallelExecute(SaveBodies);
+	m_scene->ParallelExecute(SaveContacts);
+	m_scene->End();
+
+	ndInt64 offset = layout.m_joints;
+	ndJointSnapshot record;
+	for (ndJointList::ndNode* node = m_jointList.GetFirst(); node; node = node->GetNext())
+	{
+		const ndJointBilateralConstraint* const joint = *node->GetInfo();
+		record.m_forceBody0 = joint->m_forceBody0;
+		record.m_torqueBody0 = joint->m_torqueBody0;
+		record.m_forceBody1 = joint->m_forceBody1;
+		record.m_torqueBody1 = joint->m_torqueBody1;
+		for (ndInt32 i = 0; i < ND_BILATERAL_CONTRAINT_DOF; ++i)
+		{
+			record.m_jointForce[i] = joint->m_jointForce[i];
+		}
+		record.m_body0Id = joint->m_body0->m_uniqueId;
+		record.m_body1Id = joint->m_body1->m_uniqueId;
+		memcpy(data + offset, &record, sizeof(record));
+		offset += ndInt64(sizeof(ndJointSnapshot));
+	}
+
+	return layout.m_size;
+}
+
+bool ndWorld::RestoreSnapshot(const void* const buffer, ndInt64 bufferSize)
+{
+	D_TRACKTIME();
+	ndAssert(!m_inUpdate);
+	if (!buffer || (bufferSize < ndInt64(sizeof(ndWorldSnapshotHeader))) || m_scene->GetBodyList().IsListDirty())
+	{
+		return false;
+	}
+
+	const ndUnsigned8* const data = (const ndUnsigned8*)buffer;
+	ndWorldSnapshotHeader header;
+	memcpy(&header, data, sizeof(header));
+	if ((header.m_magic != D_WORLD_SNAPSHOT_MAGIC) || (header.m_version != D_WORLD_SNAPSHOT_VERSION) || (header.m_floatSize != sizeof(ndFloat32)))
+	{
+		return false;
+	}
+
+	const ndArray<ndBodyKinematic*>& bodyArray = m_scene->GetBodyList().GetView();
+	if ((header.m_bodyCount != bodyArray.GetCount()) || (header.m_jointCount != m_jointList.GetCount()))
+	{
+		return false;
+	}
+	const ndWorldSnapshotLayout layout(header.m_bodyCount, header.m_jointCount, header.m_contactCount, header.m_pointCount);
+	if ((header.m_size != layout.m_size) || (bufferSize < layout.m_size))
+	{
+		return false;
+	}
+
+	// validate the bodies and joints before touching the world
+	ndAtomic<ndInt32> mismatches(0);
+	auto ValidateBodies = ndMakeObject::ndFunction([&bodyArray, &layout, &mismatches, data](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(ValidateBodies);
+		ndInt32 count = 0;
+		ndBodySnapshot record;
+		const ndStartEnd startEnd(bodyArray.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			memcpy(&record, data + layout.m_bodies + ndInt64(sizeof(ndBodySnapshot)) * i, sizeof(record));
+			count += (record.m_id != bodyArray[i]->m_uniqueId) ? 1 : 0;
+		}
+		mismatches.fetch_add(count);
+	});
+	m_scene->Begin();
+	m_scene->ParallelExecute(ValidateBodies);
+	m_scene->End();
+
+	ndInt64 offset = layout.m_joints;
+	ndJointSnapshot jointRecord;
+	for (ndJointList::ndNode* node = m_jointList.GetFirst(); node; node = node->GetNext())
+	{
+		const ndJointBilateralConstraint* const joint = *node->GetInfo();
+		memcpy(&jointRecord, data + offset, sizeof(jointRecord));
+		if ((jointRecord.m_body0Id != joint->m_body0->m_uniqueId) || (jointRecord.m_body1Id != joint->m_body1->m_uniqueId))
+		{
+			mismatches.fetch_add(1);
+		}
+		offset += ndInt64(sizeof(ndJointSnapshot));
+	}
+	if (mismatches.load())
+	{
+		return false;
+	}
+
+	auto RestoreBodies = ndMakeObject::ndFunction([&bodyArray, &layout, data](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(RestoreBodies);
+		ndBodySnapshot record;
+		const ndStartEnd startEnd(bodyArray.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			ndBodyKinematic* const body = bodyArray[i];
+			memcpy(&record, data + layout.m_bodies + ndInt64(sizeof(ndBodySnapshot)) * i, sizeof(record));
+			body->m_matrix = record.m_matrix;
+			body->m_rotation = record.m_rotation;
+			body->m_globalCentreOfMass = body->m_matrix.TransformVector(body->m_localCentreOfMass);
+			body->m_gyroRotation = record.m_gyroRotation;
+			body->m_veloc = record.m_veloc;
+			body->m_omega = record.m_omega;
+			body->m_accel = record.m_accel;
+			body->m_alpha = record.m_alpha;
+			body->m_gyroAlpha = record.m_gyroAlpha;
+			body->m_gyroTorque = record.m_gyroTorque;
+			body->m_equilibrium = record.m_equilibrium;
+			body->m_equilibrium0 = record.m_equilibrium0;
+			body->m_autoSleep = record.m_autoSleep;
+			body->m_sceneForceUpdate = 1;
+			body->UpdateCollisionMatrix();
+
+			ndBodyDynamic* const dynBody = body->GetAsBodyDynamic();
+			if (dynBody)
+			{
+				dynBody->m_impulseForce = record.m_impulseForce;
+				dynBody->m_impulseTorque = record.m_impulseTorque;
+				dynBody->m_savedExternalForce = record.m_savedExternalForce;
+				dynBody->m_savedExternalTorque = record.m_savedExternalTorque;
+			}
+		}
+	});
+	m_scene->Begin();
+	m_scene->ParallelExecute(RestoreBodies);
+	m_scene->End();
+
+	offset = layout.m_joints;
+	for (ndJointList::ndNode* node = m_jointList.GetFirst(); node; node = node->GetNext())
+	{
+		ndJointBilateralConstraint* const joint = *node->GetInfo();
+		memcpy(&jointRecord, data + offset, sizeof(jointRecord));
+		joint->m_forceBody0 = jointRecord.m_forceBody0;
+		joint->m_torqueBody0 = jointRecord.m_torqueBody0;
+		joint->m_forceBody1 = jointRecord.m_forceBody1;
+		joint->m_torqueBody1 = jointRecord.m_torqueBody1;
+		for (ndInt32 i = 0; i < ND_BILATERAL_CONTRAINT_DOF; ++i)
+		{
+			joint->m_jointForce[i] = jointRecord.m_jointForce[i];
+		}
+		offset += ndInt64(sizeof(ndJointSnapshot));
+	}
+
+	// contacts that are not in the snapshot are detached, and the scene deletes them
+	// in the next update. contacts that are missing are recreated with their cached points.
+	ndContactArray& contactArray = m_scene->m_contactArray;
+	for (ndInt32 i = 0; i < contactArray.GetCount(); ++i)
+	{
+		contactArray[i]->m_isDead = 1;
+	}
+
+	ndArray<ndUnsigned8>& scratchBuffer = m_scene->m_scratchBuffer;
+	scratchBuffer.SetCount(ndInt32(sizeof(ndBodyIdPair)) * bodyArray.GetCount());
+	ndBodyIdPair* const bodyIds = (ndBodyIdPair*)&scratchBuffer[0];
+	for (ndInt32 i = 0; i < bodyArray.GetCount(); ++i)
+	{
+		bodyIds[i].m_id = bodyArray[i]->m_uniqueId;
+		bodyIds[i].m_body = bodyArray[i];
+	}
+	ndSort<ndBodyIdPair, ndCompareBodyIdPair>(bodyIds, bodyArray.GetCount(), nullptr);
+
+	const ndInt32 existingCount = contactArray.GetCount();
+	ndContactSnapshot contactRecord;
+	for (ndInt32 i = 0; i < header.m_contactCount; ++i)
+	{
+		memcpy(&contactRecord, data + layout.m_contacts + ndInt64(sizeof(ndContactSnapshot)) * i, sizeof(contactRecord));
+		ndBodyKinematic* const body0 = ndFindBodyById(bodyIds, bodyArray.GetCount(), contactRecord.m_body0Id);
+		ndBodyKinematic* const body1 = ndFindBodyById(bodyIds, bodyArray.GetCount(), contactRecord.m_body1Id);
+		if (contactRecord.m_isDead || !body0 || !body1)
+		{
+			continue;
+		}
+
+		ndContact* contact = body0->GetContactMap().FindContact(body0, body1);
+		if (!contact)
+		{
+			contact = contactArray.CreateContact(body0, body1);
+		}
+		contact->m_isDead = 0;
+		contact->m_positAcc = contactRecord.m_positAcc;
+		contact->m_separatingVector = contactRecord.m_separatingVector;
+		contact->m_rotationAcc = contactRecord.m_rotationAcc;
+		contact->m_timeOfImpact = contactRecord.m_timeOfImpact;
+		contact->m_separationDistance = contactRecord.m_separationDistance;
+		contact->m_maxDOF = contactRecord.m_maxDOF;
+		contact->m_sceneLru = contactRecord.m_sceneLru;
+		contact->SetActive(contactRecord.m_active ? true : false);
+
+		ndContactPointList& pointList = contact->m_contacPointsList;
+		while (pointList.GetCount() > contactRecord.m_pointCount)
+		{
+			pointList.Remove(pointList.GetLast());
+		}
+		while (pointList.GetCount() < contactRecord.m_pointCount)
+		{
+			pointList.Append();
+		}
+		ndInt64 pointOffset = layout.m_points + ndInt64(sizeof(ndContactMaterial)) * contactRecord.m_pointStart;
+		for (ndContactPointList::ndNode* node = pointList.GetFirst(); node; node = node->GetNext())
+		{
+			memcpy(&node->GetInfo(), data + pointOffset, sizeof(ndContactMaterial));
+			pointOffset += ndInt64(sizeof(ndContactMaterial));
+		}
+		contact->m_material = m_scene->m_contactNotifyCallback->GetMaterial(contact, body0->GetCollisionShape(), body1->GetCollisionShape());
+	}
+
+	for (ndInt32 i = 0; i < existingCount; ++i)
+	{
+		ndContact* const contact = contactArray[i];
+		if (contact->m_isDead)
+		{
+			contactArray.DetachContact(contact);
+		}
+	}
+
+	m_scene->m_lru = header.m_lru;
+	return true;
+}
@@ -71,6 +71,11 @@ class ndWorld: public ndClassAlloc
 	D_NEWTON_API ndInt32 GetThreadCount() const;
 	D_NEWTON_API void SetThreadCount(ndInt32 count);
 
+	// particle sets update in their own thread pool, at the same time as the rigid bodies.
+	// zero gives them as many threads as the rigid bodies.
+	D_NEWTON_API ndInt32 GetParticleThreadCount() const;
+	D_NEWTON_API void SetParticleThreadCount(ndInt32 count);
+
 	D_NEWTON_API ndInt32 GetSubSteps() const;
 	D_NEWTON_API void SetSubSteps(ndInt32 subSteps);
 
@@ -122,6 +127,14 @@ class ndWorld: public ndClassAlloc
 
 	D_NEWTON_API void CalculateJointContacts(ndContact* const contact);
 
+	// binary snapshot of the dynamic state of the world: body transforms and velocities,
+	// sleep state, the contact cache and the joint warm start forces.
+	// must be called outside the update. snapshots can only be restored
+	// on the world that saved them, with the same bodies and joints.
+	D_NEWTON_API ndInt64 GetSnapshotSize() const;
+	D_NEWTON_API ndInt64 SaveSnapshot(void* const buffer, ndInt64 bufferSize) const;
+	D_NEWTON_API bool RestoreSnapshot(const void* const buffer, ndInt64 bufferSize);
+
 	private:
 	void ThreadFunction();
 	
@@ -157,6 +170,7 @@ class ndWorld: public ndClassAlloc
 	void ModelPostUpdate();
 	void CalculateAverageUpdateTime();
 	void SubStepUpdate(ndFloat32 timestep);
+	void ParticleSync();
 	void ParticleUpdate(ndFloat32 timestep);
 
 	bool SkeletonJointTest(ndJointBilateralConstraint* const jointA) const;
@@ -183,6 +197,7 @@ class ndWorld: public ndClassAlloc
 	dgSolverProgressiveSleepEntry m_sleepTable[D_SLEEP_ENTRIES];
 
 	ndInt32 m_subSteps;
+	ndInt32 m_particleThreadCount;
 	ndSolverModes m_solverMode;
 	ndInt32 m_solverIterations;
 	bool m_inUpdate;
@@ -0,0 +1,287 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndNewton.h"
+#include "testWorld.h"
+#include <gtest/gtest.h>
+
+// a square cloth in the xz plane, with rigid structural springs and soft shear and bending springs
+static ndBodySoftBody* AddCloth(ndWorld& world, ndInt32 size, ndFloat32 spacing, const ndVector& origin)
+{
+	ndBodySoftBody* const cloth = new ndBodySoftBody();
+	cloth->SetParticleRadius(0.25f * spacing);
+	cloth->SetGravity(ndVector(0.0f, -10.0f, 0.0f, 0.0f));
+	cloth->SetAsynUpdate(false);
+	cloth->SetSolverIterations(4);
+	cloth->SetSubSteps(8);
+
+	for (ndInt32 z = 0; z < size; ++z)
+	{
+		for (ndInt32 x = 0; x < size; ++x)
+		{
+			cloth->AddParticle(origin + ndVector(ndFloat32(x) * spacing, 0.0f, ndFloat32(z) * spacing, 0.0f), 0.1f);
+		}
+	}
+
+	for (ndInt32 z = 0; z < size; ++z)
+	{
+		for (ndInt32 x = 0; x < size; ++x)
+		{
+			const ndInt32 i = z * size + x;
+			if (x + 1 < size)
+			{
+				cloth->AddSpring(i, i + 1, 0.0f, 0.0f);
+			}
+			if (z + 1 < size)
+			{
+				cloth->AddSpring(i, i + size, 0.0f, 0.0f);
+			}
+			if ((x + 1 < size) && (z + 1 < size))
+			{
+				cloth->AddSpring(i, i + size + 1, 1.0e-4f, 0.1f);
+				cloth->AddSpring(i + 1, i + size, 1.0e-4f, 0.1f);
+			}
+			if (x + 2 < size)
+			{
+				cloth->AddSpring(i, i + 2, 1.0e-3f, 0.1f);
+			}
+			if (z + 2 < size)
+			{
+				cloth->AddSpring(i, i + 2 * size, 1.0e-3f, 0.1f);
+			}
+		}
+	}
+
+	ndSharedPtr<ndBody> body(cloth);
+	world.AddBody(body);
+	return cloth;
+}
+
+/* A cloth pinned at two corners must hang without stretching its structural springs. */
+TEST(BodySoftBody, HangingClothStrain)
+{
+	ndWorld world;
+	world.SetThreadCount(4);
+
+	const ndInt32 size = 16;
+	const ndFloat32 spacing = 0.1f;
+	const ndVector origin(0.0f, 4.0f, 0.0f, 0.0f);
+	ndBodySoftBody* const cloth = AddCloth(world, size, spacing, origin);
+	cloth->SetParticleMass(0, 0.0f);
+	cloth->SetParticleMass(size - 1, 0.0f);
+
+	// damp the swing so that the cloth settles
+	cloth->SetDamping(2.0f);
+	Simulate(world, 120);
+
+	const ndArray<ndVector>& posit = cloth->GetPositions();
+	for (ndInt32 i = 0; i < posit.GetCount(); ++i)
+	{
+		ASSERT_TRUE(ndCheckFloat(posit[i].m_x) && ndCheckFloat(posit[i].m_y) && ndCheckFloat(posit[i].m_z));
+	}
+
+	// the pinned corners stay in place
+	EXPECT_NEAR(posit[0].m_y, origin.m_y, 1.0e-5f);
+	EXPECT_NEAR(posit[size - 1].m_x, ndFloat32(size - 1) * spacing, 1.0e-5f);
+
+	// the cloth hangs down
+	EXPECT_LT(posit[size * (size - 1)].m_y, origin.m_y - 1.0f);
+
+	ndFloat32 maxStrain = 0.0f;
+	for (ndInt32 z = 0; z < size; ++z)
+	{
+		for (ndInt32 x = 0; x < size - 1; ++x)
+		{
+			const ndVector dist(posit[z * size + x + 1] - posit[z * size + x]);
+			maxStrain = ndMax(maxStrain, ndSqrt(dist.DotProduct(dist).GetScalar()) / spacing - 1.0f);
+		}
+	}
+	for (ndInt32 z = 0; z < size - 1; ++z)
+	{
+		for (ndInt32 x = 0; x < size; ++x)
+		{
+			const ndVector dist(posit[(z + 1) * size + x] - posit[z * size + x]);
+			maxStrain = ndMax(maxStrain, ndSqrt(dist.DotProduct(dist).GetScalar()) / spacing - 1.0f);
+		}
+	}
+	EXPECT_LT(maxStrain, 0.05f);
+	world.CleanUp();
+}
+
+/* A hanging spring must stretch by the weight times its compliance, and not at all when rigid. */
+TEST(BodySoftBody, SpringCompliance)
+{
+	ndWorld world;
+	const ndFloat32 mass = 0.1f;
+	const ndFloat32 compliance[] = { 0.0f, 0.05f };
+
+	ndBodySoftBody* const body = new ndBodySoftBody();
+	body->SetParticleRadius(0.05f);
+	body->SetGravity(ndVector(0.0f, -10.0f, 0.0f, 0.0f));
+	body->SetAsynUpdate(false);
+	body->SetSubSteps(8);
+	body->SetDamping(2.0f);
+	for (ndInt32 i = 0; i < 2; ++i)
+	{
+		const ndFloat32 x = ndFloat32(i) * 2.0f;
+		const ndInt32 pin = body->AddParticle(ndVector(x, 4.0f, 0.0f, 0.0f), 0.0f);
+		const ndInt32 bob = body->AddParticle(ndVector(x, 3.0f, 0.0f, 0.0f), mass);
+		body->AddSpring(pin, bob, compliance[i], 0.1f);
+	}
+	ndSharedPtr<ndBody> bodyPtr(body);
+	world.AddBody(bodyPtr);
+	Simulate(world, 240);
+
+	const ndArray<ndVector>& posit = body->GetPositions();
+	for (ndInt32 i = 0; i < 2; ++i)
+	{
+		const ndFloat32 stretch = posit[i * 2].m_y - posit[i * 2 + 1].m_y - 1.0f;
+		EXPECT_NEAR(stretch, mass * 10.0f * compliance[i], 0.01f);
+	}
+	world.CleanUp();
+}
+
+/* A cloth dropped on a static box must drape over it without going through. */
+TEST(BodySoftBody, ClothOnBox)
+{
+	ndWorld world;
+	world.SetThreadCount(4);
+
+	ndShapeInstance shape(new ndShapeBox(1.0f, 1.0f, 1.0f));
+	ndBodyDynamic* const box = new ndBodyDynamic();
+	ndMatrix matrix(ndGetIdentityMatrix());
+	matrix.m_posit = ndVector(0.75f, 0.5f, 0.75f, 1.0f);
+	box->SetMatrix(matrix);
+	box->SetCollisionShape(shape);
+	ndSharedPtr<ndBody> boxPtr(box);
+	world.AddBody(boxPtr);
+
+	const ndInt32 size = 16;
+	const ndFloat32 spacing = 0.1f;
+	ndBodySoftBody* const cloth = AddCloth(world, size, spacing, ndVector(0.0f, 1.5f, 0.0f, 0.0f));
+
+	Simulate(world, 90);
+
+	// the particles over the box top rest on it
+	const ndArray<ndVector>& posit = cloth->GetPositions();
+	ndInt32 restingCount = 0;
+	for (ndInt32 i = 0; i < posit.GetCount(); ++i)
+	{
+		ASSERT_TRUE(ndCheckFloat(posit[i].m_x) && ndCheckFloat(posit[i].m_y) && ndCheckFloat(posit[i].m_z));
+		const ndVector p(posit[i]);
+		if ((p.m_x > 0.35f) && (p.m_x < 1.15f) && (p.m_z > 0.35f) && (p.m_z < 1.15f))
+		{
+			EXPECT_GT(p.m_y, 0.98f);
+			restingCount += (p.m_y < 1.1f) ? 1 : 0;
+		}
+	}
+	EXPECT_GT(restingCount, 0);
+	world.CleanUp();
+}
+
+/* A block of tetrahedra falling under gravity must keep its volume. */
+TEST(BodySoftBody, TetrahedraKeepVolume)
+{
+	ndWorld world;
+	world.SetThreadCount(4);
+
+	ndBodySoftBody* const block = new ndBodySoftBody();
+	block->SetParticleRadius(0.025f);
+	block->SetGravity(ndVector(0.0f, -10.0f, 0.0f, 0.0f));
+	block->SetAsynUpdate(false);
+	block->SetBodyCollision(false);
+
+	// a 4 x 4 x 4 grid of cubes, each split in five tetrahedra, hanging from a corner
+	const ndInt32 cells = 4;
+	const ndInt32 points = cells + 1;
+	const ndFloat32 spacing = 0.1f;
+	for (ndInt32 z = 0; z < points; ++z)
+	{
+		for (ndInt32 y = 0; y < points; ++y)
+		{
+			for (ndInt32 x = 0; x < points; ++x)
+			{
+				block->AddParticle(ndVector(ndFloat32(x) * spacing, 2.0f + ndFloat32(y) * spacing, ndFloat32(z) * spacing, 0.0f), 0.1f);
+			}
+		}
+	}
+	block->SetParticleMass((points - 1) * points, 0.0f);
+
+	ndFloat32 restVolume = 0.0f;
+	for (ndInt32 z = 0; z < cells; ++z)
+	{
+		for (ndInt32 y = 0; y < cells; ++y)
+		{
+			for (ndInt32 x = 0; x < cells; ++x)
+			{
+				ndInt32 v[8];
+				for (ndInt32 i = 0; i < 8; ++i)
+				{
+					v[i] = ((z + ((i >> 2) & 1)) * points + (y + ((i >> 1) & 1))) * points + (x + (i & 1));
+				}
+				block->AddTetrahedron(v[0], v[1], v[2], v[4], 0.0f);
+				block->AddTetrahedron(v[1], v[3], v[2], v[7], 0.0f);
+				block->AddTetrahedron(v[1], v[4], v[5], v[7], 0.0f);
+				block->AddTetrahedron(v[2], v[7], v[6], v[4], 0.0f);
+				block->AddTetrahedron(v[1], v[2], v[4], v[7], 0.0f);
+				restVolume += spacing * spacing * spacing;
+			}
+		}
+	}
+	EXPECT_EQ(block->GetTetrahedronCount(), cells * cells * cells * 5);
+
+	ndSharedPtr<ndBody> body(block);
+	world.AddBody(body);
+	Simulate(world, 60);
+
+	const ndArray<ndVector>& posit = block->GetPositions();
+	ndFloat32 volume = 0.0f;
+	for (ndInt32 z = 0; z < cells; ++z)
+	{
+		for (ndInt32 y = 0; y < cells; ++y)
+		{
+			for (ndInt32 x = 0; x < cells; ++x)
+			{
+				ndInt32 v[8];
+				for (ndInt32 i = 0; i < 8; ++i)
+				{
+					v[i] = ((z + ((i >> 2) & 1)) * points + (y + ((i >> 1) & 1))) * points + (x + (i & 1));
+				}
+				const ndInt32 tetra[5][4] = { {0, 1, 2, 4}, {1, 3, 2, 7}, {1, 4, 5, 7}, {2, 7, 6, 4}, {1, 2, 4, 7} };
+				for (ndInt32 i = 0; i < 5; ++i)
+				{
+					const ndVector p0(posit[v[tetra[i][0]]]);
+					const ndVector e1(posit[v[tetra[i][1]]] - p0);
+					const ndVector e2(posit[v[tetra[i][2]]] - p0);
+					const ndVector e3(posit[v[tetra[i][3]]] - p0);
+					volume += ndAbs(e1.DotProduct(e2.CrossProduct(e3)).GetScalar()) / 6.0f;
+				}
+			}
+		}
+	}
+
+	// the block swings down, but keeps its volume
+	EXPECT_LT(posit[0].m_y, 2.0f);
+	EXPECT_NEAR(volume / restVolume, 1.0f, 0.1f);
+	world.CleanUp();
+}
+
+/* Coloring a cloth grid must give a small number of independent batches. */
+TEST(BodySoftBody, ConstraintBatches)
+{
+	ndWorld world;
+	ndBodySoftBody* const cloth = AddCloth(world, 32, 0.1f, ndVector(0.0f, 2.0f, 0.0f, 0.0f));
+
+	// 12 springs touch each inner particle
+	EXPECT_GT(cloth->GetBatchCount(), 0);
+	EXPECT_LE(cloth->GetBatchCount(), 24);
+	world.CleanUp();
+}
@@ -0,0 +1,355 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include <cstdio>
+#include "ndNewton.h"
+#include "testWorld.h"
+#include <gtest/gtest.h>
+
+static ndBodySphFluid* AddFluidBlock(ndWorld& world, ndInt32 size, ndInt32 height)
+{
+	ndBodySphFluid* const fluid = new ndBodySphFluid();
+	fluid->SetParticleRadius(0.05f);
+	fluid->SetGravity(ndVector(0.0f, -10.0f, 0.0f, 0.0f));
+	fluid->SetSolverMode(ndBodySphFluid::m_positionBased);
+	fluid->SetAsynUpdate(false);
+
+	const ndFloat32 spacing = 2.0f * fluid->GetParticleRadius();
+	for (ndInt32 z = 0; z < size; ++z)
+	{
+		for (ndInt32 y = 0; y < height; ++y)
+		{
+			for (ndInt32 x = 0; x < size; ++x)
+			{
+				fluid->GetPositions().PushBack(ndVector(ndFloat32(x) * spacing, 1.0f + ndFloat32(y) * spacing, ndFloat32(z) * spacing, 0.0f));
+				fluid->GetVelocity().PushBack(ndVector::m_zero);
+			}
+		}
+	}
+
+	ndSharedPtr<ndBody> body(fluid);
+	world.AddBody(body);
+	return fluid;
+}
+
+// brute force poly6 density, normalized by the rest density
+static ndFloat32 CalculateMaxDensityError(const ndBodySphFluid* const fluid)
+{
+	const ndArray<ndVector>& posit = fluid->GetPositions();
+	const ndFloat32 r = fluid->GetParticleRadius();
+	const ndFloat32 h = 2.0f * r;
+	const ndFloat32 h2 = h * h;
+	const ndFloat32 mass = ndPi * ndFloat32(4.0f / 3.0f) * r * r * r * fluid->GetRestDensity();
+	const ndFloat32 kernelConst = mass * ndFloat32(315.0f) / (ndFloat32(64.0f) * ndPi * ndPow(h, ndFloat32(9.0f)));
+
+	ndFloat32 maxError = 0.0f;
+	for (ndInt32 i = 0; i < posit.GetCount(); ++i)
+	{
+		ndFloat32 volume = 0.0f;
+		for (ndInt32 j = 0; j < posit.GetCount(); ++j)
+		{
+			const ndVector dp(posit[i] - posit[j]);
+			const ndFloat32 dist2 = dp.DotProduct(dp).GetScalar();
+			const ndFloat32 w = ndMax(h2 - dist2, ndFloat32(0.0f));
+			volume += w * w * w;
+		}
+		maxError = ndMax(maxError, kernelConst * volume / fluid->GetRestDensity() - 1.0f);
+	}
+	return maxError;
+}
+
+// static walls and floor around a fluid block, the walls go below the fluid floor
+static void AddTank(ndWorld& world, ndFloat32 width)
+{
+	const ndFloat32 thickness = 0.2f;
+	const ndFloat32 center = 0.5f * (width - 0.1f);
+	const ndFloat32 offset = 0.5f * (width + thickness);
+	AddBox(world, ndVector(center, 1.4f, center - offset, 1.0f), ndVector(width + 2.0f * thickness, 1.2f, thickness, 0.0f), 0.0f);
+	AddBox(world, ndVector(center, 1.4f, center + offset, 1.0f), ndVector(width + 2.0f * thickness, 1.2f, thickness, 0.0f), 0.0f);
+	AddBox(world, ndVector(center - offset, 1.4f, center, 1.0f), ndVector(thickness, 1.2f, width + 2.0f * thickness, 0.0f), 0.0f);
+	AddBox(world, ndVector(center + offset, 1.4f, center, 1.0f), ndVector(thickness, 1.2f, width + 2.0f * thickness, 0.0f), 0.0f);
+	AddBox(world, ndVector(center, 0.5f, center, 1.0f), ndVector(width + 1.0f, 1.0f, width + 1.0f, 0.0f), 0.0f);
+}
+
+/* A single free particle must follow the ballistic trajectory. */
+TEST(BodySphFluid, PositionBasedFreeFall)
+{
+	ndWorld world;
+	world.SetThreadCount(4);
+	ndBodySphFluid* const fluid = AddFluidBlock(world, 1, 1);
+	fluid->GetPositions()[0].m_y = 10.0f;
+
+	Simulate(world, 30);
+
+	// semi implicit euler
+	const ndFloat32 timestep = 1.0f / 60.0f;
+	const ndFloat32 drop = 10.0f * timestep * timestep * 30.0f * 31.0f * 0.5f;
+	EXPECT_NEAR(fluid->GetVelocity()[0].m_y, -10.0f * timestep * 30.0f, 1.0e-3f);
+	EXPECT_NEAR(fluid->GetPositions()[0].m_y, 10.0f - drop, 1.0e-3f);
+	world.CleanUp();
+}
+
+/* The position based solver must hold a column of fluid at the world time step. */
+TEST(BodySphFluid, PositionBasedStable)
+{
+	ndWorld world;
+	world.SetThreadCount(4);
+	ndBodySphFluid* const fluid = AddFluidBlock(world, 8, 8);
+
+	Simulate(world, 120);
+
+	const ndArray<ndVector>& posit = fluid->GetPositions();
+	for (ndInt32 i = 0; i < posit.GetCount(); ++i)
+	{
+		ASSERT_TRUE(ndCheckFloat(posit[i].m_x) && ndCheckFloat(posit[i].m_y) && ndCheckFloat(posit[i].m_z));
+		EXPECT_GE(posit[i].m_y, 1.0f);
+		EXPECT_LT(posit[i].m_y, 1.8f);
+	}
+	EXPECT_LT(CalculateMaxDensityError(fluid), 0.2f);
+	world.CleanUp();
+}
+
+/* Static bodies overlapping the fluid must contain the particles. */
+TEST(BodySphFluid, BodyCouplingContainsFluid)
+{
+	ndWorld world;
+	world.SetThreadCount(4);
+	AddTank(world, 0.8f);
+	ndBodySphFluid* const fluid = AddFluidBlock(world, 8, 8);
+	fluid->SetBodyCoupling(true);
+
+	Simulate(world, 90);
+
+	const ndArray<ndVector>& posit = fluid->GetPositions();
+	for (ndInt32 i = 0; i < posit.GetCount(); ++i)
+	{
+		ASSERT_TRUE(ndCheckFloat(posit[i].m_x) && ndCheckFloat(posit[i].m_y) && ndCheckFloat(posit[i].m_z));
+		EXPECT_GT(posit[i].m_x, -0.1f);
+		EXPECT_LT(posit[i].m_x, 0.8f);
+		EXPECT_GT(posit[i].m_z, -0.1f);
+		EXPECT_LT(posit[i].m_z, 0.8f);
+	}
+	world.CleanUp();
+}
+
+/* The fluid must push back on dynamic bodies, a light box floats and a heavy box sinks. */
+TEST(BodySphFluid, BodyCouplingBuoyancy)
+{
+	ndFloat32 elevation[2];
+	const ndFloat32 density[] = { 300.0f, 3000.0f };
+	for (ndInt32 i = 0; i < 2; ++i)
+	{
+		ndWorld world;
+		world.SetThreadCount(4);
+		AddTank(world, 1.2f);
+		ndBodySphFluid* const fluid = AddFluidBlock(world, 12, 8);
+		fluid->SetBodyCoupling(true);
+		ndBodyKinematic* const box = AddBox(world, ndVector(0.55f, 2.2f, 0.55f, 1.0f), ndVector(0.4f, 0.4f, 0.4f, 0.0f), density[i] * 0.4f * 0.4f * 0.4f);
+
+		Simulate(world, 60);
+
+		elevation[i] = box->GetMatrix().m_posit.m_y;
+		world.CleanUp();
+	}
+
+	// the fluid surface is at about 1.8, the floor at 1.0
+	EXPECT_GT(elevation[0], 1.5f);
+	EXPECT_LT(elevation[1], 1.3f);
+}
+
+static ndFloat32 CalculateMeanStride(const ndArray<ndVector>& posit)
+{
+	ndFloat32 stride = 0.0f;
+	for (ndInt32 i = 1; i < posit.GetCount(); ++i)
+	{
+		const ndVector dp(posit[i] - posit[i - 1]);
+		stride += ndSqrt(dp.DotProduct(dp).GetScalar());
+	}
+	return stride / ndFloat32(posit.GetCount() - 1);
+}
+
+/* Reordering must keep the same particles and put spatial neighbors next to each other. */
+TEST(BodySphFluid, ReorderParticles)
+{
+	ndWorld world;
+	world.SetThreadCount(4);
+	ndBodySphFluid* const fluid = AddFluidBlock(world, 16, 8);
+	fluid->SetGravity(ndVector::m_zero);
+	fluid->SetReorderPeriod(1);
+
+	ndArray<ndVector>& posit = fluid->GetPositions();
+	posit.RandomShuffle(ndInt32(posit.GetCount()));
+	ndVector sum0(ndVector::m_zero);
+	for (ndInt32 i = 0; i < posit.GetCount(); ++i)
+	{
+		sum0 += posit[i] + posit[i] * posit[i];
+	}
+	const ndFloat32 stride0 = CalculateMeanStride(posit);
+
+	// the first update only finds the fluid bounds
+	Simulate(world, 2);
+
+	ndVector sum1(ndVector::m_zero);
+	for (ndInt32 i = 0; i < posit.GetCount(); ++i)
+	{
+		sum1 += posit[i] + posit[i] * posit[i];
+	}
+	EXPECT_NEAR(sum0.m_x, sum1.m_x, 1.0e-2f);
+	EXPECT_NEAR(sum0.m_y, sum1.m_y, 1.0e-2f);
+	EXPECT_NEAR(sum0.m_z, sum1.m_z, 1.0e-2f);
+	EXPECT_LT(CalculateMeanStride(posit), stride0 * 0.25f);
+	world.CleanUp();
+}
+
+/* The cell list must settle a fluid column like the pair list, using less working memory. */
+TEST(BodySphFluid, CellListMatchesPairList)
+{
+	ndFloat32 meanY[2];
+	ndUnsigned64 memory[2];
+	for (ndInt32 search = 0; search < 2; ++search)
+	{
+		ndWorld world;
+		world.SetThreadCount(4);
+		ndBodySphFluid* const fluid = AddFluidBlock(world, 8, 8);
+		fluid->SetNeighborSearch(ndBodySphFluid::ndNeighborSearch(search));
+
+		Simulate(world, 120);
+
+		const ndArray<ndVector>& posit = fluid->GetPositions();
+		ndFloat32 sumY = 0.0f;
+		for (ndInt32 i = 0; i < posit.GetCount(); ++i)
+		{
+			sumY += posit[i].m_y;
+		}
+		meanY[search] = sumY / ndFloat32(posit.GetCount());
+		memory[search] = fluid->GetWorkingMemory();
+		EXPECT_LT(CalculateMaxDensityError(fluid), 0.2f);
+		world.CleanUp();
+	}
+	EXPECT_NEAR(meanY[0], meanY[1], 0.05f);
+	EXPECT_LT(memory[1], memory[0]);
+}
+
+/* A clump denser than the pair list bucket must conserve momentum with the cell list. */
+TEST(BodySphFluid, CellListNoNeighborLimit)
+{
+	ndWorld world;
+	world.SetThreadCount(4);
+	ndBodySphFluid* const fluid = AddFluidBlock(world, 1, 1);
+	fluid->SetGravity(ndVector::m_zero);
+	fluid->SetNeighborSearch(ndBodySphFluid::m_cellList);
+
+	// 125 particles packed inside a single smoothing length, slightly jittered
+	ndArray<ndVector>& posit = fluid->GetPositions();
+	ndArray<ndVector>& veloc = fluid->GetVelocity();
+	posit.SetCount(0);
+	veloc.SetCount(0);
+	for (ndInt32 z = 0; z < 5; ++z)
+	{
+		for (ndInt32 y = 0; y < 5; ++y)
+		{
+			for (ndInt32 x = 0; x < 5; ++x)
+			{
+				posit.PushBack(ndVector(ndFloat32(x) * 0.03f + ndFloat32(y) * 0.001f, 5.0f + ndFloat32(y) * 0.03f, ndFloat32(z) * 0.03f + ndFloat32(x) * 0.0013f, 0.0f));
+				veloc.PushBack(ndVector::m_zero);
+			}
+		}
+	}
+
+	Simulate(world, 3);
+
+	ndVector momentum(ndVector::m_zero);
+	ndFloat32 speed = 0.0f;
+	for (ndInt32 i = 0; i < veloc.GetCount(); ++i)
+	{
+		momentum += veloc[i];
+		speed += ndSqrt(veloc[i].DotProduct(veloc[i] & ndVector::m_triplexMask).GetScalar());
+	}
+	// the clump must expand, but the pair forces must cancel
+	EXPECT_GT(speed, 1.0f);
+	EXPECT_LT(ndSqrt(momentum.DotProduct(momentum & ndVector::m_triplexMask).GetScalar()), 1.0e-3f * speed);
+	world.CleanUp();
+}
+
+/* A background update must overlap the rigid step and give the same result as a blocking update. */
+TEST(BodySphFluid, BackgroundUpdateMatchesBlocking)
+{
+	ndVector boxPosit[2];
+	ndArray<ndVector> posit[2];
+	for (ndInt32 i = 0; i < 2; ++i)
+	{
+		ndWorld world;
+		world.SetThreadCount(2);
+		world.SetParticleThreadCount(2);
+		EXPECT_GE(world.GetParticleThreadCount(), 1);
+
+		AddTank(world, 0.8f);
+		ndBodySphFluid* const fluid = AddFluidBlock(world, 8, 6);
+		fluid->SetAsynUpdate(i ? true : false);
+		ndBodyKinematic* const box = AddBox(world, ndVector(0.35f, 2.0f, 0.35f, 1.0f), ndVector(0.3f, 0.3f, 0.3f, 0.0f), 300.0f * 0.3f * 0.3f * 0.3f);
+
+		ndArray<ndVector> renderPosit;
+		for (ndInt32 j = 0; j < 40; ++j)
+		{
+			world.Update(1.0f / 60.0f);
+			world.Sync();
+
+			// the published positions are the ones of the completed frame
+			EXPECT_EQ(fluid->GetRenderPositions(renderPosit), ndUnsigned32(j + 1));
+			ASSERT_EQ(renderPosit.GetCount(), fluid->GetPositions().GetCount());
+			EXPECT_EQ(renderPosit[0].m_y, fluid->GetPositions()[0].m_y);
+		}
+
+		boxPosit[i] = box->GetMatrix().m_posit;
+		posit[i].SetCount(fluid->GetPositions().GetCount());
+		for (ndInt32 j = 0; j < posit[i].GetCount(); ++j)
+		{
+			posit[i][j] = fluid->GetPositions()[j];
+		}
+		world.CleanUp();
+	}
+
+	EXPECT_NEAR(boxPosit[0].m_y, boxPosit[1].m_y, 1.0e-4f);
+	ASSERT_EQ(posit[0].GetCount(), posit[1].GetCount());
+	for (ndInt32 i = 0; i < posit[0].GetCount(); ++i)
+	{
+		EXPECT_NEAR(posit[0][i].m_x, posit[1][i].m_x, 1.0e-4f);
+		EXPECT_NEAR(posit[0][i].m_y, posit[1][i].m_y, 1.0e-4f);
+		EXPECT_NEAR(posit[0][i].m_z, posit[1][i].m_z, 1.0e-4f);
+	}
+}
+
+/* The cell list sorts the particles into cell order, the application must still see them at their own index. */
+TEST(BodySphFluid, CellListKeepsParticleOrder)
+{
+	ndWorld world;
+	world.SetThreadCount(4);
+	ndBodySphFluid* const fluid = AddFluidBlock(world, 8, 8);
+	fluid->SetNeighborSearch(ndBodySphFluid::m_cellList);
+
+	const ndArray<ndVector>& posit = fluid->GetPositions();
+	ndArray<ndVector> posit0;
+	for (ndInt32 i = 0; i < posit.GetCount(); ++i)
+	{
+		posit0.PushBack(posit[i]);
+	}
+
+	Simulate(world, 3);
+
+	// in three steps no particle moves sideways more than a fraction of the spacing
+	for (ndInt32 i = 0; i < posit.GetCount(); ++i)
+	{
+		const ndVector step(posit[i] - posit0[i]);
+		EXPECT_LT(ndAbs(step.m_x), 0.025f);
+		EXPECT_LT(ndAbs(step.m_z), 0.025f);
+	}
+	world.CleanUp();
+}
@@ -0,0 +1,90 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include <cstdio>
+#include "ndNewton.h"
+#include "ndBrainInc.h"
+#include <gtest/gtest.h>
+
+static ndFloat64 ReferenceActivation(ndBrainActivationType type, ndFloat64 x)
+{
+	switch (type)
+	{
+		case m_relu:
+			return (x > 0.0) ? x : 0.0;
+		case m_lineal:
+			return x;
+		case m_tanh:
+			return tanh(x);
+		case m_sigmoid:
+			return 1.0 / (1.0 + exp(-x));
+		case m_leakyRelu:
+			return (x > 0.0) ? x : x * D_BRAIN_LEAKY_RELU_SLOPE;
+		case m_elu:
+			return (x > 0.0) ? x : exp(x) - 1.0;
+		case m_softplus:
+			return log(1.0 + exp(x));
+		default:
+			return 0.0;
+	}
+}
+
+/* The fast activations must match the libm versions, and the derivatives must match finite differences. */
+TEST(BrainActivation, MatchesReference)
+{
+	const ndBrainActivationType types[] = { m_relu, m_lineal, m_tanh, m_sigmoid, m_leakyRelu, m_elu, m_softplus };
+	const ndInt32 count = 400;
+	for (ndInt32 i = 0; i < ndInt32(sizeof(types) / sizeof(types[0])); ++i)
+	{
+		ndBrainLayer layer(1, count, types[i]);
+		ndBrainVector input;
+		ndBrainVector output;
+		ndBrainVector derivative;
+		input.SetCount(count);
+		output.SetCount(count);
+		derivative.SetCount(count);
+		for (ndInt32 j = 0; j < count; ++j)
+		{
+			// skip zero, where relu has no derivative
+			input[j] = ndReal(-10.0f) + ndReal(20.0f) * (ndReal(j) + ndReal(0.5f)) / ndReal(count);
+		}
+
+		output.Set(input);
+		layer.ApplyActivation(output);
+		layer.ActivationDerivative(output, derivative);
+		for (ndInt32 j = 0; j < count; ++j)
+		{
+			const ndFloat64 x = input[j];
+			const ndFloat64 step = 1.0e-3;
+			const ndFloat64 slope = (ReferenceActivation(types[i], x + step) - ReferenceActivation(types[i], x - step)) / (2.0 * step);
+			EXPECT_NEAR(output[j], ReferenceActivation(types[i], x), 1.0e-5 * (1.0 + fabs(x)));
+			EXPECT_NEAR(derivative[j], slope, 1.0e-3);
+		}
+	}
+}
+
+/* Softmax must stay finite and sum to one for large inputs. */
+TEST(BrainActivation, SoftmaxLargeInputs)
+{
+	ndBrainLayer layer(1, 4, m_softmax);
+	ndBrainVector output;
+	output.SetCount(4);
+	output[0] = ndReal(200.0f);
+	output[1] = ndReal(199.0f);
+	output[2] = ndReal(-300.0f);
+	output[3] = ndReal(100.0f);
+	layer.ApplyActivation(output);
+
+	const ndFloat64 e = exp(-1.0);
+	EXPECT_NEAR(output[0], 1.0 / (1.0 + e), 1.0e-5);
+	EXPECT_NEAR(output[1], e / (1.0 + e), 1.0e-5);
+	EXPECT_NEAR(output[0] + output[1] + output[2] + output[3], 1.0f, 1.0e-5f);
+}
@@ -0,0 +1,224 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include <cstdio>
+#include "ndNewton.h"
+#include "ndBrainInc.h"
+#include <gtest/gtest.h>
+
+static void BuildBrain(ndBrain& brain, ndInt32 inputs, ndInt32 outputs)
+{
+	ndBrainLayer* const inputLayer = new ndBrainLayer(inputs, 37, m_tanh);
+	ndBrainLayer* const hiddenLayer = new ndBrainLayer(inputLayer->GetOuputSize(), 21, m_relu);
+	ndBrainLayer* const ouputLayer = new ndBrainLayer(hiddenLayer->GetOuputSize(), outputs, m_sigmoid);
+
+	brain.BeginAddLayer();
+	brain.AddLayer(inputLayer);
+	brain.AddLayer(hiddenLayer);
+	brain.AddLayer(ouputLayer);
+	brain.EndAddLayer();
+	brain.InitGaussianWeights(0.0f, 0.25f);
+}
+
+static void RandomFill(ndBrainMatrix& matrix)
+{
+	for (ndInt32 i = 0; i < matrix.GetRows(); ++i)
+	{
+		for (ndInt32 j = 0; j < matrix.GetColumns(); ++j)
+		{
+			matrix[i][j] = ndReal(ndGaussianRandom(0.5f, 0.25f));
+		}
+	}
+}
+
+/* A minibatch prediction must match predicting the samples one at a time. */
+TEST(BrainBatch, PredictionMatchesSingleSample)
+{
+	ndSetRandSeed(12345);
+	ndBrain brain;
+	BuildBrain(brain, 300, 5);
+
+	const ndInt32 samples = 83;
+	ndBrainMatrix input(samples, brain.GetInputSize());
+	ndBrainMatrix output(samples, brain.GetOutputSize());
+	ndBrainMatrix parallelOutput(samples, brain.GetOutputSize());
+	RandomFill(input);
+
+	ndWorld world;
+	world.SetThreadCount(4);
+	ndThreadPool& threadPool = *world.GetScene();
+
+	ndBrainInstance instance(&brain);
+	instance.MakePrediction(input, output);
+
+	// the worker threads only pick up jobs between Begin and End
+	threadPool.Begin();
+	instance.MakePrediction(threadPool, input, parallelOutput);
+	threadPool.End();
+
+	ndBrainVector sampleOutput;
+	for (ndInt32 i = 0; i < samples; ++i)
+	{
+		instance.MakePrediction(input[i], sampleOutput);
+		for (ndInt32 j = 0; j < sampleOutput.GetCount(); ++j)
+		{
+			EXPECT_NEAR(output[i][j], sampleOutput[j], 1.0e-6f);
+			EXPECT_NEAR(parallelOutput[i][j], sampleOutput[j], 1.0e-6f);
+		}
+	}
+	world.CleanUp();
+}
+
+/* Training a minibatch must produce the same weights as back propagating one sample at a time. */
+TEST(BrainBatch, BackPropagateMatchesSingleSample)
+{
+	ndSetRandSeed(12345);
+	ndBrain brain0;
+	BuildBrain(brain0, 10, 3);
+	ndBrain brain1(brain0);
+
+	const ndInt32 samples = 22;
+	ndBrainMatrix input(samples, brain0.GetInputSize());
+	ndBrainMatrix truth(samples, brain0.GetOutputSize());
+	RandomFill(input);
+	RandomFill(truth);
+
+	ndBrainTrainer trainer0(&brain0);
+	ndBrainTrainer trainer1(&brain1);
+	for (ndInt32 i = 0; i < samples; ++i)
+	{
+		trainer0.MakePrediction(input[i]);
+		trainer0.BackPropagate(truth[i]);
+	}
+	trainer0.UpdateWeights(1.0e-2f, samples);
+
+	trainer1.MakePrediction(input);
+	trainer1.BackPropagate(input, truth);
+	trainer1.UpdateWeights(1.0e-2f, samples);
+
+	for (ndInt32 i = 0; i < brain0.GetCount(); ++i)
+	{
+		const ndBrainLayer& layer0 = *brain0[i];
+		const ndBrainLayer& layer1 = *brain1[i];
+		for (ndInt32 j = 0; j < layer0.GetOuputSize(); ++j)
+		{
+			EXPECT_NEAR(layer0.GetBias()[j], layer1.GetBias()[j], 1.0e-5f);
+			for (ndInt32 k = 0; k < layer0.GetInputSize(); ++k)
+			{
+				EXPECT_NEAR(layer0[j][k], layer1[j][k], 1.0e-5f);
+			}
+		}
+	}
+}
+
+/* The inference server must return the same actions as evaluating each agent on its own. */
+TEST(BrainBatch, InferenceServerMatchesSingleSample)
+{
+	ndSetRandSeed(12345);
+	ndBrain brain0;
+	ndBrain brain1;
+	BuildBrain(brain0, 12, 4);
+	BuildBrain(brain1, 7, 2);
+
+	const ndInt32 agents = 57;
+	ndBrainMatrix input0(agents, brain0.GetInputSize());
+	ndBrainMatrix input1(agents, brain1.GetInputSize());
+	ndBrainMatrix output0(agents, brain0.GetOutputSize());
+	ndBrainMatrix output1(agents, brain1.GetOutputSize());
+	RandomFill(input0);
+	RandomFill(input1);
+
+	ndWorld world;
+	world.SetThreadCount(4);
+
+	ndBrainInferenceServer server;
+	for (ndInt32 frame = 0; frame < 2; ++frame)
+	{
+		// the agents of the two networks are interleaved, and the second frame has fewer of them
+		const ndInt32 count = agents - frame * 20;
+		for (ndInt32 i = 0; i < count; ++i)
+		{
+			server.AddRequest(&brain0, input0[i], output0[i]);
+			server.AddRequest(&brain1, input1[i], output1[i]);
+		}
+		EXPECT_EQ(server.GetRequestCount(), count * 2);
+		if (frame)
+		{
+			ndThreadPool& threadPool = *world.GetScene();
+			threadPool.Begin();
+			server.Execute(threadPool);
+			threadPool.End();
+		}
+		else
+		{
+			server.Execute();
+		}
+		EXPECT_EQ(server.GetRequestCount(), 0);
+
+		ndBrainVector output;
+		ndBrainInstance instance0(&brain0);
+		ndBrainInstance instance1(&brain1);
+		for (ndInt32 i = 0; i < count; ++i)
+		{
+			instance0.MakePrediction(input0[i], output);
+			for (ndInt32 j = 0; j < output.GetCount(); ++j)
+			{
+				EXPECT_NEAR(output0[i][j], output[j], 1.0e-5f);
+			}
+			instance1.MakePrediction(input1[i], output);
+			for (ndInt32 j = 0; j < output.GetCount(); ++j)
+			{
+				EXPECT_NEAR(output1[i][j], output[j], 1.0e-5f);
+			}
+		}
+	}
+	world.CleanUp();
+}
+
+/* Splitting the minibatches across threads must train the same network as the serial trainer. */
+TEST(BrainBatch, ParallelTrainerMatchesSerial)
+{
+	ndSetRandSeed(12345);
+	ndBrain brain0;
+	BuildBrain(brain0, 6, 2);
+	ndBrain brain1(brain0);
+
+	const ndInt32 samples = 203;
+	ndBrainMatrix input(samples, brain0.GetInputSize());
+	ndBrainMatrix truth(samples, brain0.GetOutputSize());
+	RandomFill(input);
+	RandomFill(truth);
+
+	ndBrainTrainer trainer0(&brain0);
+	ndBrainTrainer::ndValidation validator0(trainer0);
+	trainer0.SetMiniBatchSize(32);
+	trainer0.Optimize(validator0, input, truth, 1.0e-3f, 1);
+
+	ndBrainParallelTrainer trainer1(&brain1, 4);
+	ndBrainTrainer::ndValidation validator1(trainer1);
+	trainer1.SetMiniBatchSize(32);
+	trainer1.Optimize(validator1, input, truth, 1.0e-3f, 1);
+	EXPECT_GT(trainer1.GetSamplesPerSecond(), 0.0f);
+
+	for (ndInt32 i = 0; i < brain0.GetCount(); ++i)
+	{
+		const ndBrainLayer& layer0 = *brain0[i];
+		const ndBrainLayer& layer1 = *brain1[i];
+		for (ndInt32 j = 0; j < layer0.GetOuputSize(); ++j)
+		{
+			EXPECT_NEAR(layer0.GetBias()[j], layer1.GetBias()[j], 1.0e-4f);
+			for (ndInt32 k = 0; k < layer0.GetInputSize(); ++k)
+			{
+				EXPECT_NEAR(layer0[j][k], layer1[j][k], 1.0e-4f);
+			}
+		}
+	}
+}
@@ -0,0 +1,146 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include <cstdio>
+#include <string>
+#include "ndNewton.h"
+#include "ndBrainInc.h"
+#include <gtest/gtest.h>
+
+static void BuildBrain(ndBrain& brain, ndInt32 inputs, ndInt32 outputs)
+{
+	ndBrainLayer* const inputLayer = new ndBrainLayer(inputs, 45, m_tanh);
+	ndBrainLayer* const hiddenLayer = new ndBrainLayer(inputLayer->GetOuputSize(), 29, m_relu);
+	ndBrainLayer* const ouputLayer = new ndBrainLayer(hiddenLayer->GetOuputSize(), outputs, m_sigmoid);
+
+	brain.BeginAddLayer();
+	brain.AddLayer(inputLayer);
+	brain.AddLayer(hiddenLayer);
+	brain.AddLayer(ouputLayer);
+	brain.EndAddLayer();
+	brain.InitGaussianWeights(0.0f, 0.25f);
+}
+
+static void RandomFill(ndBrainMatrix& matrix)
+{
+	for (ndInt32 i = 0; i < matrix.GetRows(); ++i)
+	{
+		for (ndInt32 j = 0; j < matrix.GetColumns(); ++j)
+		{
+			matrix[i][j] = ndReal(ndGaussianRandom(0.0f, 1.0f));
+		}
+	}
+}
+
+/* A brain loaded from the binary format must predict exactly like the original. */
+TEST(BrainModel, BinaryRoundTrip)
+{
+	ndSetRandSeed(777);
+	ndBrain brain;
+	BuildBrain(brain, 19, 7);
+
+	ndArray<ndUnsigned8> buffer;
+	brain.Save(buffer);
+
+	// the file goes to the temp folder, and is removed before any check can bail out
+	const std::string path(testing::TempDir() + "brainModel_test.bin");
+	const bool saved = brain.Save(path.c_str());
+	ndBrain fileBrain;
+	const bool loaded = saved && fileBrain.Load(path.c_str());
+	remove(path.c_str());
+	ASSERT_TRUE(saved);
+	ASSERT_TRUE(loaded);
+
+	ndBrain bufferBrain;
+	ASSERT_TRUE(bufferBrain.Load(&buffer[0], buffer.GetCount()));
+	EXPECT_TRUE(bufferBrain.Compare(brain));
+
+	ndBrainMatrix input(16, brain.GetInputSize());
+	RandomFill(input);
+	ndBrainInstance instance(&brain);
+	ndBrainInstance fileInstance(&fileBrain);
+	ndBrainVector output;
+	ndBrainVector fileOutput;
+	for (ndInt32 i = 0; i < input.GetRows(); ++i)
+	{
+		instance.MakePrediction(input[i], output);
+		fileInstance.MakePrediction(input[i], fileOutput);
+		for (ndInt32 j = 0; j < output.GetCount(); ++j)
+		{
+			EXPECT_EQ(output[j], fileOutput[j]);
+		}
+	}
+
+	// a flipped bit in the weights must fail the checksum
+	buffer[buffer.GetCount() - 64] ^= 1;
+	ndBrain corruptBrain;
+	EXPECT_FALSE(corruptBrain.Load(&buffer[0], buffer.GetCount()));
+}
+
+/* A layer offset near the top of the address range must not wrap the bounds check. */
+TEST(BrainModel, RejectsWrappedLayerOffset)
+{
+	ndSetRandSeed(779);
+	ndBrain brain;
+	BuildBrain(brain, 19, 7);
+	ndArray<ndUnsigned8> buffer;
+	brain.Save(buffer);
+
+	// the header is 32 bytes with the checksum last, followed by the 24 byte
+	// layer table entries with the weights offset last
+	const ndInt32 headerSize = 32;
+	const ndInt32 checksumOffset = 24;
+	const ndInt32 layerOffset = headerSize + 16;
+	const ndUnsigned64 offset = ~ndUnsigned64(0) - 63;
+	memcpy(&buffer[layerOffset], &offset, sizeof(offset));
+	const ndUnsigned64 checksum = dCRC64(&buffer[headerSize], ndInt32(buffer.GetCount() - headerSize), 0);
+	memcpy(&buffer[checksumOffset], &checksum, sizeof(checksum));
+
+	ndBrain corruptBrain;
+	EXPECT_FALSE(corruptBrain.Load(&buffer[0], buffer.GetCount()));
+}
+
+/* The int8 quantized model must stay close to the float model. */
+TEST(BrainModel, QuantizedPredictionMatchesFloat)
+{
+	ndSetRandSeed(778);
+	ndBrain brain;
+	BuildBrain(brain, 64, 10);
+
+	const ndInt32 samples = 100;
+	ndBrainMatrix input(samples, brain.GetInputSize());
+	ndBrainMatrix output(samples, brain.GetOutputSize());
+	ndBrainMatrix parallelOutput(samples, brain.GetOutputSize());
+	RandomFill(input);
+
+	ndBrainQuantizedInstance quantized(&brain);
+	quantized.MakePrediction(input, output);
+
+	ndWorld world;
+	world.SetThreadCount(4);
+	ndThreadPool& threadPool = *world.GetScene();
+	threadPool.Begin();
+	quantized.MakePrediction(threadPool, input, parallelOutput);
+	threadPool.End();
+
+	ndBrainInstance instance(&brain);
+	ndBrainVector floatOutput;
+	for (ndInt32 i = 0; i < samples; ++i)
+	{
+		instance.MakePrediction(input[i], floatOutput);
+		for (ndInt32 j = 0; j < floatOutput.GetCount(); ++j)
+		{
+			EXPECT_NEAR(output[i][j], floatOutput[j], 2.0e-2f);
+			EXPECT_EQ(output[i][j], parallelOutput[i][j]);
+		}
+	}
+	world.CleanUp();
+}
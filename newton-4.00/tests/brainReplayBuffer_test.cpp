@@ -0,0 +1,124 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include <cstdio>
+#include "ndNewton.h"
+#include "ndBrainInc.h"
+#include <gtest/gtest.h>
+
+#define STATE_SIZE	5
+#define ACTION_SIZE	3
+
+static void MakeTransition(ndBrainReiforcementTransition& transition, ndInt32 id)
+{
+	transition.m_state.SetCount(STATE_SIZE);
+	transition.m_action.SetCount(ACTION_SIZE);
+	transition.m_nextState.SetCount(STATE_SIZE);
+	transition.m_state.Set(ndReal(id));
+	transition.m_action.Set(ndReal(2 * id));
+	transition.m_nextState.Set(ndReal(id) + ndReal(0.5f));
+	transition.m_reward = ndReal(id);
+	transition.m_terminalState = (id & 1) ? true : false;
+}
+
+/* Transitions added from many threads must all be stored, and batches must alias them. */
+TEST(BrainReplayBuffer, ConcurrentInsertion)
+{
+	const ndInt32 perThread = 200;
+	const ndInt32 threadCount = 4;
+	ndBrainReplayBuffer buffer;
+	buffer.SetCount(1000, 64, STATE_SIZE, ACTION_SIZE);
+
+	ndWorld world;
+	world.SetThreadCount(threadCount);
+	auto AddTransitions = ndMakeObject::ndFunction([&buffer, perThread](ndInt32 threadIndex, ndInt32)
+	{
+		ndBrainReiforcementTransition transition;
+		for (ndInt32 i = 0; i < perThread; ++i)
+		{
+			MakeTransition(transition, threadIndex * perThread + i);
+			buffer.AddTransition(transition);
+		}
+	});
+	ndThreadPool& threadPool = *world.GetScene();
+	threadPool.Begin();
+	threadPool.ParallelExecute(AddTransitions);
+	threadPool.End();
+	const ndInt32 count = world.GetThreadCount() * perThread;
+	ASSERT_EQ(buffer.GetCount(), count);
+
+	buffer.MakeRandomBatch();
+	ndArray<ndInt32> histogram;
+	histogram.SetCount(count);
+	for (ndInt32 i = 0; i < count; ++i)
+	{
+		histogram[i] = 0;
+	}
+	for (ndInt32 i = 0; i < buffer.m_learnBatchSize; ++i)
+	{
+		const ndInt32 id = ndInt32(buffer.m_inputBatch[i][0]);
+		ASSERT_TRUE((id >= 0) && (id < count));
+		histogram[id]++;
+		EXPECT_EQ(buffer.m_inputBatch[i][STATE_SIZE - 1], ndReal(id));
+		EXPECT_EQ(buffer.m_outputBatch[i][0], ndReal(2 * id));
+		EXPECT_EQ(buffer.m_nextInputBatch[i][0], ndReal(id) + ndReal(0.5f));
+		EXPECT_EQ(buffer.n_rewardBatch[i], ndReal(id));
+		EXPECT_EQ(buffer.n_terminalBatch[i], (id & 1) ? ndReal(0.0f) : ndReal(1.0f));
+	}
+
+	// uniform batches are drawn without replacement
+	for (ndInt32 i = 0; i < count; ++i)
+	{
+		EXPECT_LE(histogram[i], 1);
+	}
+	world.CleanUp();
+}
+
+/* Prioritized sampling must favor the transition with the largest error. */
+TEST(BrainReplayBuffer, PrioritizedSampling)
+{
+	ndSetRandSeed(4321);
+	const ndInt32 count = 64;
+	const ndInt32 target = 7;
+	ndBrainReplayBuffer buffer;
+	buffer.SetCount(128, 16, STATE_SIZE, ACTION_SIZE);
+	buffer.SetPrioritizedSampling(ndReal(1.0f), ndReal(1.0f));
+
+	ndBrainReiforcementTransition transition;
+	for (ndInt32 i = 0; i < count; ++i)
+	{
+		MakeTransition(transition, i);
+		buffer.AddTransition(transition);
+	}
+
+	ndBrainVector errors;
+	errors.SetCount(buffer.m_learnBatchSize);
+	ndInt32 hits = 0;
+	ndInt32 samples = 0;
+	for (ndInt32 pass = 0; pass < 100; ++pass)
+	{
+		buffer.MakeRandomBatch();
+		for (ndInt32 i = 0; i < buffer.m_learnBatchSize; ++i)
+		{
+			const ndInt32 id = ndInt32(buffer.m_inputBatch[i][0]);
+			errors[i] = (id == target) ? ndReal(100.0f) : ndReal(0.0f);
+			EXPECT_GT(buffer.m_weightBatch[i], ndReal(0.0f));
+			EXPECT_LE(buffer.m_weightBatch[i], ndReal(1.0f));
+			if (pass >= 50)
+			{
+				hits += (id == target) ? 1 : 0;
+				samples++;
+			}
+		}
+		buffer.UpdatePriorities(errors);
+	}
+	EXPECT_GT(hits, samples * 9 / 10);
+}
@@ -0,0 +1,141 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include <cstdio>
+#include "ndNewton.h"
+#include "ndBrainInc.h"
+#include <gtest/gtest.h>
+
+#define TIMESTEP	ndFloat32(0.1f)
+
+class ndPointEnvironment: public ndBrainRollout::ndEnvironment
+{
+	public:
+	ndPointEnvironment(ndInt32 id)
+		:ndBrainRollout::ndEnvironment()
+		,m_position(0.0f)
+		,m_velocity(0.0f)
+		,m_steps(0)
+		,m_id(id)
+	{
+		Reset();
+	}
+
+	void GetObservation(ndBrainVector& observation) const
+	{
+		observation[0] = m_position;
+		observation[1] = ndReal(m_steps);
+	}
+
+	void ApplyAction(ndBrainVector& action)
+	{
+		m_velocity = action[0];
+	}
+
+	void Step(ndFloat32 timestep)
+	{
+		m_position += m_velocity * ndReal(timestep);
+		m_steps++;
+	}
+
+	ndReal GetReward() const
+	{
+		return -ndAbs(m_position);
+	}
+
+	bool IsTerminal() const
+	{
+		return m_steps >= (5 + m_id % 3);
+	}
+
+	void Reset()
+	{
+		m_position = ndReal(m_id);
+		m_steps = 0;
+	}
+
+	ndReal m_position;
+	ndReal m_velocity;
+	ndInt32 m_steps;
+	ndInt32 m_id;
+};
+
+static void BuildPolicy(ndBrain& brain)
+{
+	ndBrainLayer* const inputLayer = new ndBrainLayer(2, 16, m_tanh);
+	ndBrainLayer* const ouputLayer = new ndBrainLayer(inputLayer->GetOuputSize(), 1, m_tanh);
+
+	brain.BeginAddLayer();
+	brain.AddLayer(inputLayer);
+	brain.AddLayer(ouputLayer);
+	brain.EndAddLayer();
+	brain.InitGaussianWeights(0.0f, 0.25f);
+}
+
+/* A threaded rollout must step the environments like the serial one, and record every step. */
+TEST(BrainRollout, ParallelMatchesSerial)
+{
+	ndSetRandSeed(2023);
+	ndBrain brain;
+	BuildPolicy(brain);
+
+	const ndInt32 environmentCount = 37;
+	const ndInt32 steps = 20;
+	ndBrainReplayBuffer replayBuffer;
+	replayBuffer.SetCount(2 * environmentCount * steps, 64, brain.GetInputSize(), brain.GetOutputSize());
+
+	ndArray<ndPointEnvironment*> serialEnvironments;
+	ndArray<ndPointEnvironment*> parallelEnvironments;
+	ndBrainRollout serialRollout(&brain, &replayBuffer);
+	ndBrainRollout parallelRollout(&brain, &replayBuffer);
+	for (ndInt32 i = 0; i < environmentCount; ++i)
+	{
+		serialEnvironments.PushBack(new ndPointEnvironment(i));
+		parallelEnvironments.PushBack(new ndPointEnvironment(i));
+		serialRollout.AddEnvironment(serialEnvironments[i]);
+		parallelRollout.AddEnvironment(parallelEnvironments[i]);
+	}
+
+	// the worker threads only pick up jobs between Begin and End
+	ndWorld world;
+	world.SetThreadCount(4);
+	ndThreadPool& threadPool = *world.GetScene();
+	threadPool.Begin();
+	for (ndInt32 i = 0; i < steps; ++i)
+	{
+		serialRollout.Step(TIMESTEP);
+		parallelRollout.Step(threadPool, TIMESTEP);
+	}
+	threadPool.End();
+	EXPECT_EQ(serialRollout.GetStepCount(), ndUnsigned64(environmentCount * steps));
+	EXPECT_EQ(parallelRollout.GetStepCount(), ndUnsigned64(environmentCount * steps));
+	EXPECT_EQ(replayBuffer.GetCount(), 2 * environmentCount * steps);
+
+	for (ndInt32 i = 0; i < environmentCount; ++i)
+	{
+		EXPECT_EQ(serialEnvironments[i]->m_steps, parallelEnvironments[i]->m_steps);
+		EXPECT_NEAR(serialEnvironments[i]->m_position, parallelEnvironments[i]->m_position, 1.0e-6f);
+		delete serialEnvironments[i];
+		delete parallelEnvironments[i];
+	}
+
+	// the next state of each transition is one integration step from its state
+	replayBuffer.MakeRandomBatch();
+	for (ndInt32 i = 0; i < replayBuffer.m_learnBatchSize; ++i)
+	{
+		const ndBrainVector& state = replayBuffer.m_inputBatch[i];
+		const ndBrainVector& nextState = replayBuffer.m_nextInputBatch[i];
+		const ndBrainVector& action = replayBuffer.m_outputBatch[i];
+		EXPECT_NEAR(nextState[0], state[0] + action[0] * TIMESTEP, 1.0e-5f);
+		EXPECT_EQ(nextState[1], state[1] + ndReal(1.0f));
+	}
+	world.CleanUp();
+}
@@ -0,0 +1,197 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include <vector>
+#include <algorithm>
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+
+// a blob of particles, a solid box with some random particles around it
+static void BuildPointCloud(ndArray<ndVector>& points, ndFloat32 spacing)
+{
+	ndSetRandSeed(17);
+	for (ndInt32 z = 0; z < 12; ++z)
+	{
+		for (ndInt32 y = 0; y < 8; ++y)
+		{
+			for (ndInt32 x = 0; x < 12; ++x)
+			{
+				points.PushBack(ndVector(ndFloat32(x) * spacing, ndFloat32(y) * spacing, ndFloat32(z) * spacing, ndFloat32(0.0f)));
+			}
+		}
+	}
+	for (ndInt32 i = 0; i < 200; ++i)
+	{
+		points.PushBack(ndVector(ndRand() * 16.0f * spacing, ndRand() * 12.0f * spacing, ndRand() * 16.0f * spacing, ndFloat32(0.0f)));
+	}
+}
+
+static void ExpectSameMesh(const ndIsoSurface& surface0, const ndIsoSurface& surface1)
+{
+	const ndArray<ndVector>& points0 = surface0.GetPoints();
+	const ndArray<ndVector>& points1 = surface1.GetPoints();
+	ASSERT_EQ(points0.GetCount(), points1.GetCount());
+	for (ndInt32 i = 0; i < points0.GetCount(); ++i)
+	{
+		const ndVector p0(surface0.GetOrigin() + points0[i]);
+		const ndVector p1(surface1.GetOrigin() + points1[i]);
+		EXPECT_NEAR(p0.m_x, p1.m_x, 1.0e-4f);
+		EXPECT_NEAR(p0.m_y, p1.m_y, 1.0e-4f);
+		EXPECT_NEAR(p0.m_z, p1.m_z, 1.0e-4f);
+	}
+}
+
+/* The index list must weld the triangle list into a closed surface. */
+TEST(IsoSurface, IndexListWeldsTriangles)
+{
+	const ndFloat32 spacing = 0.1f;
+	ndArray<ndVector> cloud;
+	BuildPointCloud(cloud, spacing);
+
+	ndIsoSurface surface;
+	surface.GenerateMesh(cloud, spacing);
+	const ndArray<ndVector>& points = surface.GetPoints();
+	ASSERT_GT(points.GetCount(), 0);
+
+	const ndInt32 stride = 6;
+	ndArray<ndInt32> indexList;
+	ndArray<ndReal> vertex;
+	indexList.SetCount(points.GetCount());
+	vertex.SetCount(points.GetCount() * stride);
+	const ndInt32 vertexCount = surface.GenerateListIndexList(&indexList[0], stride, &vertex[0], &vertex[3]);
+
+	// each triangle corner must land on its vertex, and each vertex must be unique
+	ndInt32 referenced = 0;
+	ndArray<ndInt32> useCount;
+	useCount.SetCount(vertexCount);
+	for (ndInt32 i = 0; i < vertexCount; ++i)
+	{
+		useCount[i] = 0;
+	}
+	for (ndInt32 i = 0; i < points.GetCount(); ++i)
+	{
+		const ndInt32 index = indexList[i];
+		ASSERT_GE(index, 0);
+		ASSERT_LT(index, vertexCount);
+		EXPECT_NEAR(vertex[index * stride + 0], points[i].m_x, 1.0e-5f);
+		EXPECT_NEAR(vertex[index * stride + 1], points[i].m_y, 1.0e-5f);
+		EXPECT_NEAR(vertex[index * stride + 2], points[i].m_z, 1.0e-5f);
+		referenced += useCount[index] ? 0 : 1;
+		useCount[index]++;
+	}
+	EXPECT_EQ(referenced, vertexCount);
+
+	// a closed surface shares each edge between exactly two triangles
+	std::vector<ndUnsigned64> edges;
+	for (ndInt32 i = 0; i < points.GetCount(); i += 3)
+	{
+		for (ndInt32 j = 0; j < 3; ++j)
+		{
+			const ndUnsigned64 i0 = ndUnsigned64(indexList[i + j]);
+			const ndUnsigned64 i1 = ndUnsigned64(indexList[i + (j + 1) % 3]);
+			edges.push_back((ndMin(i0, i1) << 32) | ndMax(i0, i1));
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	for (size_t i = 0; i < edges.size(); i += 2)
+	{
+		ASSERT_EQ(edges[i], edges[i + 1]);
+		ASSERT_TRUE(((i + 2) == edges.size()) || (edges[i + 2] != edges[i]));
+	}
+
+	for (ndInt32 i = 0; i < vertexCount; ++i)
+	{
+		const ndVector n(vertex[i * stride + 3], vertex[i * stride + 4], vertex[i * stride + 5], ndFloat32(0.0f));
+		EXPECT_NEAR(n.DotProduct(n).GetScalar(), 1.0f, 1.0e-3f);
+	}
+}
+
+/* Updating a mesh from the previous frame must give the same mesh as building it again. */
+TEST(IsoSurface, IncrementalMatchesRebuild)
+{
+	const ndFloat32 spacing = 0.1f;
+	ndArray<ndVector> cloud;
+	BuildPointCloud(cloud, spacing);
+
+	ndIsoSurface surface;
+	surface.GenerateMesh(cloud, spacing);
+	EXPECT_GT(surface.GetChangedCellCount(), 0);
+
+	// the same cloud changes nothing
+	const ndInt32 triangleCount = ndInt32(surface.GetPoints().GetCount());
+	surface.GenerateMesh(cloud, spacing);
+	EXPECT_EQ(surface.GetChangedCellCount(), 0);
+	EXPECT_EQ(ndInt32(surface.GetPoints().GetCount()), triangleCount);
+
+	// move some particles around, and drift the whole cloud
+	for (ndInt32 frame = 0; frame < 4; ++frame)
+	{
+		for (ndInt32 i = 0; i < cloud.GetCount(); i += 7)
+		{
+			cloud[i] += ndVector(ndRand() - 0.5f, ndRand() - 0.5f, ndRand() - 0.5f, ndFloat32(0.0f)).Scale(spacing * 3.0f);
+		}
+		for (ndInt32 i = 0; i < cloud.GetCount(); ++i)
+		{
+			cloud[i] += ndVector(spacing * 0.7f, ndFloat32(0.0f), ndFloat32(0.0f), ndFloat32(0.0f));
+		}
+		surface.GenerateMesh(cloud, spacing);
+		EXPECT_GT(surface.GetChangedCellCount(), 0);
+
+		ndIsoSurface rebuild;
+		rebuild.GenerateMesh(cloud, spacing);
+		ExpectSameMesh(surface, rebuild);
+	}
+}
+
+/* The thread pool must produce the same mesh and index list as the serial path. */
+TEST(IsoSurface, ParallelMatchesSerial)
+{
+	const ndFloat32 spacing = 0.1f;
+	ndArray<ndVector> cloud;
+	BuildPointCloud(cloud, spacing);
+
+	ndWorld world;
+	world.SetThreadCount(4);
+	ndThreadPool& threadPool = *world.GetScene();
+
+	ndIsoSurface serial;
+	ndIsoSurface parallel;
+	serial.GenerateMesh(cloud, spacing);
+	threadPool.Begin();
+	parallel.GenerateMesh(cloud, spacing, nullptr, &threadPool);
+	threadPool.End();
+	ExpectSameMesh(serial, parallel);
+
+	const ndInt32 count = ndInt32(serial.GetPoints().GetCount());
+	ndArray<ndInt32> indexList0;
+	ndArray<ndInt32> indexList1;
+	ndArray<ndReal> vertex0;
+	ndArray<ndReal> vertex1;
+	indexList0.SetCount(count);
+	indexList1.SetCount(count);
+	vertex0.SetCount(count * 6);
+	vertex1.SetCount(count * 6);
+
+	const ndInt32 vertexCount0 = serial.GenerateListIndexList(&indexList0[0], 6, &vertex0[0], &vertex0[3]);
+	threadPool.Begin();
+	const ndInt32 vertexCount1 = parallel.GenerateListIndexList(&indexList1[0], 6, &vertex1[0], &vertex1[3], &threadPool);
+	threadPool.End();
+
+	ASSERT_EQ(vertexCount0, vertexCount1);
+	for (ndInt32 i = 0; i < count; ++i)
+	{
+		EXPECT_EQ(indexList0[i], indexList1[i]);
+	}
+	for (ndInt32 i = 0; i < vertexCount0 * 6; ++i)
+	{
+		EXPECT_NEAR(vertex0[i], vertex1[i], 1.0e-5f);
+	}
+}
@@ -0,0 +1,146 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include <cstdio>
+#include "ndNewton.h"
+#include "testWorld.h"
+#include <gtest/gtest.h>
+
+static ndSharedPtr<ndBody> MakeBox(const ndVector& posit, ndFloat32 mass, const ndVector& gravity)
+{
+	ndShapeInstance box(new ndShapeBox(0.5f, 0.5f, 0.5f));
+	ndBodyDynamic* const body = new ndBodyDynamic();
+	if (mass > 0.0f)
+	{
+		body->SetNotifyCallback(new ndBodyNotify(gravity));
+	}
+	ndMatrix matrix(ndGetIdentityMatrix());
+	matrix.m_posit = posit;
+	body->SetMatrix(matrix);
+	body->SetCollisionShape(box);
+	body->SetMassMatrix(mass, box);
+	return ndSharedPtr<ndBody>(body);
+}
+
+// a box with a second box hinged to one side, around the z axis
+static ndModelArticulation* AddModel(ndWorld& world, const ndVector& posit, const ndVector& gravity)
+{
+	ndModelArticulation* const model = new ndModelArticulation();
+	ndSharedPtr<ndBody> root(MakeBox(posit, 1.0f, gravity));
+	ndSharedPtr<ndBody> limb(MakeBox(posit + ndVector(0.6f, 0.0f, 0.0f, 0.0f), 1.0f, gravity));
+
+	ndMatrix pivot(ndYawMatrix(90.0f * ndDegreeToRad));
+	pivot.m_posit = posit + ndVector(0.3f, 0.0f, 0.0f, 0.0f);
+	ndJointHinge* const hinge = new ndJointHinge(pivot, limb->GetAsBodyKinematic(), root->GetAsBodyKinematic());
+	ndSharedPtr<ndJointBilateralConstraint> joint(hinge);
+
+	ndModelArticulation::ndNode* const rootNode = model->AddRootBody(root);
+	model->AddLimb(rootNode, limb, joint);
+
+	ndSharedPtr<ndModel> modelPtr(model);
+	world.AddModel(modelPtr);
+	return model;
+}
+
+/* The batched observation must match reading each body and joint on its own. */
+TEST(ModelArticulationBatch, ObservationMatchesBodies)
+{
+	ndWorld world;
+	world.SetThreadCount(4);
+	const ndVector gravity(0.0f, -10.0f, 0.0f, 0.0f);
+	ndSharedPtr<ndBody> floor(MakeBox(ndVector(0.0f, -0.25f, 0.0f, 1.0f), 0.0f, gravity));
+	floor->GetAsBodyKinematic()->GetCollisionShape().SetScale(ndVector(40.0f, 1.0f, 40.0f, 0.0f));
+	world.AddBody(floor);
+
+	ndModelArticulationBatch batch;
+	for (ndInt32 i = 0; i < 7; ++i)
+	{
+		batch.AddModel(AddModel(world, ndVector(ndFloat32(i) * 2.0f - 6.0f, 0.25f + 0.2f * ndFloat32(i), 0.0f, 1.0f), gravity));
+	}
+	ASSERT_EQ(batch.GetModelCount(), 7);
+	ASSERT_EQ(batch.GetBodyCount(), 14);
+	ASSERT_EQ(batch.GetJointCount(), 7);
+	Simulate(world, 120);
+
+	ndModelArticulationBatch::ndObservation observation;
+	ndModelArticulationBatch::ndObservation parallelObservation;
+	batch.GetObservation(observation);
+	ndThreadPool& threadPool = *world.GetScene();
+	threadPool.Begin();
+	batch.GetObservation(threadPool, parallelObservation);
+	threadPool.End();
+
+	ndInt32 body = 0;
+	for (ndModelList::ndNode* node = world.GetModelList().GetFirst(); node; node = node->GetNext())
+	{
+		ndModelArticulation* const model = node->GetInfo()->GetAsModelArticulation();
+		ndModelArticulation::ndNode* const root = model->GetRoot();
+		ndModelArticulation::ndNode* const limb = root->GetFirstChild();
+		ASSERT_EQ(batch.GetBodyStart(body / 2), body);
+
+		const ndBodyKinematic* const rootBody = root->m_body->GetAsBodyKinematic();
+		const ndBodyKinematic* const limbBody = limb->m_body->GetAsBodyKinematic();
+		EXPECT_EQ(observation.m_posit[1][body], rootBody->GetMatrix().m_posit.m_y);
+		EXPECT_EQ(observation.m_posit[0][body + 1], limbBody->GetMatrix().m_posit.m_x);
+		EXPECT_EQ(observation.m_veloc[1][body + 1], limbBody->GetVelocity().m_y);
+		EXPECT_EQ(observation.m_omega[2][body], rootBody->GetOmega().m_z);
+		EXPECT_EQ(observation.m_rotation[3][body + 1], limbBody->GetRotation().m_w);
+
+		const ndJointHinge* const hinge = (ndJointHinge*)*limb->m_joint;
+		EXPECT_EQ(observation.m_jointAngle[body / 2], hinge->GetAngle());
+		EXPECT_EQ(observation.m_jointOmega[body / 2], hinge->GetOmega());
+
+		// resting on the floor, the contacts carry the weight of the two boxes
+		const ndFloat32 contactForce = observation.m_contactForce[1][body] + observation.m_contactForce[1][body + 1];
+		EXPECT_NEAR(contactForce, 20.0f, 0.5f);
+		body += 2;
+	}
+
+	for (ndInt32 i = 0; i < batch.GetBodyCount(); ++i)
+	{
+		for (ndInt32 j = 0; j < 3; ++j)
+		{
+			EXPECT_EQ(parallelObservation.m_posit[j][i], observation.m_posit[j][i]);
+			EXPECT_EQ(parallelObservation.m_contactForce[j][i], observation.m_contactForce[j][i]);
+		}
+	}
+	world.CleanUp();
+}
+
+/* Joint torques must be applied on every sub step of the update that follows. */
+TEST(ModelArticulationBatch, ApplyTorques)
+{
+	ndWorld world;
+	const ndVector gravity(0.0f, 0.0f, 0.0f, 0.0f);
+	ndModelArticulationBatch* const batch = new ndModelArticulationBatch();
+	batch->AddModel(AddModel(world, ndVector(0.0f, 0.0f, 0.0f, 1.0f), gravity));
+	batch->AddModel(AddModel(world, ndVector(5.0f, 0.0f, 0.0f, 1.0f), gravity));
+	ndSharedPtr<ndModel> batchPtr(batch);
+	world.AddModel(batchPtr);
+
+	ndModelArticulationBatch::ndAction action;
+	action.m_jointTorque.PushBack(1.0f);
+	action.m_jointTorque.PushBack(-1.0f);
+	batch->ApplyActions(action);
+	Simulate(world, 10);
+
+	ndModelArticulationBatch::ndObservation observation;
+	batch->GetObservation(observation);
+	EXPECT_GT(observation.m_jointOmega[0], 0.1f);
+	EXPECT_LT(observation.m_jointOmega[1], -0.1f);
+	EXPECT_NEAR(observation.m_jointOmega[0], -observation.m_jointOmega[1], 1.0e-4f);
+
+	// the pair starts at rest, so the reaction spins the root the other way
+	const ndInt32 root = batch->GetBodyStart(0);
+	const ndInt32 limb = root + 1;
+	EXPECT_LT(observation.m_omega[2][root] * observation.m_omega[2][limb], 0.0f);
+	world.CleanUp();
+}
@@ -0,0 +1,397 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include <vector>
+#include "ndNewton.h"
+#include "testWorld.h"
+#include <gtest/gtest.h>
+
+// a capsule that walks in a circle under gravity
+class ndWalkingCapsule : public ndBodyPlayerCapsule
+{
+	public:
+	ndWalkingCapsule(const ndMatrix& localAxis, const ndMatrix& location, ndFloat32 heading)
+		:ndBodyPlayerCapsule(localAxis, 100.0f, 0.5f, 1.9f, 0.5f)
+		,m_heading(heading)
+	{
+		SetMatrix(location);
+	}
+
+	void ApplyInputs(ndFloat32 timestep)
+	{
+		m_impulse += ndVector(0.0f, -10.0f * m_mass * timestep, 0.0f, 0.0f);
+		m_heading += 0.5f * timestep;
+		SetForwardSpeed(2.0f);
+		SetHeadingAngle(m_heading);
+	}
+
+	ndFloat32 m_heading;
+};
+
+// a capsule that runs straight along the x axis
+class ndRunningCapsule : public ndBodyPlayerCapsule
+{
+	public:
+	ndRunningCapsule(const ndMatrix& localAxis, const ndMatrix& location, ndFloat32 speed)
+		:ndBodyPlayerCapsule(localAxis, 100.0f, 0.5f, 1.9f, 0.5f)
+		,m_speed(speed)
+	{
+		SetMatrix(location);
+	}
+
+	void ApplyInputs(ndFloat32 timestep)
+	{
+		m_impulse += ndVector(0.0f, -10.0f * m_mass * timestep, 0.0f, 0.0f);
+		SetForwardSpeed(m_speed);
+		SetHeadingAngle(0.0f);
+	}
+
+	ndFloat32 m_speed;
+};
+
+// logs the trigger call backs
+class ndLoggingTrigger : public ndBodyTriggerVolume
+{
+	public:
+	void OnTrigger(ndBodyKinematic* const body, ndFloat32)
+	{
+		m_log.push_back(ndInt32(body->GetId()) * 4 + 1);
+	}
+
+	void OnTriggerEnter(ndBodyKinematic* const body, ndFloat32)
+	{
+		m_log.push_back(ndInt32(body->GetId()) * 4 + 0);
+	}
+
+	void OnTriggerExit(ndBodyKinematic* const body, ndFloat32)
+	{
+		m_log.push_back(ndInt32(body->GetId()) * 4 + 2);
+	}
+
+	std::vector<ndInt32> m_log;
+};
+
+// a crowd of touching capsules walking on a floor and pushing a few boxes
+static void BuildCrowd(ndWorld& world, ndInt32 size, std::vector<ndBodyKinematic*>& bodies)
+{
+	AddBox(world, ndVector(0.0f, -0.5f, 0.0f, 1.0f), ndVector(100.0f, 1.0f, 100.0f, 0.0f), 0.0f);
+
+	ndMatrix localAxis(ndGetIdentityMatrix());
+	localAxis[0] = ndVector(0.0f, 1.0f, 0.0f, 0.0f);
+	localAxis[1] = ndVector(1.0f, 0.0f, 0.0f, 0.0f);
+	localAxis[2] = localAxis[0].CrossProduct(localAxis[1]);
+
+	for (ndInt32 z = 0; z < size; ++z)
+	{
+		for (ndInt32 x = 0; x < size; ++x)
+		{
+			ndMatrix location(ndGetIdentityMatrix());
+			location.m_posit = ndVector(ndFloat32(x) * 0.9f, 0.0f, ndFloat32(z) * 0.9f, 1.0f);
+			ndWalkingCapsule* const capsule = new ndWalkingCapsule(localAxis, location, ndFloat32(x + z));
+			ndSharedPtr<ndBody> ptr(capsule);
+			world.AddBody(ptr);
+			bodies.push_back(capsule);
+		}
+	}
+
+	for (ndInt32 i = 0; i < 4; ++i)
+	{
+		bodies.push_back(AddBox(world, ndVector(ndFloat32(i) * 2.0f, 0.25f, -1.0f, 1.0f), ndVector(0.5f, 0.5f, 0.5f, 0.0f), 10.0f));
+	}
+}
+
+/* The parallel special update must give the same result for any thread count. */
+TEST(PlayerCapsule, ParallelUpdateIsDeterministic)
+{
+	std::vector<ndVector> positions[2];
+	const ndInt32 threadCount[] = { 4, 1 };
+	for (ndInt32 i = 0; i < 2; ++i)
+	{
+		ndWorld world;
+		world.SetThreadCount(threadCount[i]);
+		if ((threadCount[i] > 1) && (world.GetThreadCount() <= 1))
+		{
+			GTEST_SKIP() << "needs more than one thread";
+		}
+
+		std::vector<ndBodyKinematic*> bodies;
+		BuildCrowd(world, 6, bodies);
+		Simulate(world, 60);
+
+		for (size_t j = 0; j < bodies.size(); ++j)
+		{
+			positions[i].push_back(bodies[j]->GetMatrix().m_posit);
+		}
+		world.CleanUp();
+	}
+
+	ASSERT_EQ(positions[0].size(), positions[1].size());
+	for (size_t i = 0; i < positions[0].size(); ++i)
+	{
+		ASSERT_TRUE(ndCheckFloat(positions[0][i].m_x) && ndCheckFloat(positions[0][i].m_y) && ndCheckFloat(positions[0][i].m_z));
+		EXPECT_EQ(positions[0][i].m_x, positions[1][i].m_x);
+		EXPECT_EQ(positions[0][i].m_y, positions[1][i].m_y);
+		EXPECT_EQ(positions[0][i].m_z, positions[1][i].m_z);
+	}
+
+	// the capsules stay on the floor, or step on the boxes
+	for (ndInt32 i = 0; i < 36; ++i)
+	{
+		EXPECT_GT(positions[0][size_t(i)].m_y, -0.05f);
+		EXPECT_LT(positions[0][size_t(i)].m_y, 0.6f);
+	}
+}
+
+/* Trigger call backs are deferred, and come out in the same order for any thread count. */
+TEST(PlayerCapsule, TriggerEventsAreOrdered)
+{
+	std::vector<ndInt32> logs[2];
+	const ndInt32 threadCount[] = { 4, 1 };
+	for (ndInt32 i = 0; i < 2; ++i)
+	{
+		ndWorld world;
+		world.SetThreadCount(threadCount[i]);
+		if ((threadCount[i] > 1) && (world.GetThreadCount() <= 1))
+		{
+			GTEST_SKIP() << "needs more than one thread";
+		}
+
+		ndShapeInstance shape(new ndShapeBox(4.0f, 1.0f, 4.0f));
+		ndLoggingTrigger* const trigger = new ndLoggingTrigger();
+		ndMatrix matrix(ndGetIdentityMatrix());
+		matrix.m_posit.m_y = 2.0f;
+		trigger->SetCollisionShape(shape);
+		trigger->SetMatrix(matrix);
+		ndSharedPtr<ndBody> triggerPtr(trigger);
+		world.AddBody(triggerPtr);
+
+		// a few boxes falling through the trigger
+		for (ndInt32 j = 0; j < 6; ++j)
+		{
+			AddBox(world, ndVector(ndFloat32(j % 3) - 1.0f, 4.0f + ndFloat32(j / 3) * 0.5f, ndFloat32(j / 3) - 0.5f, 1.0f), ndVector(0.25f, 0.25f, 0.25f, 0.0f), 1.0f);
+		}
+
+		Simulate(world, 90);
+		logs[i] = trigger->m_log;
+		world.CleanUp();
+	}
+
+	EXPECT_EQ(logs[0], logs[1]);
+
+	// each box enters and exits once, and is inside in between
+	std::vector<ndInt32> state;
+	for (size_t i = 0; i < logs[0].size(); ++i)
+	{
+		const ndInt32 id = logs[0][i] / 4;
+		const ndInt32 type = logs[0][i] % 4;
+		if (size_t(id) >= state.size())
+		{
+			state.resize(size_t(id + 1), 0);
+		}
+		EXPECT_EQ(state[size_t(id)], (type == 0) ? 0 : 1);
+		state[size_t(id)] = (type == 2) ? 2 : 1;
+	}
+
+	ndInt32 exitCount = 0;
+	for (size_t i = 0; i < state.size(); ++i)
+	{
+		exitCount += (state[i] == 2) ? 1 : 0;
+	}
+	EXPECT_EQ(exitCount, 6);
+}
+
+/* The predicted time of impact must stop a walking capsule at the walls of a pen. */
+TEST(PlayerCapsule, StopsAtWalls)
+{
+	ndWorld world;
+	world.SetThreadCount(1);
+
+	AddBox(world, ndVector(0.0f, -0.5f, 0.0f, 1.0f), ndVector(20.0f, 1.0f, 20.0f, 0.0f), 0.0f);
+	AddBox(world, ndVector( 2.25f, 1.0f, 0.0f, 1.0f), ndVector(0.5f, 2.0f, 5.0f, 0.0f), 0.0f);
+	AddBox(world, ndVector(-2.25f, 1.0f, 0.0f, 1.0f), ndVector(0.5f, 2.0f, 5.0f, 0.0f), 0.0f);
+	AddBox(world, ndVector(0.0f, 1.0f,  2.25f, 1.0f), ndVector(5.0f, 2.0f, 0.5f, 0.0f), 0.0f);
+	AddBox(world, ndVector(0.0f, 1.0f, -2.25f, 1.0f), ndVector(5.0f, 2.0f, 0.5f, 0.0f), 0.0f);
+
+	ndMatrix localAxis(ndGetIdentityMatrix());
+	localAxis[0] = ndVector(0.0f, 1.0f, 0.0f, 0.0f);
+	localAxis[1] = ndVector(1.0f, 0.0f, 0.0f, 0.0f);
+	localAxis[2] = localAxis[0].CrossProduct(localAxis[1]);
+
+	ndWalkingCapsule* const capsule = new ndWalkingCapsule(localAxis, ndGetIdentityMatrix(), 0.0f);
+	ndSharedPtr<ndBody> ptr(capsule);
+	world.AddBody(ptr);
+
+	// the capsule walks in a wide circle, so it keeps running into the walls
+	ndFloat32 maxDist = 0.0f;
+	for (ndInt32 i = 0; i < 300; ++i)
+	{
+		Simulate(world, 1);
+		const ndVector posit(capsule->GetMatrix().m_posit);
+		ASSERT_TRUE(ndCheckFloat(posit.m_x) && ndCheckFloat(posit.m_y) && ndCheckFloat(posit.m_z));
+		maxDist = ndMax(maxDist, ndMax(ndAbs(posit.m_x), ndAbs(posit.m_z)));
+	}
+
+	// the walls are 2 meters away, and the capsule radius is half a meter
+	EXPECT_GT(maxDist, 1.3f);
+	EXPECT_LT(maxDist, 1.55f);
+	world.CleanUp();
+}
+
+/* A capsule moving more than the broad phase padding in one step must not go through a thin wall. */
+TEST(PlayerCapsule, FastCapsuleStopsAtThinWall)
+{
+	ndWorld world;
+	world.SetThreadCount(1);
+	AddBox(world, ndVector(0.0f, -0.5f, 0.0f, 1.0f), ndVector(20.0f, 1.0f, 20.0f, 0.0f), 0.0f);
+	AddBox(world, ndVector(3.0f, 1.0f, 0.0f, 1.0f), ndVector(0.05f, 2.0f, 5.0f, 0.0f), 0.0f);
+
+	ndMatrix localAxis(ndGetIdentityMatrix());
+	localAxis[0] = ndVector(0.0f, 1.0f, 0.0f, 0.0f);
+	localAxis[1] = ndVector(1.0f, 0.0f, 0.0f, 0.0f);
+	localAxis[2] = localAxis[0].CrossProduct(localAxis[1]);
+
+	// the capsule reaches the wall at about 10 meters per second, a sixth of a meter per step
+	ndRunningCapsule* const capsule = new ndRunningCapsule(localAxis, ndGetIdentityMatrix(), 40.0f);
+	ndSharedPtr<ndBody> ptr(capsule);
+	world.AddBody(ptr);
+
+	ndFloat32 maxX = 0.0f;
+	for (ndInt32 i = 0; i < 60; ++i)
+	{
+		Simulate(world, 1);
+		const ndVector posit(capsule->GetMatrix().m_posit);
+		ASSERT_TRUE(ndCheckFloat(posit.m_x) && ndCheckFloat(posit.m_y) && ndCheckFloat(posit.m_z));
+		maxX = ndMax(maxX, posit.m_x);
+	}
+
+	// the wall face is at 2.975, and the capsule radius is half a meter
+	EXPECT_GT(maxX, 2.3f);
+	EXPECT_LT(maxX, 2.5f);
+	world.CleanUp();
+}
+
+/* A crowd batches the capsules on a static floor, and gives them back to the full update when they touch a dynamic body. */
+TEST(PlayerCapsule, CrowdBatchesStaticPlayers)
+{
+	std::vector<ndVector> positions[2];
+	ndInt32 batchedCount[2] = { 0, 0 };
+	const ndInt32 threadCount[] = { 1, 4 };
+	for (ndInt32 i = 0; i < 2; ++i)
+	{
+		ndWorld world;
+		world.SetThreadCount(threadCount[i]);
+		AddBox(world, ndVector(0.0f, -0.5f, 0.0f, 1.0f), ndVector(100.0f, 1.0f, 100.0f, 0.0f), 0.0f);
+
+		ndMatrix localAxis(ndGetIdentityMatrix());
+		localAxis[0] = ndVector(0.0f, 1.0f, 0.0f, 0.0f);
+		localAxis[1] = ndVector(1.0f, 0.0f, 0.0f, 0.0f);
+		localAxis[2] = localAxis[0].CrossProduct(localAxis[1]);
+
+		ndPlayerCapsuleCrowd crowd;
+		std::vector<ndBodyKinematic*> bodies;
+		for (ndInt32 j = 0; j < 10; ++j)
+		{
+			ndMatrix location(ndGetIdentityMatrix());
+			location.m_posit = ndVector(ndFloat32(j % 5) * 6.0f, 0.0f, ndFloat32(j / 5) * 6.0f, 1.0f);
+			ndWalkingCapsule* const capsule = new ndWalkingCapsule(localAxis, location, ndFloat32(j));
+			ndSharedPtr<ndBody> ptr(capsule);
+			world.AddBody(ptr);
+			crowd.AddPlayer(capsule);
+			bodies.push_back(capsule);
+		}
+
+		// one box in the way of the first capsule
+		bodies.push_back(AddBox(world, ndVector(1.5f, 0.25f, -0.2f, 1.0f), ndVector(0.5f, 0.5f, 0.5f, 0.0f), 10.0f));
+		world.GetScene()->AddPlayerCrowd(&crowd);
+
+		ndInt32 minBatched = 10;
+		ndInt32 maxBatched = 0;
+		for (ndInt32 j = 0; j < 120; ++j)
+		{
+			Simulate(world, 1);
+			if (j > 10)
+			{
+				minBatched = ndMin(minBatched, crowd.GetBatchedCount());
+				maxBatched = ndMax(maxBatched, crowd.GetBatchedCount());
+			}
+		}
+		EXPECT_EQ(maxBatched, 10);
+		EXPECT_LT(minBatched, 10);
+		batchedCount[i] = crowd.GetBatchedCount();
+
+		for (size_t j = 0; j < bodies.size(); ++j)
+		{
+			positions[i].push_back(bodies[j]->GetMatrix().m_posit);
+		}
+		world.CleanUp();
+		EXPECT_EQ(crowd.GetPlayerCount(), 0);
+	}
+
+	EXPECT_EQ(batchedCount[0], batchedCount[1]);
+	for (size_t i = 0; i < positions[0].size(); ++i)
+	{
+		ASSERT_TRUE(ndCheckFloat(positions[0][i].m_x) && ndCheckFloat(positions[0][i].m_y) && ndCheckFloat(positions[0][i].m_z));
+		EXPECT_EQ(positions[0][i].m_x, positions[1][i].m_x);
+		EXPECT_EQ(positions[0][i].m_z, positions[1][i].m_z);
+	}
+
+	// the capsules walked on the floor, the first one may step on the box
+	for (size_t i = 0; i < 10; ++i)
+	{
+		EXPECT_GT(positions[0][i].m_y, -0.05f);
+		EXPECT_LT(positions[0][i].m_y, i ? 0.05f : 0.6f);
+	}
+}
+
+/* A capsule on a moving kinematic platform goes to the full update, one on a still platform stays in the crowd. */
+TEST(PlayerCapsule, CrowdSkipsMovingPlatforms)
+{
+	const ndFloat32 platformSpeed[] = { 0.0f, 1.0f };
+	for (ndInt32 i = 0; i < 2; ++i)
+	{
+		ndWorld world;
+		world.SetThreadCount(4);
+
+		ndShapeInstance box(new ndShapeBox(20.0f, 1.0f, 20.0f));
+		ndBodyKinematic* const platform = new ndBodyKinematic();
+		ndMatrix matrix(ndGetIdentityMatrix());
+		matrix.m_posit = ndVector(0.0f, -0.5f, 0.0f, 1.0f);
+		platform->SetMatrix(matrix);
+		platform->SetCollisionShape(box);
+		platform->SetVelocity(ndVector(platformSpeed[i], 0.0f, 0.0f, 0.0f));
+		ndSharedPtr<ndBody> platformPtr(platform);
+		world.AddBody(platformPtr);
+
+		ndMatrix localAxis(ndGetIdentityMatrix());
+		localAxis[0] = ndVector(0.0f, 1.0f, 0.0f, 0.0f);
+		localAxis[1] = ndVector(1.0f, 0.0f, 0.0f, 0.0f);
+		localAxis[2] = localAxis[0].CrossProduct(localAxis[1]);
+
+		ndPlayerCapsuleCrowd crowd;
+		ndWalkingCapsule* const capsule = new ndWalkingCapsule(localAxis, ndGetIdentityMatrix(), 0.0f);
+		ndSharedPtr<ndBody> capsulePtr(capsule);
+		world.AddBody(capsulePtr);
+		crowd.AddPlayer(capsule);
+		world.GetScene()->AddPlayerCrowd(&crowd);
+
+		ndInt32 maxBatched = 0;
+		for (ndInt32 j = 0; j < 60; ++j)
+		{
+			Simulate(world, 1);
+			if (j > 10)
+			{
+				maxBatched = ndMax(maxBatched, crowd.GetBatchedCount());
+			}
+		}
+		EXPECT_EQ(maxBatched, i ? 0 : 1);
+		world.CleanUp();
+	}
+}
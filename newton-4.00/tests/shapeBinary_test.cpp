@@ -0,0 +1,192 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include <cstdio>
+#include <string>
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+
+#define GRID_SIZE	16
+
+static ndFloat32 GridHeight(ndInt32 x, ndInt32 z)
+{
+	return ndFloat32(0.25f) * ndFloat32((x * 7 + z * 3) % 5);
+}
+
+static ndShape* BuildMesh()
+{
+	ndPolygonSoupBuilder meshBuilder;
+	meshBuilder.Begin();
+	for (ndInt32 z = 0; z < GRID_SIZE; ++z)
+	{
+		for (ndInt32 x = 0; x < GRID_SIZE; ++x)
+		{
+			ndVector p00(ndFloat32(x + 0), GridHeight(x + 0, z + 0), ndFloat32(z + 0), 0.0f);
+			ndVector p10(ndFloat32(x + 1), GridHeight(x + 1, z + 0), ndFloat32(z + 0), 0.0f);
+			ndVector p01(ndFloat32(x + 0), GridHeight(x + 0, z + 1), ndFloat32(z + 1), 0.0f);
+			ndVector p11(ndFloat32(x + 1), GridHeight(x + 1, z + 1), ndFloat32(z + 1), 0.0f);
+
+			ndVector face0[] = { p00, p11, p10 };
+			ndVector face1[] = { p00, p01, p11 };
+			meshBuilder.AddFace(&face0[0].m_x, sizeof(ndVector), 3, 0);
+			meshBuilder.AddFace(&face1[0].m_x, sizeof(ndVector), 3, 0);
+		}
+	}
+	meshBuilder.End(false);
+	return new ndShapeStatic_bvh(meshBuilder);
+}
+
+static void AddStaticBody(ndWorld& world, ndShape* const shape, const ndVector& posit)
+{
+	ndShapeInstance instance(shape);
+	ndBodyDynamic* const body = new ndBodyDynamic();
+	ndMatrix matrix(ndGetIdentityMatrix());
+	matrix.m_posit = posit;
+	body->SetMatrix(matrix);
+	body->SetCollisionShape(instance);
+	body->SetMassMatrix(0.0f, instance);
+
+	ndSharedPtr<ndBody> bodyPtr(body);
+	world.AddBody(bodyPtr);
+}
+
+/* Rays cast against the original and the loaded shapes must hit the same points. */
+static void CompareRayCasts(ndShape* const source, ndShape* const loaded, ndFloat32 size)
+{
+	ndWorld world;
+	AddStaticBody(world, source, ndVector(0.0f, 0.0f, 0.0f, 1.0f));
+	AddStaticBody(world, loaded, ndVector(0.0f, 0.0f, 100.0f, 1.0f));
+	world.Update(1.0f / 60.0f);
+	world.Sync();
+
+	for (ndInt32 i = 0; i < 100; ++i)
+	{
+		const ndFloat32 x = ndFloat32(0.1f) + (size - ndFloat32(0.2f)) * ndRand();
+		const ndFloat32 z = ndFloat32(0.1f) + (size - ndFloat32(0.2f)) * ndRand();
+
+		ndRayCastClosestHitCallback sourceHit;
+		ndRayCastClosestHitCallback loadedHit;
+		ASSERT_TRUE(world.RayCast(sourceHit, ndVector(x, 10.0f, z, 1.0f), ndVector(x, -10.0f, z, 1.0f)));
+		ASSERT_TRUE(world.RayCast(loadedHit, ndVector(x, 10.0f, z + 100.0f, 1.0f), ndVector(x, -10.0f, z + 100.0f, 1.0f)));
+		EXPECT_NEAR(sourceHit.m_contact.m_point.m_y, loadedHit.m_contact.m_point.m_y, 1.0e-5f);
+	}
+	world.CleanUp();
+}
+
+TEST(ShapeBinaryFormat, StaticBvhRoundTrip)
+{
+	// the instances keep the shapes alive across the two test worlds
+	ndShape* const mesh = BuildMesh();
+	ndShapeInstance meshInstance(mesh);
+	ndArray<ndUnsigned8> buffer;
+	ASSERT_TRUE(ndShapeBinaryFormat::Save(mesh, buffer));
+
+	// the zero copy mesh reads the buffer in place, so it must stay alive.
+	ndShape* const copy = ndShapeBinaryFormat::Load(&buffer[0], buffer.GetCount(), false);
+	ndShape* const mapped = ndShapeBinaryFormat::Load(&buffer[0], buffer.GetCount(), true);
+	ASSERT_TRUE(copy && copy->GetAsShapeStaticBVH());
+	ASSERT_TRUE(mapped && mapped->GetAsShapeStaticBVH());
+	ndShapeInstance copyInstance(copy);
+	ndShapeInstance mappedInstance(mapped);
+	EXPECT_EQ(copy->GetHash(), mesh->GetHash());
+
+	CompareRayCasts(mesh, copy, ndFloat32(GRID_SIZE));
+	CompareRayCasts(mesh, mapped, ndFloat32(GRID_SIZE));
+
+	// corrupted containers must be rejected
+	buffer[0] = 0;
+	EXPECT_TRUE(ndShapeBinaryFormat::Load(&buffer[0], buffer.GetCount(), true) == nullptr);
+}
+
+TEST(ShapeBinaryFormat, HeightfieldRoundTrip)
+{
+	ndShapeHeightfield* const heightfield = new ndShapeHeightfield(GRID_SIZE + 1, GRID_SIZE + 1, ndShapeHeightfield::m_normalDiagonals, 1.0f, 1.0f);
+	for (ndInt32 z = 0; z <= GRID_SIZE; ++z)
+	{
+		for (ndInt32 x = 0; x <= GRID_SIZE; ++x)
+		{
+			heightfield->GetElevationMap()[z * (GRID_SIZE + 1) + x] = ndReal(GridHeight(x, z));
+		}
+	}
+	heightfield->UpdateElevationMapAabb();
+
+	ndArray<ndUnsigned8> buffer;
+	ASSERT_TRUE(ndShapeBinaryFormat::Save(heightfield, buffer));
+	ndShape* const loaded = ndShapeBinaryFormat::Load(&buffer[0], buffer.GetCount(), false);
+	ASSERT_TRUE(loaded && loaded->GetAsShapeHeightfield());
+	ndShapeInstance heightfieldInstance(heightfield);
+	ndShapeInstance loadedInstance(loaded);
+	CompareRayCasts(heightfield, loaded, ndFloat32(GRID_SIZE));
+}
+
+TEST(ShapeBinaryFormat, CompoundFileRoundTrip)
+{
+	ndShapeInstance compoundInstance(new ndShapeCompound());
+	ndShapeCompound* const compound = compoundInstance.GetShape()->GetAsShapeCompound();
+	compound->BeginAddRemove();
+
+	ndShapeInstance box(new ndShapeBox(1.0f, 2.0f, 3.0f));
+	box.SetLocalMatrix(ndYawMatrix(0.5f) * ndMatrix(ndGetIdentityMatrix()));
+	compound->AddCollision(&box);
+
+	ndShapeInstance sphere(new ndShapeSphere(0.5f));
+	ndMatrix sphereMatrix(ndGetIdentityMatrix());
+	sphereMatrix.m_posit = ndVector(0.0f, 2.0f, 0.0f, 1.0f);
+	sphere.SetLocalMatrix(sphereMatrix);
+	compound->AddCollision(&sphere);
+
+	ndShapeInstance cone(new ndShapeCone(0.5f, 1.5f));
+	compound->AddCollision(&cone);
+	compound->EndAddRemove();
+
+	const std::string path(testing::TempDir() + "shapeBinary_compound.bin");
+	ASSERT_TRUE(ndShapeBinaryFormat::Save(compound, path.c_str()));
+	ndShape* const loaded = ndShapeBinaryFormat::Load(path.c_str());
+	remove(path.c_str());
+	ASSERT_TRUE(loaded && loaded->GetAsShapeCompound());
+
+	ndShapeInstance loadedInstance(loaded);
+	EXPECT_EQ(loaded->GetHash(), compoundInstance.GetShape()->GetHash());
+	EXPECT_NEAR(loadedInstance.GetVolume(), compoundInstance.GetVolume(), 1.0e-4f);
+}
+
+/* A convex hull saved to a file must load with the same vertices. */
+TEST(ShapeBinaryFormat, ConvexHullFileRoundTrip)
+{
+	ndVector points[32];
+	for (ndInt32 i = 0; i < ndInt32(sizeof(points) / sizeof(points[0])); ++i)
+	{
+		const ndFloat32 yaw = ndFloat32(2.0f) * ndPi * ndFloat32(i) / ndFloat32(8.0f);
+		const ndFloat32 y = ndFloat32(i / 8) * ndFloat32(0.5f);
+		const ndFloat32 radius = ndFloat32(1.0f) + ndFloat32(0.25f) * y;
+		points[i] = ndVector(radius * ndCos(yaw), y, radius * ndSin(yaw), ndFloat32(0.0f));
+	}
+	ndShapeInstance hullInstance(new ndShapeConvexHull(ndInt32(sizeof(points) / sizeof(points[0])), sizeof(ndVector), 0.0f, &points[0].m_x));
+	ndShape* const hull = hullInstance.GetShape();
+	ASSERT_EQ(hull->GetShapeInfo().m_collisionType, ::m_convexHull);
+
+	const std::string path(testing::TempDir() + "shapeBinary_convexHull.bin");
+	ASSERT_TRUE(ndShapeBinaryFormat::Save(hull, path.c_str()));
+	ndShape* const loaded = ndShapeBinaryFormat::Load(path.c_str());
+	remove(path.c_str());
+	ASSERT_TRUE(loaded && (loaded->GetShapeInfo().m_collisionType == ::m_convexHull));
+
+	ndShapeInstance loadedInstance(loaded);
+	EXPECT_EQ(loaded->GetHash(), hull->GetHash());
+	EXPECT_NEAR(loadedInstance.GetVolume(), hullInstance.GetVolume(), 1.0e-4f);
+
+	const ndVector dir(ndVector(1.0f, 0.5f, -0.25f, 0.0f).Normalize());
+	const ndVector support0(hullInstance.SupportVertex(dir));
+	const ndVector support1(loadedInstance.SupportVertex(dir));
+	EXPECT_NEAR(support0.m_x, support1.m_x, 1.0e-5f);
+	EXPECT_NEAR(support0.m_y, support1.m_y, 1.0e-5f);
+	EXPECT_NEAR(support0.m_z, support1.m_z, 1.0e-5f);
+}
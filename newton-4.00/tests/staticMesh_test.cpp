@@ -0,0 +1,196 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include <cstdio>
+#include "ndNewton.h"
+#include "testWorld.h"
+#include <gtest/gtest.h>
+
+#define GRID_SIZE	32
+#define CELL_SIZE	1.0f
+
+static ndFloat32 GridHeight(ndInt32 x, ndInt32 z, ndFloat32 amplitude)
+{
+	return amplitude * ndSin(ndFloat32(x) * 0.7f) * ndCos(ndFloat32(z) * 0.4f);
+}
+
+/* Sample the mesh surface the same way the faces were triangulated. */
+static ndFloat32 SurfaceHeight(ndFloat32 x, ndFloat32 z, ndFloat32 amplitude)
+{
+	const ndInt32 i = ndInt32(ndFloor(x / CELL_SIZE));
+	const ndInt32 j = ndInt32(ndFloor(z / CELL_SIZE));
+	const ndFloat32 fx = x / CELL_SIZE - ndFloat32(i);
+	const ndFloat32 fz = z / CELL_SIZE - ndFloat32(j);
+	const ndFloat32 h00 = GridHeight(i, j, amplitude);
+	const ndFloat32 h10 = GridHeight(i + 1, j, amplitude);
+	const ndFloat32 h01 = GridHeight(i, j + 1, amplitude);
+	const ndFloat32 h11 = GridHeight(i + 1, j + 1, amplitude);
+	if (fx >= fz)
+	{
+		return h00 + fx * (h10 - h00) + fz * (h11 - h10);
+	}
+	return h00 + fz * (h01 - h00) + fx * (h11 - h01);
+}
+
+static ndBodyKinematic* BuildMesh(ndWorld& world, ndFloat32 amplitude, bool optimize = false, ndThreadPool* const threadPool = nullptr)
+{
+	ndPolygonSoupBuilder meshBuilder;
+	meshBuilder.Begin();
+	for (ndInt32 z = 0; z < GRID_SIZE; ++z)
+	{
+		for (ndInt32 x = 0; x < GRID_SIZE; ++x)
+		{
+			ndVector p00(ndFloat32(x + 0) * CELL_SIZE, GridHeight(x + 0, z + 0, amplitude), ndFloat32(z + 0) * CELL_SIZE, 0.0f);
+			ndVector p10(ndFloat32(x + 1) * CELL_SIZE, GridHeight(x + 1, z + 0, amplitude), ndFloat32(z + 0) * CELL_SIZE, 0.0f);
+			ndVector p01(ndFloat32(x + 0) * CELL_SIZE, GridHeight(x + 0, z + 1, amplitude), ndFloat32(z + 1) * CELL_SIZE, 0.0f);
+			ndVector p11(ndFloat32(x + 1) * CELL_SIZE, GridHeight(x + 1, z + 1, amplitude), ndFloat32(z + 1) * CELL_SIZE, 0.0f);
+
+			ndVector face0[] = { p00, p11, p10 };
+			ndVector face1[] = { p00, p01, p11 };
+			meshBuilder.AddFace(&face0[0].m_x, sizeof(ndVector), 3, 0);
+			meshBuilder.AddFace(&face1[0].m_x, sizeof(ndVector), 3, 0);
+		}
+	}
+	meshBuilder.End(optimize, threadPool);
+
+	ndShapeInstance instance(new ndShapeStatic_bvh(meshBuilder, threadPool));
+	ndBodyDynamic* const body = new ndBodyDynamic();
+	body->SetMatrix(ndGetIdentityMatrix());
+	body->SetCollisionShape(instance);
+	body->SetMassMatrix(0.0f, instance);
+
+	ndSharedPtr<ndBody> bodyPtr(body);
+	world.AddBody(bodyPtr);
+	return body;
+}
+
+/* Rays cast against a bumpy mesh must hit the exact triangle surface. */
+TEST(StaticMesh, RayCastHitsSurface)
+{
+	const ndFloat32 amplitude = 2.0f;
+	ndWorld world;
+	BuildMesh(world, amplitude);
+	Simulate(world, 1);
+
+	ndInt32 hitCount = 0;
+	for (ndInt32 i = 0; i < 200; ++i)
+	{
+		const ndFloat32 x = ndFloat32(0.5f) + ndFloat32(GRID_SIZE - 1) * ndRand();
+		const ndFloat32 z = ndFloat32(0.5f) + ndFloat32(GRID_SIZE - 1) * ndRand();
+
+		ndRayCastClosestHitCallback callback;
+		if (world.RayCast(callback, ndVector(x, 10.0f, z, 1.0f), ndVector(x, -10.0f, z, 1.0f)))
+		{
+			hitCount++;
+			EXPECT_NEAR(callback.m_contact.m_point.m_y, SurfaceHeight(x, z, amplitude), 1.0e-3f);
+		}
+	}
+	EXPECT_EQ(hitCount, 200);
+
+	world.CleanUp();
+}
+
+/* Spheres dropped over a flat mesh must come to rest on top of it. */
+TEST(StaticMesh, SpheresRestOnMesh)
+{
+	ndWorld world;
+	world.SetSubSteps(2);
+	BuildMesh(world, 0.0f);
+
+	ndArray<ndBodyDynamic*> spheres;
+	for (ndInt32 i = 0; i < 4; ++i)
+	{
+		ndBodyDynamic* const body = new ndBodyDynamic();
+		body->SetNotifyCallback(new ndBodyNotify(ndVector(0.0f, -10.0f, 0.0f, 0.0f)));
+
+		ndMatrix matrix(ndGetIdentityMatrix());
+		matrix.m_posit = ndVector(4.0f + ndFloat32(i) * 7.3f, 2.0f, 3.0f + ndFloat32(i) * 6.1f, 1.0f);
+		body->SetMatrix(matrix);
+
+		ndShapeInstance sphere(new ndShapeSphere(0.5f));
+		body->SetCollisionShape(sphere);
+		body->SetMassMatrix(1.0f, sphere);
+
+		ndSharedPtr<ndBody> bodyPtr(body);
+		world.AddBody(bodyPtr);
+		spheres.PushBack(body);
+	}
+
+	Simulate(world, 120);
+
+	for (ndInt32 i = 0; i < spheres.GetCount(); ++i)
+	{
+		EXPECT_NEAR(spheres[i]->GetMatrix().m_posit.m_y, 0.5f, 0.05f);
+	}
+
+	world.CleanUp();
+}
+
+/* An optimized mesh built in parallel must be the same as the serial build. */
+TEST(StaticMesh, ParallelBuildRayCast)
+{
+	const ndFloat32 amplitude = 2.0f;
+	ndWorld serialWorld;
+	BuildMesh(serialWorld, amplitude, true);
+	Simulate(serialWorld, 1);
+
+	ndWorld parallelWorld;
+	parallelWorld.SetThreadCount(4);
+
+	BuildMesh(parallelWorld, amplitude, true, parallelWorld.GetScene());
+	Simulate(parallelWorld, 1);
+
+	for (ndInt32 i = 0; i < 200; ++i)
+	{
+		const ndFloat32 x = ndFloat32(0.5f) + ndFloat32(GRID_SIZE - 1) * ndRand();
+		const ndFloat32 z = ndFloat32(0.5f) + ndFloat32(GRID_SIZE - 1) * ndRand();
+		const ndVector p0(x, 10.0f, z, 1.0f);
+		const ndVector p1(x, -10.0f, z, 1.0f);
+
+		ndRayCastClosestHitCallback serialHit;
+		ndRayCastClosestHitCallback parallelHit;
+		ASSERT_TRUE(serialWorld.RayCast(serialHit, p0, p1));
+		ASSERT_TRUE(parallelWorld.RayCast(parallelHit, p0, p1));
+		EXPECT_NEAR(serialHit.m_contact.m_point.m_y, parallelHit.m_contact.m_point.m_y, 1.0e-5f);
+		EXPECT_NEAR(parallelHit.m_contact.m_point.m_y, SurfaceHeight(x, z, amplitude), 1.0e-2f);
+	}
+
+	serialWorld.CleanUp();
+	parallelWorld.CleanUp();
+}
+
+/* Removing the faces of a region must open a hole, restoring them must close it. */
+TEST(StaticMesh, RemoveAndRestoreFaces)
+{
+	ndWorld world;
+	ndBodyKinematic* const body = BuildMesh(world, 0.0f);
+	ndShapeStatic_bvh* const mesh = ((ndShape*)body->GetCollisionShape().GetShape())->GetAsShapeStaticBVH();
+	ASSERT_TRUE(mesh != nullptr);
+	Simulate(world, 1);
+
+	ndRayCastClosestHitCallback hit0;
+	EXPECT_TRUE(world.RayCast(hit0, ndVector(10.5f, 5.0f, 10.3f, 1.0f), ndVector(10.5f, -5.0f, 10.3f, 1.0f)));
+
+	// two triangles per cell, in a 4 x 4 cells region
+	const ndInt32 removed = mesh->RemoveFaces(ndVector(8.0f, -1.0f, 8.0f, 0.0f), ndVector(12.0f, 1.0f, 12.0f, 0.0f));
+	EXPECT_EQ(removed, 32);
+
+	ndRayCastClosestHitCallback hit1;
+	EXPECT_FALSE(world.RayCast(hit1, ndVector(10.5f, 5.0f, 10.3f, 1.0f), ndVector(10.5f, -5.0f, 10.3f, 1.0f)));
+	ndRayCastClosestHitCallback hit2;
+	EXPECT_TRUE(world.RayCast(hit2, ndVector(14.5f, 5.0f, 10.3f, 1.0f), ndVector(14.5f, -5.0f, 10.3f, 1.0f)));
+
+	mesh->RestoreFaces();
+	ndRayCastClosestHitCallback hit3;
+	EXPECT_TRUE(world.RayCast(hit3, ndVector(10.5f, 5.0f, 10.3f, 1.0f), ndVector(10.5f, -5.0f, 10.3f, 1.0f)));
+
+	world.CleanUp();
+}
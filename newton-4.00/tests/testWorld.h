@@ -0,0 +1,49 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#ifndef __TEST_WORLD_H__
+#define __TEST_WORLD_H__
+
+#include "ndNewton.h"
+
+// steps the world at 60 hz, waiting for each update
+inline void Simulate(ndWorld& world, ndInt32 steps)
+{
+	for (ndInt32 i = 0; i < steps; ++i)
+	{
+		world.Update(1.0f / 60.0f);
+		world.Sync();
+	}
+}
+
+// adds a box body, a zero mass makes it static
+inline ndBodyDynamic* AddBox(ndWorld& world, const ndVector& posit, const ndVector& size, ndFloat32 mass)
+{
+	ndShapeInstance box(new ndShapeBox(size.m_x, size.m_y, size.m_z));
+	ndBodyDynamic* const body = new ndBodyDynamic();
+
+	ndMatrix matrix(ndGetIdentityMatrix());
+	matrix.m_posit = posit;
+	matrix.m_posit.m_w = 1.0f;
+	body->SetMatrix(matrix);
+	body->SetCollisionShape(box);
+	if (mass > 0.0f)
+	{
+		body->SetNotifyCallback(new ndBodyNotify(ndVector(0.0f, -10.0f, 0.0f, 0.0f)));
+		body->SetMassMatrix(mass, box);
+	}
+
+	ndSharedPtr<ndBody> ptr(body);
+	world.AddBody(ptr);
+	return body;
+}
+
+#endif
@@ -0,0 +1,215 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include <cstdio>
+#include "ndNewton.h"
+#include "testWorld.h"
+#include <gtest/gtest.h>
+
+#define TILES_COUNT		8
+#define CELLS_PER_TILE	16
+#define CELL_SIZE		1.0f
+#define MAX_ELEVATION	4.0f
+
+/* Loader that generates flat tiles at zero elevation. */
+class csFlatTileLoader : public ndShapeHeightfieldTiled::ndTileLoader
+{
+	public:
+	virtual bool LoadTile(ndInt32, ndInt32, ndShapeHeightfieldTiled::ndTile& tile)
+	{
+		ndArray<ndReal> elevation;
+		elevation.SetCount(tile.GetSampleWidth() * tile.GetSampleWidth());
+		for (ndInt32 i = 0; i < elevation.GetCount(); ++i)
+		{
+			elevation[i] = ndReal(0.0f);
+		}
+		tile.Quantize(&elevation[0], nullptr);
+		return true;
+	}
+};
+
+// a rolling terrain, the elevation of the sample at global cell x, z
+static ndFloat32 RollingElevation(ndInt32 x, ndInt32 z)
+{
+	return 2.0f + 1.5f * ndSin(ndFloat32(x) * 0.2f) * ndCos(ndFloat32(z) * 0.15f);
+}
+
+/* Loader that generates tiles of a rolling terrain. */
+class csRollingTileLoader : public ndShapeHeightfieldTiled::ndTileLoader
+{
+	public:
+	virtual bool LoadTile(ndInt32 tileX, ndInt32 tileZ, ndShapeHeightfieldTiled::ndTile& tile)
+	{
+		const ndInt32 width = tile.GetSampleWidth();
+		ndArray<ndReal> elevation;
+		elevation.SetCount(width * width);
+		for (ndInt32 z = 0; z < width; ++z)
+		{
+			for (ndInt32 x = 0; x < width; ++x)
+			{
+				elevation[z * width + x] = ndReal(RollingElevation(tileX * CELLS_PER_TILE + x, tileZ * CELLS_PER_TILE + z));
+			}
+		}
+		tile.Quantize(&elevation[0], nullptr);
+		return true;
+	}
+};
+
+static ndShapeHeightfieldTiled* BuildTerrain(ndWorld& world, ndShapeHeightfieldTiled::ndTileLoader* const loader = new csFlatTileLoader())
+{
+	ndShapeHeightfieldTiled* const shape = new ndShapeHeightfieldTiled(
+		TILES_COUNT, TILES_COUNT, CELLS_PER_TILE, CELL_SIZE, CELL_SIZE,
+		0.0f, MAX_ELEVATION, loader);
+
+	ndShapeInstance instance(shape);
+	ndBodyDynamic* const body = new ndBodyDynamic();
+	body->SetMatrix(ndGetIdentityMatrix());
+	body->SetCollisionShape(instance);
+	body->SetMassMatrix(0.0f, instance);
+
+	ndSharedPtr<ndBody> bodyPtr(body);
+	world.AddBody(bodyPtr);
+	return (ndShapeHeightfieldTiled*)body->GetCollisionShape().GetShape();
+}
+
+static ndBodyDynamic* BuildSphere(ndWorld& world, const ndVector& pos)
+{
+	ndBodyDynamic* const body = new ndBodyDynamic();
+	body->SetNotifyCallback(new ndBodyNotify(ndVector(0.0f, -10.0f, 0.0f, 0.0f)));
+
+	ndMatrix matrix(ndGetIdentityMatrix());
+	matrix.m_posit = pos;
+	body->SetMatrix(matrix);
+
+	ndShapeInstance sphere(new ndShapeSphere(0.5f));
+	body->SetCollisionShape(sphere);
+	body->SetMassMatrix(1.0f, sphere);
+
+	ndSharedPtr<ndBody> bodyPtr(body);
+	world.AddBody(bodyPtr);
+	return body;
+}
+
+/* Spheres over tiles that are not resident must rest on the conservative tile bounds. */
+TEST(TiledHeightfield, UnloadedTilesAreConservative)
+{
+	ndWorld world;
+	world.SetSubSteps(2);
+	ndShapeHeightfieldTiled* const terrain = BuildTerrain(world);
+	EXPECT_EQ(terrain->GetResidentTilesCount(), 0);
+
+	ndBodyDynamic* const sphere = BuildSphere(world, ndVector(40.0f, 6.0f, 40.0f, 1.0f));
+	Simulate(world, 120);
+	EXPECT_NEAR(sphere->GetMatrix().m_posit.m_y, MAX_ELEVATION + 0.5f, 0.05f);
+
+	world.CleanUp();
+}
+
+/* Streaming the tiles around a sphere must let it fall down to the real terrain. */
+TEST(TiledHeightfield, StreamedTilesCollide)
+{
+	ndWorld world;
+	world.SetSubSteps(2);
+	ndShapeHeightfieldTiled* const terrain = BuildTerrain(world);
+
+	const ndVector position(40.0f, 2.0f, 40.0f, 1.0f);
+	ndBodyDynamic* const sphere = BuildSphere(world, position);
+
+	terrain->StreamTiles(nullptr, &position, 1, 8.0f, 16.0f);
+	EXPECT_TRUE(terrain->IsTileResident(2, 2));
+	EXPECT_FALSE(terrain->IsTileResident(7, 7));
+	EXPECT_NEAR(terrain->GetElevation(40, 40), 0.0f, 1.0e-4f);
+
+	Simulate(world, 120);
+	EXPECT_NEAR(sphere->GetMatrix().m_posit.m_y, 0.5f, 0.05f);
+
+	// moving the point of interest away must evict the tiles
+	const ndVector farPosition(120.0f, 2.0f, 120.0f, 1.0f);
+	terrain->StreamTiles(nullptr, &farPosition, 1, 8.0f, 16.0f);
+	EXPECT_FALSE(terrain->IsTileResident(2, 2));
+	EXPECT_TRUE(terrain->IsTileResident(7, 7));
+
+	world.CleanUp();
+}
+
+/* Tiles streamed through the scene background thread become resident after a few updates. */
+TEST(TiledHeightfield, BackgroundStreaming)
+{
+	ndWorld world;
+	world.SetSubSteps(2);
+	ndShapeHeightfieldTiled* const terrain = BuildTerrain(world);
+
+	const ndVector position(40.0f, 2.0f, 40.0f, 1.0f);
+	ndBodyDynamic* const sphere = BuildSphere(world, position);
+
+	// the pending tiles are collected by the next call
+	terrain->StreamTiles(world.GetScene(), &position, 1, 8.0f, 16.0f);
+	for (ndInt32 i = 0; (i < 600) && !terrain->IsTileResident(2, 2); ++i)
+	{
+		Simulate(world, 1);
+		terrain->StreamTiles(world.GetScene(), &position, 1, 8.0f, 16.0f);
+	}
+	ASSERT_TRUE(terrain->IsTileResident(2, 2));
+
+	Simulate(world, 120);
+	EXPECT_NEAR(sphere->GetMatrix().m_posit.m_y, 0.5f, 0.05f);
+
+	world.CleanUp();
+}
+
+/* The quantized elevation of a rolling terrain stays within one step of the source. */
+TEST(TiledHeightfield, QuantizedElevation)
+{
+	ndWorld world;
+	ndShapeHeightfieldTiled* const terrain = BuildTerrain(world, new csRollingTileLoader());
+
+	const ndVector center(64.0f, 0.0f, 64.0f, 1.0f);
+	terrain->StreamTiles(nullptr, &center, 1, 256.0f, 256.0f);
+	ASSERT_EQ(terrain->GetResidentTilesCount(), TILES_COUNT * TILES_COUNT);
+
+	// 16 bits over a 3 meter range
+	const ndFloat32 tolerance = 3.0f / 65535.0f;
+	const ndInt32 samples = TILES_COUNT * CELLS_PER_TILE + 1;
+	for (ndInt32 z = 0; z < samples; ++z)
+	{
+		for (ndInt32 x = 0; x < samples; ++x)
+		{
+			EXPECT_NEAR(terrain->GetElevation(x, z), RollingElevation(x, z), tolerance);
+		}
+	}
+
+	world.CleanUp();
+}
+
+/* The edge shared with a tile that is not resident comes from the resident tile. */
+TEST(TiledHeightfield, EdgeSamplesUseResidentTile)
+{
+	ndWorld world;
+	ndShapeHeightfieldTiled* const terrain = BuildTerrain(world, new csRollingTileLoader());
+
+	// only the tile at 0, 0 is resident
+	const ndVector corner(1.0f, 0.0f, 1.0f, 1.0f);
+	terrain->StreamTiles(nullptr, &corner, 1, 1.0f, 1.0f);
+	ASSERT_TRUE(terrain->IsTileResident(0, 0));
+	ASSERT_FALSE(terrain->IsTileResident(1, 0));
+	ASSERT_FALSE(terrain->IsTileResident(0, 1));
+
+	const ndFloat32 tolerance = 3.0f / 65535.0f;
+	for (ndInt32 i = 0; i <= CELLS_PER_TILE; ++i)
+	{
+		EXPECT_NEAR(terrain->GetElevation(CELLS_PER_TILE, i), RollingElevation(CELLS_PER_TILE, i), tolerance);
+		EXPECT_NEAR(terrain->GetElevation(i, CELLS_PER_TILE), RollingElevation(i, CELLS_PER_TILE), tolerance);
+	}
+	// the samples inside the missing tile stay conservative
+	EXPECT_EQ(terrain->GetElevation(CELLS_PER_TILE + 1, 0), MAX_ELEVATION);
+
+	world.CleanUp();
+}
@@ -10,6 +10,7 @@
  */
 
 #include "ndNewton.h"
+#include "testWorld.h"
 #include <gtest/gtest.h>
 
 class csBodyTrigger : public ndBodyTriggerVolume 
@@ -61,11 +62,82 @@ TEST(Collisions, TriggerCollision)
 	ndSharedPtr<ndBody> movingPtr(movingbody);
 	world.AddBody(movingPtr);
 
-	for (int i = 0; i < 480; i++)
+	Simulate(world, 480);
+
+	world.CleanUp();
+}
+
+// keeps the batched events of each step
+class ndBatchTrigger : public ndBodyTriggerVolume
+{
+	public:
+	ndBatchTrigger()
+		:ndBodyTriggerVolume()
+		,m_enterCount(0)
+		,m_exitCount(0)
+		,m_callCount(0)
+		,m_sorted(true)
+	{
+	}
+
+	virtual void OnTriggerEvents(ndFloat32)
+	{
+		m_callCount++;
+		m_enterCount += ndInt32(GetEnterBodies().GetCount());
+		m_exitCount += ndInt32(GetExitBodies().GetCount());
+		const ndArray<ndBodyKinematic*>& overlaps = GetOverlaps();
+		for (ndInt32 i = 1; i < overlaps.GetCount(); ++i)
+		{
+			m_sorted = m_sorted && (overlaps[i - 1]->GetId() < overlaps[i]->GetId());
+		}
+	}
+
+	ndInt32 m_enterCount;
+	ndInt32 m_exitCount;
+	ndInt32 m_callCount;
+	bool m_sorted;
+};
+
+/* The trigger keeps the bodies inside it, static bodies never enter, and removed bodies are forgotten. */
+TEST(Collisions, TriggerOverlapSet)
+{
+	ndWorld world;
+	AddBox(world, ndVector(ndFloat32(0.0f), ndFloat32(-5.0f), ndFloat32(0.0f), ndFloat32(1.0f)), ndVector(10.0f, 10.0f, 10.0f, 0.0f), ndFloat32(0.0f));
+
+	ndShapeInstance shape(new ndShapeBox(ndFloat32(4.0f), ndFloat32(2.0f), ndFloat32(4.0f)));
+	ndBatchTrigger* const trigger = new ndBatchTrigger();
+	ndMatrix matrix(ndGetIdentityMatrix());
+	matrix.m_posit.m_y = ndFloat32(1.0f);
+	trigger->SetCollisionShape(shape);
+	trigger->SetMatrix(matrix);
+	ndSharedPtr<ndBody> triggerPtr(trigger);
+	world.AddBody(triggerPtr);
+
+	// a static box inside the trigger, and a few boxes falling into it
+	AddBox(world, ndVector(ndFloat32(1.0f), ndFloat32(1.0f), ndFloat32(1.0f), ndFloat32(1.0f)), ndVector(0.5f, 0.5f, 0.5f, 0.0f), ndFloat32(0.0f));
+	ndBodyDynamic* boxes[5];
+	for (ndInt32 i = 0; i < 5; ++i)
 	{
-		world.Update(1.0f / 60.0f);
-		world.Sync();
+		boxes[i] = AddBox(world, ndVector(ndFloat32(i) * ndFloat32(0.6f) - ndFloat32(1.2f), ndFloat32(3.0f), ndFloat32(-1.0f), ndFloat32(1.0f)), ndVector(0.25f, 0.25f, 0.25f, 0.0f), ndFloat32(1.0f));
 	}
 
+	Simulate(world, 60);
+	EXPECT_EQ(trigger->GetOverlaps().GetCount(), 5);
+	EXPECT_EQ(trigger->m_enterCount, 5);
+	EXPECT_EQ(trigger->m_exitCount, 0);
+	EXPECT_GE(trigger->m_callCount, 30);
+	EXPECT_TRUE(trigger->m_sorted);
+
+	// a removed body has no exit call back, but it is not inside anymore
+	world.RemoveBody(boxes[0]);
+	Simulate(world, 1);
+	EXPECT_EQ(trigger->GetOverlaps().GetCount(), 4);
+
+	// throw a box out of the trigger
+	boxes[1]->SetVelocity(ndVector(ndFloat32(0.0f), ndFloat32(20.0f), ndFloat32(0.0f), ndFloat32(0.0f)));
+	Simulate(world, 30);
+	EXPECT_EQ(trigger->m_exitCount, 1);
+	EXPECT_EQ(trigger->GetOverlaps().GetCount(), 3);
+
 	world.CleanUp();
-}
\ No newline at end of file
+}
@@ -0,0 +1,119 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include <cstdio>
+#include "ndNewton.h"
+#include "testWorld.h"
+#include <gtest/gtest.h>
+
+/* Simulating after a restore must replay the same trajectories. */
+TEST(WorldSnapshot, RollbackReplaysSameState)
+{
+	ndWorld world;
+	ndArray<ndBodyDynamic*> bodies;
+	AddBox(world, ndVector(0.0f, -0.5f, 0.0f, 1.0f), ndVector(1.0f, 1.0f, 1.0f, 0.0f), 0.0f);
+	for (ndInt32 i = 0; i < 6; ++i)
+	{
+		bodies.PushBack(AddBox(world, ndVector(0.1f * ndFloat32(i), 0.6f + 1.1f * ndFloat32(i), 0.0f, 1.0f), ndVector(1.0f, 1.0f, 1.0f, 0.0f), 1.0f));
+	}
+
+	ndBodyDynamic* const pendulum = AddBox(world, ndVector(5.0f, 3.0f, 0.0f, 1.0f), ndVector(1.0f, 1.0f, 1.0f, 0.0f), 1.0f);
+	ndSharedPtr<ndJointBilateralConstraint> joint(new ndJointFixDistance(ndVector(5.0f, 3.0f, 0.0f, 1.0f), ndVector(3.0f, 4.0f, 0.0f, 1.0f), pendulum, world.GetSentinelBody()));
+	world.AddJoint(joint);
+	bodies.PushBack(pendulum);
+
+	Simulate(world, 30);
+
+	ndArray<ndUnsigned8> snapshot;
+	snapshot.SetCount(ndInt32(world.GetSnapshotSize()));
+	ASSERT_EQ(world.SaveSnapshot(&snapshot[0], snapshot.GetCount()), ndInt64(snapshot.GetCount()));
+	EXPECT_GT(world.GetContactList().GetCount(), 0);
+
+	Simulate(world, 40);
+	ndArray<ndVector> positions;
+	for (ndInt32 i = 0; i < bodies.GetCount(); ++i)
+	{
+		positions.PushBack(bodies[i]->GetMatrix().m_posit);
+	}
+
+	// a buffer that is too small must be rejected
+	EXPECT_EQ(world.SaveSnapshot(&snapshot[0], 16), 0);
+
+	ASSERT_TRUE(world.RestoreSnapshot(&snapshot[0], snapshot.GetCount()));
+	Simulate(world, 40);
+	for (ndInt32 i = 0; i < bodies.GetCount(); ++i)
+	{
+		const ndVector posit(bodies[i]->GetMatrix().m_posit);
+		EXPECT_NEAR(posit.m_x, positions[i].m_x, 1.0e-4f);
+		EXPECT_NEAR(posit.m_y, positions[i].m_y, 1.0e-4f);
+		EXPECT_NEAR(posit.m_z, positions[i].m_z, 1.0e-4f);
+	}
+
+	world.CleanUp();
+}
+
+/* A snapshot can not be restored after the bodies in the world changed. */
+TEST(WorldSnapshot, RejectsDifferentWorld)
+{
+	ndWorld world;
+	AddBox(world, ndVector(0.0f, -0.5f, 0.0f, 1.0f), ndVector(1.0f, 1.0f, 1.0f, 0.0f), 0.0f);
+	AddBox(world, ndVector(0.0f, 2.0f, 0.0f, 1.0f), ndVector(1.0f, 1.0f, 1.0f, 0.0f), 1.0f);
+	Simulate(world, 2);
+
+	ndArray<ndUnsigned8> snapshot;
+	snapshot.SetCount(ndInt32(world.GetSnapshotSize()));
+	ASSERT_GT(world.SaveSnapshot(&snapshot[0], snapshot.GetCount()), 0);
+
+	AddBox(world, ndVector(3.0f, 2.0f, 0.0f, 1.0f), ndVector(1.0f, 1.0f, 1.0f, 0.0f), 1.0f);
+	Simulate(world, 1);
+	EXPECT_FALSE(world.RestoreSnapshot(&snapshot[0], snapshot.GetCount()));
+
+	world.CleanUp();
+}
+
+/* Saving and restoring runs on the worker threads of the world. */
+TEST(WorldSnapshot, ThreadedRestore)
+{
+	ndWorld world;
+	world.SetThreadCount(4);
+	if (world.GetThreadCount() < 2)
+	{
+		GTEST_SKIP() << "needs more than one thread";
+	}
+	AddBox(world, ndVector(0.0f, -0.5f, 0.0f, 1.0f), ndVector(1.0f, 1.0f, 1.0f, 0.0f), 0.0f);
+	ndArray<ndBodyDynamic*> bodies;
+	for (ndInt32 i = 0; i < 64; ++i)
+	{
+		bodies.PushBack(AddBox(world, ndVector(1.5f * ndFloat32(i % 8), 0.6f + 1.1f * ndFloat32(i / 8), 0.0f, 1.0f), ndVector(1.0f, 1.0f, 1.0f, 0.0f), 1.0f));
+	}
+	Simulate(world, 20);
+
+	ndArray<ndUnsigned8> snapshot;
+	snapshot.SetCount(ndInt32(world.GetSnapshotSize()));
+	ASSERT_EQ(world.SaveSnapshot(&snapshot[0], snapshot.GetCount()), ndInt64(snapshot.GetCount()));
+	ndArray<ndVector> positions;
+	for (ndInt32 i = 0; i < bodies.GetCount(); ++i)
+	{
+		positions.PushBack(bodies[i]->GetMatrix().m_posit);
+	}
+
+	Simulate(world, 20);
+	ASSERT_TRUE(world.RestoreSnapshot(&snapshot[0], snapshot.GetCount()));
+	for (ndInt32 i = 0; i < bodies.GetCount(); ++i)
+	{
+		const ndVector posit(bodies[i]->GetMatrix().m_posit);
+		EXPECT_EQ(posit.m_x, positions[i].m_x);
+		EXPECT_EQ(posit.m_y, positions[i].m_y);
+		EXPECT_EQ(posit.m_z, positions[i].m_z);
+	}
+
+	world.CleanUp();
+}